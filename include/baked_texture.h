@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GRATE_BAKED_TEXTURE_H
+#define GRATE_BAKED_TEXTURE_H 1
+
+#include <stdint.h>
+
+#define BAKED_TEX_MAGIC		"grateTEX"
+#define BAKED_TEX_VER		1
+
+/* payloads start on a page boundary of the file */
+#define BAKED_TEX_PAYLOAD_ALIGN	4096
+
+/*
+ * A baked texture holds the payloads of a texture exactly as they are
+ * stored in the pixelbuffer BO, so that loading it is a plain copy out of
+ * the mapped file: pixels are flipped vertically like grate_texture_load()
+ * does, compressed, swizzled into the GR3D ETC1 word order and, for the
+ * tiled layout, tiled into 16x16 byte tiles.
+ *
+ * Level 0 is laid out like grate_create_texture() allocates the texture,
+ * with the pitch aligned to PIX_BUF_FORMAT_ALIGNMENT() and, if tiled, to
+ * the 256 bytes of a tile row. Further levels are laid out like the mipmap
+ * pixelbuffer with a 16 bytes aligned pitch, which requires a linear base
+ * level with power of two dimensions. Compressed formats count rows of 4x4
+ * blocks.
+ */
+struct __attribute__((packed)) baked_texture_level {
+	uint32_t width;
+	uint32_t height;
+	uint32_t pitch;
+	uint32_t rows;
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct __attribute__((packed)) baked_texture_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t format;
+	uint32_t layout;
+	uint32_t width;
+	uint32_t height;
+	uint32_t num_levels;
+	struct baked_texture_level levels[];
+};
+
+#endif
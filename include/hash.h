@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GRATE_HASH_H
+#define GRATE_HASH_H 1
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Open addressing hash table with linear probing that maps 64bit keys to
+ * non-NULL pointers. A zero-initialized table is empty and valid. The table
+ * is kept at most half full, so probe sequences stay short, and removal
+ * shifts the following entries back instead of leaving tombstones.
+ */
+struct hash_entry {
+	uint64_t key;
+	void *value;
+};
+
+struct hash_table {
+	struct hash_entry *entries;
+	unsigned int size;
+	unsigned int count;
+};
+
+#define HASH_TABLE_MIN_SIZE	64
+
+static inline uint64_t hash_key(uint32_t hi, uint32_t lo)
+{
+	return ((uint64_t)hi << 32) | lo;
+}
+
+static inline unsigned int hash_index(const struct hash_table *ht,
+				      uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+
+	return key & (ht->size - 1);
+}
+
+static inline void *hash_table_lookup(const struct hash_table *ht,
+				      uint64_t key)
+{
+	struct hash_entry *entry;
+	unsigned int i;
+
+	if (!ht->count)
+		return NULL;
+
+	for (i = hash_index(ht, key); ; i = (i + 1) & (ht->size - 1)) {
+		entry = &ht->entries[i];
+
+		if (!entry->value)
+			return NULL;
+
+		if (entry->key == key)
+			return entry->value;
+	}
+}
+
+static inline void hash_table_place(struct hash_table *ht, uint64_t key,
+				    void *value)
+{
+	struct hash_entry *entry;
+	unsigned int i;
+
+	for (i = hash_index(ht, key); ; i = (i + 1) & (ht->size - 1)) {
+		entry = &ht->entries[i];
+
+		if (!entry->value) {
+			ht->count++;
+			break;
+		}
+
+		if (entry->key == key)
+			break;
+	}
+
+	entry->key = key;
+	entry->value = value;
+}
+
+static inline int hash_table_resize(struct hash_table *ht, unsigned int size)
+{
+	struct hash_entry *entries = ht->entries;
+	unsigned int old_size = ht->size;
+	unsigned int i;
+
+	ht->entries = calloc(size, sizeof(*ht->entries));
+	if (!ht->entries) {
+		ht->entries = entries;
+		return -ENOMEM;
+	}
+
+	ht->size = size;
+	ht->count = 0;
+
+	for (i = 0; i < old_size; i++)
+		if (entries[i].value)
+			hash_table_place(ht, entries[i].key, entries[i].value);
+
+	free(entries);
+
+	return 0;
+}
+
+/* inserts @value under @key, replacing the value of an existing key */
+static inline int hash_table_insert(struct hash_table *ht, uint64_t key,
+				    void *value)
+{
+	unsigned int size;
+	int err;
+
+	if ((ht->count + 1) * 2 > ht->size) {
+		size = ht->size ? ht->size * 2 : HASH_TABLE_MIN_SIZE;
+
+		err = hash_table_resize(ht, size);
+		if (err < 0)
+			return err;
+	}
+
+	hash_table_place(ht, key, value);
+
+	return 0;
+}
+
+static inline void hash_table_remove(struct hash_table *ht, uint64_t key)
+{
+	unsigned int mask = ht->size - 1;
+	unsigned int i, j, k;
+
+	if (!ht->count)
+		return;
+
+	for (i = hash_index(ht, key); ; i = (i + 1) & mask) {
+		if (!ht->entries[i].value)
+			return;
+
+		if (ht->entries[i].key == key)
+			break;
+	}
+
+	/*
+	 * Move the entries that follow in the same cluster back if the
+	 * removed slot lies on their probe sequence.
+	 */
+	for (j = (i + 1) & mask; ht->entries[j].value; j = (j + 1) & mask) {
+		k = hash_index(ht, ht->entries[j].key);
+
+		if (((j - k) & mask) >= ((j - i) & mask)) {
+			ht->entries[i] = ht->entries[j];
+			i = j;
+		}
+	}
+
+	ht->entries[i].value = NULL;
+	ht->count--;
+}
+
+static inline void hash_table_fini(struct hash_table *ht)
+{
+	free(ht->entries);
+
+	ht->entries = NULL;
+	ht->size = 0;
+	ht->count = 0;
+}
+
+#endif
@@ -25,10 +25,12 @@
 #ifndef GRATE_HOST1X_H
 #define GRATE_HOST1X_H 1
 
+#include <errno.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifndef BIT
 #define BIT(x) (1 << (x))
@@ -181,6 +183,42 @@ void host1x_pixelbuffer_check_guard(struct host1x_pixelbuffer *pixbuf);
 void host1x_pixelbuffer_disable_bo_guard(void);
 bool host1x_pixelbuffer_bo_guard_disabled(void);
 
+/*
+ * Expand block-compressed data to RGBA8888. The block functions write a
+ * 4x4 block of pixels with the given pitch in bytes, ETC1 blocks are taken
+ * in the word order used by GR3D.
+ */
+void host1x_decompress_dxt1_block(const void *block, void *dst,
+				  unsigned int pitch);
+void host1x_decompress_dxt3_block(const void *block, void *dst,
+				  unsigned int pitch);
+void host1x_decompress_dxt5_block(const void *block, void *dst,
+				  unsigned int pitch);
+void host1x_decompress_etc1_block(const void *block, void *dst,
+				  unsigned int pitch);
+int host1x_decompress_image(const void *data, unsigned int data_pitch,
+			    enum pixel_format format,
+			    unsigned int width, unsigned int height,
+			    void *dst, unsigned int dst_pitch);
+int host1x_pixelbuffer_decompress(struct host1x_pixelbuffer *pixbuf,
+				  void *dst, unsigned int dst_pitch);
+
+/*
+ * Convert between linear and 16x16 tiled data on the CPU. The rectangle is
+ * given in pixels (texels of compressed formats, which must be block
+ * aligned) within the tiled surface, @linear points at its first pixel.
+ */
+int host1x_tile_rect(void *tiled, unsigned int tiled_pitch,
+		     const void *linear, unsigned int linear_pitch,
+		     enum pixel_format format,
+		     unsigned int x, unsigned int y,
+		     unsigned int width, unsigned int height);
+int host1x_detile_rect(void *linear, unsigned int linear_pitch,
+		       const void *tiled, unsigned int tiled_pitch,
+		       enum pixel_format format,
+		       unsigned int x, unsigned int y,
+		       unsigned int width, unsigned int height);
+
 struct host1x_options {
 	unsigned int rotate_display;
 	bool open_display;
@@ -339,6 +377,8 @@ struct host1x_pushbuf_reloc {
 	unsigned long shift;
 };
 
+struct host1x_cmdring;
+
 struct host1x_pushbuf {
 	struct host1x_bo *bo;
 	unsigned long offset;
@@ -346,8 +386,13 @@ struct host1x_pushbuf {
 
 	struct host1x_pushbuf_reloc *relocs;
 	unsigned long num_relocs;
+	unsigned long max_relocs;
 
 	uint32_t *ptr;
+	uint32_t *end;
+
+	/* command ring the pushbuf was taken from, grows on overflow */
+	struct host1x_cmdring *ring;
 };
 
 struct host1x_job {
@@ -356,20 +401,112 @@ struct host1x_job {
 
 	struct host1x_pushbuf *pushbufs;
 	unsigned int num_pushbufs;
+	unsigned int max_pushbufs;
 };
 
 struct host1x_job *host1x_job_create(uint32_t syncpt, uint32_t increments);
 void host1x_job_free(struct host1x_job *job);
+int host1x_job_reserve_pushbufs(struct host1x_job *job, unsigned int count);
 struct host1x_pushbuf *host1x_job_append(struct host1x_job *job,
 					 struct host1x_bo *bo,
 					 unsigned long offset);
-int host1x_pushbuf_push(struct host1x_pushbuf *pb, uint32_t word);
+int host1x_pushbuf_grow(struct host1x_pushbuf *pb, unsigned long words);
+int host1x_pushbuf_reserve_relocs(struct host1x_pushbuf *pb,
+				  unsigned long count);
 int host1x_pushbuf_relocate(struct host1x_pushbuf *pb, struct host1x_bo *target,
 			    unsigned long offset, unsigned long shift);
+int host1x_pushbuf_relocate_word(struct host1x_pushbuf *pb, uint32_t *word,
+				 struct host1x_bo *target,
+				 unsigned long offset, unsigned long shift);
 int host1x_client_submit(struct host1x_client *client, struct host1x_job *job);
 int host1x_client_flush(struct host1x_client *client, uint32_t *fence);
 int host1x_client_wait(struct host1x_client *client, uint32_t fence,
 		       uint32_t timeout);
+int host1x_client_poll(struct host1x_client *client);
+
+/*
+ * Fence of the jobs submitted to a client, signaled once the syncpoint of
+ * the client reached @value. A fence without a client is always signaled.
+ */
+struct host1x_fence {
+	struct host1x_client *client;
+	uint32_t value;
+};
+
+typedef void (*host1x_fence_func_t)(const struct host1x_fence *fence,
+				    void *data);
+
+int host1x_fence_poll(const struct host1x_fence *fence);
+int host1x_fence_wait(const struct host1x_fence *fence, uint32_t timeout);
+int host1x_fence_wait_any(const struct host1x_fence *fences,
+			  unsigned int count, uint32_t timeout,
+			  unsigned int *index);
+int host1x_fence_add_callback(const struct host1x_fence *fence,
+			      host1x_fence_func_t func, void *data);
+
+struct host1x_cmdring *host1x_cmdring_create(struct host1x *host1x,
+					     struct host1x_client *client,
+					     unsigned int num_segments,
+					     size_t segment_size);
+void host1x_cmdring_free(struct host1x_cmdring *ring);
+struct host1x_pushbuf *host1x_cmdring_append(struct host1x_cmdring *ring,
+					     struct host1x_job *job);
+int host1x_cmdring_submit(struct host1x_cmdring *ring, struct host1x_job *job);
+int host1x_cmdring_flush(struct host1x_cmdring *ring, uint32_t *fence);
+
+/*
+ * Make room for @words words and return where to write them. The words are
+ * added to the pushbuf by host1x_pushbuf_commit(), relocations for words of
+ * the reserved span are added with host1x_pushbuf_relocate_word(). The span
+ * stays valid until the next word is reserved or pushed.
+ */
+static inline uint32_t *host1x_pushbuf_reserve(struct host1x_pushbuf *pb,
+					       unsigned long words)
+{
+	if ((unsigned long)(pb->end - pb->ptr) < words &&
+	    host1x_pushbuf_grow(pb, words) < 0)
+		return NULL;
+
+	return pb->ptr;
+}
+
+static inline void host1x_pushbuf_commit(struct host1x_pushbuf *pb,
+					 unsigned long words)
+{
+	pb->ptr += words;
+	pb->length += words;
+}
+
+static inline int host1x_pushbuf_push(struct host1x_pushbuf *pb, uint32_t word)
+{
+	int err;
+
+	if (pb->ptr == pb->end) {
+		err = host1x_pushbuf_grow(pb, 1);
+		if (err < 0)
+			return err;
+	}
+
+	*pb->ptr++ = word;
+	pb->length++;
+
+	return 0;
+}
+
+static inline int host1x_pushbuf_push_data(struct host1x_pushbuf *pb,
+					   const uint32_t *words,
+					   unsigned long count)
+{
+	uint32_t *ptr = host1x_pushbuf_reserve(pb, count);
+
+	if (!ptr)
+		return -ENOSPC;
+
+	memcpy(ptr, words, count * sizeof(*words));
+	host1x_pushbuf_commit(pb, count);
+
+	return 0;
+}
 
 static inline int host1x_pushbuf_push_float(struct host1x_pushbuf *pb, float f)
 {
@@ -415,6 +552,20 @@ static inline int host1x_pushbuf_relocate_helper(struct host1x_pushbuf *pb,
 	return err;
 }
 
+static inline int host1x_pushbuf_relocate_word_helper(
+						struct host1x_pushbuf *pb,
+						uint32_t *word,
+						struct host1x_bo *target,
+						unsigned long offset,
+						unsigned long shift,
+						const char *file, int line)
+{
+	int err = host1x_pushbuf_relocate_word(pb, word, target, offset, shift);
+	if (err)
+		host1x_error("host1x_pushbuf_relocate_word() failed %d\n", err);
+	return err;
+}
+
 static inline int host1x_client_submit_helper(struct host1x_client *client,
 					      struct host1x_job *job,
 					      const char *file, int line)
@@ -455,6 +606,10 @@ static inline int host1x_client_wait_helper(struct host1x_client *client,
 	host1x_pushbuf_relocate_helper(pb, target, offset, shift, \
 					__FILE__, __LINE__)
 
+#define HOST1X_PUSHBUF_RELOCATE_WORD(pb, word, target, offset, shift) \
+	host1x_pushbuf_relocate_word_helper(pb, word, target, offset, shift, \
+					    __FILE__, __LINE__)
+
 #define HOST1X_CLIENT_SUBMIT(client, job) \
 	host1x_client_submit_helper(client, job, __FILE__, __LINE__)
 
@@ -492,6 +647,13 @@ int host1x_gr2d_blit(struct host1x_gr2d *gr2d,
 		     unsigned int sx, unsigned int sy,
 		     unsigned int dx, unsigned int dy,
 		     unsigned int width, int height);
+int host1x_gr2d_blit_async(struct host1x_gr2d *gr2d,
+			   struct host1x_pixelbuffer *src,
+			   struct host1x_pixelbuffer *dst,
+			   unsigned int sx, unsigned int sy,
+			   unsigned int dx, unsigned int dy,
+			   unsigned int width, int height,
+			   struct host1x_fence *fence);
 int host1x_gr2d_surface_blit(struct host1x_gr2d *gr2d,
 			     struct host1x_pixelbuffer *src,
 			     struct host1x_pixelbuffer *dst,
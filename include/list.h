@@ -78,6 +78,11 @@ static inline void list_del(struct list_head *entry)
 	__list_del(entry->prev, entry->next);
 }
 
+static inline int list_empty(const struct list_head *head)
+{
+	return head->next == head;
+}
+
 #define list_entry(ptr, type, member) \
 	container_of(ptr, type, member)
 
@@ -90,7 +95,7 @@ static inline void list_del(struct list_head *entry)
 	     pos = list_entry(pos->member.next, typeof(*pos), member))
 
 #define list_for_each_entry_safe(pos, n, head, member) \
-	for (pos = list_entry(head, typeof(*pos), member), \
+	for (pos = list_entry((head)->next, typeof(*pos), member), \
 		n = list_entry(pos->member.next, typeof(*pos), member); \
 	     &pos->member != (head); \
 	     pos = n, n = list_entry(n->member.next, typeof(*pos), member))
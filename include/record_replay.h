@@ -24,10 +24,15 @@
 #ifndef GRATE_RECORD_REPLAY_H
 #define GRATE_RECORD_REPLAY_H 1
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define REC_MAGIC	"grateREC"
 
+/* version written by the recorder, the oldest one replay still reads */
+#define REC_VER		0x0007
+#define REC_MIN_VER	0x0004
+
 enum record_action {
 	REC_START,
 	REC_INFO,
@@ -43,6 +48,10 @@ enum record_action {
 	REC_JOB_CTX_CREATE,
 	REC_JOB_CTX_DESTROY,
 	REC_JOB_SUBMIT,
+	REC_KEYFRAME,
+	REC_INDEX,
+	REC_BO_LOAD_REF,
+	REC_TIMESTAMP,
 };
 
 struct __attribute__((packed)) record_gather {
@@ -60,6 +69,41 @@ struct __attribute__((packed)) record_reloc {
 	uint32_t patch_offset;
 };
 
+/*
+ * Version 5 records are seekable. Every few frames the recorder writes a
+ * keyframe: a REC_KEYFRAME action followed by a block of actions that
+ * recreate all live objects and the contents of all mapped BOs. Replaying
+ * from the start skips keyframes, seeking replays the nearest keyframe and
+ * continues right after it.
+ *
+ * A finished record ends with a REC_INDEX action, followed by the 64bit
+ * offsets of all frames plus the offset where the last frame ended, the
+ * keyframes and a trailer that points at the action. A frame ends with a
+ * REC_DISP_FRAMEBUFFER, its offset is the one of the action that follows
+ * the end of the previous frame.
+ *
+ * Version 6 records store every page content only once. A REC_BO_LOAD_REF
+ * loads the page of the REC_BO_LOAD_DATA action at @offset again, the
+ * referenced action may precede the keyframe that a replay seeks to.
+ *
+ * Version 7 records put a REC_TIMESTAMP in front of every REC_JOB_SUBMIT and
+ * REC_DISP_FRAMEBUFFER, outside of keyframes. Times are in nanoseconds of
+ * the monotonic clock, @time counts from the start of the recording. The
+ * application spent @cpu_gap computing and @wait waiting for syncpoints
+ * since its previous job or display call returned.
+ */
+#define REC_INDEX_MAGIC	"grateIDX"
+
+struct __attribute__((packed)) record_keyframe {
+	uint32_t frame;
+	uint64_t offset;
+};
+
+struct __attribute__((packed)) record_trailer {
+	uint64_t index_offset;
+	char magic[8];
+};
+
 enum record_compression {
 	REC_UNCOMPRESSED,
 	REC_ZLIB,
@@ -109,6 +153,13 @@ struct __attribute__((packed)) record_act {
 			uint16_t data_size;
 		} bo_load;
 
+		struct bo_load_ref {
+			uint16_t id;
+			uint16_t ctx_id;
+			uint32_t page_id;
+			uint64_t offset;
+		} bo_load_ref;
+
 		struct bo_set_flags {
 			uint16_t id;
 			uint16_t ctx_id;
@@ -150,7 +201,70 @@ struct __attribute__((packed)) record_act {
 			uint16_t num_relocs;
 			uint16_t num_syncpt_incrs;
 		} job_submit;
+
+		struct keyframe {
+			uint32_t frame;
+			uint64_t size;
+		} keyframe;
+
+		struct index {
+			uint32_t num_frames;
+			uint32_t num_keyframes;
+		} index;
+
+		struct timestamp {
+			uint64_t time;
+			uint64_t cpu_gap;
+			uint64_t wait;
+		} timestamp;
 	} data;
 };
 
+/* size of the data of an action, not including any payload following it */
+static inline size_t record_action_size(uint32_t act)
+{
+	struct record_act *r = NULL;
+
+	switch (act) {
+	case REC_START:
+		return sizeof(r->data.header);
+	case REC_INFO:
+		return sizeof(r->data.record_info);
+	case REC_CTX_CREATE:
+		return sizeof(r->data.ctx_create);
+	case REC_CTX_DESTROY:
+		return sizeof(r->data.ctx_destroy);
+	case REC_BO_CREATE:
+		return sizeof(r->data.bo_create);
+	case REC_BO_DESTROY:
+		return sizeof(r->data.bo_destroy);
+	case REC_BO_LOAD_DATA:
+		return sizeof(r->data.bo_load);
+	case REC_BO_SET_FLAGS:
+		return sizeof(r->data.bo_set_flags);
+	case REC_ADD_FRAMEBUFFER:
+		return sizeof(r->data.add_framebuffer);
+	case REC_DEL_FRAMEBUFFER:
+		return sizeof(r->data.del_framebuffer);
+	case REC_DISP_FRAMEBUFFER:
+		return sizeof(r->data.disp_framebuffer);
+	case REC_JOB_CTX_CREATE:
+		return sizeof(r->data.job_ctx_create);
+	case REC_JOB_CTX_DESTROY:
+		return sizeof(r->data.job_ctx_destroy);
+	case REC_JOB_SUBMIT:
+		return sizeof(r->data.job_submit);
+	case REC_KEYFRAME:
+		return sizeof(r->data.keyframe);
+	case REC_INDEX:
+		return sizeof(r->data.index);
+	case REC_BO_LOAD_REF:
+		return sizeof(r->data.bo_load_ref);
+	case REC_TIMESTAMP:
+		return sizeof(r->data.timestamp);
+	default:
+		return 0;
+	}
+}
+
 #endif
@@ -12,7 +12,18 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 #include "etc1.h"
+#include <pthread.h>
 #include <string.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define ETC1_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ETC1_NEON
+#endif
+// Upper limit of the threads that encode an image
+#define ETC1_MAX_THREADS 16
 /* From http://www.khronos.org/registry/gles/extensions/OES/OES_compressed_ETC1_RGB8_texture.txt
  The number of bits that represent a 4x4 texel block is 64 bits if
  <internalformat> is given by ETC1_RGB8_OES.
@@ -248,78 +259,226 @@ static
 inline int square(int x) {
     return x * x;
 }
-static etc1_uint32 chooseModifier(const etc1_byte* pBaseColors,
-        const etc1_byte* pIn, etc1_uint32 *pLow, int bitIndex,
-        const int* pModifierTable) {
-    etc1_uint32 bestScore = ~0;
-    int bestIndex = 0;
-    int pixelR = pIn[0];
-    int pixelG = pIn[1];
-    int pixelB = pIn[2];
-    int r = pBaseColors[0];
-    int g = pBaseColors[1];
-    int b = pBaseColors[2];
-    for (int i = 0; i < 4; i++) {
-        int modifier = pModifierTable[i];
-        int decodedG = clamp(g + modifier);
-        etc1_uint32 score = (etc1_uint32) (6 * square(decodedG - pixelG));
-        if (score >= bestScore) {
-            continue;
+// Pixels of a sub-block in the order the encoder visits them. bit[i] is the
+// position of the pixel's index bits in the low word, valid[i] is ~0 for the
+// pixels that count and 0 for the ones outside of the image.
+typedef struct {
+    short r[8];
+    short g[8];
+    short b[8];
+    int valid[8];
+    int bit[8];
+    int count;
+} etc_subblock;
+static
+void etc_load_subblock(const etc1_byte* pIn, etc1_uint32 inMask,
+        etc_subblock* pSub, bool flipped, bool second) {
+    int n = 0;
+    pSub->count = 0;
+    for (int j = 0; j < 8; j++) {
+        int x, y;
+        if (flipped) {
+            x = j & 3;
+            y = (j >> 2) + (second ? 2 : 0);
+        } else {
+            x = (j & 1) + (second ? 2 : 0);
+            y = j >> 1;
         }
-        int decodedR = clamp(r + modifier);
-        score += (etc1_uint32) (3 * square(decodedR - pixelR));
-        if (score >= bestScore) {
-            continue;
+        int i = x + 4 * y;
+        const etc1_byte* p = pIn + i * 3;
+        pSub->r[n] = p[0];
+        pSub->g[n] = p[1];
+        pSub->b[n] = p[2];
+        pSub->bit[n] = y + x * 4;
+        pSub->valid[n] = (inMask & (1 << i)) ? ~0 : 0;
+        if (pSub->valid[n]) {
+            pSub->count++;
         }
-        int decodedB = clamp(b + modifier);
-        score += (etc1_uint32) square(decodedB - pixelB);
-        if (score < bestScore) {
-            bestScore = score;
-            bestIndex = i;
+        n++;
+    }
+}
+// Scores a modifier table for the pixels of a sub-block: every pixel takes the
+// modifier with the lowest weighted error, the first one on a tie. Returns the
+// summed error of the valid pixels and stores the chosen modifier indices.
+#if defined(ETC1_SSE2)
+static
+etc1_uint32 etc_score_table(const etc_subblock* pSub,
+        const etc1_byte* pBaseColors, const int* pModifierTable,
+        int* pIndices) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i r = _mm_loadu_si128((const __m128i*) pSub->r);
+    __m128i g = _mm_loadu_si128((const __m128i*) pSub->g);
+    __m128i b = _mm_loadu_si128((const __m128i*) pSub->b);
+    __m128i bestLo = _mm_set1_epi32(0x7fffffff);
+    __m128i bestHi = bestLo;
+    __m128i indexLo = zero;
+    __m128i indexHi = zero;
+    for (int i = 0; i < 4; i++) {
+        int modifier = pModifierTable[i];
+        __m128i dr = _mm_sub_epi16(r, _mm_set1_epi16(clamp(pBaseColors[0] + modifier)));
+        __m128i dg = _mm_sub_epi16(g, _mm_set1_epi16(clamp(pBaseColors[1] + modifier)));
+        __m128i db = _mm_sub_epi16(b, _mm_set1_epi16(clamp(pBaseColors[2] + modifier)));
+        __m128i dr3 = _mm_mullo_epi16(dr, _mm_set1_epi16(3));
+        __m128i dg6 = _mm_mullo_epi16(dg, _mm_set1_epi16(6));
+        // 3 * dR^2 + 6 * dG^2 + dB^2 of the pixels 0-3 and 4-7
+        __m128i errLo = _mm_add_epi32(
+                _mm_madd_epi16(_mm_unpacklo_epi16(dr, dg),
+                        _mm_unpacklo_epi16(dr3, dg6)),
+                _mm_madd_epi16(_mm_unpacklo_epi16(db, zero),
+                        _mm_unpacklo_epi16(db, zero)));
+        __m128i errHi = _mm_add_epi32(
+                _mm_madd_epi16(_mm_unpackhi_epi16(dr, dg),
+                        _mm_unpackhi_epi16(dr3, dg6)),
+                _mm_madd_epi16(_mm_unpackhi_epi16(db, zero),
+                        _mm_unpackhi_epi16(db, zero)));
+        __m128i index = _mm_set1_epi32(i);
+        __m128i ltLo = _mm_cmplt_epi32(errLo, bestLo);
+        __m128i ltHi = _mm_cmplt_epi32(errHi, bestHi);
+        bestLo = _mm_or_si128(_mm_and_si128(ltLo, errLo),
+                _mm_andnot_si128(ltLo, bestLo));
+        bestHi = _mm_or_si128(_mm_and_si128(ltHi, errHi),
+                _mm_andnot_si128(ltHi, bestHi));
+        indexLo = _mm_or_si128(_mm_and_si128(ltLo, index),
+                _mm_andnot_si128(ltLo, indexLo));
+        indexHi = _mm_or_si128(_mm_and_si128(ltHi, index),
+                _mm_andnot_si128(ltHi, indexHi));
+    }
+    __m128i validLo = _mm_loadu_si128((const __m128i*) pSub->valid);
+    __m128i validHi = _mm_loadu_si128((const __m128i*) (pSub->valid + 4));
+    _mm_storeu_si128((__m128i*) pIndices, _mm_and_si128(indexLo, validLo));
+    _mm_storeu_si128((__m128i*) (pIndices + 4), _mm_and_si128(indexHi, validHi));
+    __m128i sum = _mm_add_epi32(_mm_and_si128(bestLo, validLo),
+            _mm_and_si128(bestHi, validHi));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (etc1_uint32) _mm_cvtsi128_si32(sum);
+}
+#elif defined(ETC1_NEON)
+static
+etc1_uint32 etc_score_table(const etc_subblock* pSub,
+        const etc1_byte* pBaseColors, const int* pModifierTable,
+        int* pIndices) {
+    int16x8_t r = vld1q_s16(pSub->r);
+    int16x8_t g = vld1q_s16(pSub->g);
+    int16x8_t b = vld1q_s16(pSub->b);
+    int32x4_t bestLo = vdupq_n_s32(0x7fffffff);
+    int32x4_t bestHi = bestLo;
+    int32x4_t indexLo = vdupq_n_s32(0);
+    int32x4_t indexHi = indexLo;
+    for (int i = 0; i < 4; i++) {
+        int modifier = pModifierTable[i];
+        int16x8_t dr = vsubq_s16(r, vdupq_n_s16(clamp(pBaseColors[0] + modifier)));
+        int16x8_t dg = vsubq_s16(g, vdupq_n_s16(clamp(pBaseColors[1] + modifier)));
+        int16x8_t db = vsubq_s16(b, vdupq_n_s16(clamp(pBaseColors[2] + modifier)));
+        int16x8_t dr3 = vmulq_n_s16(dr, 3);
+        int16x8_t dg6 = vmulq_n_s16(dg, 6);
+        // 3 * dR^2 + 6 * dG^2 + dB^2 of the pixels 0-3 and 4-7
+        int32x4_t errLo = vmull_s16(vget_low_s16(dr), vget_low_s16(dr3));
+        errLo = vmlal_s16(errLo, vget_low_s16(dg), vget_low_s16(dg6));
+        errLo = vmlal_s16(errLo, vget_low_s16(db), vget_low_s16(db));
+        int32x4_t errHi = vmull_s16(vget_high_s16(dr), vget_high_s16(dr3));
+        errHi = vmlal_s16(errHi, vget_high_s16(dg), vget_high_s16(dg6));
+        errHi = vmlal_s16(errHi, vget_high_s16(db), vget_high_s16(db));
+        int32x4_t index = vdupq_n_s32(i);
+        uint32x4_t ltLo = vcltq_s32(errLo, bestLo);
+        uint32x4_t ltHi = vcltq_s32(errHi, bestHi);
+        bestLo = vbslq_s32(ltLo, errLo, bestLo);
+        bestHi = vbslq_s32(ltHi, errHi, bestHi);
+        indexLo = vbslq_s32(ltLo, index, indexLo);
+        indexHi = vbslq_s32(ltHi, index, indexHi);
+    }
+    int32x4_t validLo = vld1q_s32(pSub->valid);
+    int32x4_t validHi = vld1q_s32(pSub->valid + 4);
+    vst1q_s32(pIndices, vandq_s32(indexLo, validLo));
+    vst1q_s32(pIndices + 4, vandq_s32(indexHi, validHi));
+    int32x4_t sum = vaddq_s32(vandq_s32(bestLo, validLo),
+            vandq_s32(bestHi, validHi));
+    int32x2_t sum2 = vadd_s32(vget_low_s32(sum), vget_high_s32(sum));
+    sum2 = vpadd_s32(sum2, sum2);
+    return (etc1_uint32) vget_lane_s32(sum2, 0);
+}
+#else
+static
+etc1_uint32 etc_score_table(const etc_subblock* pSub,
+        const etc1_byte* pBaseColors, const int* pModifierTable,
+        int* pIndices) {
+    etc1_uint32 score = 0;
+    for (int j = 0; j < 8; j++) {
+        etc1_uint32 bestScore = ~0;
+        int bestIndex = 0;
+        for (int i = 0; i < 4; i++) {
+            int modifier = pModifierTable[i];
+            etc1_uint32 err = (etc1_uint32) (
+                    3 * square(clamp(pBaseColors[0] + modifier) - pSub->r[j])
+                    + 6 * square(clamp(pBaseColors[1] + modifier) - pSub->g[j])
+                    + square(clamp(pBaseColors[2] + modifier) - pSub->b[j]));
+            if (err < bestScore) {
+                bestScore = err;
+                bestIndex = i;
+            }
         }
+        pIndices[j] = bestIndex & pSub->valid[j];
+        score += bestScore & pSub->valid[j];
+    }
+    return score;
+}
+#endif
+// Upper bounds of the mean pixel deviation from the base color that select the
+// modifier tables, halfway between the mean modifiers of neighbouring tables.
+static const int kTableLimits[7] = { 8, 15, 23, 33, 45, 60, 92 };
+static
+int etc_estimate_table(const etc_subblock* pSub, const etc1_byte* pBaseColors) {
+    int sum = 0;
+    if (!pSub->count) {
+        return 0;
     }
-    etc1_uint32 lowMask = (((bestIndex >> 1) << 16) | (bestIndex & 1))
-            << bitIndex;
-    *pLow |= lowMask;
-    return bestScore;
+    for (int j = 0; j < 8; j++) {
+        int d = pSub->r[j] - pBaseColors[0] + pSub->g[j] - pBaseColors[1]
+                + pSub->b[j] - pBaseColors[2];
+        sum += (d < 0 ? -d : d) & pSub->valid[j];
+    }
+    int mean = sum / (3 * pSub->count);
+    int table = 0;
+    while (table < 7 && mean > kTableLimits[table]) {
+        table++;
+    }
+    return table;
 }
+// Picks the modifier table of a sub-block. ETC1_QUALITY_BEST tries all of
+// them, the other tiers only the estimated table and its neighbours. A
+// perfect match ends the search.
 static
 void etc_encode_subblock_helper(const etc1_byte* pIn, etc1_uint32 inMask,
         etc_compressed* pCompressed, bool flipped, bool second,
-        const etc1_byte* pBaseColors, const int* pModifierTable) {
-    int score = pCompressed->score;
-    if (flipped) {
-        int by = 0;
-        if (second) {
-            by = 2;
-        }
-        for (int y = 0; y < 2; y++) {
-            int yy = by + y;
-            for (int x = 0; x < 4; x++) {
-                int i = x + 4 * yy;
-                if (inMask & (1 << i)) {
-                    score += chooseModifier(pBaseColors, pIn + i * 3,
-                            &pCompressed->low, yy + x * 4, pModifierTable);
-                }
-            }
-        }
-    } else {
-        int bx = 0;
-        if (second) {
-            bx = 2;
-        }
-        for (int y = 0; y < 4; y++) {
-            for (int x = 0; x < 2; x++) {
-                int xx = bx + x;
-                int i = xx + 4 * y;
-                if (inMask & (1 << i)) {
-                    score += chooseModifier(pBaseColors, pIn + i * 3,
-                            &pCompressed->low, y + xx * 4, pModifierTable);
-                }
-            }
+        const etc1_byte* pBaseColors, int quality) {
+    etc_subblock sub;
+    int indices[8];
+    int bestIndices[8];
+    etc1_uint32 bestScore = ~0;
+    int bestTable = 0;
+    int first = 0;
+    int last = 7;
+    etc_load_subblock(pIn, inMask, &sub, flipped, second);
+    if (quality != ETC1_QUALITY_BEST) {
+        int table = etc_estimate_table(&sub, pBaseColors);
+        first = table > 0 ? table - 1 : 0;
+        last = table < 7 ? table + 1 : 7;
+    }
+    for (int t = first; t <= last && bestScore; t++) {
+        etc1_uint32 score = etc_score_table(&sub, pBaseColors,
+                kModifierTable + t * 4, indices);
+        if (score < bestScore) {
+            bestScore = score;
+            bestTable = t;
+            memcpy(bestIndices, indices, sizeof(indices));
         }
     }
-    pCompressed->score = score;
+    for (int j = 0; j < 8; j++) {
+        int index = bestIndices[j];
+        pCompressed->low |= (((index >> 1) << 16) | (index & 1)) << sub.bit[j];
+    }
+    pCompressed->high |= bestTable << (second ? 2 : 5);
+    pCompressed->score += bestScore;
 }
 static bool inRange4bitSigned(int color) {
     return color >= -4 && color <= 3;
@@ -373,38 +532,39 @@ static void etc_encodeBaseColors(etc1_byte* pBaseColors,
 }
 static
 void etc_encode_block_helper(const etc1_byte* pIn, etc1_uint32 inMask,
-        const etc1_byte* pColors, etc_compressed* pCompressed, bool flipped) {
-    pCompressed->score = ~0;
+        const etc1_byte* pColors, etc_compressed* pCompressed, bool flipped,
+        int quality) {
+    pCompressed->score = 0;
     pCompressed->high = (flipped ? 1 : 0);
     pCompressed->low = 0;
     etc1_byte pBaseColors[6];
     etc_encodeBaseColors(pBaseColors, pColors, pCompressed);
-    int originalHigh = pCompressed->high;
-    const int* pModifierTable = kModifierTable;
-    for (int i = 0; i < 8; i++, pModifierTable += 4) {
-        etc_compressed temp;
-        temp.score = 0;
-        temp.high = originalHigh | (i << 5);
-        temp.low = 0;
-        etc_encode_subblock_helper(pIn, inMask, &temp, flipped, false,
-                pBaseColors, pModifierTable);
-        take_best(pCompressed, &temp);
-    }
-    pModifierTable = kModifierTable;
-    etc_compressed firstHalf = *pCompressed;
-    for (int i = 0; i < 8; i++, pModifierTable += 4) {
-        etc_compressed temp;
-        temp.score = firstHalf.score;
-        temp.high = firstHalf.high | (i << 2);
-        temp.low = firstHalf.low;
-        etc_encode_subblock_helper(pIn, inMask, &temp, flipped, true,
-                pBaseColors + 3, pModifierTable);
-        if (i == 0) {
-            *pCompressed = temp;
-        } else {
-            take_best(pCompressed, &temp);
+    etc_encode_subblock_helper(pIn, inMask, pCompressed, flipped, false,
+            pBaseColors, quality);
+    etc_encode_subblock_helper(pIn, inMask, pCompressed, flipped, true,
+            pBaseColors + 3, quality);
+}
+// Error of the sub-block averages of an orientation, used by
+// ETC1_QUALITY_FAST to encode only the orientation that fits better.
+static
+etc1_uint32 etc_orientation_error(const etc1_byte* pIn, etc1_uint32 inMask,
+        const etc1_byte* pColors, bool flipped) {
+    etc1_uint32 score = 0;
+    for (int i = 0; i < 16; i++) {
+        if (!(inMask & (1 << i))) {
+            continue;
         }
+        int x = i & 3;
+        int y = i >> 2;
+        const etc1_byte* c = pColors;
+        if (flipped ? y >= 2 : x >= 2) {
+            c += 3;
+        }
+        const etc1_byte* p = pIn + i * 3;
+        score += 3 * square(p[0] - c[0]) + 6 * square(p[1] - c[1])
+                + square(p[2] - c[2]);
     }
+    return score;
 }
 static void writeBigEndian(etc1_byte* pOut, etc1_uint32 d) {
     pOut[0] = (etc1_byte)(d >> 24);
@@ -412,12 +572,9 @@ static void writeBigEndian(etc1_byte* pOut, etc1_uint32 d) {
     pOut[2] = (etc1_byte)(d >> 8);
     pOut[3] = (etc1_byte) d;
 }
-// Input is a 4 x 4 square of 3-byte pixels in form R, G, B
-// inmask is a 16-bit mask where bit (1 << (x + y * 4)) tells whether the corresponding (x,y)
-// pixel is valid or not. Invalid pixel color values are ignored when compressing.
-// Output is an ETC1 compressed version of the data.
-void etc1_encode_block(const etc1_byte* pIn, etc1_uint32 inMask,
-        etc1_byte* pOut) {
+static
+void etc_encode_block_quality(const etc1_byte* pIn, etc1_uint32 inMask,
+        etc1_byte* pOut, int quality) {
     etc1_byte colors[6];
     etc1_byte flippedColors[6];
     etc_average_colors_subblock(pIn, inMask, colors, false, false);
@@ -425,63 +582,147 @@ void etc1_encode_block(const etc1_byte* pIn, etc1_uint32 inMask,
     etc_average_colors_subblock(pIn, inMask, flippedColors, true, false);
     etc_average_colors_subblock(pIn, inMask, flippedColors + 3, true, true);
     etc_compressed a, b;
-    etc_encode_block_helper(pIn, inMask, colors, &a, false);
-    etc_encode_block_helper(pIn, inMask, flippedColors, &b, true);
-    take_best(&a, &b);
+    if (quality == ETC1_QUALITY_FAST) {
+        bool flipped = etc_orientation_error(pIn, inMask, flippedColors, true)
+                < etc_orientation_error(pIn, inMask, colors, false);
+        etc_encode_block_helper(pIn, inMask,
+                flipped ? flippedColors : colors, &a, flipped, quality);
+    } else {
+        etc_encode_block_helper(pIn, inMask, colors, &a, false, quality);
+        if (a.score) {
+            etc_encode_block_helper(pIn, inMask, flippedColors, &b, true,
+                    quality);
+            take_best(&a, &b);
+        }
+    }
     writeBigEndian(pOut, a.high);
     writeBigEndian(pOut + 4, a.low);
 }
+// Input is a 4 x 4 square of 3-byte pixels in form R, G, B
+// inmask is a 16-bit mask where bit (1 << (x + y * 4)) tells whether the corresponding (x,y)
+// pixel is valid or not. Invalid pixel color values are ignored when compressing.
+// Output is an ETC1 compressed version of the data.
+void etc1_encode_block(const etc1_byte* pIn, etc1_uint32 inMask,
+        etc1_byte* pOut) {
+    etc_encode_block_quality(pIn, inMask, pOut, ETC1_QUALITY_BEST);
+}
 // Return the size of the encoded image data (does not include size of PKM header).
 etc1_uint32 etc1_get_encoded_data_size(etc1_uint32 width, etc1_uint32 height) {
     return (((width + 3) & ~3) * ((height + 3) & ~3)) >> 1;
 }
+typedef struct {
+    const etc1_byte* pIn;
+    etc1_uint32 width;
+    etc1_uint32 height;
+    etc1_uint32 pixelSize;
+    etc1_uint32 stride;
+    etc1_byte* pOut;
+    int quality;
+    // rows of blocks, handed out to the threads one at a time
+    etc1_uint32 numRows;
+    etc1_uint32 nextRow;
+} etc_image_job;
+static
+void etc_encode_row(const etc_image_job* pJob, etc1_uint32 row) {
+    static const unsigned short kYMask[] = { 0x0, 0xf, 0xff, 0xfff, 0xffff };
+    static const unsigned short kXMask[] = { 0x0, 0x1111, 0x3333, 0x7777,
+            0xffff };
+    etc1_byte block[ETC1_DECODED_BLOCK_SIZE];
+    etc1_uint32 encodedWidth = (pJob->width + 3) & ~3;
+    etc1_uint32 pixelSize = pJob->pixelSize;
+    etc1_uint32 y = row * 4;
+    etc1_byte* pOut = pJob->pOut + row * (encodedWidth / 4)
+            * ETC1_ENCODED_BLOCK_SIZE;
+    etc1_uint32 yEnd = pJob->height - y;
+    if (yEnd > 4) {
+        yEnd = 4;
+    }
+    int ymask = kYMask[yEnd];
+    for (etc1_uint32 x = 0; x < encodedWidth; x += 4) {
+        etc1_uint32 xEnd = pJob->width - x;
+        if (xEnd > 4) {
+            xEnd = 4;
+        }
+        int mask = ymask & kXMask[xEnd];
+        for (etc1_uint32 cy = 0; cy < yEnd; cy++) {
+            etc1_byte* q = block + (cy * 4) * 3;
+            const etc1_byte* p = pJob->pIn + pixelSize * x
+                    + pJob->stride * (y + cy);
+            if (pixelSize == 3) {
+                memcpy(q, p, xEnd * 3);
+            } else {
+                for (etc1_uint32 cx = 0; cx < xEnd; cx++) {
+                    int pixel = (p[1] << 8) | p[0];
+                    *q++ = convert5To8(pixel >> 11);
+                    *q++ = convert6To8(pixel >> 5);
+                    *q++ = convert5To8(pixel);
+                    p += pixelSize;
+                }
+            }
+        }
+        etc_encode_block_quality(block, mask, pOut, pJob->quality);
+        pOut += ETC1_ENCODED_BLOCK_SIZE;
+    }
+}
+static
+void* etc_encode_worker(void* arg) {
+    etc_image_job* pJob = (etc_image_job*) arg;
+    etc1_uint32 row;
+    while ((row = __sync_fetch_and_add(&pJob->nextRow, 1)) < pJob->numRows) {
+        etc_encode_row(pJob, row);
+    }
+    return NULL;
+}
 // Encode an entire image.
 // pIn - pointer to the image data. Formatted such that the Red component of
 //       pixel (x,y) is at pIn + pixelSize * x + stride * y + redOffset;
 // pOut - pointer to encoded data. Must be large enough to store entire encoded image.
 int etc1_encode_image(const etc1_byte* pIn, etc1_uint32 width, etc1_uint32 height,
         etc1_uint32 pixelSize, etc1_uint32 stride, etc1_byte* pOut) {
+    return etc1_encode_image_mt(pIn, width, height, pixelSize, stride, pOut,
+            ETC1_QUALITY_BEST, 1);
+}
+// Encode an entire image on several threads, each encodes one row of blocks
+// at a time. The calling thread encodes rows too.
+int etc1_encode_image_mt(const etc1_byte* pIn, etc1_uint32 width, etc1_uint32 height,
+        etc1_uint32 pixelSize, etc1_uint32 stride, etc1_byte* pOut,
+        int quality, etc1_uint32 numThreads) {
     if (pixelSize < 2 || pixelSize > 3) {
         return -1;
     }
-    static const unsigned short kYMask[] = { 0x0, 0xf, 0xff, 0xfff, 0xffff };
-    static const unsigned short kXMask[] = { 0x0, 0x1111, 0x3333, 0x7777,
-            0xffff };
-    etc1_byte block[ETC1_DECODED_BLOCK_SIZE];
-    etc1_byte encoded[ETC1_ENCODED_BLOCK_SIZE];
-    etc1_uint32 encodedWidth = (width + 3) & ~3;
-    etc1_uint32 encodedHeight = (height + 3) & ~3;
-    for (etc1_uint32 y = 0; y < encodedHeight; y += 4) {
-        etc1_uint32 yEnd = height - y;
-        if (yEnd > 4) {
-            yEnd = 4;
-        }
-        int ymask = kYMask[yEnd];
-        for (etc1_uint32 x = 0; x < encodedWidth; x += 4) {
-            etc1_uint32 xEnd = width - x;
-            if (xEnd > 4) {
-                xEnd = 4;
-            }
-            int mask = ymask & kXMask[xEnd];
-            for (etc1_uint32 cy = 0; cy < yEnd; cy++) {
-                etc1_byte* q = block + (cy * 4) * 3;
-                const etc1_byte* p = pIn + pixelSize * x + stride * (y + cy);
-                if (pixelSize == 3) {
-                    memcpy(q, p, xEnd * 3);
-                } else {
-                    for (etc1_uint32 cx = 0; cx < xEnd; cx++) {
-                        int pixel = (p[1] << 8) | p[0];
-                        *q++ = convert5To8(pixel >> 11);
-                        *q++ = convert6To8(pixel >> 5);
-                        *q++ = convert5To8(pixel);
-                        p += pixelSize;
-                    }
-                }
-            }
-            etc1_encode_block(block, mask, encoded);
-            memcpy(pOut, encoded, sizeof(encoded));
-            pOut += sizeof(encoded);
-        }
+    if (quality < ETC1_QUALITY_FAST || quality > ETC1_QUALITY_BEST) {
+        return -1;
+    }
+    etc_image_job job;
+    job.pIn = pIn;
+    job.width = width;
+    job.height = height;
+    job.pixelSize = pixelSize;
+    job.stride = stride;
+    job.pOut = pOut;
+    job.quality = quality;
+    job.numRows = (height + 3) / 4;
+    job.nextRow = 0;
+    if (!numThreads) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        numThreads = cpus > 0 ? cpus : 1;
+    }
+    if (numThreads > job.numRows) {
+        numThreads = job.numRows;
+    }
+    if (numThreads > ETC1_MAX_THREADS) {
+        numThreads = ETC1_MAX_THREADS;
+    }
+    pthread_t threads[ETC1_MAX_THREADS];
+    etc1_uint32 started = 0;
+    // a thread that fails to start leaves its rows to the others
+    while (started + 1 < numThreads &&
+            !pthread_create(&threads[started], NULL, etc_encode_worker, &job)) {
+        started++;
+    }
+    etc_encode_worker(&job);
+    for (etc1_uint32 i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
     }
     return 0;
 }
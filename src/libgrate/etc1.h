@@ -53,6 +53,19 @@ etc1_uint32 etc1_get_encoded_data_size(etc1_uint32 width, etc1_uint32 height);
 // returns non-zero if there is an error.
 int etc1_encode_image(const etc1_byte* pIn, etc1_uint32 width, etc1_uint32 height,
         etc1_uint32 pixelSize, etc1_uint32 stride, etc1_byte* pOut);
+// Quality tiers of etc1_encode_image_mt(). ETC1_QUALITY_BEST searches all
+// modifier tables in both block orientations, like etc1_encode_image().
+// ETC1_QUALITY_MEDIUM only tries the tables next to the one estimated from the
+// pixels, ETC1_QUALITY_FAST also encodes only the better fitting orientation.
+#define ETC1_QUALITY_FAST 0
+#define ETC1_QUALITY_MEDIUM 1
+#define ETC1_QUALITY_BEST 2
+// Encode an entire image like etc1_encode_image(), the rows of blocks are split
+// across numThreads threads. numThreads 0 uses one thread per CPU.
+// returns non-zero if there is an error.
+int etc1_encode_image_mt(const etc1_byte* pIn, etc1_uint32 width, etc1_uint32 height,
+        etc1_uint32 pixelSize, etc1_uint32 stride, etc1_byte* pOut,
+        int quality, etc1_uint32 numThreads);
 // Decode an entire image.
 // pIn - pointer to encoded data.
 // pOut - pointer to the image data. Will be written such that
@@ -64,6 +64,8 @@ void grate_clear(struct grate *grate)
 			((uint32_t)(clear->r * 255) <<  0);
 	}
 
+	grate_finish(grate);
+
 	err = host1x_gr2d_clear(gr2d, pixbuf, color);
 	if (err < 0)
 		grate_error("host1x_gr2d_clear() failed: %d\n", err);
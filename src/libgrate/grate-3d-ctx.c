@@ -23,6 +23,7 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include <stddef.h>
 #include <string.h>
 
 #include "libgrate-private.h"
@@ -70,10 +71,69 @@ struct grate_3d_ctx * grate_3d_alloc_ctx(struct grate *grate)
 	}
 
 	ctx->grate = grate;
+	grate_3d_ctx_mark_dirty(ctx, GRATE_3D_DIRTY_ALL);
 
 	return ctx;
 }
 
+void grate_3d_ctx_mark_dirty(struct grate_3d_ctx *ctx, uint32_t dirty)
+{
+	if (dirty & GRATE_3D_DIRTY_VS_CONSTANTS) {
+		ctx->vs_uniforms_dirty_start = 0;
+		ctx->vs_uniforms_dirty_end = 256;
+	}
+
+	if (dirty & GRATE_3D_DIRTY_TEXTURES)
+		memset(ctx->emitted_textures, 0,
+		       sizeof(ctx->emitted_textures));
+
+	ctx->dirty |= dirty;
+}
+
+/*
+ * Updates @nb VS constant words starting at word @location, widening the
+ * dirty range by the vec4s that actually changed.
+ */
+static void grate_3d_ctx_update_vs_uniforms(struct grate_3d_ctx *ctx,
+					    unsigned location,
+					    const uint32_t *values,
+					    unsigned nb)
+{
+	unsigned first = ~0u, last = 0;
+	unsigned start, end, i;
+
+	for (i = 0; i < nb; i++) {
+		if (ctx->vs_uniforms[location + i] == values[i])
+			continue;
+
+		ctx->vs_uniforms[location + i] = values[i];
+
+		if (first == ~0u)
+			first = location + i;
+
+		last = location + i;
+	}
+
+	if (first == ~0u)
+		return;
+
+	start = first / 4;
+	end = last / 4 + 1;
+
+	if (!(ctx->dirty & GRATE_3D_DIRTY_VS_CONSTANTS)) {
+		ctx->vs_uniforms_dirty_start = start;
+		ctx->vs_uniforms_dirty_end = end;
+		ctx->dirty |= GRATE_3D_DIRTY_VS_CONSTANTS;
+		return;
+	}
+
+	if (start < ctx->vs_uniforms_dirty_start)
+		ctx->vs_uniforms_dirty_start = start;
+
+	if (end > ctx->vs_uniforms_dirty_end)
+		ctx->vs_uniforms_dirty_end = end;
+}
+
 int grate_3d_ctx_vertex_attrib_pointer(struct grate_3d_ctx *ctx,
 				       unsigned location, unsigned size,
 				       unsigned type, unsigned stride,
@@ -125,6 +185,7 @@ int grate_3d_ctx_vertex_attrib_pointer(struct grate_3d_ctx *ctx,
 	attr->bo = data_bo;
 
 	ctx->vtx_attributes[location] = attr;
+	ctx->dirty |= GRATE_3D_DIRTY_ATTRIBUTES;
 
 	return 0;
 }
@@ -138,6 +199,7 @@ int grate_3d_ctx_enable_vertex_attrib_array(struct grate_3d_ctx *ctx,
 	}
 
 	ctx->attributes_enable_mask |= 1u << location;
+	ctx->dirty |= GRATE_3D_DIRTY_ATTRIBUTES;
 
 	return 0;
 }
@@ -151,6 +213,7 @@ int grate_3d_ctx_disable_vertex_attrib_array(struct grate_3d_ctx *ctx,
 	}
 
 	ctx->attributes_enable_mask &= ~(1u << target);
+	ctx->dirty |= GRATE_3D_DIRTY_ATTRIBUTES;
 
 	return 0;
 }
@@ -184,6 +247,7 @@ int grate_3d_ctx_bind_render_target(struct grate_3d_ctx *ctx,
 	}
 
 	ctx->render_targets[target].pixbuf = pixbuf;
+	ctx->dirty |= GRATE_3D_DIRTY_RENDER_TARGETS;
 
 	return 0;
 }
@@ -198,6 +262,7 @@ int grate_3d_ctx_set_render_target_dither(struct grate_3d_ctx *ctx,
 	}
 
 	ctx->render_targets[target].dither_enabled = enable;
+	ctx->dirty |= GRATE_3D_DIRTY_RENDER_TARGETS;
 
 	return 0;
 }
@@ -211,6 +276,7 @@ int grate_3d_ctx_enable_render_target(struct grate_3d_ctx *ctx,
 	}
 
 	ctx->render_targets_enable_mask |= 1u << target;
+	ctx->dirty |= GRATE_3D_DIRTY_RENDER_TARGETS;
 
 	return 0;
 }
@@ -224,6 +290,7 @@ int grate_3d_ctx_disable_render_target(struct grate_3d_ctx *ctx,
 	}
 
 	ctx->render_targets_enable_mask &= ~(1u << target);
+	ctx->dirty |= GRATE_3D_DIRTY_RENDER_TARGETS;
 
 	return 0;
 }
@@ -236,13 +303,65 @@ int grate_3d_ctx_bind_program(struct grate_3d_ctx *ctx,
 		return -1;
 	}
 
+	/*
+	 * Rebinding the current program only resets the uniforms, the
+	 * program itself doesn't need to be uploaded again.
+	 */
+	if (ctx->program != program)
+		ctx->dirty |= GRATE_3D_DIRTY_PROGRAM |
+			      GRATE_3D_DIRTY_RASTER |
+			      GRATE_3D_DIRTY_DEPTH_STENCIL |
+			      GRATE_3D_DIRTY_ATTRIBUTES;
+
 	ctx->program = program;
 
-	memcpy(ctx->vs_uniforms, program->vs_constants,
-	       sizeof(ctx->vs_uniforms));
+	grate_3d_ctx_update_vs_uniforms(ctx, 0, program->vs_constants,
+					ARRAY_SIZE(ctx->vs_uniforms));
 
-	memcpy(ctx->fs_uniforms, program->fs_constants,
-	       sizeof(ctx->fs_uniforms));
+	if (memcmp(ctx->fs_uniforms, program->fs_constants,
+		   sizeof(ctx->fs_uniforms))) {
+		memcpy(ctx->fs_uniforms, program->fs_constants,
+		       sizeof(ctx->fs_uniforms));
+		ctx->dirty |= GRATE_3D_DIRTY_FS_CONSTANTS;
+	}
+
+	return 0;
+}
+
+/*
+ * Loads the pipeline state and the program of the state object into the
+ * context. The program is only rebound if it differs, so the uniforms are
+ * preserved otherwise. The next draw gathers the pre-encoded commands of
+ * the state object instead of emitting the state.
+ */
+int grate_3d_ctx_bind_state(struct grate_3d_ctx *ctx,
+			    struct grate_3d_state *state)
+{
+	const size_t start = offsetof(struct grate_3d_ctx, depth_range_near);
+	const size_t end = offsetof(struct grate_3d_ctx, stencil_mask_back) +
+			   sizeof(ctx->stencil_mask_back);
+
+	if (!state) {
+		grate_error("Bad state ptr\n");
+		return -1;
+	}
+
+	/* depth and stencil buffers are enabled as render targets */
+	if (ctx->depth_test != state->ctx.depth_test ||
+	    ctx->stencil_test != state->ctx.stencil_test)
+		ctx->dirty |= GRATE_3D_DIRTY_RENDER_TARGETS;
+
+	if (ctx->program != state->ctx.program)
+		grate_3d_ctx_bind_program(ctx, state->ctx.program);
+
+	memcpy((char *)ctx + start, (char *)&state->ctx + start, end - start);
+	ctx->dirty &= ~GRATE_3D_DIRTY_STATE;
+
+	if (ctx->state_id != state->id) {
+		ctx->state = state;
+		ctx->state_id = state->id;
+		ctx->state_pending = true;
+	}
 
 	return 0;
 }
@@ -261,7 +380,8 @@ int grate_3d_ctx_set_vertex_uniform(struct grate_3d_ctx *ctx,
 		return -1;
 	}
 
-	memcpy(&ctx->vs_uniforms[location * 4], values, nb * sizeof(float));
+	grate_3d_ctx_update_vs_uniforms(ctx, location * 4,
+					(const uint32_t *)values, nb);
 
 	return 0;
 }
@@ -347,6 +467,8 @@ int grate_3d_ctx_set_fragment_uniform(struct grate_3d_ctx *ctx,
 		location += lowp ? 1 : 2;
 	}
 
+	ctx->dirty |= GRATE_3D_DIRTY_FS_CONSTANTS;
+
 	return 0;
 }
 
@@ -361,11 +483,13 @@ void grate_3d_ctx_set_depth_range(struct grate_3d_ctx *ctx,
 {
 	ctx->depth_range_near = near;
 	ctx->depth_range_far = far;
+	ctx->dirty |= GRATE_3D_DIRTY_RASTER;
 }
 
 void grate_3d_ctx_set_dither(struct grate_3d_ctx *ctx, uint32_t unk)
 {
 	ctx->dither_unk = unk;
+	ctx->dirty |= GRATE_3D_DIRTY_RASTER;
 }
 
 void grate_3d_ctx_set_viewport_bias(struct grate_3d_ctx *ctx,
@@ -374,6 +498,7 @@ void grate_3d_ctx_set_viewport_bias(struct grate_3d_ctx *ctx,
 	ctx->viewport_x_bias = x;
 	ctx->viewport_y_bias = y;
 	ctx->viewport_z_bias = z;
+	ctx->dirty |= GRATE_3D_DIRTY_VIEWPORT;
 }
 
 void grate_3d_ctx_set_viewport_scale(struct grate_3d_ctx *ctx,
@@ -382,31 +507,37 @@ void grate_3d_ctx_set_viewport_scale(struct grate_3d_ctx *ctx,
 	ctx->viewport_x_scale = width;
 	ctx->viewport_y_scale = height;
 	ctx->viewport_z_scale = depth;
+	ctx->dirty |= GRATE_3D_DIRTY_VIEWPORT;
 }
 
 void grate_3d_ctx_set_point_params(struct grate_3d_ctx *ctx, uint32_t params)
 {
 	ctx->point_params = params;
+	ctx->dirty |= GRATE_3D_DIRTY_RASTER;
 }
 
 void grate_3d_ctx_set_point_size(struct grate_3d_ctx *ctx, float size)
 {
 	ctx->point_size = size;
+	ctx->dirty |= GRATE_3D_DIRTY_RASTER;
 }
 
 void grate_3d_ctx_set_line_params(struct grate_3d_ctx *ctx, uint32_t params)
 {
 	ctx->line_params = params;
+	ctx->dirty |= GRATE_3D_DIRTY_RASTER;
 }
 
 void grate_3d_ctx_set_line_width(struct grate_3d_ctx *ctx, float width)
 {
 	ctx->line_width = width;
+	ctx->dirty |= GRATE_3D_DIRTY_RASTER;
 }
 
 void grate_3d_ctx_use_guardband(struct grate_3d_ctx *ctx, bool enabled)
 {
 	ctx->guarband_enabled = enabled;
+	ctx->dirty |= GRATE_3D_DIRTY_VIEWPORT;
 }
 
 void grate_3d_ctx_set_front_direction_is_cw(struct grate_3d_ctx *ctx,
@@ -433,6 +564,7 @@ void grate_3d_ctx_set_front_direction_is_cw(struct grate_3d_ctx *ctx,
 	}
 
 	ctx->tri_face_front_cw = front_cw;
+	ctx->dirty |= GRATE_3D_DIRTY_RASTER;
 }
 
 void grate_3d_ctx_set_cull_face(struct grate_3d_ctx *ctx,
@@ -462,6 +594,8 @@ void grate_3d_ctx_set_cull_face(struct grate_3d_ctx *ctx,
 	default:
 		grate_error("Invalid cull face %u\n", cull_face);
 	}
+
+	ctx->dirty |= GRATE_3D_DIRTY_RASTER;
 }
 
 void grate_3d_ctx_set_scissor(struct grate_3d_ctx *ctx,
@@ -472,6 +606,7 @@ void grate_3d_ctx_set_scissor(struct grate_3d_ctx *ctx,
 	ctx->scissor_y = y;
 	ctx->scissor_width = width;
 	ctx->scissor_heigth = height;
+	ctx->dirty |= GRATE_3D_DIRTY_RASTER;
 }
 
 void grate_3d_ctx_set_point_coord_range(struct grate_3d_ctx *ctx,
@@ -482,6 +617,7 @@ void grate_3d_ctx_set_point_coord_range(struct grate_3d_ctx *ctx,
 	ctx->point_coord_range_max_s = max_s;
 	ctx->point_coord_range_min_t = min_t;
 	ctx->point_coord_range_max_t = max_t;
+	ctx->dirty |= GRATE_3D_DIRTY_RASTER;
 }
 
 void grate_3d_ctx_set_polygon_offset(struct grate_3d_ctx *ctx,
@@ -489,6 +625,7 @@ void grate_3d_ctx_set_polygon_offset(struct grate_3d_ctx *ctx,
 {
 	ctx->polygon_offset_units = units;
 	ctx->polygon_offset_factor = factor;
+	ctx->dirty |= GRATE_3D_DIRTY_RASTER;
 }
 
 void grate_3d_ctx_set_provoking_vtx_last(struct grate_3d_ctx *ctx, bool last)
@@ -506,6 +643,7 @@ int grate_3d_ctx_bind_texture(struct grate_3d_ctx *ctx,
 	}
 
 	ctx->textures[location] = tex;
+	ctx->dirty |= GRATE_3D_DIRTY_TEXTURES;
 
 	return 0;
 }
@@ -548,16 +686,21 @@ void grate_3d_ctx_set_depth_func(struct grate_3d_ctx *ctx,
 	default:
 		grate_error("Invalid depth function %u\n", func);
 	}
+
+	ctx->dirty |= GRATE_3D_DIRTY_DEPTH_STENCIL;
 }
 
 void grate_3d_ctx_perform_depth_test(struct grate_3d_ctx *ctx, bool enable)
 {
 	ctx->depth_test = enable;
+	ctx->dirty |= GRATE_3D_DIRTY_DEPTH_STENCIL |
+		      GRATE_3D_DIRTY_RENDER_TARGETS;
 }
 
 void grate_3d_ctx_perform_depth_write(struct grate_3d_ctx *ctx, bool enable)
 {
 	ctx->depth_write = enable;
+	ctx->dirty |= GRATE_3D_DIRTY_DEPTH_STENCIL;
 }
 
 int grate_3d_ctx_bind_depth_buffer(struct grate_3d_ctx *ctx,
@@ -584,6 +727,7 @@ int grate_3d_ctx_bind_depth_buffer(struct grate_3d_ctx *ctx,
 	}
 
 	ctx->render_targets[0].pixbuf = pixbuf;
+	ctx->dirty |= GRATE_3D_DIRTY_RENDER_TARGETS;
 
 	return 0;
 }
@@ -591,6 +735,8 @@ int grate_3d_ctx_bind_depth_buffer(struct grate_3d_ctx *ctx,
 void grate_3d_ctx_perform_stencil_test(struct grate_3d_ctx *ctx, bool enable)
 {
 	ctx->stencil_test = enable;
+	ctx->dirty |= GRATE_3D_DIRTY_DEPTH_STENCIL |
+		      GRATE_3D_DIRTY_RENDER_TARGETS;
 }
 
 void grate_3d_ctx_set_stencil_func(struct grate_3d_ctx *ctx,
@@ -656,6 +802,8 @@ void grate_3d_ctx_set_stencil_func(struct grate_3d_ctx *ctx,
 		ctx->stencil_mask_back = mask;
 		ctx->stencil_ref_back  = ref;
 	}
+
+	ctx->dirty |= GRATE_3D_DIRTY_DEPTH_STENCIL;
 }
 
 static int get_stencil_op(enum grate_3d_ctx_stencil_operation op)
@@ -729,6 +877,8 @@ void grate_3d_ctx_set_stencil_ops(struct grate_3d_ctx *ctx,
 		ctx->stencil_zfail_op_back = stencil_zfail_op;
 		ctx->stencil_zpass_op_back = stencil_zpass_op;
 	}
+
+	ctx->dirty |= GRATE_3D_DIRTY_DEPTH_STENCIL;
 }
 
 int grate_3d_ctx_bind_stencil_buffer(struct grate_3d_ctx *ctx,
@@ -754,6 +904,7 @@ int grate_3d_ctx_bind_stencil_buffer(struct grate_3d_ctx *ctx,
 	}
 
 	ctx->render_targets[2].pixbuf = pixbuf;
+	ctx->dirty |= GRATE_3D_DIRTY_RENDER_TARGETS;
 
 	return 0;
 }
@@ -30,6 +30,7 @@ struct grate;
 struct grate_program;
 struct grate_texture;
 struct grate_3d_ctx;
+struct grate_3d_state;
 struct mat4;
 
 enum grate_3d_ctx_cull_face
@@ -114,6 +115,9 @@ int grate_3d_ctx_disable_render_target(struct grate_3d_ctx *ctx,
 int grate_3d_ctx_bind_program(struct grate_3d_ctx *ctx,
 			      struct grate_program *program);
 
+int grate_3d_ctx_bind_state(struct grate_3d_ctx *ctx,
+			    struct grate_3d_state *state);
+
 int grate_3d_ctx_set_vertex_uniform(struct grate_3d_ctx *ctx,
 				    unsigned location, unsigned nb,
 				    float *values);
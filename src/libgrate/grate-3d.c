@@ -40,13 +40,10 @@
 #define TGR3D_BOOL(reg_name, field_name, boolean) \
 	((boolean) ? TGR3D_ ## reg_name ## _ ## field_name : 0)
 
-static void grate_shader_emit(struct host1x_pushbuf *pb,
-			      struct grate_shader *shader)
+static int grate_shader_emit(struct host1x_pushbuf *pb,
+			     struct grate_shader *shader)
 {
-	unsigned i;
-
-	for (i = 0; i < shader->num_words; i++)
-		host1x_pushbuf_push(pb, shader->words[i]);
+	return host1x_pushbuf_push_data(pb, shader->words, shader->num_words);
 }
 
 static void grate_3d_begin(struct host1x_pushbuf *pb)
@@ -357,27 +354,25 @@ static void grate_3d_set_used_tram_rows_nb(struct host1x_pushbuf *pb,
 static void grate_3d_upload_vp_constants(struct host1x_pushbuf *pb,
 					 struct grate_3d_ctx *ctx)
 {
-	unsigned i;
+	unsigned start = ctx->vs_uniforms_dirty_start;
+	unsigned end = ctx->vs_uniforms_dirty_end;
 
 	host1x_pushbuf_push(pb,
-			HOST1X_OPCODE_IMM(TGR3D_VP_UPLOAD_CONST_ID, 0));
+			HOST1X_OPCODE_IMM(TGR3D_VP_UPLOAD_CONST_ID, start));
 
 	host1x_pushbuf_push(pb,
-			HOST1X_OPCODE_NONINCR(TGR3D_VP_UPLOAD_CONST, 256 * 4));
+			HOST1X_OPCODE_NONINCR(TGR3D_VP_UPLOAD_CONST,
+					      (end - start) * 4));
 
-	for (i = 0; i < 256 * 4; i++)
-		host1x_pushbuf_push(pb, ctx->vs_uniforms[i]);
+	host1x_pushbuf_push_data(pb, &ctx->vs_uniforms[start * 4],
+				 (end - start) * 4);
 }
 
 static void grate_3d_upload_fp_constants(struct host1x_pushbuf *pb,
 					 struct grate_3d_ctx *ctx)
 {
-	unsigned i;
-
 	host1x_pushbuf_push(pb, HOST1X_OPCODE_INCR(TGR3D_FP_CONST(0), 32));
-
-	for (i = 0; i < 32; i++)
-		host1x_pushbuf_push(pb, ctx->fs_uniforms[i]);
+	host1x_pushbuf_push_data(pb, ctx->fs_uniforms, 32);
 }
 
 static void grate_3d_set_polygon_offset(struct host1x_pushbuf *pb,
@@ -662,18 +657,17 @@ static void grate_3d_relocate_texture(struct host1x_pushbuf *pb,
 	host1x_pushbuf_push(pb, 0xdeadbeef);
 }
 
-static void grate_3d_set_texture_desc(struct host1x_pushbuf *pb,
-				      unsigned index,
-				      struct host1x_pixelbuffer *pixbuf,
-				      unsigned max_lod,
-				      bool wrap_t_clamp_to_edge,
-				      bool wrap_s_clamp_to_edge,
-				      bool wrap_t_mirrored_repeat,
-				      bool wrap_s_mirrored_repeat,
-				      bool mipmap_enabled,
-				      bool min_filter_enabled,
-				      bool mip_filter_enabled,
-				      bool mag_filter_enabled)
+static int grate_3d_get_texture_desc(uint32_t *desc1, uint32_t *desc2,
+				     struct host1x_pixelbuffer *pixbuf,
+				     unsigned max_lod,
+				     bool wrap_t_clamp_to_edge,
+				     bool wrap_s_clamp_to_edge,
+				     bool wrap_t_mirrored_repeat,
+				     bool wrap_s_mirrored_repeat,
+				     bool mipmap_enabled,
+				     bool min_filter_enabled,
+				     bool mip_filter_enabled,
+				     bool mag_filter_enabled)
 {
 	int log2_width = log2_size(pixbuf->width);
 	int log2_height = log2_size(pixbuf->height);
@@ -736,7 +730,7 @@ static void grate_3d_set_texture_desc(struct host1x_pushbuf *pb,
 		break;
 	default:
 		grate_error("Invalid format %u\n", pixbuf->format);
-		return;
+		return -1;
 	}
 
 	switch (pixbuf->layout) {
@@ -744,12 +738,9 @@ static void grate_3d_set_texture_desc(struct host1x_pushbuf *pb,
 		break;
 	default:
 		grate_error("Invalid layout %u\n", pixbuf->layout);
-		return;
+		return -1;
 	}
 
-	host1x_pushbuf_push(pb,
-			    HOST1X_OPCODE_INCR(TGR3D_TEXTURE_DESC1(index), 2));
-
 	value  = TGR3D_VAL(TEXTURE_DESC1, FORMAT, pixel_format);
 
 	value |= TGR3D_BOOL(TEXTURE_DESC1, COMPRESSED,
@@ -770,7 +761,7 @@ static void grate_3d_set_texture_desc(struct host1x_pushbuf *pb,
 			    wrap_s_mirrored_repeat);
 // 	value |= 0x50;
 
-	host1x_pushbuf_push(pb, value);
+	*desc1 = value;
 
 	value = TGR3D_BOOL(TEXTURE_DESC2, MIPMAP_DISABLE, !mipmap_enabled);
 
@@ -785,7 +776,9 @@ static void grate_3d_set_texture_desc(struct host1x_pushbuf *pb,
 		value |= TGR3D_VAL(TEXTURE_DESC2, HEIGHT, pixbuf->height);
 	}
 
-	host1x_pushbuf_push(pb, value);
+	*desc2 = value;
+
+	return 0;
 }
 
 static void grate_3d_setup_textures(struct host1x_pushbuf *pb,
@@ -794,8 +787,10 @@ static void grate_3d_setup_textures(struct host1x_pushbuf *pb,
 	unsigned i;
 
 	for (i = 0; i < 16; i++) {
+		struct grate_texture_state *state = &ctx->emitted_textures[i];
 		struct grate_texture *tex = ctx->textures[i];
 		struct host1x_pixelbuffer *pixbuf;
+		uint32_t desc1, desc2;
 
 		if (!tex)
 			continue;
@@ -808,21 +803,41 @@ static void grate_3d_setup_textures(struct host1x_pushbuf *pb,
 		if (!pixbuf)
 			continue;
 
+		if (grate_3d_get_texture_desc(&desc1, &desc2,
+					      pixbuf,
+					      tex->max_lod,
+					      tex->wrap_t_clamp_to_edge,
+					      tex->wrap_s_clamp_to_edge,
+					      tex->wrap_t_mirrored_repeat,
+					      tex->wrap_s_mirrored_repeat,
+					      tex->mipmap_enabled,
+					      tex->min_filter_enabled,
+					      tex->mip_filter_enabled,
+					      tex->mag_filter_enabled))
+			continue;
+
+		/*
+		 * Texture parameters are changed behind the back of the
+		 * context, so compare against what the channel saw last.
+		 */
+		if (state->bo == pixbuf->bo &&
+		    state->offset == pixbuf->bo->offset &&
+		    state->desc1 == desc1 && state->desc2 == desc2)
+			continue;
+
 		grate_3d_relocate_texture(pb, i,
 					  pixbuf->bo,
 					  pixbuf->bo->offset);
 
-		grate_3d_set_texture_desc(pb, i,
-					  pixbuf,
-					  tex->max_lod,
-					  tex->wrap_t_clamp_to_edge,
-					  tex->wrap_s_clamp_to_edge,
-					  tex->wrap_t_mirrored_repeat,
-					  tex->wrap_s_mirrored_repeat,
-					  tex->mipmap_enabled,
-					  tex->min_filter_enabled,
-					  tex->mip_filter_enabled,
-					  tex->mag_filter_enabled);
+		host1x_pushbuf_push(pb,
+			HOST1X_OPCODE_INCR(TGR3D_TEXTURE_DESC1(i), 2));
+		host1x_pushbuf_push(pb, desc1);
+		host1x_pushbuf_push(pb, desc2);
+
+		state->bo = pixbuf->bo;
+		state->offset = pixbuf->bo->offset;
+		state->desc1 = desc1;
+		state->desc2 = desc2;
 	}
 }
 
@@ -836,49 +851,235 @@ static void grate_3d_setup_indices(struct host1x_pushbuf *pb,
 	grate_3d_relocate_primitive_indices(pb, bo, bo->offset);
 }
 
+/*
+ * Emits the dirty groups of the pipeline state, which a state object
+ * captures. The program itself is uploaded separately since it has to go
+ * last, after everything that depends on the previous program.
+ */
+static void grate_3d_emit_pipeline(struct host1x_pushbuf *pb,
+				   struct grate_3d_ctx *ctx,
+				   uint32_t dirty)
+{
+	if (dirty & GRATE_3D_DIRTY_RASTER) {
+		grate_3d_set_dither(pb, ctx);
+		grate_3d_set_scissor(pb, ctx);
+		grate_3d_set_point_size(pb, ctx);
+		grate_3d_set_line_width(pb, ctx);
+		grate_3d_set_line_params(pb, ctx);
+		grate_3d_set_depth_range(pb, ctx);
+		grate_3d_set_point_params(pb, ctx);
+		grate_3d_set_polygon_offset(pb, ctx);
+		grate_3d_set_point_coord_range(pb, ctx);
+		grate_3d_set_cull_face_and_linker_inst_nb(pb, ctx);
+	}
+
+	if (dirty & GRATE_3D_DIRTY_VIEWPORT) {
+		grate_3d_set_guardband(pb, ctx);
+		grate_3d_set_viewport_bias_scale(pb, ctx);
+	}
+
+	if (dirty & GRATE_3D_DIRTY_DEPTH_STENCIL) {
+		grate_3d_set_late_test(pb, ctx);
+		grate_3d_set_depth_buffer(pb, ctx);
+		grate_3d_set_stencil_test(pb, ctx);
+	}
+
+	if (dirty & GRATE_3D_DIRTY_PROGRAM) {
+		grate_3d_set_pseq_dw_cfg(pb, ctx);
+		grate_3d_set_alu_buffer_size(pb, ctx);
+		grate_3d_startup_pseq_engine(pb, ctx);
+		grate_3d_set_used_tram_rows_nb(pb, ctx);
+	}
+}
+
+static int grate_3d_upload_program(struct host1x_pushbuf *pb,
+				   struct grate_3d_ctx *ctx)
+{
+	int err;
+
+	grate_3d_reset_program(pb);
+
+	err = grate_shader_emit(pb, ctx->program->vs);
+	if (err < 0)
+		return err;
+
+	err = grate_shader_emit(pb, ctx->program->fs);
+	if (err < 0)
+		return err;
+
+	return grate_shader_emit(pb, ctx->program->linker);
+}
+
+/*
+ * Emits the state groups of the context that changed since it was emitted
+ * into the batch last. The GR3D state persists within a batch, so nothing
+ * else needs to be emitted again.
+ */
 static void grate_3d_setup_context(struct host1x_pushbuf *pb,
 				   struct grate_3d_ctx *ctx)
 {
-	grate_3d_begin(pb);
-	grate_3d_init(pb);
-
-	grate_3d_set_dither(pb, ctx);
-	grate_3d_set_scissor(pb, ctx);
-	grate_3d_set_guardband(pb, ctx);
-	grate_3d_set_late_test(pb, ctx);
-	grate_3d_set_point_size(pb, ctx);
-	grate_3d_set_line_width(pb, ctx);
-	grate_3d_set_line_params(pb, ctx);
-	grate_3d_set_pseq_dw_cfg(pb, ctx);
-	grate_3d_set_depth_range(pb, ctx);
-	grate_3d_set_point_params(pb, ctx);
-	grate_3d_set_depth_buffer(pb, ctx);
-	grate_3d_set_stencil_test(pb, ctx);
-	grate_3d_set_polygon_offset(pb, ctx);
-	grate_3d_set_alu_buffer_size(pb, ctx);
-	grate_3d_startup_pseq_engine(pb, ctx);
-	grate_3d_set_point_coord_range(pb, ctx);
-	grate_3d_set_used_tram_rows_nb(pb, ctx);
-	grate_3d_set_viewport_bias_scale(pb, ctx);
-	grate_3d_set_cull_face_and_linker_inst_nb(pb, ctx);
-
-	grate_3d_upload_vp_constants(pb, ctx);
-	grate_3d_upload_fp_constants(pb, ctx);
-
-	grate_3d_setup_attributes(pb, ctx);
-	grate_3d_setup_render_targets(pb, ctx);
+	uint32_t dirty = ctx->dirty;
+
+	/* the emitted pipeline state no longer matches the state object */
+	if (dirty & GRATE_3D_DIRTY_STATE)
+		ctx->state_id = 0;
+
+	grate_3d_emit_pipeline(pb, ctx, dirty);
+
+	if (dirty & GRATE_3D_DIRTY_VS_CONSTANTS)
+		grate_3d_upload_vp_constants(pb, ctx);
+
+	if (dirty & GRATE_3D_DIRTY_FS_CONSTANTS)
+		grate_3d_upload_fp_constants(pb, ctx);
+
+	if (dirty & GRATE_3D_DIRTY_ATTRIBUTES)
+		grate_3d_setup_attributes(pb, ctx);
+
+	if (dirty & GRATE_3D_DIRTY_RENDER_TARGETS)
+		grate_3d_setup_render_targets(pb, ctx);
+
 	grate_3d_setup_textures(pb, ctx);
 
-	grate_3d_reset_program(pb);
-	grate_shader_emit(pb, ctx->program->vs);
-	grate_shader_emit(pb, ctx->program->fs);
-	grate_shader_emit(pb, ctx->program->linker);
+	if (dirty & GRATE_3D_DIRTY_PROGRAM)
+		grate_3d_upload_program(pb, ctx);
+
+	ctx->dirty = 0;
 }
 
-static void grate_3d_check_render_targets_guard(struct grate_3d_ctx *ctx)
+/* words of a state object besides the shaders */
+#define GRATE_3D_STATE_WORDS	512
+
+struct grate_3d_state *grate_3d_create_state(struct grate_3d_ctx *ctx)
+{
+	static uint32_t next_id;
+	struct grate_3d_state *state;
+	struct grate_program *program = ctx->program;
+	struct host1x_pushbuf *pb;
+	struct host1x_job *job;
+	unsigned words;
+	int err;
+
+	if (!program || !program->vs || !program->fs || !program->linker) {
+		grate_error("Program wasn't compiled\n");
+		return NULL;
+	}
+
+	state = calloc(1, sizeof(*state));
+	if (!state) {
+		grate_error("Failed to allocate state\n");
+		return NULL;
+	}
+
+	state->grate = ctx->grate;
+	state->ctx = *ctx;
+	state->id = ++next_id;
+
+	words = GRATE_3D_STATE_WORDS;
+	words += program->vs->num_words;
+	words += program->fs->num_words;
+	words += program->linker->num_words;
+
+	/*
+	 * Words pushed past the end of the BO are dropped, the spare word
+	 * makes a state that doesn't fit longer than @words.
+	 */
+	state->bo = HOST1X_BO_CREATE(ctx->grate->host1x,
+				     (words + 1) * sizeof(uint32_t),
+				     NVHOST_BO_FLAG_COMMAND_BUFFER);
+	if (!state->bo)
+		goto free_state;
+
+	err = HOST1X_BO_MMAP(state->bo, NULL);
+	if (err < 0)
+		goto free_bo;
+
+	job = HOST1X_JOB_CREATE(0, 0);
+	if (!job)
+		goto free_bo;
+
+	pb = HOST1X_JOB_APPEND(job, state->bo, 0);
+	if (!pb)
+		goto free_job;
+
+	grate_3d_emit_pipeline(pb, &state->ctx, GRATE_3D_DIRTY_STATE);
+	err = grate_3d_upload_program(pb, &state->ctx);
+
+	if (err < 0 || pb->length > words) {
+		grate_error("State doesn't fit into %u words\n", words);
+		goto free_job;
+	}
+
+	err = HOST1X_BO_FLUSH(state->bo, 0, pb->length * sizeof(uint32_t));
+	if (err < 0)
+		goto free_job;
+
+	state->num_words = pb->length;
+	state->relocs = pb->relocs;
+	state->num_relocs = pb->num_relocs;
+	pb->relocs = NULL;
+
+	host1x_job_free(job);
+
+	return state;
+
+free_job:
+	host1x_job_free(job);
+free_bo:
+	host1x_bo_free(state->bo);
+free_state:
+	free(state);
+
+	return NULL;
+}
+
+void grate_3d_free_state(struct grate_3d_state *state)
+{
+	if (!state)
+		return;
+
+	/* in-flight batches may still gather the state */
+	grate_3d_finish(state->grate);
+
+	host1x_bo_free(state->bo);
+	free(state->relocs);
+	free(state);
+}
+
+/*
+ * Words needed by a draw besides the shaders: the VP constants upload and
+ * a generous margin for the rest of the context setup and the draw itself.
+ */
+#define GRATE_3D_DRAW_WORDS	(256 * 4 + 1024)
+
+static unsigned grate_3d_batch_words(struct grate *grate)
+{
+	return grate->commands->segment_size / 2 / sizeof(uint32_t);
+}
+
+static void grate_3d_batch_add_guard(struct grate_3d_batch *batch,
+				     struct host1x_pixelbuffer *pixbuf)
 {
 	unsigned i;
 
+	for (i = 0; i < batch->num_guards; i++) {
+		if (batch->guards[i] == pixbuf)
+			return;
+	}
+
+	if (batch->num_guards < GRATE_3D_BATCH_GUARDS)
+		batch->guards[batch->num_guards++] = pixbuf;
+	else
+		host1x_pixelbuffer_check_guard(pixbuf);
+}
+
+static void grate_3d_add_render_targets_guard(struct grate_3d_batch *batch,
+					      struct grate_3d_ctx *ctx)
+{
+	unsigned i;
+
+	if (host1x_pixelbuffer_bo_guard_disabled())
+		return;
+
 	for (i = 0; i < 16; i++) {
 		struct grate_render_target *rt = &ctx->render_targets[i];
 
@@ -898,10 +1099,191 @@ pixbuf_check:
 		if (!rt->pixbuf)
 			continue;
 
-		host1x_pixelbuffer_check_guard(rt->pixbuf);
+		grate_3d_batch_add_guard(batch, rt->pixbuf);
 	}
 }
 
+static void grate_3d_batch_retire(struct grate_3d_batch *batch)
+{
+	unsigned i;
+
+	if (!batch->busy)
+		return;
+
+	grate_fence_wait(&batch->fence, ~0u);
+
+	for (i = 0; i < batch->num_guards; i++)
+		host1x_pixelbuffer_check_guard(batch->guards[i]);
+
+	batch->num_guards = 0;
+	batch->busy = false;
+}
+
+/*
+ * Returns the pushbuf of the batch that is being recorded. A batch that would
+ * grow beyond its size limit with @words more words is submitted first and
+ * recording continues in a new batch once the GPU is done with it. A single
+ * draw larger than the limit makes the ring segment grow.
+ */
+static struct host1x_pushbuf *grate_3d_batch_reserve(struct grate *grate,
+						     unsigned words)
+{
+	struct host1x_gr3d *gr3d = host1x_get_gr3d(grate->host1x);
+	struct host1x_syncpt *syncpt = &gr3d->client->syncpts[0];
+	struct grate_3d_batch *batch = &grate->batches[grate->batch];
+	unsigned max_words = grate_3d_batch_words(grate);
+	struct host1x_job *job;
+
+	/* leave space for the syncpoint increment that ends the batch */
+	words += 2;
+
+	if (batch->pb && batch->words + batch->pb->length + words > max_words) {
+		if (grate_3d_flush(grate) < 0)
+			return NULL;
+
+		batch = &grate->batches[grate->batch];
+	}
+
+	if (batch->pb)
+		return batch->pb;
+
+	grate_3d_batch_retire(batch);
+
+	job = HOST1X_JOB_CREATE(syncpt->id, 1);
+	if (!job)
+		return NULL;
+
+	batch->pb = host1x_cmdring_append(grate->commands, job);
+	if (!batch->pb) {
+		host1x_job_free(job);
+		return NULL;
+	}
+
+	batch->job = job;
+	batch->ctx = NULL;
+	batch->words = 0;
+
+	/* the state left behind by the previous batch is unknown */
+	grate_3d_begin(batch->pb);
+	grate_3d_init(batch->pb);
+
+	return batch->pb;
+}
+
+/*
+ * Makes the batch gather the commands of the state object of the context
+ * and continues recording the batch in a new pushbuf after it.
+ */
+static int grate_3d_batch_gather_state(struct grate *grate,
+				       struct grate_3d_ctx *ctx)
+{
+	struct grate_3d_batch *batch = &grate->batches[grate->batch];
+	struct grate_3d_state *state = ctx->state;
+	struct host1x_job *job = batch->job;
+	struct host1x_pushbuf *pb;
+	unsigned long index;
+	unsigned words;
+	int err;
+
+	index = batch->pb - job->pushbufs;
+
+	/*
+	 * Reserving may move the pushbuf array, after that it holds room for
+	 * the two pushbufs appended below and stays in place.
+	 */
+	err = host1x_job_reserve_pushbufs(job, 2);
+	if (err < 0)
+		return err;
+
+	batch->pb = &job->pushbufs[index];
+	words = batch->pb->length;
+
+	pb = HOST1X_JOB_APPEND(job, state->bo, 0);
+	if (!pb)
+		return -ENOMEM;
+
+	err = host1x_pushbuf_reserve_relocs(pb, state->num_relocs);
+	if (err < 0)
+		goto drop;
+
+	memcpy(pb->relocs, state->relocs,
+	       state->num_relocs * sizeof(*state->relocs));
+	pb->num_relocs = state->num_relocs;
+	host1x_pushbuf_commit(pb, state->num_words);
+
+	pb = host1x_cmdring_append(grate->commands, job);
+	if (!pb) {
+		err = -ENOMEM;
+		goto drop;
+	}
+
+	batch->pb = pb;
+	batch->words += words;
+
+	ctx->state_id = state->id;
+	ctx->state_pending = false;
+
+	return 0;
+
+drop:
+	free(job->pushbufs[--job->num_pushbufs].relocs);
+	batch->pb = &job->pushbufs[index];
+
+	return err;
+}
+
+int grate_3d_flush(struct grate *grate)
+{
+	struct host1x_gr3d *gr3d = host1x_get_gr3d(grate->host1x);
+	struct host1x_syncpt *syncpt = &gr3d->client->syncpts[0];
+	struct grate_3d_batch *batch = &grate->batches[grate->batch];
+	struct host1x_pushbuf *pb = batch->pb;
+	uint32_t fence;
+	int err;
+
+	if (!batch->job)
+		return 0;
+
+	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x00, 0x01));
+	host1x_pushbuf_push(pb, 0x000001 << 8 | syncpt->id);
+
+	err = host1x_cmdring_submit(grate->commands, batch->job);
+
+	host1x_job_free(batch->job);
+	batch->job = NULL;
+	batch->pb = NULL;
+
+	if (err < 0) {
+		batch->num_guards = 0;
+		return err;
+	}
+
+	err = host1x_cmdring_flush(grate->commands, &fence);
+	if (err < 0) {
+		batch->num_guards = 0;
+		return err;
+	}
+
+	batch->fence.client = gr3d->client;
+	batch->fence.value = fence;
+	batch->busy = true;
+
+	grate->fence = batch->fence;
+	grate->batch = (grate->batch + 1) % GRATE_3D_NUM_BATCHES;
+
+	return 0;
+}
+
+void grate_3d_finish(struct grate *grate)
+{
+	unsigned i;
+
+	grate_3d_flush(grate);
+
+	for (i = 0; i < GRATE_3D_NUM_BATCHES; i++)
+		grate_3d_batch_retire(&grate->batches[i]);
+}
+
 void grate_3d_draw_elements(struct grate_3d_ctx *ctx,
 			    unsigned primitive_type,
 			    struct host1x_bo *indices_bo,
@@ -909,12 +1291,9 @@ void grate_3d_draw_elements(struct grate_3d_ctx *ctx,
 			    unsigned vtx_count)
 {
 	struct grate *grate = ctx->grate;
-	struct host1x_gr3d *gr3d = host1x_get_gr3d(grate->host1x);
-	struct host1x_syncpt *syncpt = &gr3d->client->syncpts[0];
+	struct grate_3d_batch *batch;
 	struct host1x_pushbuf *pb;
-	struct host1x_job *job;
-	uint32_t fence;
-	int err;
+	unsigned words;
 
 	if (!ctx->program) {
 		grate_error("No program bound\n");
@@ -950,39 +1329,49 @@ void grate_3d_draw_elements(struct grate_3d_ctx *ctx,
 		return;
 	}
 
-	job = HOST1X_JOB_CREATE(syncpt->id, 1);
-	if (!job)
-		return;
+	words = GRATE_3D_DRAW_WORDS;
+	words += ctx->program->vs->num_words;
+	words += ctx->program->fs->num_words;
+	words += ctx->program->linker->num_words;
 
-	pb = HOST1X_JOB_APPEND(job, gr3d->commands, 0);
-	if (!pb) {
-		host1x_job_free(job);
+	pb = grate_3d_batch_reserve(grate, words);
+	if (!pb)
 		return;
-	}
 
-	grate_3d_setup_context(pb, ctx);
-	grate_3d_setup_indices(pb, indices_bo, index_mode);
-	grate_3d_set_draw_params(pb, ctx, primitive_type, index_mode);
-	grate_3d_draw_primitives(pb, vtx_count);
+	batch = &grate->batches[grate->batch];
 
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x00, 0x01));
-	host1x_pushbuf_push(pb, 0x000001 << 8 | syncpt->id);
+	/*
+	 * The state left behind by another context is unknown. The pipeline
+	 * state is gathered again if it still is the one of the state object.
+	 */
+	if (batch->ctx != ctx) {
+		bool gather = ctx->state_pending ||
+			      (ctx->state_id &&
+			       !(ctx->dirty & GRATE_3D_DIRTY_STATE));
 
-	err = HOST1X_CLIENT_SUBMIT(gr3d->client, job);
-	if (err < 0) {
-		host1x_job_free(job);
-		return;
+		grate_3d_ctx_mark_dirty(ctx, GRATE_3D_DIRTY_ALL);
+
+		if (gather) {
+			ctx->dirty &= ~GRATE_3D_DIRTY_STATE;
+			ctx->state_pending = true;
+		}
+
+		batch->ctx = ctx;
 	}
 
-	host1x_job_free(job);
+	if (ctx->state_pending) {
+		if (grate_3d_batch_gather_state(grate, ctx) < 0) {
+			grate_3d_ctx_mark_dirty(ctx, GRATE_3D_DIRTY_STATE);
+			ctx->state_pending = false;
+		}
 
-	err = HOST1X_CLIENT_FLUSH(gr3d->client, &fence);
-	if (err < 0)
-		return;
+		pb = batch->pb;
+	}
 
-	err = HOST1X_CLIENT_WAIT(gr3d->client, fence, ~0u);
-	if (err < 0)
-		return;
+	grate_3d_setup_context(pb, ctx);
+	grate_3d_setup_indices(pb, indices_bo, index_mode);
+	grate_3d_set_draw_params(pb, ctx, primitive_type, index_mode);
+	grate_3d_draw_primitives(pb, vtx_count);
 
-	grate_3d_check_render_targets_guard(ctx);
+	grate_3d_add_render_targets_guard(batch, ctx);
 }
@@ -6,6 +6,7 @@
 #define log2_size(s)		(31 - __builtin_clz(s))
 
 struct host1x_bo;
+struct host1x_pushbuf_reloc;
 struct cgc_shader;
 
 struct grate_attribute {
@@ -81,8 +82,46 @@ struct grate_texture {
 	bool min_filter_enabled;
 	bool mip_filter_enabled;
 	bool mipmap_enabled;
+
+	/* streamed texture, @pixbuf is the placeholder until it's uploaded */
+	struct grate_texture_upload *upload;
+	bool placeholder;
+};
+
+/*
+ * Texture unit state as it was last emitted to the channel, textures are
+ * compared against it on every draw since their parameters are changed
+ * without the context knowing about it.
+ */
+struct grate_texture_state {
+	struct host1x_bo *bo;
+	unsigned long offset;
+	uint32_t desc1;
+	uint32_t desc2;
 };
 
+/*
+ * Groups of context state that changed since the context was emitted last.
+ * Only dirty groups are emitted as long as the context keeps drawing into
+ * the same command stream batch.
+ */
+#define GRATE_3D_DIRTY_PROGRAM		(1u << 0)
+#define GRATE_3D_DIRTY_RASTER		(1u << 1)
+#define GRATE_3D_DIRTY_VIEWPORT		(1u << 2)
+#define GRATE_3D_DIRTY_DEPTH_STENCIL	(1u << 3)
+#define GRATE_3D_DIRTY_VS_CONSTANTS	(1u << 4)
+#define GRATE_3D_DIRTY_FS_CONSTANTS	(1u << 5)
+#define GRATE_3D_DIRTY_ATTRIBUTES	(1u << 6)
+#define GRATE_3D_DIRTY_RENDER_TARGETS	(1u << 7)
+#define GRATE_3D_DIRTY_TEXTURES		(1u << 8)
+#define GRATE_3D_DIRTY_ALL		((1u << 9) - 1)
+
+/* groups that are baked into a state object */
+#define GRATE_3D_DIRTY_STATE		(GRATE_3D_DIRTY_PROGRAM | \
+					 GRATE_3D_DIRTY_RASTER | \
+					 GRATE_3D_DIRTY_VIEWPORT | \
+					 GRATE_3D_DIRTY_DEPTH_STENCIL)
+
 struct grate_3d_ctx {
 	uint32_t vs_uniforms[256 * 4];
 	uint32_t fs_uniforms[32];
@@ -94,6 +133,13 @@ struct grate_3d_ctx {
 	struct grate_vtx_attribute *vtx_attributes[16];
 	struct grate_texture *textures[16];
 
+	uint16_t attributes_enable_mask;
+	uint16_t render_targets_enable_mask;
+
+	/*
+	 * Pipeline state, from depth_range_near up to stencil_mask_back,
+	 * that is captured by a state object together with the program.
+	 */
 	float depth_range_near;
 	float depth_range_far;
 	float point_size;
@@ -133,14 +179,46 @@ struct grate_3d_ctx {
 	uint16_t scissor_y;
 	uint16_t scissor_width;
 	uint16_t scissor_heigth;
-
-	uint16_t attributes_enable_mask;
-	uint16_t render_targets_enable_mask;
-
 	uint8_t stencil_ref_front;
 	uint8_t stencil_ref_back;
 	uint8_t stencil_mask_front;
 	uint8_t stencil_mask_back;
+
+	uint32_t dirty;
+
+	/*
+	 * State object that was bound last. The ID is non-zero as long as
+	 * the pipeline state emitted into the batch is the one of the state
+	 * object, which then needn't be gathered again when rebound.
+	 */
+	struct grate_3d_state *state;
+	uint32_t state_id;
+	bool state_pending;
+
+	/* range of dirty VS constants, in vec4 units */
+	uint16_t vs_uniforms_dirty_start;
+	uint16_t vs_uniforms_dirty_end;
+
+	struct grate_texture_state emitted_textures[16];
+};
+
+/*
+ * Immutable, pre-encoded pipeline state of a context: the program and the
+ * rasterizer, viewport and depth/stencil setup. The command words live in
+ * a command buffer BO that draws gather instead of emitting the state.
+ */
+struct grate_3d_state {
+	struct grate *grate;
+	struct host1x_bo *bo;
+	unsigned num_words;
+
+	struct host1x_pushbuf_reloc *relocs;
+	unsigned num_relocs;
+
+	uint32_t id;
+	struct grate_3d_ctx ctx;
 };
 
+void grate_3d_ctx_mark_dirty(struct grate_3d_ctx *ctx, uint32_t dirty);
+
 #endif
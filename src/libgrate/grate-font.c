@@ -375,7 +375,9 @@ void grate_3d_printf(struct grate *grate,
 				       font->indices_bo,
 				       TGR3D_INDEX_MODE_UINT16,
 				       chars_nb_to_draw * 6);
-		grate_flush(grate);
+
+		/* the vertex BOs are rewritten by the next batch of chars */
+		grate_finish(grate);
 
 		chars_nb_to_draw = 0;
 	}
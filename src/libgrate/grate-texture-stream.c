@@ -0,0 +1,562 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Asynchronous texture loading. grate_create_texture_async() returns a
+ * texture that samples a shared placeholder, worker threads decode and
+ * compress the image and copy it into one of a few staging BOs. The render
+ * thread then queues a GR2D blit from the staging BO into the texture and,
+ * once that blit retired, switches the texture over to its pixelbuffer.
+ * Staging BOs are handed back to the workers as their blits retire, which
+ * bounds the amount of decoded data in flight.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "grate.h"
+#include "grate-3d.h"
+#include "libgrate-private.h"
+#include "list.h"
+
+#define GRATE_STREAM_MAX_THREADS	8
+#define GRATE_STREAM_STAGING_BOS	4
+#define GRATE_STREAM_STAGING_SIZE	(4 << 20)
+
+/* opaque mid grey */
+#define GRATE_STREAM_PLACEHOLDER	0xff808080
+
+struct grate_staging {
+	struct host1x_bo *bo;
+	void *map;
+	bool busy;
+};
+
+struct grate_texture_upload {
+	struct list_head node;
+	struct grate_texture_stream *stream;
+
+	/* NULL once the texture was freed before the upload finished */
+	struct grate_texture *tex;
+
+	char *path;
+	enum pixel_format format;
+	enum layout_format layout;
+	int err;
+
+	/* decoded data, kept here only if it didn't fit a staging BO */
+	struct grate_texture_data data;
+	struct grate_staging *staging;
+
+	/* owned by the render thread once the upload was decoded */
+	struct host1x_pixelbuffer *pixbuf;
+	struct host1x_pixelbuffer src;
+	struct host1x_fence fence;
+};
+
+struct grate_texture_stream {
+	struct grate *grate;
+
+	pthread_t threads[GRATE_STREAM_MAX_THREADS];
+	unsigned int num_threads;
+
+	/* protects the queues, the staging BOs and @exit */
+	pthread_mutex_t lock;
+	pthread_cond_t queued;
+	pthread_cond_t staging_free;
+
+	struct list_head queue;
+	struct list_head decoded;
+	bool exit;
+
+	/* render thread only */
+	struct list_head blitting;
+
+	struct grate_staging staging[GRATE_STREAM_STAGING_BOS];
+	struct host1x_pixelbuffer *placeholder;
+};
+
+static void upload_free(struct grate_texture_upload *upload)
+{
+	grate_texture_data_free(&upload->data);
+	free(upload->path);
+	free(upload);
+}
+
+static void upload_complete(struct grate_texture_upload *upload)
+{
+	struct grate_texture *tex = upload->tex;
+
+	if (tex) {
+		tex->pixbuf = upload->pixbuf;
+		tex->placeholder = false;
+		tex->upload = NULL;
+	} else {
+		host1x_pixelbuffer_free(upload->pixbuf);
+	}
+
+	upload_free(upload);
+}
+
+static void upload_fail(struct grate_texture_upload *upload, int err)
+{
+	if (upload->tex) {
+		grate_error("failed to load %s: %d\n", upload->path, err);
+		upload->tex->upload = NULL;
+	}
+
+	if (upload->pixbuf)
+		host1x_pixelbuffer_free(upload->pixbuf);
+
+	upload_free(upload);
+}
+
+static struct grate_staging *
+staging_get(struct grate_texture_stream *stream)
+{
+	unsigned int i;
+
+	for (i = 0; i < GRATE_STREAM_STAGING_BOS; i++)
+		if (!stream->staging[i].busy) {
+			stream->staging[i].busy = true;
+			return &stream->staging[i];
+		}
+
+	return NULL;
+}
+
+static void staging_put(struct grate_texture_stream *stream,
+			struct grate_staging *staging)
+{
+	pthread_mutex_lock(&stream->lock);
+	staging->busy = false;
+	pthread_cond_signal(&stream->staging_free);
+	pthread_mutex_unlock(&stream->lock);
+}
+
+static void *stream_worker(void *arg)
+{
+	struct grate_texture_stream *stream = arg;
+	struct grate_texture_upload *upload;
+	struct grate_staging *staging;
+
+	pthread_mutex_lock(&stream->lock);
+
+	while (!stream->exit) {
+		if (list_empty(&stream->queue)) {
+			pthread_cond_wait(&stream->queued, &stream->lock);
+			continue;
+		}
+
+		upload = list_entry(stream->queue.next,
+				    struct grate_texture_upload, node);
+		list_del(&upload->node);
+
+		if (!upload->tex) {
+			upload_free(upload);
+			continue;
+		}
+
+		pthread_mutex_unlock(&stream->lock);
+
+		upload->err = grate_texture_decode(upload->path,
+						   upload->format, 0, 0,
+						   &upload->data);
+
+		pthread_mutex_lock(&stream->lock);
+
+		/* wait for a staging BO, larger textures stay in memory */
+		while (!upload->err &&
+		       upload->data.size <= GRATE_STREAM_STAGING_SIZE &&
+		       !stream->exit) {
+			staging = staging_get(stream);
+			if (!staging) {
+				pthread_cond_wait(&stream->staging_free,
+						  &stream->lock);
+				continue;
+			}
+
+			pthread_mutex_unlock(&stream->lock);
+
+			memcpy(staging->map, upload->data.data,
+			       upload->data.size);
+			grate_texture_data_free(&upload->data);
+			upload->staging = staging;
+
+			pthread_mutex_lock(&stream->lock);
+			break;
+		}
+
+		list_add_tail(&upload->node, &stream->decoded);
+	}
+
+	pthread_mutex_unlock(&stream->lock);
+
+	return NULL;
+}
+
+static struct grate_texture_stream *stream_create(struct grate *grate)
+{
+	struct grate_texture_stream *stream;
+	const char *str;
+	uint32_t *map;
+	unsigned int i;
+	int err;
+
+	stream = calloc(1, sizeof(*stream));
+	if (!stream)
+		return NULL;
+
+	stream->grate = grate;
+	pthread_mutex_init(&stream->lock, NULL);
+	pthread_cond_init(&stream->queued, NULL);
+	pthread_cond_init(&stream->staging_free, NULL);
+	INIT_LIST_HEAD(&stream->queue);
+	INIT_LIST_HEAD(&stream->decoded);
+	INIT_LIST_HEAD(&stream->blitting);
+
+	for (i = 0; i < GRATE_STREAM_STAGING_BOS; i++) {
+		struct grate_staging *staging = &stream->staging[i];
+
+		staging->bo = HOST1X_BO_CREATE(grate->host1x,
+					       GRATE_STREAM_STAGING_SIZE,
+					       NVHOST_BO_FLAG_FRAMEBUFFER);
+		if (!staging->bo)
+			goto err_free;
+
+		err = HOST1X_BO_MMAP(staging->bo, &staging->map);
+		if (err)
+			goto err_free;
+
+		staging->map = (uint8_t *)staging->map + staging->bo->offset;
+	}
+
+	stream->placeholder = grate_texture_create_pixbuf(grate, 4, 4,
+						PIX_BUF_FMT_RGBA8888,
+						PIX_BUF_LAYOUT_LINEAR);
+	if (!stream->placeholder)
+		goto err_free;
+
+	err = HOST1X_BO_MMAP(stream->placeholder->bo, (void **)&map);
+	if (err)
+		goto err_free;
+
+	map = (void *)map + stream->placeholder->bo->offset;
+
+	for (i = 0; i < 4 * stream->placeholder->pitch / 4; i++)
+		map[i] = GRATE_STREAM_PLACEHOLDER;
+
+	HOST1X_BO_FLUSH(stream->placeholder->bo,
+			stream->placeholder->bo->offset,
+			4 * stream->placeholder->pitch);
+
+	stream->num_threads = 2;
+
+	str = getenv("GRATE_STREAM_THREADS");
+	if (str)
+		stream->num_threads = strtoul(str, NULL, 0);
+
+	stream->num_threads = MAX(stream->num_threads, 1);
+	stream->num_threads = MIN(stream->num_threads,
+				  GRATE_STREAM_MAX_THREADS);
+
+	for (i = 0; i < stream->num_threads; i++) {
+		if (pthread_create(&stream->threads[i], NULL, stream_worker,
+				   stream)) {
+			stream->num_threads = i;
+			grate_texture_stream_destroy(stream);
+			return NULL;
+		}
+	}
+
+	return stream;
+
+err_free:
+	grate_texture_stream_destroy(stream);
+	return NULL;
+}
+
+void grate_texture_stream_destroy(struct grate_texture_stream *stream)
+{
+	struct grate_texture_upload *upload, *tmp;
+	unsigned int i;
+
+	if (!stream)
+		return;
+
+	pthread_mutex_lock(&stream->lock);
+	stream->exit = true;
+	pthread_cond_broadcast(&stream->queued);
+	pthread_cond_broadcast(&stream->staging_free);
+	pthread_mutex_unlock(&stream->lock);
+
+	for (i = 0; i < stream->num_threads; i++)
+		pthread_join(stream->threads[i], NULL);
+
+	list_for_each_entry_safe(upload, tmp, &stream->blitting, node) {
+		host1x_fence_wait(&upload->fence, ~0u);
+		host1x_bo_free(upload->src.bo);
+		upload_complete(upload);
+	}
+
+	list_for_each_entry_safe(upload, tmp, &stream->decoded, node) {
+		if (upload->tex)
+			upload->tex->upload = NULL;
+
+		upload_free(upload);
+	}
+
+	list_for_each_entry_safe(upload, tmp, &stream->queue, node) {
+		if (upload->tex)
+			upload->tex->upload = NULL;
+
+		upload_free(upload);
+	}
+
+	for (i = 0; i < GRATE_STREAM_STAGING_BOS; i++)
+		if (stream->staging[i].bo)
+			host1x_bo_free(stream->staging[i].bo);
+
+	if (stream->placeholder)
+		host1x_pixelbuffer_free(stream->placeholder);
+
+	pthread_cond_destroy(&stream->staging_free);
+	pthread_cond_destroy(&stream->queued);
+	pthread_mutex_destroy(&stream->lock);
+	free(stream);
+}
+
+struct grate_texture *grate_create_texture_async(struct grate *grate,
+						 const char *path,
+						 enum pixel_format format,
+						 enum layout_format layout)
+{
+	struct grate_texture_upload *upload;
+	struct grate_texture *tex;
+
+	if (!grate->stream) {
+		grate->stream = stream_create(grate);
+		if (!grate->stream)
+			return NULL;
+	}
+
+	tex = calloc(1, sizeof(*tex));
+	upload = calloc(1, sizeof(*upload));
+	if (!tex || !upload)
+		goto err_free;
+
+	upload->path = strdup(path);
+	if (!upload->path)
+		goto err_free;
+
+	upload->stream = grate->stream;
+	upload->tex = tex;
+	upload->format = format;
+	upload->layout = layout;
+
+	tex->pixbuf = grate->stream->placeholder;
+	tex->placeholder = true;
+	tex->upload = upload;
+
+	pthread_mutex_lock(&grate->stream->lock);
+	list_add_tail(&upload->node, &grate->stream->queue);
+	pthread_cond_signal(&grate->stream->queued);
+	pthread_mutex_unlock(&grate->stream->lock);
+
+	return tex;
+
+err_free:
+	if (upload)
+		free(upload->path);
+	free(upload);
+	free(tex);
+
+	return NULL;
+}
+
+/*
+ * The texture is freed while its upload is in flight, the upload is
+ * dropped as soon as a worker or the render thread picks it up.
+ */
+void grate_texture_stream_cancel(struct grate_texture_upload *upload)
+{
+	struct grate_texture_stream *stream = upload->stream;
+
+	pthread_mutex_lock(&stream->lock);
+	upload->tex = NULL;
+	pthread_mutex_unlock(&stream->lock);
+}
+
+bool grate_texture_ready(struct grate_texture *tex)
+{
+	return !tex->upload && !tex->placeholder;
+}
+
+/*
+ * GR2D copies pixels, compressed data is blitted as rows of 32bpp pixels
+ * that cover the block rows. Tiled compressed textures are loaded by the
+ * CPU.
+ */
+static int upload_blit(struct grate_texture_stream *stream,
+		       struct grate_texture_upload *upload)
+{
+	struct host1x_gr2d *gr2d = host1x_get_gr2d(stream->grate->host1x);
+	struct host1x_pixelbuffer *pixbuf = upload->pixbuf;
+	struct host1x_pixelbuffer dst = *pixbuf;
+	struct host1x_pixelbuffer *src = &upload->src;
+	struct grate_texture_data *data = &upload->data;
+	struct host1x_bo *bo = upload->staging->bo;
+	unsigned int rows = data->size / data->pitch;
+	int err;
+
+	if (PIX_BUF_FORMAT_COMPRESSED(pixbuf->format)) {
+		if (pixbuf->layout != PIX_BUF_LAYOUT_LINEAR)
+			return -EINVAL;
+
+		dst.format = PIX_BUF_FMT_RGBA8888;
+		dst.width = data->pitch / 4;
+		dst.height = rows;
+	}
+
+	err = HOST1X_BO_FLUSH(bo, bo->offset, data->size);
+	if (err)
+		return err;
+
+	src->bo = HOST1X_BO_WRAP(bo, 0, data->size);
+	if (!src->bo)
+		return -ENOMEM;
+
+	src->format = dst.format;
+	src->layout = PIX_BUF_LAYOUT_LINEAR;
+	src->width = dst.width;
+	src->height = dst.height;
+	src->pitch = data->pitch;
+	src->guarded = false;
+
+	err = host1x_gr2d_blit_async(gr2d, src, &dst, 0, 0, 0, 0,
+				     dst.width, dst.height, &upload->fence);
+	if (err) {
+		host1x_bo_free(src->bo);
+		src->bo = NULL;
+	}
+
+	return err;
+}
+
+/*
+ * Runs on the render thread: retires finished blits, then queues blits for
+ * the uploads decoded since the last call. Returns the number of textures
+ * that became ready.
+ */
+int grate_texture_stream_poll(struct grate *grate)
+{
+	struct grate_texture_stream *stream = grate->stream;
+	struct grate_texture_upload *upload, *tmp;
+	struct host1x *host1x = grate->host1x;
+	struct grate_texture_data *data;
+	struct list_head decoded;
+	void *map;
+	int ready = 0;
+	int err;
+
+	if (!stream)
+		return 0;
+
+	list_for_each_entry_safe(upload, tmp, &stream->blitting, node) {
+		if (host1x_fence_poll(&upload->fence) <= 0)
+			continue;
+
+		list_del(&upload->node);
+		host1x_bo_free(upload->src.bo);
+		staging_put(stream, upload->staging);
+
+		if (upload->tex)
+			ready++;
+
+		upload_complete(upload);
+	}
+
+	INIT_LIST_HEAD(&decoded);
+
+	pthread_mutex_lock(&stream->lock);
+	list_for_each_entry_safe(upload, tmp, &stream->decoded, node) {
+		list_del(&upload->node);
+		list_add_tail(&upload->node, &decoded);
+	}
+	pthread_mutex_unlock(&stream->lock);
+
+	list_for_each_entry_safe(upload, tmp, &decoded, node) {
+		list_del(&upload->node);
+		data = &upload->data;
+
+		if (upload->err || !upload->tex) {
+			if (upload->staging)
+				staging_put(stream, upload->staging);
+
+			upload_fail(upload, upload->err);
+			continue;
+		}
+
+		upload->pixbuf = grate_texture_create_pixbuf(grate,
+							data->width,
+							data->height,
+							upload->format,
+							upload->layout);
+		if (!upload->pixbuf) {
+			if (upload->staging)
+				staging_put(stream, upload->staging);
+
+			upload_fail(upload, -ENOMEM);
+			continue;
+		}
+
+		if (upload->staging) {
+			if (!upload_blit(stream, upload)) {
+				list_add_tail(&upload->node, &stream->blitting);
+				continue;
+			}
+
+			map = upload->staging->map;
+		} else {
+			map = data->data;
+		}
+
+		err = host1x_pixelbuffer_load_data(host1x, upload->pixbuf,
+						   map, data->pitch,
+						   data->size, upload->format,
+						   PIX_BUF_LAYOUT_LINEAR);
+		if (upload->staging)
+			staging_put(stream, upload->staging);
+
+		if (err) {
+			upload_fail(upload, err);
+			continue;
+		}
+
+		ready++;
+		upload_complete(upload);
+	}
+
+	return ready;
+}
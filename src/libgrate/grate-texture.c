@@ -23,23 +23,33 @@
 
 #include <assert.h>
 #include <byteswap.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <IL/il.h>
 #include <IL/ilu.h>
 
+#include "baked_texture.h"
 #include "etc1.h"
 #include "grate.h"
 #include "grate-3d.h"
 
 #include "libgrate-private.h"
 
-struct grate_texture *grate_create_texture(struct grate *grate,
-					   unsigned width, unsigned height,
-					   enum pixel_format format,
-					   enum layout_format layout)
+struct host1x_pixelbuffer *grate_texture_create_pixbuf(struct grate *grate,
+							unsigned width,
+							unsigned height,
+							enum pixel_format format,
+							enum layout_format layout)
 {
-	struct grate_texture *tex;
+	struct host1x_pixelbuffer *pixbuf;
 	unsigned pitch;
 
 	switch (format) {
@@ -66,19 +76,33 @@ struct grate_texture *grate_create_texture(struct grate *grate,
 		return NULL;
 	}
 
-	tex = calloc(1, sizeof(*tex));
-	if (!tex)
-		return NULL;
-
 	pitch = PIX_BUF_FORMAT_BYTES(format) * width;
 	pitch = pitch / PIX_BUF_FORMAT_TEXEL_WIDTH(format);
 	pitch = ALIGN(pitch, PIX_BUF_FORMAT_ALIGNMENT(format));
 
-	tex->pixbuf = host1x_pixelbuffer_create(grate->host1x, width, height,
-						pitch, format, layout);
-	if (!tex->pixbuf) {
+	pixbuf = host1x_pixelbuffer_create(grate->host1x, width, height,
+					   pitch, format, layout);
+	if (!pixbuf)
 		grate_error("failed to allocate texture %ux%u bpp:%u pitch:%u\n",
 			    width, height, PIX_BUF_FORMAT_BYTES(format), pitch);
+
+	return pixbuf;
+}
+
+struct grate_texture *grate_create_texture(struct grate *grate,
+					   unsigned width, unsigned height,
+					   enum pixel_format format,
+					   enum layout_format layout)
+{
+	struct grate_texture *tex;
+
+	tex = calloc(1, sizeof(*tex));
+	if (!tex)
+		return NULL;
+
+	tex->pixbuf = grate_texture_create_pixbuf(grate, width, height,
+						  format, layout);
+	if (!tex->pixbuf) {
 		free(tex);
 		return NULL;
 	}
@@ -86,54 +110,71 @@ struct grate_texture *grate_create_texture(struct grate *grate,
 	return tex;
 }
 
-static int grate_texture_load_internal(struct grate *grate,
-				       struct grate_texture **tex,
-				       const char *path, bool create,
-				       enum pixel_format format,
-				       enum layout_format layout)
+/*
+ * ETC1 compression is by far the slowest part of loading a texture, the
+ * GRATE_ETC1_QUALITY environment variable allows to trade quality for
+ * loading time.
+ */
+static int grate_etc1_quality(void)
+{
+	const char *str = getenv("GRATE_ETC1_QUALITY");
+
+	if (str && !strcmp(str, "fast"))
+		return ETC1_QUALITY_FAST;
+
+	if (str && !strcmp(str, "medium"))
+		return ETC1_QUALITY_MEDIUM;
+
+	return ETC1_QUALITY_BEST;
+}
+
+/*
+ * DevIL keeps the bound image in global state, so only one thread at a time
+ * may use it.
+ */
+static pthread_mutex_t il_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void grate_texture_data_free(struct grate_texture_data *data)
+{
+	free(data->data);
+	data->data = NULL;
+}
+
+/*
+ * Decodes the image at @path and converts it into the texels of @format,
+ * flipped for GR3D and scaled to @width x @height unless those are zero.
+ * Safe to call from any thread.
+ */
+int grate_texture_decode(const char *path, enum pixel_format format,
+			 unsigned width, unsigned height,
+			 struct grate_texture_data *out)
 {
-	unsigned tex_pitch;
-	unsigned tex_bpp;
-	unsigned tw, bpp;
-	void *tex_data;
-	ILuint tex_size;
 	ILuint ImageTex;
+	ILenum DXTCFormat;
+	ILubyte *pixels;
+	ILuint dxtSize;
 	ILenum il_fmt;
-	unsigned i;
+	void *dxt_data;
+	unsigned bpp, i;
 	int err;
 
-	grate_info("loading \"%s\" pixbuf format 0x%08x layout %u\n",
-		   path, format, layout);
+	memset(out, 0, sizeof(*out));
 
 	if (format == PIX_BUF_FMT_ETC1)
 		il_fmt = IL_RGB;
 	else
 		il_fmt = IL_RGBA;
 
+	pthread_mutex_lock(&il_lock);
+
 	ilInit();
 	ilGenImages(1, &ImageTex);
 	ilBindImage(ImageTex);
 	ilLoadImage(path);
 	ilConvertImage(il_fmt, IL_UNSIGNED_BYTE);
 
-	err = ilGetError();
-	if (err != IL_NO_ERROR) {
-		grate_error("\"%s\" load failed 0x%04X\n", path, err);
-		goto out;
-	}
-
-	if (create) {
-		*tex = grate_create_texture(grate,
-					    ilGetInteger(IL_IMAGE_WIDTH),
-					    ilGetInteger(IL_IMAGE_HEIGHT),
-					    format, layout);
-		if (!(*tex)) {
-			err = -12;
-			goto out;
-		}
-	} else {
-		iluScale((*tex)->pixbuf->width, (*tex)->pixbuf->height, 0);
-	}
+	if (width && height)
+		iluScale(width, height, 0);
 
 	/*
 	 * ilOriginFunc() doesn't work properly in conjunction with
@@ -147,99 +188,148 @@ static int grate_texture_load_internal(struct grate *grate,
 	err = ilGetError();
 	if (err != IL_NO_ERROR) {
 		grate_error("\"%s\" load failed 0x%04X\n", path, err);
+		err = -EIO;
 		goto out;
 	}
 
-	tex_data  = ilGetData();
-	tex_size  = ilGetInteger(IL_IMAGE_SIZE_OF_DATA);
-	tex_bpp   = ilGetInteger(IL_IMAGE_BYTES_PER_PIXEL);
-	tex_pitch = ilGetInteger(IL_IMAGE_WIDTH) * tex_bpp;
-
-	if (PIX_BUF_FORMAT_COMPRESSED(format)) {
-		etc1_byte *etc1_data;
-		ILenum DXTCFormat;
-		ILuint dxtSize;
-
-		switch (format) {
-		case PIX_BUF_FMT_DXT1:
-			grate_info("compressing data to DXT1\n");
-			DXTCFormat = IL_DXT1;
-			break;
-		case PIX_BUF_FMT_DXT3:
-			grate_info("compressing data to DXT3\n");
-			DXTCFormat = IL_DXT3;
-			break;
-		case PIX_BUF_FMT_DXT5:
-			grate_info("compressing data to DXT5\n");
-			DXTCFormat = IL_DXT5;
-			break;
-		case PIX_BUF_FMT_ETC1:
-			grate_info("compressing data to ETC1\n");
-			dxtSize = etc1_get_encoded_data_size(
-						ilGetInteger(IL_IMAGE_WIDTH),
-						ilGetInteger(IL_IMAGE_HEIGHT));
-
-			etc1_data = malloc(dxtSize);
-			if (!etc1_data) {
-				err = -1;
-				goto out;
-			}
-
-			err = etc1_encode_image(tex_data,
-						ilGetInteger(IL_IMAGE_WIDTH),
-						ilGetInteger(IL_IMAGE_HEIGHT),
-						tex_bpp, tex_pitch, etc1_data);
-			if (err)
-				goto err_compression;
-
-			/* Tegra's GR3D uses a different layout for ETC1 data */
-			for (i = 0; i < dxtSize / 8; i++) {
-				uint64_t *etc1_word64 = (uint64_t*) etc1_data;
-				uint64_t a = bswap_32(etc1_word64[i] >> 32);
-				uint64_t b = bswap_32(etc1_word64[i]);
-
-				etc1_word64[i] = (b << 32) | a;
-			}
-
-			tex_data = etc1_data;
-
-			goto done_compression;
-		default:
-			grate_error("\"%s\" unsupported compression format %u\n",
-				    path, format);
-			err = -1;
+	pixels     = ilGetData();
+	bpp        = ilGetInteger(IL_IMAGE_BYTES_PER_PIXEL);
+	out->width  = ilGetInteger(IL_IMAGE_WIDTH);
+	out->height = ilGetInteger(IL_IMAGE_HEIGHT);
+	out->pitch  = out->width * bpp;
+	out->size   = ilGetInteger(IL_IMAGE_SIZE_OF_DATA);
+
+	switch (format) {
+	case PIX_BUF_FMT_DXT1:
+		DXTCFormat = IL_DXT1;
+		break;
+	case PIX_BUF_FMT_DXT3:
+		DXTCFormat = IL_DXT3;
+		break;
+	case PIX_BUF_FMT_DXT5:
+		DXTCFormat = IL_DXT5;
+		break;
+	default:
+		/* ETC1 is compressed after DevIL was released */
+		out->data = malloc(out->size);
+		if (!out->data) {
+			err = -ENOMEM;
 			goto out;
 		}
 
-		ilEnable(IL_SQUISH_COMPRESS);
-
-		tex_data = ilCompressDXT(tex_data,
-					 ilGetInteger(IL_IMAGE_WIDTH),
-					 ilGetInteger(IL_IMAGE_HEIGHT), 1,
-					 DXTCFormat, &dxtSize);
-		err = ilGetError();
-err_compression:
-		if (err != IL_NO_ERROR) {
-			grate_error("\"%s\" compression failed 0x%04X\n",
-				    path, err);
-			goto out;
+		memcpy(out->data, pixels, out->size);
+		goto out;
+	}
+
+	grate_info("compressing \"%s\" to DXT%u\n", path,
+		   format == PIX_BUF_FMT_DXT1 ? 1 :
+		   format == PIX_BUF_FMT_DXT3 ? 3 : 5);
+
+	ilEnable(IL_SQUISH_COMPRESS);
+
+	dxt_data = ilCompressDXT(pixels, out->width, out->height, 1,
+				 DXTCFormat, &dxtSize);
+	err = ilGetError();
+	if (err != IL_NO_ERROR || !dxt_data) {
+		grate_error("\"%s\" compression failed 0x%04X\n", path, err);
+		err = -EIO;
+		goto out;
+	}
+
+	out->data = malloc(dxtSize);
+	if (out->data)
+		memcpy(out->data, dxt_data, dxtSize);
+	else
+		err = -ENOMEM;
+
+	ifree(dxt_data);
+
+	out->pitch = ALIGN(out->width, 4) / 4 * PIX_BUF_FORMAT_BYTES(format);
+	out->size  = dxtSize;
+out:
+	ilDeleteImage(ImageTex);
+
+	pthread_mutex_unlock(&il_lock);
+
+	if (err || format != PIX_BUF_FMT_ETC1)
+		return err;
+
+	grate_info("compressing \"%s\" to ETC1\n", path);
+
+	pixels = out->data;
+
+	out->size = etc1_get_encoded_data_size(out->width, out->height);
+	out->data = malloc(out->size);
+	if (!out->data) {
+		free(pixels);
+		return -ENOMEM;
+	}
+
+	err = etc1_encode_image_mt(pixels, out->width, out->height, 3,
+				   out->pitch, out->data,
+				   grate_etc1_quality(), 0);
+	free(pixels);
+
+	if (err) {
+		grate_error("\"%s\" compression failed\n", path);
+		grate_texture_data_free(out);
+		return -EINVAL;
+	}
+
+	/* Tegra's GR3D uses a different layout for ETC1 data */
+	for (i = 0; i < out->size / 8; i++) {
+		uint64_t *etc1_word64 = (uint64_t*) out->data;
+		uint64_t a = bswap_32(etc1_word64[i] >> 32);
+		uint64_t b = bswap_32(etc1_word64[i]);
+
+		etc1_word64[i] = (b << 32) | a;
+	}
+
+	out->pitch = ALIGN(out->width, 4) / 4 * PIX_BUF_FORMAT_BYTES(format);
+
+	return 0;
+}
+
+static int grate_texture_load_internal(struct grate *grate,
+				       struct grate_texture **tex,
+				       const char *path, bool create,
+				       enum pixel_format format,
+				       enum layout_format layout)
+{
+	struct grate_texture_data data;
+	unsigned width = 0, height = 0;
+	int err;
+
+	grate_info("loading \"%s\" pixbuf format 0x%08x layout %u\n",
+		   path, format, layout);
+
+	if (!create) {
+		width  = (*tex)->pixbuf->width;
+		height = (*tex)->pixbuf->height;
+	}
+
+	err = grate_texture_decode(path, format, width, height, &data);
+	if (err)
+		goto out;
+
+	if (create) {
+		*tex = grate_create_texture(grate, data.width, data.height,
+					    format, layout);
+		if (!(*tex)) {
+			err = -ENOMEM;
+			goto out_free;
 		}
-done_compression:
-		grate_info("compressed \"%s\" size tex_size %u -> %u\n",
-			   path, tex_size, dxtSize);
-
-		tw        = PIX_BUF_FORMAT_TEXEL_WIDTH(format);
-		bpp       = PIX_BUF_FORMAT_BYTES(format);
-		tex_pitch = ALIGN(ilGetInteger(IL_IMAGE_WIDTH), tw) / tw * bpp;
-		tex_size  = dxtSize;
 	}
 
+	/* deferred draws may still sample the texture */
+	grate_finish(grate);
+
 	err = host1x_pixelbuffer_load_data(grate->host1x, (*tex)->pixbuf,
-					   tex_data, tex_pitch, tex_size,
+					   data.data, data.pitch, data.size,
 					   format, PIX_BUF_LAYOUT_LINEAR);
+out_free:
+	grate_texture_data_free(&data);
 out:
-	ilDeleteImage(ImageTex);
-
 	if (err)
 		grate_error("failed to load \"%s\"\n", path);
 	else
@@ -279,7 +369,15 @@ struct host1x_pixelbuffer *grate_texture_pixbuf(struct grate_texture *tex)
 
 void grate_texture_free(struct grate_texture *tex)
 {
-	host1x_pixelbuffer_free(tex->pixbuf);
+	if (tex->upload)
+		grate_texture_stream_cancel(tex->upload);
+
+	if (tex->mipmap_pixbuf)
+		host1x_pixelbuffer_free(tex->mipmap_pixbuf);
+
+	/* the placeholder is shared by all streamed textures */
+	if (!tex->placeholder)
+		host1x_pixelbuffer_free(tex->pixbuf);
 	free(tex);
 }
 
@@ -384,6 +482,8 @@ void grate_texture_clear(struct grate *grate, struct grate_texture *tex,
 	struct host1x_gr2d *gr2d = host1x_get_gr2d(grate->host1x);
 	int err;
 
+	grate_finish(grate);
+
 	err = host1x_gr2d_clear(gr2d, tex->pixbuf, color);
 	if (err < 0)
 		grate_error("host1x_gr2d_clear() failed: %d\n", err);
@@ -396,19 +496,36 @@ void grate_texture_clear_rect(struct grate *grate, struct grate_texture *tex,
 	struct host1x_gr2d *gr2d = host1x_get_gr2d(grate->host1x);
 	int err;
 
+	grate_finish(grate);
+
 	err = host1x_gr2d_clear_rect(gr2d, tex->pixbuf, color,
 				     x, y, width, height);
 	if (err < 0)
 		grate_error("host1x_gr2d_clear() failed: %d\n", err);
 }
 
+/* compressed formats are stored as rows of 4x4 blocks */
+static unsigned lod_pitch(enum pixel_format format, unsigned width)
+{
+	unsigned tw = PIX_BUF_FORMAT_TEXEL_WIDTH(format);
+
+	return ALIGN(ALIGN(width, tw) / tw * PIX_BUF_FORMAT_BYTES(format), 16);
+}
+
+static unsigned lod_rows(enum pixel_format format, unsigned height)
+{
+	unsigned th = PIX_BUF_FORMAT_TEXEL_HEIGHT(format);
+
+	return ALIGN(height, th) / th;
+}
+
 static int alloc_mipmap(struct grate *grate, struct grate_texture *tex)
 {
 	struct host1x_pixelbuffer *pixbuf = tex->pixbuf;
 	struct host1x_bo *bo;
 	unsigned log2_width, log2_height;
 	unsigned lod, lod_levels, size;
-	unsigned w, h, bpp;
+	unsigned w, h, bpp, tw;
 
 	if (!tex->pixbuf)
 		return -1;
@@ -425,6 +542,7 @@ static int alloc_mipmap(struct grate *grate, struct grate_texture *tex)
 		   pixbuf->width, pixbuf->height, lod_levels);
 
 	bpp = PIX_BUF_FORMAT_BYTES(pixbuf->format);
+	tw  = PIX_BUF_FORMAT_TEXEL_WIDTH(pixbuf->format);
 
 	for (size = 0, lod = 0; lod <= lod_levels; lod++) {
 		w = MAX(1 << log2_width >> lod, 1);
@@ -433,7 +551,8 @@ static int alloc_mipmap(struct grate *grate, struct grate_texture *tex)
 		grate_info("LOD %u w: %u h: %u\toffset 0x%08X\n",
 			   lod, w, h, size);
 
-		size += ALIGN(w * bpp, 16) * h;
+		size += lod_pitch(pixbuf->format, w) *
+			lod_rows(pixbuf->format, h);
 	}
 
 	if (!host1x_pixelbuffer_bo_guard_disabled())
@@ -453,7 +572,8 @@ static int alloc_mipmap(struct grate *grate, struct grate_texture *tex)
 	tex->mipmap_pixbuf->bo     = bo;
 	tex->mipmap_pixbuf->width  = 1 << log2_width;
 	tex->mipmap_pixbuf->height = 1 << log2_height;
-	tex->mipmap_pixbuf->pitch  = tex->mipmap_pixbuf->width * bpp;
+	tex->mipmap_pixbuf->pitch  = ALIGN(tex->mipmap_pixbuf->width, tw) /
+				     tw * bpp;
 	tex->mipmap_pixbuf->format = pixbuf->format;
 	tex->mipmap_pixbuf->layout = pixbuf->layout;
 
@@ -470,17 +590,16 @@ static void setup_lod_pixbuf(struct host1x_pixelbuffer *mipmap,
 {
 	unsigned long offset = 0;
 	unsigned long size = 0;
-	unsigned w, h, bpp;
+	unsigned w, h;
 	unsigned i;
 
 	memset(dst, 0, sizeof(*dst));
 
-	bpp = PIX_BUF_FORMAT_BYTES(mipmap->format);
-
 	for (i = 0; i <= level; i++) {
 		w = MAX(mipmap->width >> i, 1);
 		h = MAX(mipmap->height >> i, 1);
-		size = ALIGN(w * bpp, 16) * h;
+		size = lod_pitch(mipmap->format, w) *
+		       lod_rows(mipmap->format, h);
 		offset += size;
 	}
 
@@ -489,7 +608,7 @@ static void setup_lod_pixbuf(struct host1x_pixelbuffer *mipmap,
 	dst->layout = mipmap->layout;
 	dst->width  = MAX(mipmap->width >> level, 1);
 	dst->height = MAX(mipmap->height >> level, 1);
-	dst->pitch  = ALIGN(dst->width * bpp, 16);
+	dst->pitch  = lod_pitch(dst->format, dst->width);
 
 	assert(dst->bo != NULL);
 }
@@ -507,6 +626,8 @@ int grate_texture_generate_mipmap(struct grate *grate,
 	if (err)
 		return err;
 
+	grate_finish(grate);
+
 	/* Setup base level. */
 	setup_lod_pixbuf(tex->mipmap_pixbuf, &dst_pixbuf, 0);
 
@@ -563,6 +684,9 @@ int grate_texture_load_miplevel(struct grate *grate,
 
 	setup_lod_pixbuf(tex->mipmap_pixbuf, &dst_pixbuf,
 			 MIN(level, tex->max_lod));
+
+	pthread_mutex_lock(&il_lock);
+
 	ilInit();
 	ilGenImages(1, &ImageTex);
 	ilBindImage(ImageTex);
@@ -586,6 +710,8 @@ int grate_texture_load_miplevel(struct grate *grate,
 		   dst_pixbuf.width, dst_pixbuf.height, level,
 		   dst_pixbuf.bo->offset);
 
+	grate_finish(grate);
+
 	err = host1x_pixelbuffer_load_data(grate->host1x, &dst_pixbuf,
 					   ilGetData(),
 					   ilGetInteger(IL_IMAGE_WIDTH) * 4,
@@ -596,6 +722,8 @@ out:
 	host1x_bo_free(dst_pixbuf.bo);
 	ilDeleteImage(ImageTex);
 
+	pthread_mutex_unlock(&il_lock);
+
 	return err;
 }
 
@@ -610,6 +738,8 @@ int grate_texture_blit(struct grate *grate,
 	struct host1x_pixelbuffer *dst_pixbuf = dst_tex->pixbuf;
 	int err;
 
+	grate_finish(grate);
+
 	if (sw == dw && sh == dh)
 		err = host1x_gr2d_blit(gr2d, src_pixbuf, dst_pixbuf,
 				       sx, sy, dx, dy, dw, dh);
@@ -619,3 +749,162 @@ int grate_texture_blit(struct grate *grate,
 
 	return err;
 }
+
+static bool baked_texture_valid(const struct baked_texture_header *hdr,
+				size_t file_size)
+{
+	const struct baked_texture_level *level;
+	unsigned i;
+
+	if (file_size < sizeof(*hdr) ||
+	    memcmp(hdr->magic, BAKED_TEX_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->version != BAKED_TEX_VER || !hdr->num_levels ||
+	    hdr->num_levels > 32 ||
+	    file_size < sizeof(*hdr) + hdr->num_levels * sizeof(*level))
+		return false;
+
+	for (i = 0; i < hdr->num_levels; i++) {
+		level = &hdr->levels[i];
+
+		if ((uint64_t)level->pitch * level->rows != level->size ||
+		    level->offset > file_size ||
+		    level->size > file_size - level->offset)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Levels are normally stored at the pitch of the pixelbuffer and go in
+ * with a single copy. Only level 0 of a mipmapped texture has to be copied
+ * row by row into the mipmap, which uses a tighter pitch.
+ */
+static int load_baked_level(struct host1x_pixelbuffer *pixbuf,
+			    const void *file,
+			    const struct baked_texture_level *level)
+{
+	const uint8_t *src = (const uint8_t *)file + level->offset;
+	unsigned rows = lod_rows(pixbuf->format, pixbuf->height);
+	unsigned y;
+	uint8_t *dst;
+	void *map;
+	int err;
+
+	if (pixbuf->layout == PIX_BUF_LAYOUT_TILED_16x16)
+		rows = ALIGN(rows, 16);
+
+	if (level->width != pixbuf->width ||
+	    level->height != pixbuf->height || level->rows != rows ||
+	    (level->pitch != pixbuf->pitch &&
+	     pixbuf->layout != PIX_BUF_LAYOUT_LINEAR)) {
+		grate_error("level %ux%u pitch %u doesn't fit pixbuf %ux%u pitch %u\n",
+			    level->width, level->height, level->pitch,
+			    pixbuf->width, pixbuf->height, pixbuf->pitch);
+		return -EINVAL;
+	}
+
+	err = HOST1X_BO_MMAP(pixbuf->bo, &map);
+	if (err)
+		return err;
+
+	dst = (uint8_t *)map + pixbuf->bo->offset;
+
+	if (level->pitch == pixbuf->pitch)
+		memcpy(dst, src, level->size);
+	else
+		for (y = 0; y < rows; y++)
+			memcpy(dst + y * pixbuf->pitch, src + y * level->pitch,
+			       MIN(pixbuf->pitch, level->pitch));
+
+	return HOST1X_BO_FLUSH(pixbuf->bo, pixbuf->bo->offset,
+			       rows * pixbuf->pitch);
+}
+
+struct grate_texture *grate_create_baked_texture(struct grate *grate,
+						 const char *path)
+{
+	const struct baked_texture_header *hdr;
+	struct host1x_pixelbuffer lod_pixbuf;
+	struct grate_texture *tex = NULL;
+	struct stat st;
+	unsigned i;
+	void *file;
+	int fd, err = -EINVAL;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		grate_error("failed to open \"%s\": %s\n", path,
+			    strerror(errno));
+		return NULL;
+	}
+
+	if (fstat(fd, &st) < 0) {
+		grate_error("failed to stat \"%s\": %s\n", path,
+			    strerror(errno));
+		close(fd);
+		return NULL;
+	}
+
+	file = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE,
+		    fd, 0);
+	close(fd);
+
+	if (file == MAP_FAILED) {
+		grate_error("failed to map \"%s\": %s\n", path,
+			    strerror(errno));
+		return NULL;
+	}
+
+	hdr = file;
+
+	if (!baked_texture_valid(hdr, st.st_size)) {
+		grate_error("\"%s\" isn't a valid baked texture\n", path);
+		goto out;
+	}
+
+	grate_info("loading baked \"%s\" %ux%u format 0x%08x layout %u levels %u\n",
+		   path, hdr->width, hdr->height, hdr->format, hdr->layout,
+		   hdr->num_levels);
+
+	tex = grate_create_texture(grate, hdr->width, hdr->height,
+				   hdr->format, hdr->layout);
+	if (!tex)
+		goto out;
+
+	err = load_baked_level(tex->pixbuf, file, &hdr->levels[0]);
+	if (err || hdr->num_levels == 1)
+		goto out;
+
+	err = alloc_mipmap(grate, tex);
+	if (err)
+		goto out;
+
+	if (hdr->num_levels > tex->max_lod + 1) {
+		grate_error("\"%s\" has %u levels, texture takes %u\n", path,
+			    hdr->num_levels, tex->max_lod + 1);
+		err = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < hdr->num_levels && !err; i++) {
+		setup_lod_pixbuf(tex->mipmap_pixbuf, &lod_pixbuf, i);
+		err = load_baked_level(&lod_pixbuf, file, &hdr->levels[i]);
+		host1x_bo_free(lod_pixbuf.bo);
+	}
+
+	tex->max_lod = hdr->num_levels - 1;
+out:
+	munmap(file, st.st_size);
+
+	if (err) {
+		grate_error("failed to load \"%s\"\n", path);
+
+		if (tex)
+			grate_texture_free(tex);
+
+		return NULL;
+	}
+
+	return tex;
+}
@@ -171,6 +171,7 @@ bool grate_parse_command_line(struct grate_options *options, int argc,
 
 struct grate *grate_init_with_fd(struct grate_options *options, int fd)
 {
+	struct host1x_gr3d *gr3d;
 	struct grate *grate;
 
 	grate = calloc(1, sizeof(*grate));
@@ -188,6 +189,17 @@ struct grate *grate_init_with_fd(struct grate_options *options, int fd)
 		return NULL;
 	}
 
+	gr3d = host1x_get_gr3d(grate->host1x);
+
+	grate->commands = host1x_cmdring_create(grate->host1x, gr3d->client,
+						GRATE_3D_NUM_SEGMENTS,
+						GRATE_3D_SEGMENT_SIZE);
+	if (!grate->commands) {
+		host1x_close(grate->host1x);
+		free(grate);
+		return NULL;
+	}
+
 	grate->options = options;
 
 	if (grate->options->nodisplay)
@@ -219,8 +231,12 @@ void grate_exit(struct grate *grate)
 {
 	struct termios term;
 
-	if (grate)
+	if (grate) {
+		grate_finish(grate);
+		grate_texture_stream_destroy(grate->stream);
+		host1x_cmdring_free(grate->commands);
 		host1x_close(grate->host1x);
+	}
 
 	if (termio_adjusted && saved_c_lflag) {
 		/* Restore terminal input */
@@ -263,8 +279,49 @@ struct host1x_pixelbuffer * grate_get_draw_pixbuf(struct grate_framebuffer *fb)
 	return fb->back ? fb->back->pixbuf : fb->front->pixbuf;
 }
 
+bool grate_fence_signaled(const struct grate_fence *fence)
+{
+	struct host1x_fence f = { fence->client, fence->value };
+
+	return host1x_fence_poll(&f) > 0;
+}
+
+int grate_fence_wait(const struct grate_fence *fence, uint32_t timeout)
+{
+	struct host1x_fence f = { fence->client, fence->value };
+	int err;
+
+	err = host1x_fence_wait(&f, timeout);
+	if (err < 0 && err != -EAGAIN)
+		grate_error("host1x_fence_wait() failed: %d\n", err);
+
+	return err;
+}
+
+/*
+ * Submits all deferred work without waiting for it, @fence is signaled once
+ * the GPU finished it.
+ */
+int grate_flush_fence(struct grate *grate, struct grate_fence *fence)
+{
+	int err;
+
+	err = grate_3d_flush(grate);
+
+	if (fence)
+		*fence = grate->fence;
+
+	return err;
+}
+
 void grate_flush(struct grate *grate)
 {
+	grate_flush_fence(grate, NULL);
+}
+
+void grate_finish(struct grate *grate)
+{
+	grate_3d_finish(grate);
 }
 
 struct grate_framebuffer *grate_framebuffer_create(struct grate *grate,
@@ -327,6 +384,8 @@ void grate_framebuffer_save(struct grate *grate,
 {
 	char dir[1024];
 
+	grate_finish(grate);
+
 	grate_info("Saving to \"%s/%s\"\n", getcwd(dir, sizeof(dir)), path);
 
 	host1x_framebuffer_save(grate->host1x, fb->front, path);
@@ -334,6 +393,9 @@ void grate_framebuffer_save(struct grate *grate,
 
 void grate_swap_buffers(struct grate *grate)
 {
+	grate_texture_stream_poll(grate);
+	grate_finish(grate);
+
 	grate_framebuffer_swap(grate->fb);
 
 	if (grate->display || grate->overlay) {
@@ -419,6 +481,10 @@ uint8_t grate_key_pressed2(struct grate *grate)
 	return grate_key_pressed__(grate, true);
 }
 
+/*
+ * Draws are deferred and grate_flush() doesn't wait for them, call
+ * grate_finish() before reading back rendered pixels.
+ */
 void *grate_framebuffer_data(struct grate_framebuffer *fb, bool front)
 {
 	struct host1x_framebuffer *host1x_fb = front ? fb->front : fb->back;
@@ -91,7 +91,20 @@ void grate_bind_framebuffer(struct grate *grate, struct grate_framebuffer *fb);
 
 struct host1x_pixelbuffer * grate_get_draw_pixbuf(struct grate_framebuffer *fb);
 
+/*
+ * Fence of submitted GPU work, a fence without a client is always signaled.
+ */
+struct grate_fence {
+	struct host1x_client *client;
+	uint32_t value;
+};
+
+bool grate_fence_signaled(const struct grate_fence *fence);
+int grate_fence_wait(const struct grate_fence *fence, uint32_t timeout);
+
+int grate_flush_fence(struct grate *grate, struct grate_fence *fence);
 void grate_flush(struct grate *grate);
+void grate_finish(struct grate *grate);
 void grate_swap_buffers(struct grate *grate);
 void grate_wait_for_key(struct grate *grate);
 bool grate_key_pressed(struct grate *grate);
@@ -148,6 +161,7 @@ void grate_profile_finish(struct grate_profile *profile);
 float grate_profile_time_elapsed(struct grate_profile *profile);
 
 struct grate_3d_ctx;
+struct grate_3d_state;
 struct grate_texture;
 
 void grate_3d_draw_elements(struct grate_3d_ctx *ctx,
@@ -156,6 +170,9 @@ void grate_3d_draw_elements(struct grate_3d_ctx *ctx,
 			    unsigned index_mode,
 			    unsigned vtx_count);
 
+struct grate_3d_state *grate_3d_create_state(struct grate_3d_ctx *ctx);
+void grate_3d_free_state(struct grate_3d_state *state);
+
 enum grate_textute_wrap_mode {
 	GRATE_TEXTURE_CLAMP_TO_EDGE,
 	GRATE_TEXTURE_MIRRORED_REPEAT,
@@ -181,6 +198,14 @@ struct grate_texture *grate_create_texture2(struct grate *grate,
 					    enum layout_format layout);
 int grate_texture_load(struct grate *grate, struct grate_texture *tex,
 		       const char *path);
+struct grate_texture *grate_create_baked_texture(struct grate *grate,
+						 const char *path);
+struct grate_texture *grate_create_texture_async(struct grate *grate,
+						 const char *path,
+						 enum pixel_format format,
+						 enum layout_format layout);
+bool grate_texture_ready(struct grate_texture *tex);
+int grate_texture_stream_poll(struct grate *grate);
 struct host1x_pixelbuffer *grate_texture_pixbuf(struct grate_texture *tex);
 void grate_texture_free(struct grate_texture *tex);
 void grate_texture_set_max_lod(struct grate_texture *tex, unsigned max_lod);
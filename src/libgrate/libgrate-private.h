@@ -22,6 +22,39 @@ struct grate_framebuffer {
 	struct host1x_framebuffer *back;
 };
 
+#define GRATE_3D_NUM_BATCHES	2
+#define GRATE_3D_BATCH_GUARDS	16
+
+#define GRATE_3D_NUM_SEGMENTS	4
+#define GRATE_3D_SEGMENT_SIZE	(32 * 4096)
+
+/*
+ * Command stream of deferred 3D draws. Every batch is a pushbuf taken from
+ * the command ring of grate, draws are appended to the batch that is
+ * recorded and the batch is submitted on flush or once it filled half a ring
+ * segment. A submitted batch is busy until its fence is reached, so the next
+ * batch is recorded while the GPU is working on the previous one.
+ */
+struct grate_3d_batch {
+	struct host1x_job *job;
+	struct host1x_pushbuf *pb;
+	struct grate_fence fence;
+	bool busy;
+
+	/* words recorded into the pushbufs preceding @pb */
+	unsigned int words;
+
+	/* context whose state was emitted into the batch last */
+	struct grate_3d_ctx *ctx;
+
+	/* render targets whose BO guards are checked once the batch retired */
+	struct host1x_pixelbuffer *guards[GRATE_3D_BATCH_GUARDS];
+	unsigned int num_guards;
+};
+
+struct grate_texture_stream;
+struct grate_texture_upload;
+
 struct grate {
 	struct grate_options *options;
 	struct grate_display *display;
@@ -30,8 +63,43 @@ struct grate {
 	struct grate_color clear;
 	struct host1x_options host1x_options;
 	struct host1x *host1x;
+
+	struct host1x_cmdring *commands;
+	struct grate_3d_batch batches[GRATE_3D_NUM_BATCHES];
+	unsigned int batch;
+	struct grate_fence fence;
+
+	struct grate_texture_stream *stream;
+};
+
+/*
+ * Decoded texture data, packed rows of pixels or 4x4 blocks as they are
+ * loaded into a linear pixelbuffer.
+ */
+struct grate_texture_data {
+	void *data;
+	unsigned int width;
+	unsigned int height;
+	unsigned int pitch;
+	unsigned long size;
 };
 
+int grate_texture_decode(const char *path, enum pixel_format format,
+			 unsigned width, unsigned height,
+			 struct grate_texture_data *out);
+void grate_texture_data_free(struct grate_texture_data *data);
+struct host1x_pixelbuffer *grate_texture_create_pixbuf(struct grate *grate,
+							unsigned width,
+							unsigned height,
+							enum pixel_format format,
+							enum layout_format layout);
+
+void grate_texture_stream_cancel(struct grate_texture_upload *upload);
+void grate_texture_stream_destroy(struct grate_texture_stream *stream);
+
+int grate_3d_flush(struct grate *grate);
+void grate_3d_finish(struct grate *grate);
+
 struct grate_display *grate_display_open(struct grate *grate);
 void grate_display_close(struct grate_display *display);
 void grate_display_get_resolution(struct grate_display *display,
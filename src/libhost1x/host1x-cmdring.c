@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host1x.h"
+#include "host1x-private.h"
+
+/*
+ * Pushbufs are packed back to back into the current segment. A new pushbuf
+ * starts at the beginning of the next segment once less than this fraction
+ * of a segment is left.
+ */
+#define HOST1X_CMDRING_MIN_SPACE(ring)	((ring)->segment_size / 4)
+
+static struct host1x_bo *host1x_cmdring_bo_create(struct host1x_cmdring *ring,
+						  size_t size)
+{
+	struct host1x_bo *bo;
+	int err;
+
+	bo = HOST1X_BO_CREATE(ring->host1x, size,
+			      NVHOST_BO_FLAG_COMMAND_BUFFER);
+	if (!bo)
+		return NULL;
+
+	err = HOST1X_BO_MMAP(bo, NULL);
+	if (err < 0) {
+		host1x_bo_free(bo);
+		return NULL;
+	}
+
+	return bo;
+}
+
+struct host1x_cmdring *host1x_cmdring_create(struct host1x *host1x,
+					     struct host1x_client *client,
+					     unsigned int num_segments,
+					     size_t segment_size)
+{
+	struct host1x_cmdring *ring;
+	unsigned int i;
+
+	if (num_segments < 2) {
+		host1x_error("command ring needs at least two segments\n");
+		return NULL;
+	}
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+
+	ring->segments = calloc(num_segments, sizeof(*ring->segments));
+	if (!ring->segments) {
+		free(ring);
+		return NULL;
+	}
+
+	ring->host1x = host1x;
+	ring->client = client;
+	ring->num_segments = num_segments;
+	ring->segment_size = segment_size;
+
+	for (i = 0; i < num_segments; i++) {
+		ring->segments[i].bo = host1x_cmdring_bo_create(ring,
+								segment_size);
+		if (!ring->segments[i].bo) {
+			host1x_cmdring_free(ring);
+			return NULL;
+		}
+	}
+
+	return ring;
+}
+
+void host1x_cmdring_free(struct host1x_cmdring *ring)
+{
+	unsigned int i;
+
+	if (!ring)
+		return;
+
+	for (i = 0; i < ring->num_segments; i++) {
+		struct host1x_cmdring_segment *seg = &ring->segments[i];
+
+		if (!seg->bo)
+			continue;
+
+		/* the engine may still fetch from the segment */
+		host1x_cmdring_wait(ring, seg);
+		host1x_bo_free(seg->bo);
+	}
+
+	free(ring->segments);
+	free(ring);
+}
+
+int host1x_cmdring_wait(struct host1x_cmdring *ring,
+			struct host1x_cmdring_segment *seg)
+{
+	uint32_t fence;
+	int err;
+
+	if (seg->pending) {
+		err = host1x_cmdring_flush(ring, &fence);
+		if (err < 0)
+			return err;
+	}
+
+	if (!seg->busy)
+		return 0;
+
+	err = HOST1X_CLIENT_WAIT(ring->client, seg->fence, ~0u);
+	if (err < 0)
+		return err;
+
+	seg->busy = false;
+
+	return 0;
+}
+
+/* checks whether @job has pushbufs in @seg that weren't submitted yet */
+static bool host1x_cmdring_holds(struct host1x_cmdring *ring,
+				 struct host1x_cmdring_segment *seg,
+				 struct host1x_job *job)
+{
+	unsigned int i;
+
+	if (!job)
+		return false;
+
+	for (i = 0; i < job->num_pushbufs; i++) {
+		struct host1x_pushbuf *pb = &job->pushbufs[i];
+
+		if (pb->ring == ring && pb->bo == seg->bo)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Puts a fresh segment of at least @size bytes after the current one. Used
+ * when the job that is being built already wrapped around the ring, in which
+ * case reusing the next segment would overwrite its own commands.
+ */
+static int host1x_cmdring_insert(struct host1x_cmdring *ring, size_t size)
+{
+	unsigned int index = ring->current + 1;
+	struct host1x_cmdring_segment *segments;
+	struct host1x_bo *bo;
+
+	bo = host1x_cmdring_bo_create(ring, MAX(size, ring->segment_size));
+	if (!bo)
+		return -ENOMEM;
+
+	segments = realloc(ring->segments,
+			   (ring->num_segments + 1) * sizeof(*segments));
+	if (!segments) {
+		host1x_bo_free(bo);
+		return -ENOMEM;
+	}
+
+	memmove(&segments[index + 1], &segments[index],
+		(ring->num_segments - index) * sizeof(*segments));
+	memset(&segments[index], 0, sizeof(*segments));
+	segments[index].bo = bo;
+
+	ring->segments = segments;
+	ring->num_segments++;
+	ring->current = index;
+
+	return 0;
+}
+
+/*
+ * Move on to the next segment of the ring, waiting for the engine to be done
+ * with it and enlarging it if it can't hold @size bytes. @job is the job the
+ * segment is needed for; segments that hold commands of it or of the open
+ * job are never reused before these are submitted.
+ */
+static int host1x_cmdring_advance(struct host1x_cmdring *ring,
+				  struct host1x_job *job, size_t size)
+{
+	unsigned int index = (ring->current + 1) % ring->num_segments;
+	struct host1x_cmdring_segment *seg = &ring->segments[index];
+	struct host1x_bo *bo;
+	size_t new_size;
+	int err;
+
+	if (host1x_cmdring_holds(ring, seg, ring->job) ||
+	    host1x_cmdring_holds(ring, seg, job))
+		return host1x_cmdring_insert(ring, size);
+
+	err = host1x_cmdring_wait(ring, seg);
+	if (err < 0)
+		return err;
+
+	if (seg->bo->size < size) {
+		new_size = seg->bo->size;
+
+		while (new_size < size)
+			new_size *= 2;
+
+		bo = host1x_cmdring_bo_create(ring, new_size);
+		if (!bo)
+			return -ENOMEM;
+
+		host1x_bo_free(seg->bo);
+		seg->bo = bo;
+	}
+
+	seg->used = 0;
+	ring->current = index;
+
+	return 0;
+}
+
+static struct host1x_cmdring_segment *
+host1x_cmdring_find(struct host1x_cmdring *ring, struct host1x_bo *bo)
+{
+	unsigned int i;
+
+	for (i = 0; i < ring->num_segments; i++) {
+		if (ring->segments[i].bo == bo)
+			return &ring->segments[i];
+	}
+
+	return NULL;
+}
+
+void host1x_cmdring_close(struct host1x_cmdring *ring, struct host1x_job *job)
+{
+	struct host1x_cmdring_segment *seg;
+	struct host1x_pushbuf *pb;
+
+	if (!ring->job || ring->job != job)
+		return;
+
+	pb = &job->pushbufs[ring->index];
+	seg = host1x_cmdring_find(ring, pb->bo);
+	seg->used = pb->offset + pb->length * sizeof(uint32_t);
+	ring->job = NULL;
+}
+
+/*
+ * Appends a pushbuf taken from the ring to the job. On failure the ring is
+ * left untouched and the previously appended pushbuf stays open.
+ */
+struct host1x_pushbuf *host1x_cmdring_append(struct host1x_cmdring *ring,
+					     struct host1x_job *job)
+{
+	struct host1x_cmdring_segment *seg = &ring->segments[ring->current];
+	unsigned long used = seg->used;
+	struct host1x_pushbuf *pb;
+	int err;
+
+	if (ring->job) {
+		pb = &ring->job->pushbufs[ring->index];
+		used = pb->offset + pb->length * sizeof(uint32_t);
+	}
+
+	if (host1x_job_reserve_pushbufs(job, 1) < 0)
+		return NULL;
+
+	if (seg->bo->size - used < HOST1X_CMDRING_MIN_SPACE(ring)) {
+		err = host1x_cmdring_advance(ring, job, ring->segment_size);
+		if (err < 0) {
+			host1x_error("failed to advance command ring: %d\n",
+				     err);
+			return NULL;
+		}
+	}
+
+	host1x_cmdring_close(ring, ring->job);
+
+	seg = &ring->segments[ring->current];
+
+	pb = HOST1X_JOB_APPEND(job, seg->bo, seg->used);
+	if (!pb)
+		return NULL;
+
+	pb->ring = ring;
+
+	ring->job = job;
+	ring->index = job->num_pushbufs - 1;
+
+	return pb;
+}
+
+/*
+ * A pushbuf can't be split across segments because its users keep pointers
+ * to it, so on overflow the words emitted so far are moved to the start of
+ * the next segment and building continues there.
+ */
+int host1x_cmdring_grow(struct host1x_cmdring *ring, struct host1x_pushbuf *pb,
+			unsigned long words)
+{
+	size_t size = (pb->length + words) * sizeof(uint32_t);
+	void *src = pb->bo->ptr + pb->offset;
+	struct host1x_bo *bo;
+	unsigned long i;
+	int err;
+
+	if (!ring->job || &ring->job->pushbufs[ring->index] != pb) {
+		host1x_error("only the open pushbuf of a ring can grow\n");
+		return -EINVAL;
+	}
+
+	err = host1x_cmdring_advance(ring, ring->job, size);
+	if (err < 0) {
+		host1x_error("failed to grow pushbuf to %zu bytes: %d\n",
+			     size, err);
+		return err;
+	}
+
+	bo = ring->segments[ring->current].bo;
+	memcpy(bo->ptr, src, pb->length * sizeof(uint32_t));
+
+	for (i = 0; i < pb->num_relocs; i++)
+		pb->relocs[i].source_offset -= pb->offset;
+
+	pb->bo = bo;
+	pb->offset = 0;
+	pb->ptr = bo->ptr + pb->length * sizeof(uint32_t);
+	pb->end = bo->ptr + (bo->size & ~3ul);
+
+	return 0;
+}
+
+int host1x_cmdring_submit(struct host1x_cmdring *ring, struct host1x_job *job)
+{
+	unsigned int i;
+	int err;
+
+	err = HOST1X_CLIENT_SUBMIT(ring->client, job);
+	if (err < 0)
+		return err;
+
+	host1x_cmdring_close(ring, job);
+
+	for (i = 0; i < job->num_pushbufs; i++) {
+		struct host1x_pushbuf *pb = &job->pushbufs[i];
+
+		if (pb->ring == ring)
+			host1x_cmdring_find(ring, pb->bo)->pending = true;
+	}
+
+	return 0;
+}
+
+int host1x_cmdring_flush(struct host1x_cmdring *ring, uint32_t *fence)
+{
+	unsigned int i;
+	int err;
+
+	err = HOST1X_CLIENT_FLUSH(ring->client, fence);
+	if (err < 0)
+		return err;
+
+	for (i = 0; i < ring->num_segments; i++) {
+		struct host1x_cmdring_segment *seg = &ring->segments[i];
+
+		if (!seg->pending)
+			continue;
+
+		seg->fence = *fence;
+		seg->pending = false;
+		seg->busy = true;
+	}
+
+	return 0;
+}
@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * CPU decoders of the block-compressed texture formats to RGBA8888, used
+ * to read back and verify compressed pixelbuffers off-target.
+ *
+ * Every format boils down to a palette of four colors per pixel row and a
+ * 2bit index per pixel, optionally combined with a separately coded alpha
+ * channel. Palettes and indices are unpacked per block, expanding a row of
+ * pixels out of them is vectorized.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HOST1X_DECOMPRESS_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define HOST1X_DECOMPRESS_SSE2 1
+#endif
+
+#include "host1x-private.h"
+
+#define RGBA(r, g, b, a) \
+	((uint32_t)(r) | (uint32_t)(g) << 8 | (uint32_t)(b) << 16 | \
+	 (uint32_t)(a) << 24)
+
+/* colors of the four palette indices for each of the four pixels of a row */
+typedef uint32_t row_palette[4][4];
+
+static inline uint32_t read_le16(const uint8_t *p)
+{
+	return p[0] | p[1] << 8;
+}
+
+static inline uint32_t read_le32(const uint8_t *p)
+{
+	return read_le16(p) | read_le16(p + 2) << 16;
+}
+
+/*
+ * Expand one row of four pixels. @indices has the 2bit palette index of
+ * pixel x in bits [2x+1:2x], byte x of @alpha is OR'ed into the alpha
+ * channel of pixel x.
+ */
+static inline void store_row(uint8_t *dst, const row_palette pal,
+			     uint32_t indices, uint32_t alpha)
+{
+#if defined(HOST1X_DECOMPRESS_NEON)
+	static const int32_t shifts[4] = { 0, -2, -4, -6 };
+	uint32x4_t idx = vshlq_u32(vdupq_n_u32(indices), vld1q_s32(shifts));
+	uint32x4_t res = vld1q_u32(pal[0]);
+	uint16x4_t a16;
+
+	idx = vandq_u32(idx, vdupq_n_u32(3));
+
+	res = vbslq_u32(vceqq_u32(idx, vdupq_n_u32(1)), vld1q_u32(pal[1]), res);
+	res = vbslq_u32(vceqq_u32(idx, vdupq_n_u32(2)), vld1q_u32(pal[2]), res);
+	res = vbslq_u32(vceqq_u32(idx, vdupq_n_u32(3)), vld1q_u32(pal[3]), res);
+
+	a16 = vget_low_u16(vmovl_u8(vcreate_u8(alpha)));
+	res = vorrq_u32(res, vshlq_n_u32(vmovl_u16(a16), 24));
+
+	vst1q_u8(dst, vreinterpretq_u8_u32(res));
+#elif defined(HOST1X_DECOMPRESS_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i idx = _mm_and_si128(_mm_set1_epi32(indices),
+				    _mm_set_epi32(0xc0, 0x30, 0x0c, 0x03));
+	__m128i eq1 = _mm_cmpeq_epi32(idx, _mm_set_epi32(0x40, 0x10, 0x04, 0x01));
+	__m128i eq2 = _mm_cmpeq_epi32(idx, _mm_set_epi32(0x80, 0x20, 0x08, 0x02));
+	__m128i eq3 = _mm_cmpeq_epi32(idx, _mm_set_epi32(0xc0, 0x30, 0x0c, 0x03));
+	__m128i eq0 = _mm_cmpeq_epi32(idx, zero);
+	__m128i res, a;
+
+	res = _mm_and_si128(eq0, _mm_loadu_si128((const __m128i *)pal[0]));
+	res = _mm_or_si128(res, _mm_and_si128(eq1,
+			   _mm_loadu_si128((const __m128i *)pal[1])));
+	res = _mm_or_si128(res, _mm_and_si128(eq2,
+			   _mm_loadu_si128((const __m128i *)pal[2])));
+	res = _mm_or_si128(res, _mm_and_si128(eq3,
+			   _mm_loadu_si128((const __m128i *)pal[3])));
+
+	/* move alpha byte x to the top byte of lane x */
+	a = _mm_unpacklo_epi8(zero, _mm_cvtsi32_si128(alpha));
+	a = _mm_unpacklo_epi16(zero, a);
+	res = _mm_or_si128(res, a);
+
+	_mm_storeu_si128((__m128i *)dst, res);
+#else
+	uint32_t pixels[4];
+	unsigned int x;
+
+	for (x = 0; x < 4; x++)
+		pixels[x] = pal[(indices >> (x * 2)) & 3][x] |
+			    ((alpha >> (x * 8)) & 0xff) << 24;
+
+	memcpy(dst, pixels, sizeof(pixels));
+#endif
+}
+
+static inline void unpack_565(uint32_t c, unsigned int *r, unsigned int *g,
+			      unsigned int *b)
+{
+	*r = (c >> 11) & 0x1f;
+	*g = (c >> 5) & 0x3f;
+	*b = c & 0x1f;
+
+	*r = (*r << 3) | (*r >> 2);
+	*g = (*g << 2) | (*g >> 4);
+	*b = (*b << 3) | (*b >> 2);
+}
+
+/*
+ * The color part shared by all DXT formats. DXT3 and DXT5 always use the
+ * four color mode and leave alpha to the separate alpha block, which is
+ * passed in as one 32bit word of 8bit alphas per row.
+ */
+static void dxt_decompress_color(const uint8_t *block, uint8_t *dst,
+				 unsigned int pitch, bool dxt1,
+				 const uint32_t alpha[4])
+{
+	uint32_t c0 = read_le16(block);
+	uint32_t c1 = read_le16(block + 2);
+	uint32_t indices = read_le32(block + 4);
+	unsigned int r[4], g[4], b[4];
+	unsigned int a = dxt1 ? 0xff : 0;
+	uint32_t colors[4];
+	row_palette pal;
+	unsigned int i, x, y;
+
+	unpack_565(c0, &r[0], &g[0], &b[0]);
+	unpack_565(c1, &r[1], &g[1], &b[1]);
+
+	if (c0 > c1 || !dxt1) {
+		r[2] = (2 * r[0] + r[1]) / 3;
+		g[2] = (2 * g[0] + g[1]) / 3;
+		b[2] = (2 * b[0] + b[1]) / 3;
+		r[3] = (r[0] + 2 * r[1]) / 3;
+		g[3] = (g[0] + 2 * g[1]) / 3;
+		b[3] = (b[0] + 2 * b[1]) / 3;
+	} else {
+		r[2] = (r[0] + r[1]) / 2;
+		g[2] = (g[0] + g[1]) / 2;
+		b[2] = (b[0] + b[1]) / 2;
+	}
+
+	for (i = 0; i < 4; i++)
+		colors[i] = RGBA(r[i], g[i], b[i], a);
+
+	/* the punch-through color of the three color mode */
+	if (dxt1 && c0 <= c1)
+		colors[3] = 0;
+
+	for (i = 0; i < 4; i++)
+		for (x = 0; x < 4; x++)
+			pal[i][x] = colors[i];
+
+	for (y = 0; y < 4; y++)
+		store_row(dst + y * pitch, pal, indices >> (y * 8),
+			  alpha ? alpha[y] : 0);
+}
+
+void host1x_decompress_dxt1_block(const void *block, void *dst,
+				  unsigned int pitch)
+{
+	dxt_decompress_color(block, dst, pitch, true, NULL);
+}
+
+void host1x_decompress_dxt3_block(const void *block, void *dst,
+				  unsigned int pitch)
+{
+	const uint8_t *src = block;
+	uint32_t alpha[4];
+	unsigned int y, x;
+
+	for (y = 0; y < 4; y++) {
+		uint32_t bits = read_le16(src + y * 2);
+
+		alpha[y] = 0;
+
+		for (x = 0; x < 4; x++)
+			alpha[y] |= ((bits >> (x * 4)) & 0xf) * 0x11 << (x * 8);
+	}
+
+	dxt_decompress_color(src + 8, dst, pitch, false, alpha);
+}
+
+void host1x_decompress_dxt5_block(const void *block, void *dst,
+				  unsigned int pitch)
+{
+	const uint8_t *src = block;
+	unsigned int a0 = src[0];
+	unsigned int a1 = src[1];
+	uint64_t bits = read_le32(src + 2) | (uint64_t)read_le16(src + 6) << 32;
+	uint32_t alpha[4];
+	uint8_t codes[8];
+	unsigned int i, x, y;
+
+	codes[0] = a0;
+	codes[1] = a1;
+
+	if (a0 > a1) {
+		for (i = 1; i < 7; i++)
+			codes[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+	} else {
+		for (i = 1; i < 5; i++)
+			codes[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+
+		codes[6] = 0;
+		codes[7] = 255;
+	}
+
+	for (y = 0; y < 4; y++) {
+		alpha[y] = 0;
+
+		for (x = 0; x < 4; x++, bits >>= 3)
+			alpha[y] |= (uint32_t)codes[bits & 7] << (x * 8);
+	}
+
+	dxt_decompress_color(src + 8, dst, pitch, false, alpha);
+}
+
+static const int etc1_modifiers[8][4] = {
+	{  2,   8,  -2,   -8 },
+	{  5,  17,  -5,  -17 },
+	{  9,  29,  -9,  -29 },
+	{ 13,  42, -13,  -42 },
+	{ 18,  60, -18,  -60 },
+	{ 24,  80, -24,  -80 },
+	{ 33, 106, -33, -106 },
+	{ 47, 183, -47, -183 },
+};
+
+static inline unsigned int etc1_clamp(int v)
+{
+	return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+static inline unsigned int etc1_expand4(uint32_t v)
+{
+	v &= 0xf;
+
+	return (v << 4) | v;
+}
+
+static inline unsigned int etc1_expand5(uint32_t v)
+{
+	v &= 0x1f;
+
+	return (v << 3) | (v >> 2);
+}
+
+/* 5bit base plus the 3bit signed delta of the differential mode */
+static inline unsigned int etc1_expand_diff(uint32_t base, uint32_t diff)
+{
+	int delta = (int)((diff & 7) ^ 4) - 4;
+
+	return etc1_expand5((base & 0x1f) + delta);
+}
+
+/*
+ * Tegra's GR3D takes an ETC1 block as a little-endian 64bit word, see
+ * grate_texture_load(), so that the color word of the big-endian ETC1 block
+ * is in the upper and the pixel indices are in the lower 32 bits.
+ */
+void host1x_decompress_etc1_block(const void *block, void *dst,
+				  unsigned int pitch)
+{
+	const uint8_t *src = block;
+	uint32_t high = read_le32(src + 4);
+	uint32_t low = read_le32(src);
+	unsigned int r[2], g[2], b[2];
+	uint32_t colors[2][4];
+	row_palette pal[2];
+	bool flip = high & 1;
+	unsigned int i, s, x, y;
+
+	if (high & 2) {
+		r[0] = etc1_expand5(high >> 27);
+		g[0] = etc1_expand5(high >> 19);
+		b[0] = etc1_expand5(high >> 11);
+		r[1] = etc1_expand_diff(high >> 27, high >> 24);
+		g[1] = etc1_expand_diff(high >> 19, high >> 16);
+		b[1] = etc1_expand_diff(high >> 11, high >> 8);
+	} else {
+		r[0] = etc1_expand4(high >> 28);
+		g[0] = etc1_expand4(high >> 20);
+		b[0] = etc1_expand4(high >> 12);
+		r[1] = etc1_expand4(high >> 24);
+		g[1] = etc1_expand4(high >> 16);
+		b[1] = etc1_expand4(high >> 8);
+	}
+
+	for (s = 0; s < 2; s++) {
+		const int *mod = etc1_modifiers[(high >> (5 - s * 3)) & 7];
+
+		for (i = 0; i < 4; i++)
+			colors[s][i] = RGBA(etc1_clamp(r[s] + mod[i]),
+					    etc1_clamp(g[s] + mod[i]),
+					    etc1_clamp(b[s] + mod[i]), 0xff);
+	}
+
+	/*
+	 * The two sub-blocks are the left and right 2x4 halves, or the top
+	 * and bottom 4x2 halves of a flipped block.
+	 */
+	for (s = 0; s < 2; s++)
+		for (i = 0; i < 4; i++)
+			for (x = 0; x < 4; x++)
+				pal[s][i][x] = colors[flip ? s : x / 2][i];
+
+	for (y = 0; y < 4; y++) {
+		uint32_t indices = 0;
+
+		/* pixels are stored column by column, LSB and MSB planes apart */
+		for (x = 0; x < 4; x++) {
+			unsigned int k = x * 4 + y;
+			uint32_t idx = ((low >> k) & 1) | ((low >> (k + 15)) & 2);
+
+			indices |= idx << (x * 2);
+		}
+
+		store_row((uint8_t *)dst + y * pitch, pal[flip && y >= 2],
+			  indices, 0);
+	}
+}
+
+int host1x_decompress_image(const void *data, unsigned int data_pitch,
+			    enum pixel_format format,
+			    unsigned int width, unsigned int height,
+			    void *dst, unsigned int dst_pitch)
+{
+	void (*decompress_block)(const void *block, void *dst,
+				 unsigned int pitch);
+	unsigned int block_size = PIX_BUF_FORMAT_BYTES(format);
+	uint8_t tmp[4 * 4 * 4];
+	unsigned int bx, by, y;
+
+	switch (format) {
+	case PIX_BUF_FMT_DXT1:
+		decompress_block = host1x_decompress_dxt1_block;
+		break;
+	case PIX_BUF_FMT_DXT3:
+		decompress_block = host1x_decompress_dxt3_block;
+		break;
+	case PIX_BUF_FMT_DXT5:
+		decompress_block = host1x_decompress_dxt5_block;
+		break;
+	case PIX_BUF_FMT_ETC1:
+		decompress_block = host1x_decompress_etc1_block;
+		break;
+	default:
+		host1x_error("format 0x%08x isn't block-compressed\n", format);
+		return -EINVAL;
+	}
+
+	for (by = 0; by < height; by += 4) {
+		const uint8_t *block = (const uint8_t *)data +
+				       by / 4 * data_pitch;
+		uint8_t *out = (uint8_t *)dst + by * dst_pitch;
+		unsigned int rows = MIN(height - by, 4);
+
+		for (bx = 0; bx < width; bx += 4, block += block_size) {
+			unsigned int cols = MIN(width - bx, 4);
+
+			if (rows == 4 && cols == 4) {
+				decompress_block(block, out + bx * 4,
+						 dst_pitch);
+				continue;
+			}
+
+			/* edge blocks are clipped to the image */
+			decompress_block(block, tmp, 16);
+
+			for (y = 0; y < rows; y++)
+				memcpy(out + y * dst_pitch + bx * 4,
+				       tmp + y * 16, cols * 4);
+		}
+	}
+
+	return 0;
+}
+
+int host1x_pixelbuffer_decompress(struct host1x_pixelbuffer *pixbuf,
+				  void *dst, unsigned int dst_pitch)
+{
+	unsigned int rows = ALIGN(pixbuf->height, 4) / 4;
+	unsigned int pitch = pixbuf->pitch;
+	uint8_t *detiled = NULL;
+	unsigned long size;
+	uint8_t *data;
+	void *map;
+	int err;
+
+	if (!PIX_BUF_FORMAT_COMPRESSED(pixbuf->format)) {
+		host1x_error("pixbuf format 0x%08x isn't compressed\n",
+			     pixbuf->format);
+		return -EINVAL;
+	}
+
+	if (pixbuf->layout == PIX_BUF_LAYOUT_TILED_16x16)
+		size = pitch * ALIGN(rows, 16);
+	else
+		size = pitch * rows;
+
+	err = HOST1X_BO_MMAP(pixbuf->bo, &map);
+	if (err)
+		return err;
+
+	err = HOST1X_BO_INVALIDATE(pixbuf->bo, pixbuf->bo->offset, size);
+	if (err)
+		return err;
+
+	data = (uint8_t *)map + pixbuf->bo->offset;
+
+	if (pixbuf->layout == PIX_BUF_LAYOUT_TILED_16x16) {
+		detiled = malloc(pitch * rows);
+		if (!detiled)
+			return -ENOMEM;
+
+		err = host1x_detile_rect(detiled, pitch, data, pixbuf->pitch,
+					 pixbuf->format, 0, 0,
+					 pixbuf->width, pixbuf->height);
+		if (err) {
+			free(detiled);
+			return err;
+		}
+
+		data = detiled;
+	}
+
+	err = host1x_decompress_image(data, pitch, pixbuf->format,
+				      pixbuf->width, pixbuf->height,
+				      dst, dst_pitch);
+	free(detiled);
+
+	return err;
+}
@@ -959,6 +959,10 @@ static int drm_channel_wait(struct host1x_client *client, uint32_t fence,
 
 	err = ioctl(channel->drm->fd, DRM_IOCTL_TEGRA_SYNCPT_WAIT, &args);
 	if (err < 0) {
+		/* a fence that isn't reached within the timeout isn't an error */
+		if (errno == EAGAIN)
+			return -EAGAIN;
+
 		host1x_error("ioctl(DRM_IOCTL_TEGRA_SYNCPT_WAIT) failed: %d\n",
 			     errno);
 		return -errno;
@@ -967,6 +971,27 @@ static int drm_channel_wait(struct host1x_client *client, uint32_t fence,
 	return 0;
 }
 
+static int drm_channel_read(struct host1x_client *client, uint32_t *value)
+{
+	struct drm_channel *channel = to_drm_channel(client);
+	struct drm_tegra_syncpt_read args;
+	int err;
+
+	memset(&args, 0, sizeof(args));
+	args.id = channel->client.syncpts[0].id;
+
+	err = ioctl(channel->drm->fd, DRM_IOCTL_TEGRA_SYNCPT_READ, &args);
+	if (err < 0) {
+		host1x_error("ioctl(DRM_IOCTL_TEGRA_SYNCPT_READ) failed: %d\n",
+			     errno);
+		return -errno;
+	}
+
+	*value = args.value;
+
+	return 0;
+}
+
 static int drm_channel_init(struct drm *drm, struct drm_channel *channel,
 			    uint32_t class, unsigned int num_syncpts)
 {
@@ -1007,6 +1032,7 @@ static int drm_channel_init(struct drm *drm, struct drm_channel *channel,
 	channel->client.submit = drm_channel_submit;
 	channel->client.flush = drm_channel_flush;
 	channel->client.wait = drm_channel_wait;
+	channel->client.read = drm_channel_read;
 
 	return 0;
 }
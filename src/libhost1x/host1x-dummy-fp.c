@@ -0,0 +1,835 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Software implementation of the fragment pipeline. A fragment program is a
+ * sequence of exec bundles, each of them runs up to three MFU instructions
+ * (SFU operation, two multipliers and the TRAM interpolation), one texture
+ * sample, up to three ALU instructions of four sub-ALUs each and one store
+ * to a render target, in that order.
+ *
+ * Row and general purpose registers are 20 bits wide and hold either one
+ * fp20 value or two fx10 values. Arithmetic is done in single precision and
+ * every result is rounded to the format of its destination.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host1x-dummy.h"
+#include "tgr_3d.xml.h"
+
+#define FP_NUM_ROWS		16
+#define FP_NUM_GPRS		8
+#define FP_NUM_CRS		8
+#define FP_EXEC_NB_MASK		0x7f
+#define FP_FX10_ONE		0x100
+
+struct fp_state {
+	struct dummy_gr3d *gr3d;
+	struct dummy_fp_fragment *frag;
+
+	uint32_t r[FP_NUM_ROWS];
+	uint32_t g[FP_NUM_GPRS];
+	uint32_t cr[FP_NUM_CRS];
+	float alu[4];
+
+	float sfu;
+	float bar[2];
+	float bar_coef[2];
+	bool kill;
+};
+
+static inline float fp_round(float v)
+{
+	return dummy_fp20_to_float(dummy_float_to_fp20(v));
+}
+
+static inline uint32_t fp_pack_fx10(float low, float high)
+{
+	return dummy_float_to_fx10(low) | dummy_float_to_fx10(high) << 10;
+}
+
+static inline float fp_saturate(float v)
+{
+	return fminf(fmaxf(v, 0.0f), 1.0f);
+}
+
+static float fp_sfu(unsigned int opcode, float x)
+{
+	switch (opcode) {
+	case MFU_RCP:
+		return 1.0f / x;
+	case MFU_RSQ:
+		return 1.0f / sqrtf(x);
+	case MFU_LG2:
+		return log2f(x);
+	case MFU_EX2:
+		return exp2f(x);
+	case MFU_SQRT:
+		return sqrtf(x);
+	case MFU_SIN:
+		return sinf(x);
+	case MFU_COS:
+		return cosf(x);
+	case MFU_FRC:
+		return x - floorf(x);
+
+	/* argument reduction, folded into the operations above */
+	case MFU_PREEX2:
+	case MFU_PRESIN:
+	case MFU_PRECOS:
+	default:
+		return x;
+	}
+}
+
+static float fp_mul_src(const struct fp_state *s, unsigned int src)
+{
+	switch (src) {
+	case MFU_MUL_SRC_ROW_REG_0 ... MFU_MUL_SRC_ROW_REG_3:
+		return dummy_fp20_to_float(s->r[src - MFU_MUL_SRC_ROW_REG_0]);
+	case MFU_MUL_SRC_SFU_RESULT:
+		return s->sfu;
+	case MFU_MUL_SRC_BARYCENTRIC_COEF_0:
+		return s->bar_coef[0];
+	case MFU_MUL_SRC_BARYCENTRIC_COEF_1:
+		return s->bar_coef[1];
+	case MFU_MUL_SRC_CONST_1:
+		return 1.0f;
+	default:
+		return 0.0f;
+	}
+}
+
+static void fp_mul_dst(struct fp_state *s, unsigned int dst,
+		       unsigned int index, float v)
+{
+	switch (dst) {
+	case MFU_MUL_DST_BARYCENTRIC_WEIGHT:
+		s->bar[index] = fp_round(v);
+		break;
+	case MFU_MUL_DST_ROW_REG_0 ... MFU_MUL_DST_ROW_REG_3:
+		s->r[dst - MFU_MUL_DST_ROW_REG_0] = dummy_float_to_fp20(v);
+		break;
+	default:
+		break;
+	}
+}
+
+/* interpolates TRAM slot @reg of row @source into row register @reg */
+static void fp_interpolate(struct fp_state *s, unsigned int reg,
+			   unsigned int opcode, unsigned int source,
+			   bool saturate)
+{
+	const struct dummy_fp_fragment *frag = s->frag;
+	float w[3] = { 1.0f - s->bar[0] - s->bar[1], s->bar[0], s->bar[1] };
+	float low = 0.0f, high = 0.0f;
+	unsigned int i;
+	uint32_t value;
+
+	for (i = 0; i < 3; i++) {
+		value = frag->tram[i][source][reg];
+
+		if (opcode == MFU_VAR_FP20) {
+			low += w[i] * dummy_fp20_to_float(value);
+		} else {
+			low += w[i] * dummy_fx10_to_float(value);
+			high += w[i] * dummy_fx10_to_float(value >> 10);
+		}
+	}
+
+	if (saturate) {
+		low = fp_saturate(low);
+		high = fp_saturate(high);
+	}
+
+	switch (opcode) {
+	case MFU_VAR_FP20:
+		s->r[reg] = dummy_float_to_fp20(low);
+		break;
+	case MFU_VAR_FX10:
+		s->r[reg] = fp_pack_fx10(low, high);
+		break;
+	default:
+		break;
+	}
+}
+
+static void fp_mfu(struct fp_state *s, const uint32_t *words)
+{
+	mfu_instr mfu;
+	float mul0, mul1;
+
+	mfu.part0 = words[0];
+	mfu.part1 = words[1];
+
+	if (mfu.opcode != MFU_NOP) {
+		s->sfu = fp_sfu(mfu.opcode,
+				dummy_fp20_to_float(s->r[mfu.reg % FP_NUM_ROWS]));
+		s->sfu = fp_round(s->sfu);
+	}
+
+	mul0 = fp_mul_src(s, mfu.mul0_src0) * fp_mul_src(s, mfu.mul0_src1);
+	mul1 = fp_mul_src(s, mfu.mul1_src0) * fp_mul_src(s, mfu.mul1_src1);
+
+	fp_mul_dst(s, mfu.mul0_dst, 0, mul0);
+	fp_mul_dst(s, mfu.mul1_dst, 1, mul1);
+
+	fp_interpolate(s, 0, mfu.var0_opcode, mfu.var0_source,
+		       mfu.var0_saturate);
+	fp_interpolate(s, 1, mfu.var1_opcode, mfu.var1_source,
+		       mfu.var1_saturate);
+	fp_interpolate(s, 2, mfu.var2_opcode, mfu.var2_source,
+		       mfu.var2_saturate);
+	fp_interpolate(s, 3, mfu.var3_opcode, mfu.var3_source,
+		       mfu.var3_saturate);
+}
+
+static unsigned int fp_texture_bpp(unsigned int format)
+{
+	switch (format) {
+	case TGR3D_PIXEL_FORMAT_A8:
+	case TGR3D_PIXEL_FORMAT_L8:
+		return 1;
+
+	case TGR3D_PIXEL_FORMAT_LA88:
+	case TGR3D_PIXEL_FORMAT_RGB565:
+	case TGR3D_PIXEL_FORMAT_RGBA5551:
+	case TGR3D_PIXEL_FORMAT_RGBA4444:
+		return 2;
+
+	case TGR3D_PIXEL_FORMAT_RGBA8888:
+	case TGR3D_PIXEL_FORMAT_BGRA8888:
+		return 4;
+
+	default:
+		return 0;
+	}
+}
+
+static inline float fp_unorm(unsigned int value, unsigned int bits)
+{
+	return (value & ((1 << bits) - 1)) / (float)((1 << bits) - 1);
+}
+
+static void fp_fetch_texel(const struct dummy_fp_texture *tex,
+			   unsigned int x, unsigned int y, float texel[4])
+{
+	const uint8_t *ptr = tex->base + y * tex->pitch + x * tex->bpp;
+	uint16_t v16 = 0;
+
+	texel[0] = texel[1] = texel[2] = 0.0f;
+	texel[3] = 1.0f;
+
+	if (tex->bpp == 2)
+		memcpy(&v16, ptr, 2);
+
+	switch (tex->format) {
+	case TGR3D_PIXEL_FORMAT_A8:
+		texel[3] = fp_unorm(ptr[0], 8);
+		break;
+
+	case TGR3D_PIXEL_FORMAT_L8:
+		texel[0] = texel[1] = texel[2] = fp_unorm(ptr[0], 8);
+		break;
+
+	case TGR3D_PIXEL_FORMAT_LA88:
+		texel[0] = texel[1] = texel[2] = fp_unorm(v16, 8);
+		texel[3] = fp_unorm(v16 >> 8, 8);
+		break;
+
+	case TGR3D_PIXEL_FORMAT_RGB565:
+		texel[0] = fp_unorm(v16 >> 11, 5);
+		texel[1] = fp_unorm(v16 >> 5, 6);
+		texel[2] = fp_unorm(v16, 5);
+		break;
+
+	case TGR3D_PIXEL_FORMAT_RGBA5551:
+		texel[0] = fp_unorm(v16 >> 11, 5);
+		texel[1] = fp_unorm(v16 >> 6, 5);
+		texel[2] = fp_unorm(v16 >> 1, 5);
+		texel[3] = fp_unorm(v16, 1);
+		break;
+
+	case TGR3D_PIXEL_FORMAT_RGBA4444:
+		texel[0] = fp_unorm(v16 >> 12, 4);
+		texel[1] = fp_unorm(v16 >> 8, 4);
+		texel[2] = fp_unorm(v16 >> 4, 4);
+		texel[3] = fp_unorm(v16, 4);
+		break;
+
+	case TGR3D_PIXEL_FORMAT_RGBA8888:
+		texel[0] = fp_unorm(ptr[0], 8);
+		texel[1] = fp_unorm(ptr[1], 8);
+		texel[2] = fp_unorm(ptr[2], 8);
+		texel[3] = fp_unorm(ptr[3], 8);
+		break;
+
+	case TGR3D_PIXEL_FORMAT_BGRA8888:
+		texel[0] = fp_unorm(ptr[2], 8);
+		texel[1] = fp_unorm(ptr[1], 8);
+		texel[2] = fp_unorm(ptr[0], 8);
+		texel[3] = fp_unorm(ptr[3], 8);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static unsigned int fp_wrap(int i, unsigned int size, bool clamp,
+			    bool mirror)
+{
+	int n = size;
+
+	if (clamp)
+		return i < 0 ? 0 : i >= n ? n - 1 : i;
+
+	if (mirror) {
+		i %= 2 * n;
+		if (i < 0)
+			i += 2 * n;
+
+		return i >= n ? 2 * n - 1 - i : i;
+	}
+
+	i %= n;
+	if (i < 0)
+		i += n;
+
+	return i;
+}
+
+static void fp_sample(const struct dummy_fp_texture *tex, float s, float t,
+		      float texel[4])
+{
+	bool clamp_s = tex->desc & TGR3D_TEXTURE_DESC1_WRAP_S_CLAMP_TO_EDGE;
+	bool clamp_t = tex->desc & TGR3D_TEXTURE_DESC1_WRAP_T_CLAMP_TO_EDGE;
+	bool mirror_s = tex->desc & TGR3D_TEXTURE_DESC1_WRAP_S_MIRRORED_REPEAT;
+	bool mirror_t = tex->desc & TGR3D_TEXTURE_DESC1_WRAP_T_MIRRORED_REPEAT;
+	float u = s * tex->width, v = t * tex->height;
+	float fu, fv, texels[4][4];
+	unsigned int x[2], y[2], c;
+
+	if (!(tex->desc & TGR3D_TEXTURE_DESC1_MAGFILTER_LINEAR)) {
+		x[0] = fp_wrap(floorf(u), tex->width, clamp_s, mirror_s);
+		y[0] = fp_wrap(floorf(v), tex->height, clamp_t, mirror_t);
+		fp_fetch_texel(tex, x[0], y[0], texel);
+		return;
+	}
+
+	u -= 0.5f;
+	v -= 0.5f;
+	fu = u - floorf(u);
+	fv = v - floorf(v);
+
+	x[0] = fp_wrap(floorf(u), tex->width, clamp_s, mirror_s);
+	x[1] = fp_wrap(floorf(u) + 1, tex->width, clamp_s, mirror_s);
+	y[0] = fp_wrap(floorf(v), tex->height, clamp_t, mirror_t);
+	y[1] = fp_wrap(floorf(v) + 1, tex->height, clamp_t, mirror_t);
+
+	fp_fetch_texel(tex, x[0], y[0], texels[0]);
+	fp_fetch_texel(tex, x[1], y[0], texels[1]);
+	fp_fetch_texel(tex, x[0], y[1], texels[2]);
+	fp_fetch_texel(tex, x[1], y[1], texels[3]);
+
+	for (c = 0; c < 4; c++)
+		texel[c] = (texels[0][c] * (1.0f - fu) + texels[1][c] * fu) *
+			   (1.0f - fv) +
+			   (texels[2][c] * (1.0f - fu) + texels[3][c] * fu) * fv;
+}
+
+/* LOD and bias are ignored, the base level is always sampled */
+static void fp_tex(struct fp_state *s, tex_instr tex)
+{
+	const struct dummy_fp_texture *t =
+			&s->gr3d->fp.textures[tex.sampler_index];
+	const uint32_t *src = &s->r[tex.src_regs_select ? 2 : 0];
+	uint32_t *dst = &s->r[tex.sample_dst_regs_select ? 2 : 0];
+	float texel[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	if (t->base)
+		fp_sample(t, dummy_fp20_to_float(src[0]),
+			  dummy_fp20_to_float(src[1]), texel);
+
+	dst[0] = fp_pack_fx10(texel[0], texel[1]);
+	dst[1] = fp_pack_fx10(texel[2], texel[3]);
+}
+
+static float fp_alu_read(const struct fp_state *s, const alu_instr *imm,
+			 unsigned int reg, bool fixed10, bool high)
+{
+	uint32_t value;
+
+	switch (reg) {
+	case FRAGMENT_ROW_REG_0 ... FRAGMENT_ROW_REG_15:
+		value = s->r[reg - FRAGMENT_ROW_REG_0];
+		break;
+
+	case FRAGMENT_GENERAL_PURPOSE_REG_0 ... FRAGMENT_GENERAL_PURPOSE_REG_7:
+		value = s->g[reg - FRAGMENT_GENERAL_PURPOSE_REG_0];
+		break;
+
+	case FRAGMENT_ALU_RESULT_REG_0 ... FRAGMENT_ALU_RESULT_REG_3:
+		if (fixed10)
+			return dummy_fx10_to_float(dummy_float_to_fx10(
+				s->alu[reg - FRAGMENT_ALU_RESULT_REG_0]));
+
+		return s->alu[reg - FRAGMENT_ALU_RESULT_REG_0];
+
+	case FRAGMENT_EMBEDDED_CONSTANT(0):
+		value = fixed10 ? imm->imm0.fx10_low | imm->imm0.fx10_high << 10 :
+				  imm->imm0.fp20;
+		break;
+
+	case FRAGMENT_EMBEDDED_CONSTANT(1):
+		value = fixed10 ? imm->imm1.fx10_low | imm->imm1.fx10_high << 10 :
+				  imm->imm1.fp20;
+		break;
+
+	case FRAGMENT_EMBEDDED_CONSTANT(2):
+		value = fixed10 ? imm->imm2.fx10_low | imm->imm2.fx10_high << 10 :
+				  imm->imm2.fp20;
+		break;
+
+	/* #0 and #1 */
+	case FRAGMENT_LOWP_VEC2_0_1:
+		value = FP_FX10_ONE << 10;
+		break;
+
+	case FRAGMENT_UNIFORM_REG_0 ... FRAGMENT_UNIFORM_REG_31:
+		value = s->gr3d->regs[TGR3D_FP_CONST(reg -
+						     FRAGMENT_UNIFORM_REG_0)];
+		break;
+
+	case FRAGMENT_CONDITION_REG_0 ... FRAGMENT_CONDITION_REG_7:
+		value = s->cr[reg - FRAGMENT_CONDITION_REG_0];
+		break;
+
+	case FRAGMENT_POS_X:
+		return s->frag->x + 0.5f;
+
+	case FRAGMENT_POS_Y:
+		return s->frag->y + 0.5f;
+
+	case FRAGMENT_POLYGON_FACE:
+		return s->frag->front ? 1.0f : -1.0f;
+
+	default:
+		return 0.0f;
+	}
+
+	if (fixed10)
+		return dummy_fx10_to_float(high ? value >> 10 : value);
+
+	return dummy_fp20_to_float(value);
+}
+
+static float fp_alu_src(const struct fp_state *s, const alu_instr *imm,
+			unsigned int reg, bool high, bool fixed10,
+			bool absolute, bool negate, bool x2, bool minus_one)
+{
+	float v = fp_alu_read(s, imm, reg, fixed10, high);
+
+	if (absolute)
+		v = fabsf(v);
+
+	if (negate)
+		v = -v;
+
+	if (x2)
+		v *= 2.0f;
+
+	if (minus_one)
+		v -= 1.0f;
+
+	return v;
+}
+
+static float fp_alu_op(const struct fp_state *s,
+		       const union fragment_alu_instruction *alu,
+		       const alu_instr *imm)
+{
+	unsigned int rD_reg;
+	float a, b, c, d, v;
+
+	a = fp_alu_src(s, imm, alu->rA_reg_select, alu->rA_sub_reg_select_high,
+		       alu->rA_fixed10, alu->rA_absolute_value, alu->rA_negate,
+		       alu->rA_scale_by_two, alu->rA_minus_one);
+	b = fp_alu_src(s, imm, alu->rB_reg_select, alu->rB_sub_reg_select_high,
+		       alu->rB_fixed10, alu->rB_absolute_value, alu->rB_negate,
+		       alu->rB_scale_by_two, alu->rB_minus_one);
+	c = fp_alu_src(s, imm, alu->rC_reg_select, alu->rC_sub_reg_select_high,
+		       alu->rC_fixed10, alu->rC_absolute_value, alu->rC_negate,
+		       alu->rC_scale_by_two, alu->rC_minus_one);
+
+	/* rD re-reads the register of rB or rC with its own modifiers */
+	if (alu->rD_enable) {
+		rD_reg = alu->rD_reg_select ? alu->rC_reg_select :
+					      alu->rB_reg_select;
+		d = fp_alu_src(s, imm, rD_reg, alu->rD_sub_reg_select_high,
+			       alu->rD_fixed10, alu->rD_absolute_value,
+			       false, false, alu->rD_minus_one);
+	} else {
+		d = 1.0f;
+	}
+
+	switch (alu->opcode) {
+	case ALU_OPCODE_MAD:
+		v = a * b;
+		if (!alu->addition_disable)
+			v += c * d;
+		break;
+	case ALU_OPCODE_MIN:
+		v = fminf(a, b);
+		break;
+	case ALU_OPCODE_MAX:
+		v = fmaxf(a, b);
+		break;
+	case ALU_OPCODE_CSEL:
+	default:
+		v = a > 0.0f ? b : c;
+		break;
+	}
+
+	switch (alu->scale_result) {
+	case ALU_SCALE_X2:
+		v *= 2.0f;
+		break;
+	case ALU_SCALE_X4:
+		v *= 4.0f;
+		break;
+	case ALU_SCALE_DIV2:
+		v /= 2.0f;
+		break;
+	default:
+		break;
+	}
+
+	if (alu->saturate_result)
+		v = fp_saturate(v);
+
+	switch (alu->condition_code) {
+	case ALU_CC_ZERO:
+		v = v == 0.0f;
+		break;
+	case ALU_CC_GREATER_THAN_ZERO:
+		v = v > 0.0f;
+		break;
+	case ALU_CC_ZERO_OR_GREATER:
+		v = v >= 0.0f;
+		break;
+	default:
+		break;
+	}
+
+	return fp_round(v);
+}
+
+static void fp_alu_write(struct fp_state *s,
+			 const union fragment_alu_instruction *alu, float v)
+{
+	uint32_t *reg;
+
+	switch (alu->dst_reg) {
+	case FRAGMENT_ROW_REG_0 ... FRAGMENT_ROW_REG_15:
+		reg = &s->r[alu->dst_reg - FRAGMENT_ROW_REG_0];
+		break;
+
+	case FRAGMENT_GENERAL_PURPOSE_REG_0 ... FRAGMENT_GENERAL_PURPOSE_REG_7:
+		reg = &s->g[alu->dst_reg - FRAGMENT_GENERAL_PURPOSE_REG_0];
+		break;
+
+	/* the odd condition registers are the high halves */
+	case FRAGMENT_CONDITION_REG_0 ... FRAGMENT_CONDITION_REG_7:
+		reg = &s->cr[alu->dst_reg - FRAGMENT_CONDITION_REG_0];
+
+		if (alu->write_low_sub_reg)
+			*reg = (*reg & 0x3ff) | dummy_float_to_fx10(v) << 10;
+		else
+			*reg = (*reg & ~0x3ff) | dummy_float_to_fx10(v);
+		return;
+
+	case FRAGMENT_KILL_REG:
+		if (v != 0.0f)
+			s->kill = true;
+		return;
+
+	default:
+		return;
+	}
+
+	if (alu->write_low_sub_reg && alu->write_high_sub_reg)
+		*reg = dummy_float_to_fp20(v);
+	else if (alu->write_low_sub_reg)
+		*reg = (*reg & ~0x3ff) | dummy_float_to_fx10(v);
+	else if (alu->write_high_sub_reg)
+		*reg = (*reg & 0x3ff) | dummy_float_to_fx10(v) << 10;
+}
+
+static inline bool fp_alu_reads_imm(const union fragment_alu_instruction *alu)
+{
+	unsigned int regs[3] = {
+		alu->rA_reg_select, alu->rB_reg_select, alu->rC_reg_select,
+	};
+	unsigned int i;
+
+	for (i = 0; i < 3; i++)
+		if (regs[i] >= FRAGMENT_EMBEDDED_CONSTANT_0 &&
+		    regs[i] <= FRAGMENT_EMBEDDED_CONSTANT_2)
+			return true;
+
+	return false;
+}
+
+/*
+ * The four sub-ALUs read the registers as they were before the instruction,
+ * except for the ALU results which later sub-ALUs see right away. When the
+ * first three sub-ALUs use immediates, the last one holds them instead of
+ * an operation.
+ */
+static void fp_alu(struct fp_state *s, const uint32_t *words)
+{
+	alu_instr instr, imm;
+	unsigned int i, count = 4;
+	uint32_t swap;
+	float v[4];
+
+	memcpy(&instr, words, sizeof(uint32_t) * 8);
+
+	for (i = 0; i < 3; i++)
+		if (fp_alu_reads_imm(&instr.a[i]))
+			count = 3;
+
+	imm = instr;
+	swap = imm.part7;
+	imm.part7 = imm.part6;
+	imm.part6 = swap;
+
+	for (i = 0; i < count; i++) {
+		v[i] = fp_alu_op(s, &instr.a[i], &imm);
+		s->alu[i] = v[i];
+	}
+
+	for (i = 0; i < count; i++)
+		fp_alu_write(s, &instr.a[i], v[i]);
+}
+
+/* stencil stores are handled by the stencil test, they carry no data */
+static void fp_dw(struct fp_state *s, dw_instr dw)
+{
+	struct dummy_fp_fragment *frag = s->frag;
+	const uint32_t *src = &s->r[dw.src_regs_select ? 2 : 0];
+	int *color = frag->color[dw.render_target_index];
+
+	if (dw.stencil_write)
+		return;
+
+	color[0] = dummy_fx10_to_int(src[0]);
+	color[1] = dummy_fx10_to_int(src[0] >> 10);
+	color[2] = dummy_fx10_to_int(src[1]);
+	color[3] = dummy_fx10_to_int(src[1] >> 10);
+
+	frag->written |= BIT(dw.render_target_index);
+}
+
+/*
+ * Latches the program length, the ALU buffer size and the texture units
+ * for the following draw and resets the counters.
+ */
+void dummy_fp_prepare(struct dummy_gr3d *gr3d)
+{
+	struct dummy_fp *fp = &gr3d->fp;
+	struct dummy_fp_texture *t;
+	uint32_t desc1, desc2, reported = 0;
+	unsigned int i;
+	tex_instr tex;
+
+	fp->exec_nb = gr3d->regs[TGR3D_FP_PSEQ_ENGINE_INST] & FP_EXEC_NB_MASK;
+	if (fp->exec_nb > DUMMY_FP_NUM_INSTRUCTIONS) {
+		host1x_error("Invalid fragment program length %u\n",
+			     fp->exec_nb);
+		fp->exec_nb = DUMMY_FP_NUM_INSTRUCTIONS;
+	}
+
+	fp->alu_buffer_size = ((gr3d->regs[TGR3D_ALU_BUFFER_SIZE] &
+				TGR3D_ALU_BUFFER_SIZE_SIZE__MASK) >>
+			       TGR3D_ALU_BUFFER_SIZE_SIZE__SHIFT) + 1;
+
+	memset(&fp->stats, 0, sizeof(fp->stats));
+
+	for (i = 0; i < DUMMY_FP_NUM_TEXTURES; i++) {
+		t = &fp->textures[i];
+		desc1 = gr3d->regs[TGR3D_TEXTURE_DESC1(i)];
+		desc2 = gr3d->regs[TGR3D_TEXTURE_DESC2(i)];
+
+		if (desc2 & TGR3D_TEXTURE_DESC2_NOT_POW2_DIMENSIONS) {
+			t->width = (desc2 & TGR3D_TEXTURE_DESC2_WIDTH__MASK) >>
+				   TGR3D_TEXTURE_DESC2_WIDTH__SHIFT;
+			t->height = (desc2 & TGR3D_TEXTURE_DESC2_HEIGHT__MASK) >>
+				    TGR3D_TEXTURE_DESC2_HEIGHT__SHIFT;
+		} else {
+			t->width = 1 << ((desc2 &
+					  TGR3D_TEXTURE_DESC2_WIDTH_LOG2__MASK) >>
+					 TGR3D_TEXTURE_DESC2_WIDTH_LOG2__SHIFT);
+			t->height = 1 << ((desc2 &
+					   TGR3D_TEXTURE_DESC2_HEIGHT_LOG2__MASK) >>
+					  TGR3D_TEXTURE_DESC2_HEIGHT_LOG2__SHIFT);
+		}
+
+		t->base = gr3d->addrs[TGR3D_TEXTURE_POINTER(i)];
+		t->format = (desc1 & TGR3D_TEXTURE_DESC1_FORMAT__MASK) >>
+			    TGR3D_TEXTURE_DESC1_FORMAT__SHIFT;
+		t->desc = desc1;
+		t->bpp = fp_texture_bpp(t->format);
+		t->pitch = t->width * t->bpp;
+
+		if (desc1 & TGR3D_TEXTURE_DESC1_COMPRESSED)
+			t->bpp = 0;
+
+		if (!t->width || !t->height)
+			t->base = NULL;
+
+		/* texels are fetched unchecked, keep the texture in its BO */
+		if (t->base && t->bpp &&
+		    dummy_bo_remaining(t->base) < (size_t)t->pitch * t->height)
+			t->base = NULL;
+	}
+
+	for (i = 0; i < fp->exec_nb; i++) {
+		tex.data = fp->tex[i];
+		t = &fp->textures[tex.sampler_index];
+
+		if (!tex.enable || (t->base && t->bpp) ||
+		    (reported & BIT(tex.sampler_index)))
+			continue;
+
+		host1x_error("Texture %u with format %u can't be sampled\n",
+			     tex.sampler_index, t->format);
+
+		reported |= BIT(tex.sampler_index);
+		t->base = NULL;
+	}
+}
+
+/*
+ * Runs the fragment program for one fragment. Returns false if the program
+ * killed the fragment.
+ */
+bool dummy_fp_execute(struct dummy_gr3d *gr3d, struct dummy_fp_fragment *frag)
+{
+	struct dummy_fp *fp = &gr3d->fp;
+	struct dummy_fp_stats *stats = &fp->stats;
+	unsigned int i, k, addr;
+	struct fp_state s;
+	instr_sched sched;
+	tex_instr tex;
+	dw_instr dw;
+	float w;
+
+	memset(&s, 0, sizeof(s));
+	s.gr3d = gr3d;
+	s.frag = frag;
+
+	/*
+	 * The pipeline provides the screen-space barycentric weights of
+	 * vertices 1 and 2, their counterparts scaled by 1/w and in r4 the
+	 * interpolated 1/w, from which programs derive perspective correct
+	 * weights with "rcp r4; mul0: bar, sfu, bar0; mul1: bar, sfu, bar1".
+	 */
+	s.bar[0] = fp_round(frag->weights[1]);
+	s.bar[1] = fp_round(frag->weights[2]);
+	s.bar_coef[0] = fp_round(frag->weights[1] * frag->inv_w[1]);
+	s.bar_coef[1] = fp_round(frag->weights[2] * frag->inv_w[2]);
+
+	w = frag->weights[0] * frag->inv_w[0] +
+	    frag->weights[1] * frag->inv_w[1] +
+	    frag->weights[2] * frag->inv_w[2];
+	s.r[4] = dummy_float_to_fp20(w);
+
+	frag->written = 0;
+
+	for (i = 0; i < fp->exec_nb; i++) {
+		sched.data = fp->mfu_sched[i];
+
+		for (k = 0; k < sched.instructions_nb; k++) {
+			addr = (sched.address + k) % DUMMY_FP_NUM_INSTRUCTIONS;
+			fp_mfu(&s, &fp->mfu[addr * 2]);
+		}
+
+		stats->mfu += sched.instructions_nb;
+
+		tex.data = fp->tex[i];
+		if (tex.enable) {
+			fp_tex(&s, tex);
+			stats->tex++;
+		}
+
+		sched.data = fp->alu_sched[i];
+
+		for (k = 0; k < sched.instructions_nb; k++) {
+			addr = (sched.address + k) % DUMMY_FP_NUM_INSTRUCTIONS;
+			fp_alu(&s, &fp->alu[addr * 8]);
+		}
+
+		stats->alu += sched.instructions_nb;
+
+		dw.data = fp->dw[i];
+		if (dw.enable) {
+			fp_dw(&s, dw);
+			stats->dw++;
+		}
+	}
+
+	stats->fragments++;
+	stats->bundles += fp->exec_nb;
+	stats->cycles += fp->exec_nb * fp->alu_buffer_size;
+
+	if (s.kill) {
+		stats->killed++;
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Prints the counters of the last draw when HOST1X_DUMMY_FP_STATS is set in
+ * the environment.
+ */
+void dummy_fp_report(struct dummy_gr3d *gr3d)
+{
+	const struct dummy_fp *fp = &gr3d->fp;
+	const struct dummy_fp_stats *stats = &fp->stats;
+
+	if (!getenv("HOST1X_DUMMY_FP_STATS") || !stats->fragments)
+		return;
+
+	host1x_info("%lu fragments (%lu killed), %u bundles and ALU buffer size %u per fragment\n",
+		    stats->fragments, stats->killed, fp->exec_nb,
+		    fp->alu_buffer_size);
+	host1x_info("%lu MFU, %lu TEX, %lu ALU, %lu DW instructions, ~%lu cycles\n",
+		    stats->mfu, stats->tex, stats->alu, stats->dw,
+		    stats->cycles);
+}
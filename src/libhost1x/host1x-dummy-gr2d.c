@@ -0,0 +1,501 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Software implementation of the GR2D engine, executing the fill, copy and
+ * surface (scaled) blit operations that host1x-gr2d.c emits.
+ */
+
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DUMMY_GR2D_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define DUMMY_GR2D_SSE2 1
+#endif
+
+#include "host1x-dummy.h"
+
+#define GR2D_TRIGGER			0x09
+#define GR2D_CMDSEL			0x0c
+#define GR2D_VDDA			0x11
+#define GR2D_VDDAINI			0x12
+#define GR2D_HDDA			0x13
+#define GR2D_HDDAINILS			0x14
+#define GR2D_SBFORMAT			0x1c
+#define GR2D_CONTROLSB			0x1d
+#define GR2D_CONTROLSECOND		0x1e
+#define GR2D_CONTROLMAIN		0x1f
+#define GR2D_ROPFADE			0x20
+#define GR2D_DSTBA			0x2b
+#define GR2D_DSTST			0x2e
+#define GR2D_SRCBA			0x31
+#define GR2D_SRCST			0x33
+#define GR2D_SRCFGC			0x35
+#define GR2D_SRCSIZE			0x37
+#define GR2D_DSTSIZE			0x38
+#define GR2D_SRCPS			0x39
+#define GR2D_DSTPS			0x3a
+#define GR2D_TILEMODE			0x46
+#define GR2D_SRCBA_SB_SURFBASE		0x48
+#define GR2D_DSTBA_SB_SURFBASE		0x49
+
+#define GR2D_CMDSEL_SBOR2D		BIT(0)
+
+#define GR2D_CONTROLMAIN_TURBOFILL	BIT(2)
+#define GR2D_CONTROLMAIN_SRCSLD		BIT(6)
+#define GR2D_CONTROLMAIN_XDIR		BIT(9)
+#define GR2D_CONTROLMAIN_YDIR		BIT(10)
+#define GR2D_CONTROLMAIN_YFLIP		BIT(14)
+
+#define GR2D_CONTROLSB_VFEN		BIT(18)
+
+#define GR2D_TILEMODE_SRC_TILED		BIT(0)
+#define GR2D_TILEMODE_DST_TILED		BIT(20)
+
+#define GR2D_SBFORMAT_BGRA8888		14
+#define GR2D_SBFORMAT_RGBA8888		15
+
+#define GR2D_HFTYPE_NONE		7
+
+/* 16x16 tiles are 16 lines of 16 bytes each */
+#define TILE_LINE_BYTES			16
+#define TILE_BYTES			256
+
+/*
+ * Relocated addresses may point into the middle of a tile, @x0 and @y0 are
+ * the byte and line of the origin within the tile at @base. Surfaces start
+ * at a 256 byte boundary of a page aligned BO, so the position within the
+ * tile follows from the address itself.
+ */
+struct gr2d_surface {
+	uint8_t *base;
+	unsigned int pitch;
+	bool tiled;
+	unsigned int x0;
+	unsigned int y0;
+};
+
+static void gr2d_surface_init(struct gr2d_surface *surf, uint8_t *base,
+			      unsigned int pitch, bool tiled)
+{
+	unsigned int offset = tiled ? (uintptr_t)base % TILE_BYTES : 0;
+
+	surf->base = base ? base - offset : NULL;
+	surf->pitch = pitch;
+	surf->tiled = tiled;
+	surf->x0 = offset % TILE_LINE_BYTES;
+	surf->y0 = offset / TILE_LINE_BYTES;
+}
+
+/* @y is signed, flipped surfaces are addressed upwards from their base */
+static inline uint8_t *gr2d_address(const struct gr2d_surface *surf,
+				    unsigned int xb, int y)
+{
+	int line, row;
+
+	if (!surf->tiled)
+		return surf->base + (ptrdiff_t)y * surf->pitch + xb;
+
+	xb += surf->x0;
+	line = (int)surf->y0 + y;
+	row = line >= 0 ? line / 16 : -((15 - line) / 16);
+
+	return surf->base + (ptrdiff_t)TILE_LINE_BYTES * surf->pitch * row +
+			    TILE_BYTES * (xb / TILE_LINE_BYTES) +
+			    TILE_LINE_BYTES * (line - row * 16) +
+			    xb % TILE_LINE_BYTES;
+}
+
+/* bytes from @xb up to the end of its tile line */
+static inline unsigned int gr2d_chunk(const struct gr2d_surface *surf,
+				      unsigned int xb, unsigned int size)
+{
+	return MIN(size, TILE_LINE_BYTES - (xb + surf->x0) % TILE_LINE_BYTES);
+}
+
+static unsigned int gr2d_bytes_per_pixel(uint32_t controlmain)
+{
+	switch ((controlmain >> 16) & 0x3) {
+	case 0:
+		return 1;
+	case 1:
+		return 2;
+	default:
+		return 4;
+	}
+}
+
+static void gr2d_fill_bytes(uint8_t *dst, uint32_t pattern, unsigned int size)
+{
+#if defined(DUMMY_GR2D_NEON)
+	uint32x4_t vec = vdupq_n_u32(pattern);
+
+	for (; size >= 16; size -= 16, dst += 16)
+		vst1q_u8(dst, vreinterpretq_u8_u32(vec));
+#elif defined(DUMMY_GR2D_SSE2)
+	__m128i vec = _mm_set1_epi32(pattern);
+
+	for (; size >= 16; size -= 16, dst += 16)
+		_mm_storeu_si128((__m128i *)dst, vec);
+#endif
+	for (; size >= 4; size -= 4, dst += 4)
+		memcpy(dst, &pattern, 4);
+
+	memcpy(dst, &pattern, size);
+}
+
+/* move one span of at most 16 bytes, a full tile line in the common case */
+static inline void gr2d_move_chunk(uint8_t *dst, const uint8_t *src,
+				   unsigned int size)
+{
+#if defined(DUMMY_GR2D_NEON)
+	if (size == 16) {
+		vst1q_u8(dst, vld1q_u8(src));
+		return;
+	}
+#elif defined(DUMMY_GR2D_SSE2)
+	if (size == 16) {
+		_mm_storeu_si128((__m128i *)dst,
+				 _mm_loadu_si128((const __m128i *)src));
+		return;
+	}
+#endif
+	memcpy(dst, src, size);
+}
+
+static void gr2d_read_row(const struct gr2d_surface *surf, unsigned int xb,
+			  unsigned int y, uint8_t *row, unsigned int size)
+{
+	unsigned int chunk;
+
+	if (!surf->tiled) {
+		memcpy(row, gr2d_address(surf, xb, y), size);
+		return;
+	}
+
+	while (size) {
+		chunk = gr2d_chunk(surf, xb, size);
+		gr2d_move_chunk(row, gr2d_address(surf, xb, y), chunk);
+		row += chunk;
+		xb += chunk;
+		size -= chunk;
+	}
+}
+
+static void gr2d_write_row(const struct gr2d_surface *surf, unsigned int xb,
+			   unsigned int y, const uint8_t *row,
+			   unsigned int size)
+{
+	unsigned int chunk;
+
+	if (!surf->tiled) {
+		memcpy(gr2d_address(surf, xb, y), row, size);
+		return;
+	}
+
+	while (size) {
+		chunk = gr2d_chunk(surf, xb, size);
+		gr2d_move_chunk(gr2d_address(surf, xb, y), row, chunk);
+		row += chunk;
+		xb += chunk;
+		size -= chunk;
+	}
+}
+
+static void gr2d_fill(struct dummy_gr2d *gr2d)
+{
+	uint32_t controlmain = gr2d->regs[GR2D_CONTROLMAIN];
+	unsigned int bpp = gr2d_bytes_per_pixel(controlmain);
+	unsigned int width = gr2d->regs[GR2D_DSTSIZE] & 0xffff;
+	unsigned int height = gr2d->regs[GR2D_DSTSIZE] >> 16;
+	unsigned int dx = gr2d->regs[GR2D_DSTPS] & 0xffff;
+	unsigned int dy = gr2d->regs[GR2D_DSTPS] >> 16;
+	uint32_t color = gr2d->regs[GR2D_SRCFGC];
+	struct gr2d_surface dst;
+	unsigned int xb, chunk, size, y;
+	uint32_t pattern;
+
+	gr2d_surface_init(&dst, gr2d->addrs[GR2D_DSTBA],
+			  gr2d->regs[GR2D_DSTST],
+			  gr2d->regs[GR2D_TILEMODE] & GR2D_TILEMODE_DST_TILED);
+
+	if (!dst.base) {
+		host1x_error("Fill destination isn't relocated\n");
+		return;
+	}
+
+	switch (bpp) {
+	case 1:
+		pattern = (color & 0xff) * 0x01010101;
+		break;
+	case 2:
+		pattern = (color & 0xffff) * 0x00010001;
+		break;
+	default:
+		pattern = color;
+		break;
+	}
+
+	for (y = dy; y < dy + height; y++) {
+		if (!dst.tiled) {
+			gr2d_fill_bytes(gr2d_address(&dst, dx * bpp, y),
+					pattern, width * bpp);
+			continue;
+		}
+
+		for (xb = dx * bpp, size = width * bpp; size; size -= chunk) {
+			chunk = gr2d_chunk(&dst, xb, size);
+			gr2d_fill_bytes(gr2d_address(&dst, xb, y), pattern,
+					chunk);
+			xb += chunk;
+		}
+	}
+}
+
+static void gr2d_copy(struct dummy_gr2d *gr2d)
+{
+	uint32_t controlmain = gr2d->regs[GR2D_CONTROLMAIN];
+	uint32_t tilemode = gr2d->regs[GR2D_TILEMODE];
+	unsigned int bpp = gr2d_bytes_per_pixel(controlmain);
+	unsigned int width = gr2d->regs[GR2D_DSTSIZE] & 0xffff;
+	unsigned int height = gr2d->regs[GR2D_DSTSIZE] >> 16;
+	unsigned int sx = gr2d->regs[GR2D_SRCPS] & 0xffff;
+	unsigned int sy = gr2d->regs[GR2D_SRCPS] >> 16;
+	unsigned int dx = gr2d->regs[GR2D_DSTPS] & 0xffff;
+	unsigned int dy = gr2d->regs[GR2D_DSTPS] >> 16;
+	bool xdir = !!(controlmain & GR2D_CONTROLMAIN_XDIR);
+	bool ydir = !!(controlmain & GR2D_CONTROLMAIN_YDIR);
+	bool yflip = !!(controlmain & GR2D_CONTROLMAIN_YFLIP);
+	struct gr2d_surface src, dst;
+	unsigned int size = width * bpp;
+	unsigned int i, src_y, dst_y;
+	uint8_t *row = NULL;
+
+	gr2d_surface_init(&src, gr2d->addrs[GR2D_SRCBA],
+			  gr2d->regs[GR2D_SRCST],
+			  tilemode & GR2D_TILEMODE_SRC_TILED);
+	gr2d_surface_init(&dst, gr2d->addrs[GR2D_DSTBA],
+			  gr2d->regs[GR2D_DSTST],
+			  tilemode & GR2D_TILEMODE_DST_TILED);
+
+	if (!src.base || !dst.base) {
+		host1x_error("Blit surfaces aren't relocated\n");
+		return;
+	}
+
+	/* positions of reversed blits address the last pixel */
+	if (xdir) {
+		sx -= width - 1;
+		dx -= width - 1;
+	}
+
+	if (src.tiled || dst.tiled) {
+		row = malloc(size);
+		if (!row) {
+			host1x_error("Out of memory\n");
+			return;
+		}
+	}
+
+	for (i = 0; i < height; i++) {
+		src_y = ydir ? sy - i : sy + i;
+		dst_y = ydir != yflip ? dy - i : dy + i;
+
+		if (!row) {
+			memmove(gr2d_address(&dst, dx * bpp, dst_y),
+				gr2d_address(&src, sx * bpp, src_y), size);
+			continue;
+		}
+
+		gr2d_read_row(&src, sx * bpp, src_y, row, size);
+		gr2d_write_row(&dst, dx * bpp, dst_y, row, size);
+	}
+
+	free(row);
+}
+
+static inline uint32_t gr2d_lerp_rgba(uint32_t a, uint32_t b, unsigned int w)
+{
+#if defined(DUMMY_GR2D_NEON)
+	uint16x8_t va = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(a)));
+	uint16x8_t vb = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(b)));
+	uint16x8_t sum;
+
+	sum = vmulq_n_u16(va, 256 - w);
+	sum = vmlaq_n_u16(sum, vb, w);
+
+	return vget_lane_u32(vreinterpret_u32_u8(vrshrn_n_u16(sum, 8)), 0);
+#elif defined(DUMMY_GR2D_SSE2)
+	__m128i zero = _mm_setzero_si128();
+	__m128i va = _mm_unpacklo_epi8(_mm_cvtsi32_si128(a), zero);
+	__m128i vb = _mm_unpacklo_epi8(_mm_cvtsi32_si128(b), zero);
+	__m128i sum;
+
+	sum = _mm_add_epi16(_mm_mullo_epi16(va, _mm_set1_epi16(256 - w)),
+			    _mm_mullo_epi16(vb, _mm_set1_epi16(w)));
+	sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+
+	return _mm_cvtsi128_si32(_mm_packus_epi16(sum, zero));
+#else
+	uint32_t result = 0;
+	unsigned int i, ca, cb;
+
+	for (i = 0; i < 32; i += 8) {
+		ca = (a >> i) & 0xff;
+		cb = (b >> i) & 0xff;
+		result |= ((ca * (256 - w) + cb * w + 128) >> 8) << i;
+	}
+
+	return result;
+#endif
+}
+
+static inline uint32_t gr2d_fetch_rgba(const struct gr2d_surface *surf,
+				       unsigned int x, unsigned int y)
+{
+	uint32_t pixel;
+
+	memcpy(&pixel, gr2d_address(surf, x * 4, y), 4);
+
+	return pixel;
+}
+
+static void gr2d_surface_blit(struct dummy_gr2d *gr2d)
+{
+	uint32_t controlmain = gr2d->regs[GR2D_CONTROLMAIN];
+	uint32_t controlsb = gr2d->regs[GR2D_CONTROLSB];
+	uint32_t tilemode = gr2d->regs[GR2D_TILEMODE];
+	uint32_t sbformat = gr2d->regs[GR2D_SBFORMAT];
+	bool yflip = !!(controlmain & GR2D_CONTROLMAIN_YFLIP);
+	bool vfen = !!(controlsb & GR2D_CONTROLSB_VFEN);
+	bool hfen = ((controlsb >> 20) & 0x7) != GR2D_HFTYPE_NONE;
+	/* heights are programmed minus one, minus two with vertical filter */
+	unsigned int src_width = gr2d->regs[GR2D_SRCSIZE] & 0xffff;
+	unsigned int src_height = (gr2d->regs[GR2D_SRCSIZE] >> 16) + 1 + vfen;
+	unsigned int dst_width = gr2d->regs[GR2D_DSTSIZE] & 0xffff;
+	unsigned int dst_height = (gr2d->regs[GR2D_DSTSIZE] >> 16) + 1 + vfen;
+	uint32_t hdda = gr2d->regs[GR2D_HDDA] & 0x3ffff;
+	uint32_t vdda = gr2d->regs[GR2D_VDDA] & 0x3ffff;
+	uint32_t hini = (gr2d->regs[GR2D_HDDAINILS] & 0xff) << 4;
+	uint32_t vini = (gr2d->regs[GR2D_VDDAINI] & 0xff) << 4;
+	bool swap_rb = (sbformat & 0xff) != ((sbformat >> 8) & 0xff);
+	struct gr2d_surface src, dst;
+	unsigned int x, y, x0, x1, y0, y1, fx, fy;
+	uint32_t sxf, syf, top, bottom, pixel;
+
+	gr2d_surface_init(&src, gr2d->addrs[GR2D_SRCBA] ?:
+				gr2d->addrs[GR2D_SRCBA_SB_SURFBASE],
+			  gr2d->regs[GR2D_SRCST],
+			  tilemode & GR2D_TILEMODE_SRC_TILED);
+	gr2d_surface_init(&dst, gr2d->addrs[GR2D_DSTBA] ?:
+				gr2d->addrs[GR2D_DSTBA_SB_SURFBASE],
+			  gr2d->regs[GR2D_DSTST],
+			  tilemode & GR2D_TILEMODE_DST_TILED);
+
+	if (!src.base || !dst.base) {
+		host1x_error("Surface blit surfaces aren't relocated\n");
+		return;
+	}
+
+	if (!src_width || !dst_width)
+		return;
+
+	/*
+	 * A flipped destination is based at its programmed height, which
+	 * with the vertical filter is one line short of the last line.
+	 */
+	for (y = 0; y < dst_height; y++) {
+		syf = vini + y * vdda;
+		y0 = MIN(syf >> 12, src_height - 1);
+		y1 = MIN(y0 + 1, src_height - 1);
+		fy = vfen ? (syf & 0xfff) >> 4 : 0;
+
+		for (x = 0; x < dst_width; x++) {
+			sxf = hini + x * hdda;
+			x0 = MIN(sxf >> 12, src_width - 1);
+			x1 = MIN(x0 + 1, src_width - 1);
+			fx = hfen ? (sxf & 0xfff) >> 4 : 0;
+
+			top = gr2d_fetch_rgba(&src, x0, y0);
+			if (fx)
+				top = gr2d_lerp_rgba(top,
+						gr2d_fetch_rgba(&src, x1, y0),
+						fx);
+
+			if (fy) {
+				bottom = gr2d_fetch_rgba(&src, x0, y1);
+				if (fx)
+					bottom = gr2d_lerp_rgba(bottom,
+						gr2d_fetch_rgba(&src, x1, y1),
+						fx);
+
+				pixel = gr2d_lerp_rgba(top, bottom, fy);
+			} else {
+				pixel = top;
+			}
+
+			if (swap_rb)
+				pixel = (pixel & 0xff00ff00) |
+					(pixel >> 16 & 0xff) |
+					(pixel & 0xff) << 16;
+
+			memcpy(gr2d_address(&dst, x * 4,
+					    yflip ? vfen - (int)y : (int)y),
+			       &pixel, 4);
+		}
+	}
+}
+
+static void gr2d_execute(struct dummy_gr2d *gr2d)
+{
+	uint32_t controlmain = gr2d->regs[GR2D_CONTROLMAIN];
+
+	if (gr2d->regs[GR2D_CMDSEL] & GR2D_CMDSEL_SBOR2D) {
+		gr2d_surface_blit(gr2d);
+		return;
+	}
+
+	if (controlmain & GR2D_CONTROLMAIN_SRCSLD) {
+		gr2d_fill(gr2d);
+		return;
+	}
+
+	gr2d_copy(gr2d);
+}
+
+void dummy_gr2d_write(struct dummy_gr2d *gr2d, unsigned int offset,
+		      uint32_t value, uint8_t *addr)
+{
+	if (offset >= DUMMY_GR2D_NUM_REGS)
+		return;
+
+	gr2d->regs[offset] = value;
+	gr2d->addrs[offset] = addr;
+
+	/* the operation fires once the trigger register gets written */
+	if (offset != GR2D_TRIGGER && offset &&
+	    offset == (gr2d->regs[GR2D_TRIGGER] & 0xfff))
+		gr2d_execute(gr2d);
+}
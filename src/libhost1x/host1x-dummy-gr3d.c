@@ -0,0 +1,1231 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Software reference implementation of the GR3D engine. Captures program
+ * and constant uploads, and on DRAW_PRIMITIVES runs the vertex fetch, the
+ * vertex processor, the linker, triangle setup with rasterization, the
+ * per-fragment depth / stencil tests and the fragment program into the
+ * render target buffers.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host1x-dummy.h"
+#include "tgr_3d.xml.h"
+
+#include "../libgrate/linker_asm.h"
+
+#define GR3D_VAL(reg, field, value) \
+	(((value) & TGR3D_ ## reg ## _ ## field ## __MASK) >> \
+		    TGR3D_ ## reg ## _ ## field ## __SHIFT)
+
+#define GR3D_TRAM_ROWS		64
+#define GR3D_NUM_LINKS		32
+#define GR3D_MAX_COORD		4096
+#define GR3D_CLIP_VERTICES	4
+
+struct gr3d_vertex {
+	float exports[DUMMY_VPE_NUM_EXPORTS][4];
+
+	/* window coordinates, valid once the vertex is linked */
+	float x, y, z, inv_w;
+	bool linked;
+
+	uint32_t tram[GR3D_TRAM_ROWS][4];
+};
+
+struct gr3d_fragment {
+	unsigned int x, y;
+	float z;
+	float weights[3];
+};
+
+struct gr3d_prim {
+	const struct gr3d_vertex *v[3];
+	unsigned int provoking;
+	bool front;
+};
+
+struct gr3d_rt {
+	uint8_t *base;
+	unsigned int format;
+	unsigned int pitch;
+	unsigned int bpp;
+	bool tiled;
+
+	/* extent covered by the pitch and the backing BO */
+	unsigned int width;
+	unsigned int height;
+};
+
+struct gr3d_draw {
+	struct dummy_gr3d *gr3d;
+
+	struct gr3d_rt rts[16];
+	uint32_t color_mask;
+	bool depth_test;
+	bool stencil_test;
+
+	/* scissor intersected with the render targets, max is exclusive */
+	unsigned int scissor[4];
+};
+
+static inline float gr3d_float(const struct dummy_gr3d *gr3d,
+			       unsigned int offset)
+{
+	union {
+		uint32_t u;
+		float f;
+	} value = { .u = gr3d->regs[offset] };
+
+	return value.f;
+}
+
+static unsigned int gr3d_format_bpp(unsigned int format)
+{
+	switch (format) {
+	case TGR3D_PIXEL_FORMAT_A8:
+	case TGR3D_PIXEL_FORMAT_L8:
+	case TGR3D_PIXEL_FORMAT_S8:
+		return 1;
+
+	case TGR3D_PIXEL_FORMAT_LA88:
+	case TGR3D_PIXEL_FORMAT_RGB565:
+	case TGR3D_PIXEL_FORMAT_RGBA5551:
+	case TGR3D_PIXEL_FORMAT_RGBA4444:
+	case TGR3D_PIXEL_FORMAT_D16_LINEAR:
+	case TGR3D_PIXEL_FORMAT_D16_NONLINEAR:
+		return 2;
+
+	case TGR3D_PIXEL_FORMAT_RGBA8888:
+	case TGR3D_PIXEL_FORMAT_BGRA8888:
+	case TGR3D_PIXEL_FORMAT_RGBA_FP32:
+		return 4;
+
+	default:
+		return 0;
+	}
+}
+
+static inline uint8_t *gr3d_rt_address(const struct gr3d_rt *rt,
+				       unsigned int x, unsigned int y)
+{
+	unsigned int xb = x * rt->bpp;
+
+	if (!rt->tiled)
+		return rt->base + y * rt->pitch + xb;
+
+	return rt->base + (y / 16) * rt->pitch * 16 + (xb / 16) * 256 +
+	       (y % 16) * 16 + xb % 16;
+}
+
+/* fx10 to unorm8, 1.0 in fx10 (256) maps to 255 */
+static inline unsigned int gr3d_unorm8(int v)
+{
+	v = (v * 255 + 127) >> 8;
+
+	return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+static void gr3d_write_color(const struct gr3d_rt *rt, unsigned int x,
+			     unsigned int y, const int color[4])
+{
+	uint8_t *ptr = gr3d_rt_address(rt, x, y);
+	unsigned int r = gr3d_unorm8(color[0]);
+	unsigned int g = gr3d_unorm8(color[1]);
+	unsigned int b = gr3d_unorm8(color[2]);
+	unsigned int a = gr3d_unorm8(color[3]);
+	uint16_t v16;
+	uint32_t v32;
+	float f;
+
+	switch (rt->format) {
+	case TGR3D_PIXEL_FORMAT_A8:
+		*ptr = a;
+		break;
+
+	case TGR3D_PIXEL_FORMAT_L8:
+		*ptr = r;
+		break;
+
+	case TGR3D_PIXEL_FORMAT_LA88:
+		v16 = a << 8 | r;
+		memcpy(ptr, &v16, 2);
+		break;
+
+	case TGR3D_PIXEL_FORMAT_RGB565:
+		v16 = (r >> 3) << 11 | (g >> 2) << 5 | b >> 3;
+		memcpy(ptr, &v16, 2);
+		break;
+
+	case TGR3D_PIXEL_FORMAT_RGBA5551:
+		v16 = (r >> 3) << 11 | (g >> 3) << 6 | (b >> 3) << 1 | a >> 7;
+		memcpy(ptr, &v16, 2);
+		break;
+
+	case TGR3D_PIXEL_FORMAT_RGBA4444:
+		v16 = (r >> 4) << 12 | (g >> 4) << 8 | (b >> 4) << 4 | a >> 4;
+		memcpy(ptr, &v16, 2);
+		break;
+
+	case TGR3D_PIXEL_FORMAT_RGBA8888:
+		v32 = a << 24 | b << 16 | g << 8 | r;
+		memcpy(ptr, &v32, 4);
+		break;
+
+	case TGR3D_PIXEL_FORMAT_BGRA8888:
+		v32 = a << 24 | r << 16 | g << 8 | b;
+		memcpy(ptr, &v32, 4);
+		break;
+
+	case TGR3D_PIXEL_FORMAT_RGBA_FP32:
+		f = color[0] / 256.0f;
+		memcpy(ptr, &f, 4);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static bool gr3d_compare(unsigned int func, unsigned int a, unsigned int b)
+{
+	switch (func) {
+	case TGR3D_COMPARE_FUNC_NEVER:
+		return false;
+	case TGR3D_COMPARE_FUNC_LESS:
+		return a < b;
+	case TGR3D_COMPARE_FUNC_EQUAL:
+		return a == b;
+	case TGR3D_COMPARE_FUNC_LEQUAL:
+		return a <= b;
+	case TGR3D_COMPARE_FUNC_GREATER:
+		return a > b;
+	case TGR3D_COMPARE_FUNC_NOTEQUAL:
+		return a != b;
+	case TGR3D_COMPARE_FUNC_GEQUAL:
+		return a >= b;
+	default:
+		return true;
+	}
+}
+
+static uint8_t gr3d_stencil_op(unsigned int op, uint8_t value, uint8_t ref)
+{
+	switch (op) {
+	case TGR3D_STENCIL_OP_ZERO:
+		return 0;
+	case TGR3D_STENCIL_OP_REPLACE:
+		return ref;
+	case TGR3D_STENCIL_OP_INCR:
+		return value == 0xff ? value : value + 1;
+	case TGR3D_STENCIL_OP_DECR:
+		return value == 0x00 ? value : value - 1;
+	case TGR3D_STENCIL_OP_INVERT:
+		return ~value;
+	case TGR3D_STENCIL_OP_INCR_WRAP:
+		return value + 1;
+	case TGR3D_STENCIL_OP_DECR_WRAP:
+		return value - 1;
+	case TGR3D_STENCIL_OP_KEEP:
+	default:
+		return value;
+	}
+}
+
+static void gr3d_upload(struct dummy_gr3d *gr3d, unsigned int offset,
+			uint32_t value)
+{
+	struct dummy_fp *fp = &gr3d->fp;
+	unsigned int i;
+
+	switch (offset) {
+	case TGR3D_VP_UPLOAD_INST_ID:
+		gr3d->vpe_inst_id = value * 4;
+		break;
+
+	case TGR3D_VP_UPLOAD_INST:
+		/* instruction words are uploaded starting with part3 */
+		i = gr3d->vpe_inst_id++ % (DUMMY_VPE_NUM_INSTRUCTIONS * 4);
+		gr3d->vpe.decoded = false;
+		switch (i % 4) {
+		case 0:
+			gr3d->vpe.instructions[i / 4].part3 = value;
+			break;
+		case 1:
+			gr3d->vpe.instructions[i / 4].part2 = value;
+			break;
+		case 2:
+			gr3d->vpe.instructions[i / 4].part1 = value;
+			break;
+		case 3:
+			gr3d->vpe.instructions[i / 4].part0 = value;
+			break;
+		}
+		break;
+
+	case TGR3D_VP_UPLOAD_CONST_ID:
+		gr3d->vpe_const_id = value * 4;
+		break;
+
+	case TGR3D_VP_UPLOAD_CONST:
+		i = gr3d->vpe_const_id++ % (DUMMY_VPE_NUM_CONSTS * 4);
+		gr3d->vpe.consts[i] = value;
+		break;
+
+	case TGR3D_FP_UPLOAD_INST_ID_COMMON:
+		fp->pseq_id = value;
+		fp->mfu_sched_id = value;
+		fp->tex_id = value;
+		fp->alu_sched_id = value;
+		fp->alu_complement_id = value;
+		fp->dw_id = value;
+		break;
+
+	case TGR3D_FP_PSEQ_UPLOAD_INST_ID:
+		fp->pseq_id = value;
+		break;
+
+	case TGR3D_FP_PSEQ_UPLOAD_INST:
+		fp->pseq[fp->pseq_id++ % DUMMY_FP_NUM_INSTRUCTIONS] = value;
+		break;
+
+	case TGR3D_FP_UPLOAD_MFU_SCHED_ID:
+		fp->mfu_sched_id = value;
+		break;
+
+	case TGR3D_FP_UPLOAD_MFU_SCHED:
+		i = fp->mfu_sched_id++ % DUMMY_FP_NUM_INSTRUCTIONS;
+		fp->mfu_sched[i] = value;
+		break;
+
+	case TGR3D_FP_UPLOAD_MFU_INST_ID:
+		fp->mfu_id = value * 2;
+		break;
+
+	case TGR3D_FP_UPLOAD_MFU_INST:
+		/* part1 goes first */
+		i = fp->mfu_id++ % (DUMMY_FP_NUM_INSTRUCTIONS * 2);
+		fp->mfu[i ^ 1] = value;
+		break;
+
+	case TGR3D_FP_UPLOAD_TEX_INST_ID:
+		fp->tex_id = value;
+		break;
+
+	case TGR3D_FP_UPLOAD_TEX_INST:
+		fp->tex[fp->tex_id++ % DUMMY_FP_NUM_INSTRUCTIONS] = value;
+		break;
+
+	case TGR3D_FP_UPLOAD_ALU_SCHED_ID:
+		fp->alu_sched_id = value;
+		break;
+
+	case TGR3D_FP_UPLOAD_ALU_SCHED:
+		i = fp->alu_sched_id++ % DUMMY_FP_NUM_INSTRUCTIONS;
+		fp->alu_sched[i] = value;
+		break;
+
+	case TGR3D_FP_UPLOAD_ALU_INST_ID:
+		fp->alu_id = value * 8;
+		break;
+
+	case TGR3D_FP_UPLOAD_ALU_INST:
+		/* odd parts go first: part1, part0, part3, part2, ... */
+		i = fp->alu_id++ % (DUMMY_FP_NUM_INSTRUCTIONS * 8);
+		fp->alu[i ^ 1] = value;
+		break;
+
+	case TGR3D_FP_UPLOAD_ALU_INST_COMPLEMENT:
+		i = fp->alu_complement_id++ % DUMMY_FP_NUM_INSTRUCTIONS;
+		fp->alu_complement[i] = value;
+		break;
+
+	case TGR3D_FP_UPLOAD_DW_INST_ID:
+		fp->dw_id = value;
+		break;
+
+	case TGR3D_FP_UPLOAD_DW_INST:
+		fp->dw[fp->dw_id++ % DUMMY_FP_NUM_INSTRUCTIONS] = value;
+		break;
+
+	default:
+		break;
+	}
+}
+
+static float gr3d_half_to_float(uint16_t h)
+{
+	uint32_t sign = (h >> 15) & 0x1;
+	uint32_t exponent = (h >> 10) & 0x1f;
+	uint32_t mantissa = h & 0x3ff;
+	float f;
+
+	if (exponent == 0)
+		f = ldexpf(mantissa, -24);
+	else if (exponent == 0x1f)
+		f = mantissa ? NAN : INFINITY;
+	else
+		f = ldexpf(mantissa | 0x400, exponent - 25);
+
+	return sign ? -f : f;
+}
+
+static void gr3d_fetch_attribute(const uint8_t *ptr, unsigned int type,
+				 unsigned int size, float out[4])
+{
+	unsigned int i;
+	uint32_t u32;
+	uint16_t u16;
+
+	out[0] = out[1] = out[2] = 0.0f;
+	out[3] = 1.0f;
+
+	for (i = 0; i < size && i < 4; i++) {
+		switch (type) {
+		case TGR3D_ATTRIB_TYPE_UBYTE:
+			out[i] = ptr[i];
+			break;
+		case TGR3D_ATTRIB_TYPE_UBYTE_NORM:
+			out[i] = ptr[i] / 255.0f;
+			break;
+		case TGR3D_ATTRIB_TYPE_SBYTE:
+			out[i] = (int8_t)ptr[i];
+			break;
+		case TGR3D_ATTRIB_TYPE_SBYTE_NORM:
+			out[i] = fmaxf((int8_t)ptr[i] / 127.0f, -1.0f);
+			break;
+		case TGR3D_ATTRIB_TYPE_USHORT:
+		case TGR3D_ATTRIB_TYPE_USHORT_NORM:
+			memcpy(&u16, ptr + i * 2, 2);
+			out[i] = u16;
+			if (type == TGR3D_ATTRIB_TYPE_USHORT_NORM)
+				out[i] /= 65535.0f;
+			break;
+		case TGR3D_ATTRIB_TYPE_SSHORT:
+		case TGR3D_ATTRIB_TYPE_SSHORT_NORM:
+			memcpy(&u16, ptr + i * 2, 2);
+			out[i] = (int16_t)u16;
+			if (type == TGR3D_ATTRIB_TYPE_SSHORT_NORM)
+				out[i] = fmaxf(out[i] / 32767.0f, -1.0f);
+			break;
+		case TGR3D_ATTRIB_TYPE_UINT:
+		case TGR3D_ATTRIB_TYPE_UINT_NORM:
+			memcpy(&u32, ptr + i * 4, 4);
+			out[i] = u32;
+			if (type == TGR3D_ATTRIB_TYPE_UINT_NORM)
+				out[i] /= 4294967295.0f;
+			break;
+		case TGR3D_ATTRIB_TYPE_SINT:
+		case TGR3D_ATTRIB_TYPE_SINT_NORM:
+			memcpy(&u32, ptr + i * 4, 4);
+			out[i] = (int32_t)u32;
+			if (type == TGR3D_ATTRIB_TYPE_SINT_NORM)
+				out[i] = fmaxf(out[i] / 2147483647.0f, -1.0f);
+			break;
+		case TGR3D_ATTRIB_TYPE_FIXED16:
+			memcpy(&u32, ptr + i * 4, 4);
+			out[i] = (int32_t)u32 / 65536.0f;
+			break;
+		case TGR3D_ATTRIB_TYPE_FLOAT32:
+			memcpy(&out[i], ptr + i * 4, 4);
+			break;
+		case TGR3D_ATTRIB_TYPE_FLOAT16:
+			memcpy(&u16, ptr + i * 2, 2);
+			out[i] = gr3d_half_to_float(u16);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static void gr3d_fetch_vertex(struct dummy_gr3d *gr3d, unsigned int index,
+			      float attribs[DUMMY_VPE_NUM_ATTRIBS][4])
+{
+	uint32_t in_mask = gr3d->regs[TGR3D_VP_ATTRIB_IN_OUT_SELECT] >> 16;
+	uint32_t mode;
+	unsigned int i;
+	uint8_t *ptr;
+
+	for (i = 0; i < DUMMY_VPE_NUM_ATTRIBS; i++) {
+		ptr = gr3d->addrs[TGR3D_ATTRIB_PTR(i)];
+
+		if (!(in_mask & BIT(i)) || !ptr) {
+			attribs[i][0] = attribs[i][1] = attribs[i][2] = 0.0f;
+			attribs[i][3] = 1.0f;
+			continue;
+		}
+
+		mode = gr3d->regs[TGR3D_ATTRIB_MODE(i)];
+
+		gr3d_fetch_attribute(ptr + index * GR3D_VAL(ATTRIB_MODE, STRIDE,
+							    mode),
+				     GR3D_VAL(ATTRIB_MODE, TYPE, mode),
+				     GR3D_VAL(ATTRIB_MODE, SIZE, mode),
+				     attribs[i]);
+	}
+}
+
+/* every vertex in the index range is shaded exactly once */
+static int gr3d_shade_vertices(struct dummy_gr3d *gr3d, unsigned int first,
+			       unsigned int count,
+			       struct gr3d_vertex *vertices)
+{
+	float (*attribs)[DUMMY_VPE_NUM_ATTRIBS][4];
+	float (*exports)[DUMMY_VPE_NUM_EXPORTS][4];
+	unsigned int i;
+
+	attribs = malloc(sizeof(*attribs) * count);
+	exports = calloc(count, sizeof(*exports));
+	if (!attribs || !exports) {
+		free(attribs);
+		free(exports);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < count; i++)
+		gr3d_fetch_vertex(gr3d, first + i, attribs[i]);
+
+	dummy_vpe_execute(&gr3d->vpe, count, attribs, exports);
+
+	for (i = 0; i < count; i++) {
+		memcpy(vertices[i].exports, exports[i],
+		       sizeof(vertices[i].exports));
+		vertices[i].linked = false;
+	}
+
+	free(attribs);
+	free(exports);
+
+	return 0;
+}
+
+/*
+ * Runs the linker program over the vertex exports, filling the TRAM rows
+ * that the fragment pipeline interpolates, and computes the window
+ * coordinates of the vertex.
+ */
+static void gr3d_link_vertex(struct gr3d_draw *draw, struct gr3d_vertex *vtx)
+{
+	struct dummy_gr3d *gr3d = draw->gr3d;
+	uint32_t out_mask = gr3d->regs[TGR3D_VP_ATTRIB_IN_OUT_SELECT] & 0xffff;
+	uint32_t setup = gr3d->regs[TGR3D_CULL_FACE_LINKER_SETUP];
+	unsigned int count = GR3D_VAL(CULL_FACE_LINKER_SETUP,
+				      LINKER_INST_COUNT, setup) + 1;
+	unsigned int exports[DUMMY_VPE_NUM_EXPORTS];
+	unsigned int num_exports = 0;
+	const float *pos = vtx->exports[0];
+	unsigned int i, c, types[4], swizzle[4];
+	link_instr link;
+	uint32_t *row;
+	float v, w;
+
+	/* exports are addressed by the linker in the order they are enabled */
+	for (i = 0; i < DUMMY_VPE_NUM_EXPORTS; i++)
+		if (out_mask & BIT(i))
+			exports[num_exports++] = i;
+
+	for (i = 0; i < count && i < GR3D_NUM_LINKS; i++) {
+		link.first = gr3d->regs[TGR3D_LINKER_INSTRUCTION(i)];
+		link.latter = gr3d->regs[TGR3D_LINKER_INSTRUCTION(i) + 1];
+
+		if (link.vertex_export_index >= num_exports)
+			continue;
+
+		types[0] = link.tram_dst_type_x;
+		types[1] = link.tram_dst_type_y;
+		types[2] = link.tram_dst_type_z;
+		types[3] = link.tram_dst_type_w;
+
+		swizzle[0] = link.tram_dst_swizzle_x;
+		swizzle[1] = link.tram_dst_swizzle_y;
+		swizzle[2] = link.tram_dst_swizzle_z;
+		swizzle[3] = link.tram_dst_swizzle_w;
+
+		row = vtx->tram[link.tram_row_index];
+
+		for (c = 0; c < 4; c++) {
+			v = vtx->exports[exports[link.vertex_export_index]]
+					[swizzle[c]];
+
+			switch (types[c]) {
+			case TRAM_DST_FX10_LOW:
+				row[c] &= ~0x3ff;
+				row[c] |= dummy_float_to_fx10(v);
+				break;
+			case TRAM_DST_FX10_HIGH:
+				row[c] &= 0x3ff;
+				row[c] |= dummy_float_to_fx10(v) << 10;
+				break;
+			case TRAM_DST_FP20:
+				row[c] = dummy_float_to_fp20(v);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	w = pos[3];
+
+	/* viewport X/Y are in 1/16 pixel units, snap to the sub-pixel grid */
+	vtx->x = roundf(pos[0] / w * gr3d_float(gr3d, TGR3D_VIEWPORT_X_SCALE) +
+			gr3d_float(gr3d, TGR3D_VIEWPORT_X_BIAS)) / 16.0f;
+	vtx->y = roundf(pos[1] / w * gr3d_float(gr3d, TGR3D_VIEWPORT_Y_SCALE) +
+			gr3d_float(gr3d, TGR3D_VIEWPORT_Y_BIAS)) / 16.0f;
+	vtx->z = pos[2] / w * gr3d_float(gr3d, TGR3D_VIEWPORT_Z_SCALE) +
+		 gr3d_float(gr3d, TGR3D_VIEWPORT_Z_BIAS);
+	vtx->inv_w = 1.0f / w;
+	vtx->linked = true;
+}
+
+/* runs the fragment program, returns false if it killed the fragment */
+static bool gr3d_shade_fragment(struct gr3d_draw *draw,
+				const struct gr3d_prim *prim,
+				const struct gr3d_fragment *frag,
+				struct dummy_fp_fragment *out)
+{
+	unsigned int i;
+
+	for (i = 0; i < 3; i++) {
+		out->tram[i] = (const uint32_t (*)[4])prim->v[i]->tram;
+		out->weights[i] = frag->weights[i];
+		out->inv_w[i] = prim->v[i]->inv_w;
+	}
+
+	out->x = frag->x;
+	out->y = frag->y;
+	out->front = prim->front;
+
+	return dummy_fp_execute(draw->gr3d, out);
+}
+
+static void gr3d_process_fragment(struct gr3d_draw *draw,
+				  const struct gr3d_prim *prim,
+				  const struct gr3d_fragment *frag)
+{
+	struct dummy_gr3d *gr3d = draw->gr3d;
+	uint32_t depth_params = gr3d->regs[TGR3D_DEPTH_TEST_PARAMS];
+	uint32_t stencil1, stencil2;
+	uint8_t *stencil = NULL;
+	uint16_t *depth = NULL;
+	unsigned int func, ref, mask, d = 0, i;
+	struct dummy_fp_fragment out;
+	float near, far, z;
+
+	if (draw->stencil_test) {
+		stencil1 = gr3d->regs[prim->front ? TGR3D_STENCIL_FRONT1 :
+						    TGR3D_STENCIL_BACK1];
+		stencil2 = gr3d->regs[prim->front ? TGR3D_STENCIL_FRONT2 :
+						    TGR3D_STENCIL_BACK2];
+
+		func = GR3D_VAL(STENCIL_FRONT1, FUNC, stencil1);
+		mask = GR3D_VAL(STENCIL_FRONT1, MASK, stencil1);
+		ref = GR3D_VAL(STENCIL_FRONT2, REF, stencil2);
+
+		stencil = gr3d_rt_address(&draw->rts[2], frag->x, frag->y);
+
+		if (!gr3d_compare(func, ref & mask, *stencil & mask)) {
+			*stencil = gr3d_stencil_op(
+				GR3D_VAL(STENCIL_FRONT2, OP_FAIL, stencil2),
+				*stencil, ref);
+			return;
+		}
+	}
+
+	if (draw->depth_test) {
+		near = (gr3d->regs[TGR3D_DEPTH_RANGE_NEAR] & 0xfffff) /
+			(float)0xfffff;
+		far = (gr3d->regs[TGR3D_DEPTH_RANGE_FAR] & 0xfffff) /
+			(float)0xfffff;
+		z = fminf(fmaxf(frag->z, near), far);
+		d = (unsigned int)(z * 0xffff + 0.5f);
+
+		depth = (uint16_t *)gr3d_rt_address(&draw->rts[0],
+						    frag->x, frag->y);
+
+		func = GR3D_VAL(DEPTH_TEST_PARAMS, FUNC, depth_params);
+
+		if (!gr3d_compare(func, d, *depth)) {
+			if (stencil)
+				*stencil = gr3d_stencil_op(
+					GR3D_VAL(STENCIL_FRONT2, OP_ZFAIL,
+						 stencil2),
+					*stencil, ref);
+			return;
+		}
+	}
+
+	if (!gr3d_shade_fragment(draw, prim, frag, &out))
+		return;
+
+	if (stencil)
+		*stencil = gr3d_stencil_op(GR3D_VAL(STENCIL_FRONT2, OP_ZPASS,
+						    stencil2),
+					   *stencil, ref);
+
+	if (depth && (depth_params & TGR3D_DEPTH_TEST_PARAMS_DEPTH_WRITE))
+		*depth = d;
+
+	for (i = 0; i < 16; i++)
+		if (draw->color_mask & out.written & BIT(i))
+			gr3d_write_color(&draw->rts[i], frag->x, frag->y,
+					 out.color[i]);
+}
+
+static inline float gr3d_edge(const struct gr3d_vertex *a,
+			      const struct gr3d_vertex *b, float x, float y)
+{
+	return (b->x - a->x) * (y - a->y) - (b->y - a->y) * (x - a->x);
+}
+
+/* top-left rule: only one of the triangles sharing an edge owns it */
+static inline bool gr3d_edge_owned(const struct gr3d_vertex *a,
+				   const struct gr3d_vertex *b)
+{
+	return b->y > a->y || (b->y == a->y && b->x < a->x);
+}
+
+static void gr3d_rasterize(struct gr3d_draw *draw, struct gr3d_prim *prim)
+{
+	const struct gr3d_vertex *v0 = prim->v[0];
+	const struct gr3d_vertex *v1 = prim->v[1];
+	const struct gr3d_vertex *v2 = prim->v[2];
+	const struct gr3d_vertex *tmp;
+	struct gr3d_fragment frag;
+	float area, w[3], px, py;
+	bool owned[3], swapped = false;
+	int x, y, xmin, xmax, ymin, ymax;
+
+	area = gr3d_edge(v0, v1, v2->x, v2->y);
+	if (area == 0.0f || isnan(area))
+		return;
+
+	if (area < 0.0f) {
+		tmp = v1;
+		v1 = v2;
+		v2 = tmp;
+		area = -area;
+		swapped = true;
+	}
+
+	owned[0] = gr3d_edge_owned(v1, v2);
+	owned[1] = gr3d_edge_owned(v2, v0);
+	owned[2] = gr3d_edge_owned(v0, v1);
+
+	xmin = floorf(fminf(v0->x, fminf(v1->x, v2->x)));
+	xmax = ceilf(fmaxf(v0->x, fmaxf(v1->x, v2->x)));
+	ymin = floorf(fminf(v0->y, fminf(v1->y, v2->y)));
+	ymax = ceilf(fmaxf(v0->y, fmaxf(v1->y, v2->y)));
+
+	xmin = xmin > (int)draw->scissor[0] ? xmin : (int)draw->scissor[0];
+	xmax = xmax < (int)draw->scissor[1] ? xmax : (int)draw->scissor[1];
+	ymin = ymin > (int)draw->scissor[2] ? ymin : (int)draw->scissor[2];
+	ymax = ymax < (int)draw->scissor[3] ? ymax : (int)draw->scissor[3];
+
+	for (y = ymin; y < ymax; y++) {
+		py = y + 0.5f;
+
+		for (x = xmin; x < xmax; x++) {
+			px = x + 0.5f;
+
+			w[0] = gr3d_edge(v1, v2, px, py);
+			w[1] = gr3d_edge(v2, v0, px, py);
+			w[2] = gr3d_edge(v0, v1, px, py);
+
+			if (w[0] < 0.0f || w[1] < 0.0f || w[2] < 0.0f)
+				continue;
+
+			if ((w[0] == 0.0f && !owned[0]) ||
+			    (w[1] == 0.0f && !owned[1]) ||
+			    (w[2] == 0.0f && !owned[2]))
+				continue;
+
+			w[0] /= area;
+			w[1] /= area;
+			w[2] /= area;
+
+			frag.x = x;
+			frag.y = y;
+			frag.z = w[0] * v0->z + w[1] * v1->z + w[2] * v2->z;
+			frag.weights[0] = w[0];
+			frag.weights[1] = w[swapped ? 2 : 1];
+			frag.weights[2] = w[swapped ? 1 : 2];
+
+			gr3d_process_fragment(draw, prim, &frag);
+		}
+	}
+}
+
+static bool gr3d_culled(struct gr3d_draw *draw, struct gr3d_prim *prim)
+{
+	uint32_t setup = draw->gr3d->regs[TGR3D_CULL_FACE_LINKER_SETUP];
+	unsigned int cull = GR3D_VAL(CULL_FACE_LINKER_SETUP, CULL_FACE, setup);
+	bool front_cw = !!(setup & TGR3D_CULL_FACE_LINKER_SETUP_FRONT_CW);
+	float area;
+	bool ccw;
+
+	area = gr3d_edge(prim->v[0], prim->v[1], prim->v[2]->x,
+			 prim->v[2]->y);
+	ccw = area > 0.0f;
+
+	prim->front = ccw != front_cw;
+
+	switch (cull) {
+	case TGR3D_CULL_FACE_CCW:
+		return ccw;
+	case TGR3D_CULL_FACE_CW:
+		return !ccw;
+	case TGR3D_CULL_FACE_BOTH:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void gr3d_lerp_vertex(struct gr3d_vertex *dst,
+			     const struct gr3d_vertex *a,
+			     const struct gr3d_vertex *b, float t)
+{
+	unsigned int i, c;
+
+	for (i = 0; i < DUMMY_VPE_NUM_EXPORTS; i++)
+		for (c = 0; c < 4; c++)
+			dst->exports[i][c] = a->exports[i][c] +
+				t * (b->exports[i][c] - a->exports[i][c]);
+
+	dst->linked = false;
+}
+
+/*
+ * Clips the triangle against the near plane (z >= -w), everything else is
+ * handled by the guardband and the scissor.
+ */
+static void gr3d_draw_triangle(struct gr3d_draw *draw,
+			       struct gr3d_vertex *v0,
+			       struct gr3d_vertex *v1,
+			       struct gr3d_vertex *v2,
+			       unsigned int provoking)
+{
+	struct gr3d_vertex *in[3] = { v0, v1, v2 };
+	struct gr3d_vertex *out[GR3D_CLIP_VERTICES];
+	struct gr3d_vertex *clipped = NULL;
+	unsigned int i, n = 0, num_clipped = 0;
+	struct gr3d_prim prim;
+	float d[3];
+
+	for (i = 0; i < 3; i++)
+		d[i] = in[i]->exports[0][2] + in[i]->exports[0][3];
+
+	if (d[0] < 0.0f && d[1] < 0.0f && d[2] < 0.0f)
+		return;
+
+	if (d[0] >= 0.0f && d[1] >= 0.0f && d[2] >= 0.0f) {
+		memcpy(out, in, sizeof(in));
+		n = 3;
+	} else {
+		clipped = malloc(sizeof(*clipped) * 2);
+		if (!clipped)
+			return;
+
+		for (i = 0; i < 3; i++) {
+			unsigned int j = (i + 1) % 3;
+
+			if (d[i] >= 0.0f)
+				out[n++] = in[i];
+
+			if ((d[i] >= 0.0f) != (d[j] >= 0.0f)) {
+				gr3d_lerp_vertex(&clipped[num_clipped], in[i],
+						 in[j], d[i] / (d[i] - d[j]));
+				out[n++] = &clipped[num_clipped++];
+			}
+		}
+	}
+
+	for (i = 0; i < n; i++)
+		if (!out[i]->linked)
+			gr3d_link_vertex(draw, out[i]);
+
+	for (i = 1; i + 1 < n; i++) {
+		prim.v[0] = out[0];
+		prim.v[1] = out[i];
+		prim.v[2] = out[i + 1];
+		prim.provoking = provoking;
+
+		if (!gr3d_culled(draw, &prim))
+			gr3d_rasterize(draw, &prim);
+	}
+
+	free(clipped);
+}
+
+/*
+ * Points and lines are rasterized as screen aligned quads made of two
+ * triangles whose corners share the TRAM data of the original vertices.
+ */
+static void gr3d_draw_quad(struct gr3d_draw *draw,
+			   struct gr3d_vertex *corners[4],
+			   const float x[4], const float y[4])
+{
+	struct gr3d_vertex quad[4];
+	struct gr3d_prim prim;
+	unsigned int i;
+
+	for (i = 0; i < 4; i++) {
+		if (!corners[i]->linked)
+			gr3d_link_vertex(draw, corners[i]);
+
+		memcpy(&quad[i], corners[i], sizeof(quad[i]));
+		quad[i].x = x[i];
+		quad[i].y = y[i];
+	}
+
+	prim.front = true;
+	prim.provoking = 0;
+
+	prim.v[0] = &quad[0];
+	prim.v[1] = &quad[1];
+	prim.v[2] = &quad[2];
+	gr3d_rasterize(draw, &prim);
+
+	prim.v[0] = &quad[2];
+	prim.v[1] = &quad[1];
+	prim.v[2] = &quad[3];
+	gr3d_rasterize(draw, &prim);
+}
+
+static void gr3d_draw_point(struct gr3d_draw *draw, struct gr3d_vertex *v)
+{
+	float size = gr3d_float(draw->gr3d, TGR3D_POINT_SIZE) / 2.0f;
+	struct gr3d_vertex *corners[4] = { v, v, v, v };
+	float x[4], y[4];
+
+	if (!v->linked)
+		gr3d_link_vertex(draw, v);
+
+	x[0] = x[2] = v->x - size;
+	x[1] = x[3] = v->x + size;
+	y[0] = y[1] = v->y - size;
+	y[2] = y[3] = v->y + size;
+
+	gr3d_draw_quad(draw, corners, x, y);
+}
+
+static void gr3d_draw_line(struct gr3d_draw *draw, struct gr3d_vertex *a,
+			   struct gr3d_vertex *b)
+{
+	float width = gr3d_float(draw->gr3d, TGR3D_HALF_LINE_WIDTH);
+	struct gr3d_vertex *corners[4] = { a, b, a, b };
+	float x[4], y[4], dx, dy, len;
+
+	if (!a->linked)
+		gr3d_link_vertex(draw, a);
+	if (!b->linked)
+		gr3d_link_vertex(draw, b);
+
+	dx = b->x - a->x;
+	dy = b->y - a->y;
+	len = sqrtf(dx * dx + dy * dy);
+	if (len == 0.0f)
+		return;
+
+	dx = dx / len * width;
+	dy = dy / len * width;
+
+	x[0] = a->x - dy;
+	y[0] = a->y + dx;
+	x[1] = b->x - dy;
+	y[1] = b->y + dx;
+	x[2] = a->x + dy;
+	y[2] = a->y - dx;
+	x[3] = b->x + dy;
+	y[3] = b->y - dx;
+
+	gr3d_draw_quad(draw, corners, x, y);
+}
+
+static void gr3d_rt_bounds(struct gr3d_rt *rt)
+{
+	size_t size = dummy_bo_remaining(rt->base);
+
+	rt->width = rt->pitch / rt->bpp;
+	rt->height = 0;
+
+	if (!rt->pitch)
+		return;
+
+	/* tiled targets are only addressable in whole rows of tiles */
+	if (rt->tiled)
+		rt->height = size / (rt->pitch * 16) * 16;
+	else
+		rt->height = size / rt->pitch;
+
+	if (rt->height > GR3D_MAX_COORD)
+		rt->height = GR3D_MAX_COORD;
+}
+
+static void gr3d_setup_render_targets(struct gr3d_draw *draw)
+{
+	struct dummy_gr3d *gr3d = draw->gr3d;
+	uint32_t enable = gr3d->regs[TGR3D_RT_ENABLE];
+	uint32_t params, used;
+	unsigned int i;
+
+	for (i = 0; i < 16; i++) {
+		struct gr3d_rt *rt = &draw->rts[i];
+
+		params = gr3d->regs[TGR3D_RT_PARAMS(i)];
+
+		rt->base = gr3d->addrs[TGR3D_RT_PTR(i)];
+		rt->format = GR3D_VAL(RT_PARAMS, FORMAT, params);
+		rt->pitch = GR3D_VAL(RT_PARAMS, PITCH, params);
+		rt->tiled = !!(params & TGR3D_RT_PARAMS_TILED);
+		rt->bpp = gr3d_format_bpp(rt->format);
+
+		if (!(enable & BIT(i)) || !rt->base || !rt->bpp)
+			continue;
+
+		switch (rt->format) {
+		case TGR3D_PIXEL_FORMAT_D16_LINEAR:
+		case TGR3D_PIXEL_FORMAT_D16_NONLINEAR:
+		case TGR3D_PIXEL_FORMAT_S8:
+			break;
+		default:
+			draw->color_mask |= BIT(i);
+			break;
+		}
+	}
+
+	draw->depth_test =
+		(gr3d->regs[TGR3D_DEPTH_TEST_PARAMS] &
+		 TGR3D_DEPTH_TEST_PARAMS_DEPTH_TEST) &&
+		(enable & TGR3D_RT_ENABLE_DEPTH_BUFFER) &&
+		draw->rts[0].base && draw->rts[0].bpp == 2;
+
+	draw->stencil_test =
+		(gr3d->regs[TGR3D_STENCIL_PARAMS] &
+		 TGR3D_STENCIL_PARAMS_STENCIL_TEST) &&
+		draw->rts[2].base &&
+		draw->rts[2].format == TGR3D_PIXEL_FORMAT_S8;
+
+	if (draw->depth_test)
+		draw->color_mask &= ~BIT(0);
+
+	if (draw->stencil_test)
+		draw->color_mask &= ~BIT(2);
+
+	used = draw->color_mask;
+	if (draw->depth_test)
+		used |= BIT(0);
+	if (draw->stencil_test)
+		used |= BIT(2);
+
+	/*
+	 * The RT state has no size, so the pitch bounds the width and the
+	 * BO behind the relocation bounds the height, which keeps fragments
+	 * of oversized scissors and primitives within the targets.
+	 */
+	for (i = 0; i < 16; i++) {
+		struct gr3d_rt *rt = &draw->rts[i];
+
+		if (!(used & BIT(i)))
+			continue;
+
+		gr3d_rt_bounds(rt);
+
+		if (draw->scissor[1] > rt->width)
+			draw->scissor[1] = rt->width;
+
+		if (draw->scissor[3] > rt->height)
+			draw->scissor[3] = rt->height;
+	}
+}
+
+static int gr3d_fetch_indices(struct dummy_gr3d *gr3d, unsigned int *indices,
+			      unsigned int count)
+{
+	uint32_t params = gr3d->regs[TGR3D_DRAW_PARAMS];
+	uint32_t prims = gr3d->regs[TGR3D_DRAW_PRIMITIVES];
+	unsigned int first = GR3D_VAL(DRAW_PARAMS, FIRST, params);
+	unsigned int offset = GR3D_VAL(DRAW_PRIMITIVES, OFFSET, prims);
+	const uint8_t *ptr = gr3d->addrs[TGR3D_INDEX_PTR];
+	unsigned int i;
+	uint16_t u16;
+
+	switch (GR3D_VAL(DRAW_PARAMS, INDEX_MODE, params)) {
+	case TGR3D_INDEX_MODE_NONE:
+		for (i = 0; i < count; i++)
+			indices[i] = first + offset + i;
+		return 0;
+
+	case TGR3D_INDEX_MODE_UINT8:
+		if (!ptr)
+			break;
+		for (i = 0; i < count; i++)
+			indices[i] = first + ptr[offset + i];
+		return 0;
+
+	case TGR3D_INDEX_MODE_UINT16:
+		if (!ptr)
+			break;
+		for (i = 0; i < count; i++) {
+			memcpy(&u16, ptr + (offset + i) * 2, 2);
+			indices[i] = first + u16;
+		}
+		return 0;
+
+	default:
+		break;
+	}
+
+	host1x_error("Invalid index buffer setup\n");
+
+	return -EINVAL;
+}
+
+static void gr3d_draw_primitives(struct dummy_gr3d *gr3d)
+{
+	uint32_t params = gr3d->regs[TGR3D_DRAW_PARAMS];
+	unsigned int count = GR3D_VAL(DRAW_PRIMITIVES, INDEX_COUNT,
+				      gr3d->regs[TGR3D_DRAW_PRIMITIVES]) + 1;
+	unsigned int type = GR3D_VAL(DRAW_PARAMS, PRIMITIVE_TYPE, params);
+	bool last = GR3D_VAL(DRAW_PARAMS, PROVOKING_VERTEX, params);
+	uint32_t horiz = gr3d->regs[TGR3D_SCISSOR_HORIZ];
+	uint32_t vert = gr3d->regs[TGR3D_SCISSOR_VERT];
+	unsigned int *indices, min = ~0u, max = 0, i;
+	struct gr3d_vertex *vertices, **v;
+	struct gr3d_draw draw;
+
+	memset(&draw, 0, sizeof(draw));
+	draw.gr3d = gr3d;
+
+	draw.scissor[0] = GR3D_VAL(SCISSOR_HORIZ, MIN, horiz);
+	draw.scissor[1] = GR3D_VAL(SCISSOR_HORIZ, MAX, horiz);
+	draw.scissor[2] = GR3D_VAL(SCISSOR_VERT, MIN, vert);
+	draw.scissor[3] = GR3D_VAL(SCISSOR_VERT, MAX, vert);
+
+	for (i = 0; i < 4; i++)
+		if (draw.scissor[i] > GR3D_MAX_COORD)
+			draw.scissor[i] = GR3D_MAX_COORD;
+
+	gr3d_setup_render_targets(&draw);
+	dummy_fp_prepare(gr3d);
+
+	indices = malloc(sizeof(*indices) * count);
+	v = malloc(sizeof(*v) * count);
+	if (!indices || !v)
+		goto free_indices;
+
+	if (gr3d_fetch_indices(gr3d, indices, count) < 0)
+		goto free_indices;
+
+	for (i = 0; i < count; i++) {
+		min = indices[i] < min ? indices[i] : min;
+		max = indices[i] > max ? indices[i] : max;
+	}
+
+	vertices = calloc(max - min + 1, sizeof(*vertices));
+	if (!vertices)
+		goto free_indices;
+
+	if (gr3d_shade_vertices(gr3d, min, max - min + 1, vertices) < 0)
+		goto free_vertices;
+
+	for (i = 0; i < count; i++)
+		v[i] = &vertices[indices[i] - min];
+
+	switch (type) {
+	case TGR3D_PRIMITIVE_TYPE_POINTS:
+		for (i = 0; i < count; i++)
+			gr3d_draw_point(&draw, v[i]);
+		break;
+
+	case TGR3D_PRIMITIVE_TYPE_LINES:
+		for (i = 0; i + 1 < count; i += 2)
+			gr3d_draw_line(&draw, v[i], v[i + 1]);
+		break;
+
+	case TGR3D_PRIMITIVE_TYPE_LINE_LOOP:
+	case TGR3D_PRIMITIVE_TYPE_LINE_STRIP:
+		for (i = 0; i + 1 < count; i++)
+			gr3d_draw_line(&draw, v[i], v[i + 1]);
+
+		if (type == TGR3D_PRIMITIVE_TYPE_LINE_LOOP && count > 2)
+			gr3d_draw_line(&draw, v[count - 1], v[0]);
+		break;
+
+	case TGR3D_PRIMITIVE_TYPE_TRIANGLES:
+		for (i = 0; i + 2 < count; i += 3)
+			gr3d_draw_triangle(&draw, v[i], v[i + 1], v[i + 2],
+					   last ? 2 : 0);
+		break;
+
+	case TGR3D_PRIMITIVE_TYPE_TRIANGLE_STRIP:
+		for (i = 0; i + 2 < count; i++) {
+			if (i & 1)
+				gr3d_draw_triangle(&draw, v[i + 1], v[i],
+						   v[i + 2], last ? 2 : 1);
+			else
+				gr3d_draw_triangle(&draw, v[i], v[i + 1],
+						   v[i + 2], last ? 2 : 0);
+		}
+		break;
+
+	case TGR3D_PRIMITIVE_TYPE_TRIANGLE_FAN:
+		for (i = 1; i + 1 < count; i++)
+			gr3d_draw_triangle(&draw, v[0], v[i], v[i + 1],
+					   last ? 2 : 1);
+		break;
+
+	default:
+		host1x_error("Invalid primitive type %u\n", type);
+		break;
+	}
+
+	dummy_fp_report(gr3d);
+
+free_vertices:
+	free(vertices);
+free_indices:
+	free(indices);
+	free(v);
+}
+
+void dummy_gr3d_write(struct dummy_gr3d *gr3d, unsigned int offset,
+		      uint32_t value, uint8_t *addr)
+{
+	if (offset >= DUMMY_GR3D_NUM_REGS)
+		return;
+
+	gr3d->regs[offset] = value;
+	gr3d->addrs[offset] = addr;
+
+	gr3d_upload(gr3d, offset, value);
+
+	if (offset == TGR3D_DRAW_PRIMITIVES)
+		gr3d_draw_primitives(gr3d);
+}
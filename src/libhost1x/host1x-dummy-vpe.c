@@ -0,0 +1,947 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Software implementation of the vertex processor. Every instruction issues
+ * a vector and a scalar operation; both read their operands before either
+ * of them writes its result.
+ *
+ * The program is decoded once into an array of dummy_vpe_op and vertices
+ * are then run through it DUMMY_VPE_BATCH at a time. Registers are laid out
+ * component-major with one slot per vertex ("lane"), so that every
+ * operation is a short loop over the lanes. The arithmetic that dominates
+ * transforms (MUL, ADD, MAD and the dot products) runs four lanes at a time
+ * with SSE2 or NEON, the other operations are left to the compiler. The
+ * SIMD paths multiply and add separately, so they match the scalar path bit
+ * for bit. Lanes may diverge on branches: the batch always issues the
+ * instruction with the lowest program counter among the running lanes,
+ * masked to the lanes that are at it.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DUMMY_VPE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define DUMMY_VPE_SSE2 1
+#endif
+
+#include "host1x-dummy.h"
+
+#define VPE_NUM_TEMPS		64
+#define VPE_NO_REG		63
+#define VPE_NO_EXPORT		31
+#define VPE_STACK_DEPTH		8
+#define VPE_MAX_STEPS		4096
+
+#define B			DUMMY_VPE_BATCH
+
+struct vpe_stack_entry {
+	unsigned int ret;
+	int a0[4];
+};
+
+struct vpe_batch {
+	const struct dummy_vpe *vpe;
+	const float (*attribs)[DUMMY_VPE_NUM_ATTRIBS][4];
+	float (*exports)[DUMMY_VPE_NUM_EXPORTS][4];
+	unsigned int count;
+
+	float r[VPE_NUM_TEMPS][4][B];
+	float cr[2][4][B];
+	int a0[4][B];
+
+	unsigned int pc[B];
+	struct vpe_stack_entry stack[B][VPE_STACK_DEPTH];
+	unsigned int sp[B];
+};
+
+static void vpe_decode_operand(struct dummy_vpe_operand *src,
+			       const vpe_instr128 *ins, unsigned int type,
+			       unsigned int index, unsigned int swizzle_x,
+			       unsigned int swizzle_y, unsigned int swizzle_z,
+			       unsigned int swizzle_w, bool negate,
+			       bool absolute)
+{
+	src->type = type;
+	src->swizzle[0] = swizzle_x;
+	src->swizzle[1] = swizzle_y;
+	src->swizzle[2] = swizzle_z;
+	src->swizzle[3] = swizzle_w;
+	src->negate = negate;
+	src->absolute = absolute;
+
+	switch (type) {
+	case REG_TYPE_ATTRIBUTE:
+		src->index = ins->attribute_fetch_index;
+		src->relative = ins->attribute_relative_addressing_enable;
+		break;
+
+	case REG_TYPE_UNIFORM:
+		src->index = ins->uniform_fetch_index;
+		src->relative = ins->constant_relative_addressing_enable;
+		break;
+
+	default:
+		src->index = index;
+		src->relative = false;
+		break;
+	}
+}
+
+static void vpe_decode_op(struct dummy_vpe_op *op, const vpe_instr128 *ins)
+{
+	memset(op, 0, sizeof(*op));
+
+	vpe_decode_operand(&op->src[0], ins, ins->rA_type, ins->rA_index,
+			   ins->rA_swizzle_x, ins->rA_swizzle_y,
+			   ins->rA_swizzle_z, ins->rA_swizzle_w,
+			   ins->rA_negate, ins->rA_absolute_value);
+	vpe_decode_operand(&op->src[1], ins, ins->rB_type, ins->rB_index,
+			   ins->rB_swizzle_x, ins->rB_swizzle_y,
+			   ins->rB_swizzle_z, ins->rB_swizzle_w,
+			   ins->rB_negate, ins->rB_absolute_value);
+	vpe_decode_operand(&op->src[2], ins, ins->rC_type, ins->rC_index,
+			   ins->rC_swizzle_x, ins->rC_swizzle_y,
+			   ins->rC_swizzle_z, ins->rC_swizzle_w,
+			   ins->rC_negate, ins->rC_absolute_value);
+
+	op->vector_opcode = ins->vector_opcode;
+	op->scalar_opcode = ins->scalar_opcode;
+
+	op->vector_mask  = ins->vector_op_write_x_enable << 0;
+	op->vector_mask |= ins->vector_op_write_y_enable << 1;
+	op->vector_mask |= ins->vector_op_write_z_enable << 2;
+	op->vector_mask |= ins->vector_op_write_w_enable << 3;
+
+	op->scalar_mask  = ins->scalar_op_write_x_enable << 0;
+	op->scalar_mask |= ins->scalar_op_write_y_enable << 1;
+	op->scalar_mask |= ins->scalar_op_write_z_enable << 2;
+	op->scalar_mask |= ins->scalar_op_write_w_enable << 3;
+
+	op->vector_rd = ins->vector_rD_index;
+	op->scalar_rd = ins->scalar_rD_index;
+
+	switch (op->vector_opcode) {
+	case VECTOR_OPCODE_MOV:
+	case VECTOR_OPCODE_FRC:
+	case VECTOR_OPCODE_FLR:
+	case VECTOR_OPCODE_SSG:
+	case VECTOR_OPCODE_ARL:
+	case VECTOR_OPCODE_ARR:
+		op->src_used = BIT(0);
+		break;
+
+	case VECTOR_OPCODE_ADD:
+		op->src_used = BIT(0) | BIT(2);
+		break;
+
+	case VECTOR_OPCODE_MAD:
+		op->src_used = BIT(0) | BIT(1) | BIT(2);
+		break;
+
+	case VECTOR_OPCODE_NOP:
+	case VECTOR_OPCODE_SFL:
+	case VECTOR_OPCODE_STR:
+	case VECTOR_OPCODE_ARA:
+	case VECTOR_OPCODE_TXL:
+	case VECTOR_OPCODE_PUSHA:
+	case VECTOR_OPCODE_POPA:
+		break;
+
+	default:
+		op->src_used = BIT(0) | BIT(1);
+		break;
+	}
+
+	/* unsupported opcodes are reported when they get executed */
+	switch (op->vector_opcode) {
+	case VECTOR_OPCODE_NOP:
+	case VECTOR_OPCODE_ARL:
+	case VECTOR_OPCODE_ARR:
+	case VECTOR_OPCODE_ARA:
+	case VECTOR_OPCODE_TXL:
+	case VECTOR_OPCODE_PUSHA:
+	case VECTOR_OPCODE_POPA:
+		break;
+
+	default:
+		op->vector_result = op->vector_opcode < VECTOR_OPCODE_TXL;
+		break;
+	}
+
+	switch (op->scalar_opcode) {
+	case SCALAR_OPCODE_MOV:
+	case SCALAR_OPCODE_RCP:
+	case SCALAR_OPCODE_RCC:
+	case SCALAR_OPCODE_RSQ:
+	case SCALAR_OPCODE_EXP:
+	case SCALAR_OPCODE_LOG:
+	case SCALAR_OPCODE_LIT:
+	case SCALAR_OPCODE_LG2:
+	case SCALAR_OPCODE_EX2:
+	case SCALAR_OPCODE_SIN:
+	case SCALAR_OPCODE_COS:
+		op->scalar_result = true;
+		op->src_used |= BIT(2);
+		break;
+
+	default:
+		break;
+	}
+
+	op->export_index = ins->export_write_index;
+	op->export_vector = ins->export_vector_write_enable;
+	op->export_relative = ins->export_relative_addressing_enable;
+
+	op->address_register = ins->address_register_select;
+	op->iaddr = ins->iaddr;
+
+	op->predicated = ins->condition_check;
+	op->predicate_swizzle[0] = ins->predicate_swizzle_x;
+	op->predicate_swizzle[1] = ins->predicate_swizzle_y;
+	op->predicate_swizzle[2] = ins->predicate_swizzle_z;
+	op->predicate_swizzle[3] = ins->predicate_swizzle_w;
+	op->predicate_lt = ins->predicate_lt;
+	op->predicate_eq = ins->predicate_eq;
+	op->predicate_gt = ins->predicate_gt;
+
+	op->condition_register = ins->condition_register_index;
+	op->condition_write = ins->condition_flags_write_enable;
+
+	op->saturate = ins->saturate_result;
+	op->end = ins->end_of_program;
+}
+
+void dummy_vpe_decode(struct dummy_vpe *vpe)
+{
+	unsigned int i;
+
+	for (i = 0; i < DUMMY_VPE_NUM_INSTRUCTIONS; i++)
+		vpe_decode_op(&vpe->ops[i], &vpe->instructions[i]);
+
+	vpe->decoded = true;
+}
+
+static inline float vpe_const(const struct dummy_vpe *vpe, unsigned int index,
+			      unsigned int component)
+{
+	union {
+		uint32_t u;
+		float f;
+	} value;
+
+	value.u = vpe->consts[(index % DUMMY_VPE_NUM_CONSTS) * 4 + component];
+
+	return value.f;
+}
+
+static void vpe_fetch(const struct vpe_batch *b, const struct dummy_vpe_op *op,
+		      const struct dummy_vpe_operand *src, float out[4][B])
+{
+	const int *a0 = b->a0[op->address_register];
+	unsigned int c, l, index;
+	float v;
+
+	switch (src->type) {
+	case REG_TYPE_TEMPORARY:
+		for (c = 0; c < 4; c++)
+			memcpy(out[c], b->r[src->index][src->swizzle[c]],
+			       sizeof(out[c]));
+		break;
+
+	case REG_TYPE_ATTRIBUTE:
+		for (l = 0; l < b->count; l++) {
+			index = src->index;
+			if (src->relative)
+				index += a0[l];
+			index %= DUMMY_VPE_NUM_ATTRIBS;
+
+			for (c = 0; c < 4; c++)
+				out[c][l] = b->attribs[l][index][src->swizzle[c]];
+		}
+		break;
+
+	case REG_TYPE_UNIFORM:
+		if (!src->relative) {
+			for (c = 0; c < 4; c++) {
+				v = vpe_const(b->vpe, src->index, src->swizzle[c]);
+				for (l = 0; l < B; l++)
+					out[c][l] = v;
+			}
+			break;
+		}
+
+		for (l = 0; l < b->count; l++) {
+			index = src->index;
+			if (src->relative)
+				index += a0[l];
+
+			for (c = 0; c < 4; c++)
+				out[c][l] = vpe_const(b->vpe, index,
+						      src->swizzle[c]);
+		}
+		break;
+
+	default:
+		memset(out, 0, sizeof(float) * 4 * B);
+		break;
+	}
+
+	if (src->absolute)
+		for (c = 0; c < 4; c++)
+			for (l = 0; l < B; l++)
+				out[c][l] = fabsf(out[c][l]);
+
+	if (src->negate)
+		for (c = 0; c < 4; c++)
+			for (l = 0; l < B; l++)
+				out[c][l] = -out[c][l];
+}
+
+static inline float vpe_set(bool cond)
+{
+	return cond ? 1.0f : 0.0f;
+}
+
+static inline int vpe_round(float f)
+{
+	return (int)floorf(f + 0.5f);
+}
+
+static void vpe_push(struct vpe_batch *b, unsigned int l, unsigned int ret)
+{
+	struct vpe_stack_entry *e;
+	unsigned int c;
+
+	if (b->sp[l] == VPE_STACK_DEPTH) {
+		host1x_error("VPE stack overflow\n");
+		return;
+	}
+
+	e = &b->stack[l][b->sp[l]++];
+	e->ret = ret;
+
+	for (c = 0; c < 4; c++)
+		e->a0[c] = b->a0[c][l];
+}
+
+static bool vpe_pop(struct vpe_batch *b, unsigned int l,
+		    struct vpe_stack_entry *e)
+{
+	if (b->sp[l] == 0) {
+		host1x_error("VPE stack underflow\n");
+		return false;
+	}
+
+	*e = b->stack[l][--b->sp[l]];
+
+	return true;
+}
+
+static void vpe_pop_a0(struct vpe_batch *b, unsigned int l)
+{
+	struct vpe_stack_entry e;
+	unsigned int c;
+
+	if (!vpe_pop(b, l, &e))
+		return;
+
+	for (c = 0; c < 4; c++)
+		b->a0[c][l] = e.a0[c];
+}
+
+/*
+ * Computes the vector result of all lanes into @d. Operations that only
+ * update the address register or the stack are applied to the lanes in
+ * @lanes, with @mask holding the per-lane component write mask.
+ */
+#if (defined(DUMMY_VPE_NEON) || defined(DUMMY_VPE_SSE2)) && \
+    DUMMY_VPE_BATCH % 4
+#error "SIMD paths process lanes in groups of four"
+#endif
+
+/* d = a * b + c over all lanes, @c may be NULL */
+static inline void vpe_lanes_mad(float d[B], const float a[B],
+				 const float b[B], const float c[B])
+{
+	unsigned int l;
+
+#if defined(DUMMY_VPE_NEON)
+	float32x4_t v;
+
+	for (l = 0; l < B; l += 4) {
+		v = vmulq_f32(vld1q_f32(a + l), vld1q_f32(b + l));
+		if (c)
+			v = vaddq_f32(v, vld1q_f32(c + l));
+		vst1q_f32(d + l, v);
+	}
+#elif defined(DUMMY_VPE_SSE2)
+	__m128 v;
+
+	for (l = 0; l < B; l += 4) {
+		v = _mm_mul_ps(_mm_loadu_ps(a + l), _mm_loadu_ps(b + l));
+		if (c)
+			v = _mm_add_ps(v, _mm_loadu_ps(c + l));
+		_mm_storeu_ps(d + l, v);
+	}
+#else
+	for (l = 0; l < B; l++)
+		d[l] = c ? a[l] * b[l] + c[l] : a[l] * b[l];
+#endif
+}
+
+/* d = a + b over all lanes */
+static inline void vpe_lanes_add(float d[B], const float a[B],
+				 const float b[B])
+{
+	unsigned int l;
+
+#if defined(DUMMY_VPE_NEON)
+	for (l = 0; l < B; l += 4)
+		vst1q_f32(d + l, vaddq_f32(vld1q_f32(a + l),
+					   vld1q_f32(b + l)));
+#elif defined(DUMMY_VPE_SSE2)
+	for (l = 0; l < B; l += 4)
+		_mm_storeu_ps(d + l, _mm_add_ps(_mm_loadu_ps(a + l),
+						_mm_loadu_ps(b + l)));
+#else
+	for (l = 0; l < B; l++)
+		d[l] = a[l] + b[l];
+#endif
+}
+
+static void vpe_vector_op(struct vpe_batch *b, const struct dummy_vpe_op *op,
+			  float a[4][B], float bv[4][B], float cv[4][B],
+			  unsigned int lanes, const uint8_t mask[B],
+			  float d[4][B])
+{
+	unsigned int c, l;
+	float dot[B];
+
+	switch (op->vector_opcode) {
+	case VECTOR_OPCODE_MOV:
+		memcpy(d, a, sizeof(float) * 4 * B);
+		break;
+
+	case VECTOR_OPCODE_MUL:
+		for (c = 0; c < 4; c++)
+			vpe_lanes_mad(d[c], a[c], bv[c], NULL);
+		break;
+
+	case VECTOR_OPCODE_ADD:
+		for (c = 0; c < 4; c++)
+			vpe_lanes_add(d[c], a[c], cv[c]);
+		break;
+
+	case VECTOR_OPCODE_MAD:
+		for (c = 0; c < 4; c++)
+			vpe_lanes_mad(d[c], a[c], bv[c], cv[c]);
+		break;
+
+	case VECTOR_OPCODE_DP3:
+	case VECTOR_OPCODE_DPH:
+	case VECTOR_OPCODE_DP4:
+		/* summed in the order a0b0 + a1b1 + a2b2 + (a3b3 | b3) */
+		vpe_lanes_mad(dot, a[0], bv[0], NULL);
+		vpe_lanes_mad(dot, a[1], bv[1], dot);
+		vpe_lanes_mad(dot, a[2], bv[2], dot);
+
+		if (op->vector_opcode == VECTOR_OPCODE_DPH)
+			vpe_lanes_add(dot, dot, bv[3]);
+		else if (op->vector_opcode == VECTOR_OPCODE_DP4)
+			vpe_lanes_mad(dot, a[3], bv[3], dot);
+
+		for (c = 0; c < 4; c++)
+			memcpy(d[c], dot, sizeof(dot));
+		break;
+
+	case VECTOR_OPCODE_DST:
+		for (l = 0; l < B; l++) {
+			d[0][l] = 1.0f;
+			d[1][l] = a[1][l] * bv[1][l];
+			d[2][l] = a[2][l];
+			d[3][l] = bv[3][l];
+		}
+		break;
+
+	case VECTOR_OPCODE_MIN:
+		for (c = 0; c < 4; c++)
+			for (l = 0; l < B; l++)
+				d[c][l] = fminf(a[c][l], bv[c][l]);
+		break;
+
+	case VECTOR_OPCODE_MAX:
+		for (c = 0; c < 4; c++)
+			for (l = 0; l < B; l++)
+				d[c][l] = fmaxf(a[c][l], bv[c][l]);
+		break;
+
+	case VECTOR_OPCODE_SLT:
+		for (c = 0; c < 4; c++)
+			for (l = 0; l < B; l++)
+				d[c][l] = vpe_set(a[c][l] < bv[c][l]);
+		break;
+
+	case VECTOR_OPCODE_SGE:
+		for (c = 0; c < 4; c++)
+			for (l = 0; l < B; l++)
+				d[c][l] = vpe_set(a[c][l] >= bv[c][l]);
+		break;
+
+	case VECTOR_OPCODE_SEQ:
+		for (c = 0; c < 4; c++)
+			for (l = 0; l < B; l++)
+				d[c][l] = vpe_set(a[c][l] == bv[c][l]);
+		break;
+
+	case VECTOR_OPCODE_SGT:
+		for (c = 0; c < 4; c++)
+			for (l = 0; l < B; l++)
+				d[c][l] = vpe_set(a[c][l] > bv[c][l]);
+		break;
+
+	case VECTOR_OPCODE_SLE:
+		for (c = 0; c < 4; c++)
+			for (l = 0; l < B; l++)
+				d[c][l] = vpe_set(a[c][l] <= bv[c][l]);
+		break;
+
+	case VECTOR_OPCODE_SNE:
+		for (c = 0; c < 4; c++)
+			for (l = 0; l < B; l++)
+				d[c][l] = vpe_set(a[c][l] != bv[c][l]);
+		break;
+
+	case VECTOR_OPCODE_SFL:
+	case VECTOR_OPCODE_STR:
+		for (c = 0; c < 4; c++)
+			for (l = 0; l < B; l++)
+				d[c][l] = vpe_set(op->vector_opcode ==
+						  VECTOR_OPCODE_STR);
+		break;
+
+	case VECTOR_OPCODE_FRC:
+		for (c = 0; c < 4; c++)
+			for (l = 0; l < B; l++)
+				d[c][l] = a[c][l] - floorf(a[c][l]);
+		break;
+
+	case VECTOR_OPCODE_FLR:
+		for (c = 0; c < 4; c++)
+			for (l = 0; l < B; l++)
+				d[c][l] = floorf(a[c][l]);
+		break;
+
+	case VECTOR_OPCODE_SSG:
+		for (c = 0; c < 4; c++)
+			for (l = 0; l < B; l++)
+				d[c][l] = a[c][l] > 0.0f ? 1.0f :
+					  a[c][l] < 0.0f ? -1.0f : 0.0f;
+		break;
+
+	case VECTOR_OPCODE_ARL:
+	case VECTOR_OPCODE_ARR:
+		for (l = 0; l < b->count; l++) {
+			if (!(lanes & BIT(l)))
+				continue;
+
+			for (c = 0; c < 4; c++) {
+				if (!(mask[l] & BIT(c)))
+					continue;
+
+				if (op->vector_opcode == VECTOR_OPCODE_ARL)
+					b->a0[c][l] = (int)floorf(a[c][l]);
+				else
+					b->a0[c][l] = vpe_round(a[c][l]);
+			}
+		}
+		break;
+
+	case VECTOR_OPCODE_ARA:
+		for (l = 0; l < b->count; l++) {
+			if (!(lanes & BIT(l)))
+				continue;
+
+			if (mask[l] & BIT(0))
+				b->a0[0][l] += b->a0[2][l];
+			if (mask[l] & BIT(1))
+				b->a0[1][l] += b->a0[3][l];
+		}
+		break;
+
+	case VECTOR_OPCODE_PUSHA:
+		for (l = 0; l < b->count; l++)
+			if (lanes & BIT(l))
+				vpe_push(b, l, 0);
+		break;
+
+	case VECTOR_OPCODE_POPA:
+		for (l = 0; l < b->count; l++)
+			if (lanes & BIT(l))
+				vpe_pop_a0(b, l);
+		break;
+
+	case VECTOR_OPCODE_NOP:
+		break;
+
+	case VECTOR_OPCODE_TXL:
+	default:
+		host1x_error("Unsupported VPE vector opcode %u\n",
+			     op->vector_opcode);
+		break;
+	}
+}
+
+/*
+ * Computes the scalar result of all lanes into @d. Flow control updates
+ * the program counter of the lanes in @lanes whose predicate .x passed.
+ */
+static void vpe_scalar_op(struct vpe_batch *b, const struct dummy_vpe_op *op,
+			  float cv[4][B], unsigned int lanes,
+			  const uint8_t pred[B], float d[4][B])
+{
+	struct vpe_stack_entry e;
+	unsigned int c, l;
+	float x, r;
+
+	switch (op->scalar_opcode) {
+	case SCALAR_OPCODE_MOV:
+		memcpy(d, cv, sizeof(float) * 4 * B);
+		return;
+
+	case SCALAR_OPCODE_BRA:
+	case SCALAR_OPCODE_CAL:
+	case SCALAR_OPCODE_RET:
+		for (l = 0; l < b->count; l++) {
+			if (!(lanes & BIT(l)) || !(pred[l] & BIT(0)))
+				continue;
+
+			if (op->scalar_opcode == SCALAR_OPCODE_BRA) {
+				b->pc[l] = op->iaddr;
+			} else if (op->scalar_opcode == SCALAR_OPCODE_CAL) {
+				vpe_push(b, l, b->pc[l]);
+				b->pc[l] = op->iaddr;
+			} else if (vpe_pop(b, l, &e)) {
+				b->pc[l] = e.ret;
+			}
+		}
+		return;
+
+	case SCALAR_OPCODE_PUSHA:
+		for (l = 0; l < b->count; l++)
+			if (lanes & BIT(l))
+				vpe_push(b, l, 0);
+		return;
+
+	case SCALAR_OPCODE_POPA:
+		for (l = 0; l < b->count; l++)
+			if (lanes & BIT(l))
+				vpe_pop_a0(b, l);
+		return;
+
+	case SCALAR_OPCODE_EXP:
+		for (l = 0; l < B; l++) {
+			x = cv[0][l];
+			d[0][l] = exp2f(floorf(x));
+			d[1][l] = x - floorf(x);
+			d[2][l] = exp2f(x);
+			d[3][l] = 1.0f;
+		}
+		return;
+
+	case SCALAR_OPCODE_LOG:
+		for (l = 0; l < B; l++) {
+			r = fabsf(cv[0][l]);
+			d[0][l] = floorf(log2f(r));
+			d[1][l] = r / exp2f(d[0][l]);
+			d[2][l] = log2f(r);
+			d[3][l] = 1.0f;
+		}
+		return;
+
+	case SCALAR_OPCODE_LIT:
+		for (l = 0; l < B; l++) {
+			d[0][l] = 1.0f;
+			d[1][l] = fmaxf(cv[0][l], 0.0f);
+			d[2][l] = cv[0][l] > 0.0f ?
+				powf(fmaxf(cv[1][l], 0.0f),
+				     fminf(fmaxf(cv[3][l], -128.0f), 128.0f)) :
+				0.0f;
+			d[3][l] = 1.0f;
+		}
+		return;
+
+	case SCALAR_OPCODE_NOP:
+		return;
+
+	default:
+		if (!op->scalar_result) {
+			host1x_error("Unsupported VPE scalar opcode %u\n",
+				     op->scalar_opcode);
+			return;
+		}
+		break;
+	}
+
+	/* the remaining operations replicate a result computed from rC.x */
+	for (l = 0; l < B; l++) {
+		x = cv[0][l];
+
+		switch (op->scalar_opcode) {
+		case SCALAR_OPCODE_RCP:
+			r = 1.0f / x;
+			break;
+
+		case SCALAR_OPCODE_RCC:
+			r = 1.0f / x;
+			if (fabsf(r) > 1.884467e+19f)
+				r = copysignf(1.884467e+19f, r);
+			else if (fabsf(r) < 5.42101e-20f)
+				r = copysignf(5.42101e-20f, r);
+			break;
+
+		case SCALAR_OPCODE_RSQ:
+			r = 1.0f / sqrtf(fabsf(x));
+			break;
+
+		case SCALAR_OPCODE_LG2:
+			r = log2f(fabsf(x));
+			break;
+
+		case SCALAR_OPCODE_EX2:
+			r = exp2f(x);
+			break;
+
+		case SCALAR_OPCODE_SIN:
+			r = sinf(x);
+			break;
+
+		case SCALAR_OPCODE_COS:
+			r = cosf(x);
+			break;
+
+		default:
+			r = 0.0f;
+			break;
+		}
+
+		for (c = 0; c < 4; c++)
+			d[c][l] = r;
+	}
+}
+
+/*
+ * Evaluates the instruction predicate of every lane against the selected
+ * condition register, giving the mask of components that pass.
+ */
+static void vpe_predicate(const struct vpe_batch *b,
+			  const struct dummy_vpe_op *op, uint8_t pred[B])
+{
+	const float (*cr)[B] = b->cr[op->condition_register];
+	unsigned int c, l;
+	float v;
+
+	if (!op->predicated) {
+		memset(pred, 0xf, B);
+		return;
+	}
+
+	for (l = 0; l < B; l++) {
+		pred[l] = 0;
+
+		for (c = 0; c < 4; c++) {
+			v = cr[op->predicate_swizzle[c]][l];
+
+			if ((op->predicate_lt && v < 0.0f) ||
+			    (op->predicate_eq && v == 0.0f) ||
+			    (op->predicate_gt && v > 0.0f))
+				pred[l] |= BIT(c);
+		}
+	}
+}
+
+static void vpe_write(float dst[4][B], float src[4][B], unsigned int lanes,
+		      const uint8_t mask[B], bool saturate)
+{
+	unsigned int c, l;
+	float v;
+
+	for (c = 0; c < 4; c++) {
+		for (l = 0; l < B; l++) {
+			if (!(lanes & BIT(l)) || !(mask[l] & BIT(c)))
+				continue;
+
+			v = src[c][l];
+			if (saturate)
+				v = fminf(fmaxf(v, 0.0f), 1.0f);
+
+			dst[c][l] = v;
+		}
+	}
+}
+
+static void vpe_export(struct vpe_batch *b, const struct dummy_vpe_op *op,
+		       float src[4][B], unsigned int lanes,
+		       const uint8_t mask[B])
+{
+	const int *a0 = b->a0[op->address_register];
+	unsigned int c, l, index;
+	float v;
+
+	for (l = 0; l < b->count; l++) {
+		if (!(lanes & BIT(l)))
+			continue;
+
+		index = op->export_index;
+		if (op->export_relative)
+			index += a0[l];
+		index %= DUMMY_VPE_NUM_EXPORTS;
+
+		for (c = 0; c < 4; c++) {
+			if (!(mask[l] & BIT(c)))
+				continue;
+
+			v = src[c][l];
+			if (op->saturate)
+				v = fminf(fmaxf(v, 0.0f), 1.0f);
+
+			b->exports[l][index][c] = v;
+		}
+	}
+}
+
+static void vpe_issue(struct vpe_batch *b, const struct dummy_vpe_op *op,
+		      unsigned int lanes)
+{
+	float a[4][B], bv[4][B], cv[4][B], vd[4][B], sd[4][B];
+	uint8_t pred[B], vmask[B], smask[B];
+	unsigned int l;
+
+	if (op->src_used & BIT(0))
+		vpe_fetch(b, op, &op->src[0], a);
+	if (op->src_used & BIT(1))
+		vpe_fetch(b, op, &op->src[1], bv);
+	if (op->src_used & BIT(2))
+		vpe_fetch(b, op, &op->src[2], cv);
+	vpe_predicate(b, op, pred);
+
+	for (l = 0; l < B; l++) {
+		vmask[l] = op->vector_mask & pred[l];
+		smask[l] = op->scalar_mask & pred[l];
+	}
+
+	vpe_vector_op(b, op, a, bv, cv, lanes, vmask, vd);
+	vpe_scalar_op(b, op, cv, lanes, pred, sd);
+
+	if (op->vector_result) {
+		if (op->condition_write)
+			vpe_write(b->cr[op->condition_register], vd, lanes,
+				  vmask, op->saturate);
+
+		if (op->vector_rd != VPE_NO_REG)
+			vpe_write(b->r[op->vector_rd], vd, lanes, vmask,
+				  op->saturate);
+	}
+
+	if (op->scalar_result && op->scalar_rd != VPE_NO_REG)
+		vpe_write(b->r[op->scalar_rd], sd, lanes, smask,
+			  op->saturate);
+
+	if (op->export_index == VPE_NO_EXPORT)
+		return;
+
+	if (op->export_vector && op->vector_result)
+		vpe_export(b, op, vd, lanes, vmask);
+	else if (!op->export_vector && op->scalar_result)
+		vpe_export(b, op, sd, lanes, smask);
+}
+
+static void vpe_run_batch(struct vpe_batch *b)
+{
+	unsigned int running = BIT(b->count) - 1;
+	unsigned int steps[B] = { 0 };
+	unsigned int lanes, pc, l;
+	const struct dummy_vpe_op *op;
+
+	while (running) {
+		pc = DUMMY_VPE_NUM_INSTRUCTIONS;
+		for (l = 0; l < b->count; l++)
+			if ((running & BIT(l)) && b->pc[l] < pc)
+				pc = b->pc[l];
+
+		if (pc >= DUMMY_VPE_NUM_INSTRUCTIONS) {
+			host1x_error("VPE program counter out of range\n");
+			return;
+		}
+
+		lanes = 0;
+		for (l = 0; l < b->count; l++) {
+			if ((running & BIT(l)) && b->pc[l] == pc) {
+				lanes |= BIT(l);
+				b->pc[l] = pc + 1;
+			}
+		}
+
+		op = &b->vpe->ops[pc];
+		vpe_issue(b, op, lanes);
+
+		if (op->end)
+			running &= ~lanes;
+
+		for (l = 0; l < b->count; l++) {
+			if ((running & lanes & BIT(l)) &&
+			    ++steps[l] == VPE_MAX_STEPS) {
+				host1x_error("VPE program didn't terminate\n");
+				running &= ~BIT(l);
+			}
+		}
+	}
+}
+
+/*
+ * Runs the vertex program for @count vertices, @attribs and @exports hold
+ * the inputs and the outputs of one vertex per element.
+ */
+void dummy_vpe_execute(struct dummy_vpe *vpe, unsigned int count,
+		       const float (*attribs)[DUMMY_VPE_NUM_ATTRIBS][4],
+		       float (*exports)[DUMMY_VPE_NUM_EXPORTS][4])
+{
+	struct vpe_batch b;
+	unsigned int i;
+
+	if (!vpe->decoded)
+		dummy_vpe_decode(vpe);
+
+	for (i = 0; i < count; i += B) {
+		memset(&b, 0, sizeof(b));
+		b.vpe = vpe;
+		b.attribs = attribs + i;
+		b.exports = exports + i;
+		b.count = count - i < B ? count - i : B;
+
+		vpe_run_batch(&b);
+	}
+}
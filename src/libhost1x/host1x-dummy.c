@@ -21,15 +21,24 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
-#include "host1x-private.h"
+#include "host1x-dummy.h"
 
 struct dummy_data {
+	struct dummy_data *next;
+	uint32_t handle;
 	void *ptr;
+	size_t size;
 	int refcnt;
 };
 
+static struct dummy_data *dummy_bos;
+static uint32_t dummy_next_handle = 1;
+
 struct dummy_bo {
 	struct host1x_bo bo;
 	struct dummy_data *data;
@@ -49,6 +58,13 @@ static void host1x_dummy_bo_free(struct host1x_bo *bo)
 	struct dummy_bo *dbo = container_of(bo, struct dummy_bo, bo);
 
 	if (dbo->data->refcnt-- == 0) {
+		struct dummy_data **data = &dummy_bos;
+
+		while (*data != dbo->data)
+			data = &(*data)->next;
+
+		*data = dbo->data->next;
+
 		free(dbo->data->ptr);
 		free(dbo->data);
 	}
@@ -88,15 +104,25 @@ static struct host1x_bo *host1x_dummy_bo_create(struct host1x *host1x,
 		return NULL;
 	}
 
-	dbo->data->ptr = malloc(size);
-	if (!dbo->data->ptr) {
+	/*
+	 * Back BOs with page aligned memory like the IOMMU mappings of the
+	 * real driver, engines derive the position within a tile from the
+	 * low bits of the resolved address.
+	 */
+	if (posix_memalign(&dbo->data->ptr, 4096, size)) {
 		free(dbo->data);
 		free(dbo);
 		return NULL;
 	}
 
+	dbo->data->size = size;
+	dbo->data->handle = dummy_next_handle++;
+	dbo->data->next = dummy_bos;
+	dummy_bos = dbo->data;
+
 	bo = &dbo->bo;
 
+	bo->handle = dbo->data->handle;
 	bo->priv = priv;
 	bo->priv->mmap = host1x_dummy_bo_mmap;
 	bo->priv->free = host1x_dummy_bo_free;
@@ -105,49 +131,440 @@ static struct host1x_bo *host1x_dummy_bo_create(struct host1x *host1x,
 	return bo;
 }
 
-static void host1x_dummy_close(struct host1x *host1x)
+
+void *dummy_bo_lookup(uint32_t handle)
 {
-	free(host1x);
+	struct dummy_data *data;
+
+	for (data = dummy_bos; data; data = data->next)
+		if (data->handle == handle)
+			return data->ptr;
+
+	return NULL;
+}
+
+/* bytes from @addr up to the end of the BO containing it, 0 if there's none */
+size_t dummy_bo_remaining(const uint8_t *addr)
+{
+	struct dummy_data *data;
+	const uint8_t *ptr;
+
+	for (data = dummy_bos; data; data = data->next) {
+		ptr = data->ptr;
+
+		if (addr >= ptr && addr < ptr + data->size)
+			return ptr + data->size - addr;
+	}
+
+	return 0;
+}
+
+struct dummy_stream {
+	struct host1x_pushbuf *pb;
+	const uint32_t *words;
+	unsigned int pos;
+	unsigned int reloc;
+};
+
+/*
+ * Fetch the next word of the pushbuf. If the word was patched by a
+ * relocation, the CPU address of the relocation target is returned in
+ * @addr, NULL otherwise.
+ */
+static uint32_t dummy_stream_fetch(struct dummy_stream *stream, uint8_t **addr)
+{
+	struct host1x_pushbuf *pb = stream->pb;
+	unsigned long offset = pb->offset + stream->pos * 4;
+	struct host1x_pushbuf_reloc *r;
+	uint8_t *target;
+
+	*addr = NULL;
+
+	while (stream->reloc < pb->num_relocs &&
+	       pb->relocs[stream->reloc].source_offset < offset)
+		stream->reloc++;
+
+	if (stream->reloc < pb->num_relocs &&
+	    pb->relocs[stream->reloc].source_offset == offset) {
+		r = &pb->relocs[stream->reloc++];
+		target = dummy_bo_lookup(r->target_handle);
+		if (target)
+			*addr = target + r->target_offset;
+		else
+			host1x_error("Invalid relocation target %lu\n",
+				     r->target_handle);
+	}
+
+	return stream->words[stream->pos++];
+}
+
+static void dummy_write(unsigned int classid, unsigned int offset,
+			uint32_t value, uint8_t *addr)
+{
+	static struct dummy_gr2d gr2d;
+	static struct dummy_gr3d gr3d;
+
+	switch (classid) {
+	case HOST1X_CLASS_GR2D:
+	case HOST1X_CLASS_GR2D_SB:
+		dummy_gr2d_write(&gr2d, offset, value, addr);
+		break;
+
+	case HOST1X_CLASS_GR3D:
+		dummy_gr3d_write(&gr3d, offset, value, addr);
+		break;
+
+	default:
+		break;
+	}
+}
+
+/*
+ * The class selected by a SETCL stays in effect for the following pushbufs
+ * of the job, like it does for the gathers of a channel, hence @classid is
+ * carried from one pushbuf to the next.
+ */
+static int dummy_execute(struct host1x_pushbuf *pb, unsigned int *classid)
+{
+	struct dummy_stream stream = {
+		.pb = pb,
+		.words = pb->bo->ptr + pb->offset,
+	};
+	uint32_t opcode, instr, offset, count, mask, i;
+	uint8_t *addr;
+	uint32_t value;
+
+	while (stream.pos < pb->length) {
+		instr = dummy_stream_fetch(&stream, &addr);
+		opcode = instr >> 28;
+		offset = (instr >> 16) & 0xfff;
+
+		switch (opcode) {
+		case 0x0: /* SETCL */
+			*classid = (instr >> 6) & 0x3ff;
+			mask = instr & 0x3f;
+			count = 0;
+			break;
+
+		case 0x1: /* INCR */
+		case 0x2: /* NONINCR */
+			mask = 0;
+			count = instr & 0xffff;
+			break;
+
+		case 0x3: /* MASK */
+			mask = instr & 0xffff;
+			count = 0;
+			break;
+
+		case 0x4: /* IMM */
+			dummy_write(*classid, offset, instr & 0xffff, NULL);
+			continue;
+
+		case 0xe: /* EXTEND */
+		case 0xf: /* CHDONE */
+			continue;
+
+		default:
+			host1x_error("Unsupported opcode 0x%08x\n", instr);
+			return -EINVAL;
+		}
+
+		if (stream.pos + count + __builtin_popcount(mask) > pb->length) {
+			host1x_error("Pushbuf overrun by opcode 0x%08x\n", instr);
+			return -EINVAL;
+		}
+
+		for (i = 0; i < 16; i++) {
+			if (mask & BIT(i)) {
+				value = dummy_stream_fetch(&stream, &addr);
+				dummy_write(*classid, offset + i, value, addr);
+			}
+		}
+
+		for (i = 0; i < count; i++) {
+			value = dummy_stream_fetch(&stream, &addr);
+			dummy_write(*classid, offset, value, addr);
+
+			if (opcode == 0x1)
+				offset++;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * The dummy engines run their jobs in order. HOST1X_DUMMY_LATENCY sets the
+ * time in microseconds that every job takes; a job then completes that long
+ * after it was submitted or the previous job completed, whichever is later.
+ * Commands are executed only once the job completes, so command buffers
+ * that are reused before the fence of the job was reached show up as
+ * corrupted rendering, like they would on the hardware.
+ */
+struct dummy_job {
+	struct dummy_job *next;
+	struct host1x_pushbuf *pushbufs;
+	unsigned int num_pushbufs;
+	uint32_t fence;
+	uint64_t deadline;
+};
+
+struct dummy_client {
+	struct host1x_client base;
+	struct host1x_syncpt syncpt;
+
+	/* syncpoint value once all submitted jobs completed */
+	uint32_t fence;
+
+	struct dummy_job *jobs;
+	struct dummy_job **tail;
+	uint64_t deadline;
+};
+
+static inline struct dummy_client *to_dummy_client(struct host1x_client *client)
+{
+	return container_of(client, struct dummy_client, base);
+}
+
+static uint64_t dummy_latency;
+
+static uint64_t dummy_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void dummy_job_free(struct dummy_job *job)
+{
+	unsigned int i;
+
+	for (i = 0; i < job->num_pushbufs; i++) {
+		host1x_dummy_bo_free(job->pushbufs[i].bo);
+		free(job->pushbufs[i].relocs);
+	}
+
+	free(job->pushbufs);
+	free(job);
+}
+
+/*
+ * Takes a snapshot of the job's pushbufs. The command words aren't copied,
+ * they're fetched from the BOs when the job is executed.
+ */
+static struct dummy_job *dummy_job_create(struct host1x_job *job)
+{
+	struct dummy_job *djob;
+	unsigned int i;
+
+	djob = calloc(1, sizeof(*djob));
+	if (!djob)
+		return NULL;
+
+	djob->pushbufs = calloc(job->num_pushbufs, sizeof(*djob->pushbufs));
+	if (!djob->pushbufs) {
+		free(djob);
+		return NULL;
+	}
+
+	for (i = 0; i < job->num_pushbufs; i++) {
+		struct host1x_pushbuf *pb = &djob->pushbufs[i];
+
+		*pb = job->pushbufs[i];
+		pb->relocs = NULL;
+		pb->ring = NULL;
+
+		/* keep the data of the BO alive until the job completed */
+		pb->bo = host1x_dummy_bo_clone(job->pushbufs[i].bo);
+		if (!pb->bo)
+			goto free;
+
+		djob->num_pushbufs++;
+
+		if (!pb->num_relocs)
+			continue;
+
+		pb->relocs = malloc(pb->num_relocs * sizeof(*pb->relocs));
+		if (!pb->relocs)
+			goto free;
+
+		memcpy(pb->relocs, job->pushbufs[i].relocs,
+		       pb->num_relocs * sizeof(*pb->relocs));
+	}
+
+	return djob;
+
+free:
+	dummy_job_free(djob);
+	return NULL;
+}
+
+static int dummy_job_execute(struct host1x_pushbuf *pushbufs,
+			     unsigned int num_pushbufs)
+{
+	unsigned int classid = 0;
+	unsigned int i;
+	int err;
+
+	for (i = 0; i < num_pushbufs; i++) {
+		err = dummy_execute(&pushbufs[i], &classid);
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
+/* executes all queued jobs that completed by now */
+static void dummy_client_retire(struct dummy_client *client)
+{
+	uint64_t now = dummy_time_ns();
+	struct dummy_job *job;
+
+	while ((job = client->jobs) && job->deadline <= now) {
+		client->jobs = job->next;
+		if (!client->jobs)
+			client->tail = &client->jobs;
+
+		dummy_job_execute(job->pushbufs, job->num_pushbufs);
+		client->syncpt.value = job->fence;
+		dummy_job_free(job);
+	}
 }
 
 static int host1x_dummy_submit(struct host1x_client *client,
 			       struct host1x_job *job)
 {
+	struct dummy_client *dummy = to_dummy_client(client);
+	struct dummy_job *djob;
+	uint64_t now;
+	int err;
+
+	dummy->fence += job->syncpt_incrs;
+
+	if (!dummy_latency) {
+		err = dummy_job_execute(job->pushbufs, job->num_pushbufs);
+		dummy->syncpt.value = dummy->fence;
+		return err;
+	}
+
+	djob = dummy_job_create(job);
+	if (!djob) {
+		dummy->fence -= job->syncpt_incrs;
+		return -ENOMEM;
+	}
+
+	now = dummy_time_ns();
+	if (dummy->deadline < now)
+		dummy->deadline = now;
+
+	dummy->deadline += dummy_latency;
+
+	djob->fence = dummy->fence;
+	djob->deadline = dummy->deadline;
+
+	*dummy->tail = djob;
+	dummy->tail = &djob->next;
+
 	return 0;
 }
 
 static int host1x_dummy_flush(struct host1x_client *client, uint32_t *fence)
 {
+	struct dummy_client *dummy = to_dummy_client(client);
+
+	*fence = dummy->fence;
+
 	return 0;
 }
 
 static int host1x_dummy_wait(struct host1x_client *client, uint32_t fence,
 			     uint32_t timeout)
 {
+	struct dummy_client *dummy = to_dummy_client(client);
+	uint64_t deadline = dummy_time_ns() + timeout * 1000000ull;
+	struct timespec ts;
+	uint64_t until;
+
+	while (true) {
+		dummy_client_retire(dummy);
+
+		if (host1x_syncpt_reached(dummy->syncpt.value, fence))
+			return 0;
+
+		/* nothing that was submitted is going to reach the fence */
+		if (!dummy->jobs)
+			return -EINVAL;
+
+		until = dummy->jobs->deadline;
+
+		if (timeout != ~0u) {
+			if (dummy_time_ns() >= deadline)
+				return -EAGAIN;
+
+			if (until > deadline)
+				until = deadline;
+		}
+
+		ts.tv_sec = until / 1000000000ull;
+		ts.tv_nsec = until % 1000000000ull;
+
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+}
+
+static int host1x_dummy_read(struct host1x_client *client, uint32_t *value)
+{
+	struct dummy_client *dummy = to_dummy_client(client);
+
+	dummy_client_retire(dummy);
+	*value = dummy->syncpt.value;
+
 	return 0;
 }
 
-static struct host1x_syncpt syncpt;
+#define DUMMY_CLIENT_INIT(name) {			\
+	.base = {					\
+		.submit = host1x_dummy_submit,		\
+		.flush = host1x_dummy_flush,		\
+		.wait = host1x_dummy_wait,		\
+		.read = host1x_dummy_read,		\
+		.syncpts = &name.syncpt,		\
+		.num_syncpts = 1,			\
+	},						\
+	.tail = &name.jobs,				\
+}
 
-static struct host1x_client dummy_client = {
-	.submit = host1x_dummy_submit,
-	.flush = host1x_dummy_flush,
-	.wait = host1x_dummy_wait,
-	.syncpts = &syncpt,
-	.num_syncpts = 1,
-};
+static struct dummy_client dummy_gr2d_client = DUMMY_CLIENT_INIT(dummy_gr2d_client);
+static struct dummy_client dummy_gr3d_client = DUMMY_CLIENT_INIT(dummy_gr3d_client);
 
 static struct host1x_gr2d dummy_gr2d = {
-	.client = &dummy_client,
+	.client = &dummy_gr2d_client.base,
 };
 
 static struct host1x_gr3d dummy_gr3d = {
-	.client = &dummy_client,
+	.client = &dummy_gr3d_client.base,
 };
 
+static void dummy_client_drain(struct dummy_client *client)
+{
+	host1x_dummy_wait(&client->base, client->fence, ~0u);
+}
+
+static void host1x_dummy_close(struct host1x *host1x)
+{
+	dummy_client_drain(&dummy_gr2d_client);
+	dummy_client_drain(&dummy_gr3d_client);
+	free(host1x);
+}
+
 struct host1x *host1x_dummy_open(struct host1x_options *options)
 {
 	struct host1x *host1x;
+	const char *str;
 	int err;
 
 	host1x = calloc(1, sizeof(*host1x));
@@ -158,6 +575,10 @@ struct host1x *host1x_dummy_open(struct host1x_options *options)
 	host1x->close = host1x_dummy_close;
 	host1x->options = options;
 
+	str = getenv("HOST1X_DUMMY_LATENCY");
+	if (str)
+		dummy_latency = strtoull(str, NULL, 0) * 1000;
+
 	host1x->gr2d = &dummy_gr2d;
 	host1x->gr3d = &dummy_gr3d;
 
@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GRATE_HOST1X_DUMMY_H
+#define GRATE_HOST1X_DUMMY_H 1
+
+#include <math.h>
+#include <stdbool.h>
+
+#include "host1x.h"
+#include "host1x-private.h"
+
+#include "../libgrate/fragment_asm.h"
+#include "../libgrate/vpe_vliw.h"
+
+#define HOST1X_CLASS_GR2D_SB	0x52
+
+#define DUMMY_GR2D_NUM_REGS	0x50
+
+/*
+ * Register file of the software GR2D engine. Every register carries the
+ * raw 32bit value written by the command stream and, for address registers
+ * that were patched by a relocation, the CPU pointer the relocation resolved
+ * to.
+ */
+struct dummy_gr2d {
+	uint32_t regs[DUMMY_GR2D_NUM_REGS];
+	uint8_t *addrs[DUMMY_GR2D_NUM_REGS];
+};
+
+void dummy_gr2d_write(struct dummy_gr2d *gr2d, unsigned int offset,
+		      uint32_t value, uint8_t *addr);
+
+#define DUMMY_GR3D_NUM_REGS	0x1000
+
+/*
+ * fp20 is the 1.6.13 floating point format of the fragment pipeline with an
+ * exponent bias of 31, fx10 is its 2.8 signed fixed point format.
+ */
+static inline uint32_t dummy_float_to_fp20(float f)
+{
+	union {
+		uint32_t u;
+		float f;
+	} value = { .f = f };
+	uint32_t sign = (value.u >> 31) & 0x1;
+	int exponent = (value.u >> 23) & 0xff;
+	uint32_t mantissa = value.u & 0x7fffff;
+
+	if (exponent == 0xff)
+		return (sign << 19) | (0x3f << 13) | (mantissa >> 10);
+
+	exponent = exponent - 127 + 31;
+
+	if (exponent <= 0)
+		return sign << 19;
+
+	if (exponent >= 0x3f)
+		return (sign << 19) | (0x3e << 13) | 0x1fff;
+
+	return (sign << 19) | (exponent << 13) | (mantissa >> 10);
+}
+
+static inline float dummy_fp20_to_float(uint32_t fp20)
+{
+	union {
+		uint32_t u;
+		float f;
+	} value;
+	uint32_t sign = (fp20 >> 19) & 0x1;
+	uint32_t exponent = (fp20 >> 13) & 0x3f;
+	uint32_t mantissa = fp20 & 0x1fff;
+
+	if (exponent == 0)
+		value.u = sign << 31;
+	else if (exponent == 0x3f)
+		value.u = (sign << 31) | (0xff << 23) | (mantissa << 10);
+	else
+		value.u = (sign << 31) | ((exponent - 31 + 127) << 23) |
+			  (mantissa << 10);
+
+	return value.f;
+}
+
+static inline uint32_t dummy_float_to_fx10(float f)
+{
+	float v = f * 256.0f + 0.5f;
+
+	if (v >= 511.0f)
+		return 511;
+
+	if (v <= -512.0f)
+		return 0x200;
+
+	return (uint32_t)(int32_t)floorf(v) & 0x3ff;
+}
+
+static inline int dummy_fx10_to_int(uint32_t fx10)
+{
+	return (int)((fx10 & 0x3ff) ^ 0x200) - 0x200;
+}
+
+static inline float dummy_fx10_to_float(uint32_t fx10)
+{
+	return dummy_fx10_to_int(fx10) / 256.0f;
+}
+
+#define DUMMY_VPE_NUM_INSTRUCTIONS	256
+#define DUMMY_VPE_NUM_CONSTS		256
+#define DUMMY_VPE_NUM_ATTRIBS		16
+#define DUMMY_VPE_NUM_EXPORTS		16
+
+#define DUMMY_FP_NUM_INSTRUCTIONS	64
+
+#define DUMMY_VPE_BATCH			8
+
+/*
+ * An operand of a pre-decoded VPE instruction. For attributes and uniforms
+ * @index is the fetch index shared by all operands of that type.
+ */
+struct dummy_vpe_operand {
+	uint8_t type;
+	uint8_t swizzle[4];
+	bool negate;
+	bool absolute;
+	bool relative;
+	uint16_t index;
+};
+
+/*
+ * VPE instruction decoded once out of the packed 128bit VLIW word, so that
+ * executing it doesn't need any bitfield extraction.
+ */
+struct dummy_vpe_op {
+	struct dummy_vpe_operand src[3];
+	uint8_t src_used;
+
+	uint8_t vector_opcode;
+	uint8_t scalar_opcode;
+	uint8_t vector_mask;
+	uint8_t scalar_mask;
+	uint8_t vector_rd;
+	uint8_t scalar_rd;
+
+	/* whether the operation produces a register result at all */
+	bool vector_result;
+	bool scalar_result;
+
+	uint8_t export_index;
+	bool export_vector;
+	bool export_relative;
+
+	uint8_t address_register;
+	uint8_t iaddr;
+
+	bool predicated;
+	uint8_t predicate_swizzle[4];
+	bool predicate_lt;
+	bool predicate_eq;
+	bool predicate_gt;
+
+	uint8_t condition_register;
+	bool condition_write;
+
+	bool saturate;
+	bool end;
+};
+
+/*
+ * Vertex processor state: the uploaded program and its constant memory.
+ * Constants are kept as raw words, the VPE operates on IEEE floats. The
+ * program is decoded on first use after it was (re-)uploaded.
+ */
+struct dummy_vpe {
+	vpe_instr128 instructions[DUMMY_VPE_NUM_INSTRUCTIONS];
+	uint32_t consts[DUMMY_VPE_NUM_CONSTS * 4];
+
+	struct dummy_vpe_op ops[DUMMY_VPE_NUM_INSTRUCTIONS];
+	bool decoded;
+};
+
+void dummy_vpe_decode(struct dummy_vpe *vpe);
+
+void dummy_vpe_execute(struct dummy_vpe *vpe, unsigned int count,
+		       const float (*attribs)[DUMMY_VPE_NUM_ATTRIBS][4],
+		       float (*exports)[DUMMY_VPE_NUM_EXPORTS][4]);
+
+#define DUMMY_FP_NUM_TEXTURES		16
+
+/*
+ * Texture unit as seen by the TEX stage, @desc is the raw DESC1 word with
+ * the filter and wrap modes. Only the base level of linear uncompressed
+ * textures can be sampled.
+ */
+struct dummy_fp_texture {
+	const uint8_t *base;
+	unsigned int format;
+	unsigned int width;
+	unsigned int height;
+	unsigned int pitch;
+	unsigned int bpp;
+	uint32_t desc;
+};
+
+/*
+ * Fragment pipeline counters of a draw. Every exec bundle is one pass of the
+ * fragment through PSEQ, MFU, TEX, ALU and DW; the larger the ALU buffer of
+ * a program, the fewer fragments the pipeline keeps in flight. The estimated
+ * cost is thus one cycle per bundle and ALU buffer row.
+ */
+struct dummy_fp_stats {
+	unsigned long fragments;
+	unsigned long killed;
+	unsigned long bundles;
+	unsigned long mfu;
+	unsigned long tex;
+	unsigned long alu;
+	unsigned long dw;
+	unsigned long cycles;
+};
+
+/*
+ * Fragment entering the fragment pipeline: the TRAM rows of the vertices of
+ * its primitive and its screen-space barycentric weights. The DW stage fills
+ * in the fx10 colors stored to the render targets.
+ */
+struct dummy_fp_fragment {
+	const uint32_t (*tram[3])[4];
+	float weights[3];
+	float inv_w[3];
+	unsigned int x, y;
+	bool front;
+
+	int color[16][4];
+	uint16_t written;
+};
+
+/*
+ * Fragment program words as uploaded through the FP upload registers. MFU
+ * and ALU instructions are multi-word, their words are stored in the order
+ * of the instruction parts (part0 first), not in upload order.
+ */
+struct dummy_fp {
+	uint32_t pseq[DUMMY_FP_NUM_INSTRUCTIONS];
+	uint32_t mfu_sched[DUMMY_FP_NUM_INSTRUCTIONS];
+	uint32_t mfu[DUMMY_FP_NUM_INSTRUCTIONS * 2];
+	uint32_t tex[DUMMY_FP_NUM_INSTRUCTIONS];
+	uint32_t alu_sched[DUMMY_FP_NUM_INSTRUCTIONS];
+	uint32_t alu[DUMMY_FP_NUM_INSTRUCTIONS * 8];
+	uint32_t alu_complement[DUMMY_FP_NUM_INSTRUCTIONS];
+	uint32_t dw[DUMMY_FP_NUM_INSTRUCTIONS];
+
+	unsigned int pseq_id;
+	unsigned int mfu_sched_id;
+	unsigned int mfu_id;
+	unsigned int tex_id;
+	unsigned int alu_sched_id;
+	unsigned int alu_id;
+	unsigned int alu_complement_id;
+	unsigned int dw_id;
+
+	/* per-draw state, latched by dummy_fp_prepare() */
+	unsigned int exec_nb;
+	unsigned int alu_buffer_size;
+	struct dummy_fp_texture textures[DUMMY_FP_NUM_TEXTURES];
+	struct dummy_fp_stats stats;
+};
+
+/*
+ * Register file of the software GR3D engine. Like for GR2D, registers that
+ * were patched by a relocation carry the resolved CPU pointer. Program and
+ * constant uploads go through FIFO-like upload registers and are captured
+ * into the VPE and FP state.
+ */
+struct dummy_gr3d {
+	uint32_t regs[DUMMY_GR3D_NUM_REGS];
+	uint8_t *addrs[DUMMY_GR3D_NUM_REGS];
+
+	struct dummy_vpe vpe;
+	unsigned int vpe_inst_id;
+	unsigned int vpe_const_id;
+
+	struct dummy_fp fp;
+};
+
+void dummy_gr3d_write(struct dummy_gr3d *gr3d, unsigned int offset,
+		      uint32_t value, uint8_t *addr);
+
+void dummy_fp_prepare(struct dummy_gr3d *gr3d);
+bool dummy_fp_execute(struct dummy_gr3d *gr3d, struct dummy_fp_fragment *frag);
+void dummy_fp_report(struct dummy_gr3d *gr3d);
+
+void *dummy_bo_lookup(uint32_t handle);
+size_t dummy_bo_remaining(const uint8_t *addr);
+
+#endif
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "host1x-private.h"
+
+/*
+ * Waiting for fences of different clients can't block on any single one of
+ * them, the clients are then waited for in turns of this many milliseconds.
+ */
+#define HOST1X_FENCE_WAIT_SLICE	1
+
+static uint64_t host1x_fence_time_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000ull + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Runs the callbacks of all fences that are reached by the syncpoint
+ * @value of the client in the order the fences were signaled, callbacks of
+ * the same fence in the order they were added.
+ */
+static unsigned int host1x_client_dispatch(struct host1x_client *client,
+					   uint32_t value)
+{
+	struct host1x_fence_cb **cbp = &client->callbacks;
+	struct host1x_fence_cb *signaled = NULL, **pos;
+	struct host1x_fence_cb *cb;
+	unsigned int count = 0;
+
+	/* unlink first, callbacks may add new callbacks */
+	while ((cb = *cbp)) {
+		if (!host1x_syncpt_reached(value, cb->fence.value)) {
+			cbp = &cb->next;
+			continue;
+		}
+
+		*cbp = cb->next;
+
+		for (pos = &signaled; *pos; pos = &(*pos)->next)
+			if (!host1x_syncpt_reached(cb->fence.value,
+						   (*pos)->fence.value))
+				break;
+
+		cb->next = *pos;
+		*pos = cb;
+	}
+
+	while ((cb = signaled)) {
+		signaled = cb->next;
+		cb->func(&cb->fence, cb->data);
+		free(cb);
+		count++;
+	}
+
+	return count;
+}
+
+static int host1x_client_read(struct host1x_client *client, uint32_t *value)
+{
+	int err;
+
+	err = client->read(client, value);
+	if (err < 0)
+		return err;
+
+	host1x_client_dispatch(client, *value);
+
+	return 0;
+}
+
+/*
+ * Runs the callbacks of all signaled fences of the client without blocking
+ * and returns how many were run.
+ */
+int host1x_client_poll(struct host1x_client *client)
+{
+	uint32_t value;
+	int err;
+
+	if (!client->callbacks)
+		return 0;
+
+	err = client->read(client, &value);
+	if (err < 0)
+		return err;
+
+	return host1x_client_dispatch(client, value);
+}
+
+/*
+ * Returns 1 if the fence is signaled, 0 if it isn't and a negative error
+ * code if the syncpoint couldn't be read. Never blocks.
+ */
+int host1x_fence_poll(const struct host1x_fence *fence)
+{
+	uint32_t value;
+	int err;
+
+	if (!fence->client)
+		return 1;
+
+	err = host1x_client_read(fence->client, &value);
+	if (err < 0)
+		return err;
+
+	return host1x_syncpt_reached(value, fence->value);
+}
+
+/*
+ * Waits up to @timeout milliseconds for the fence, ~0u waits forever.
+ * Returns -EAGAIN if the fence wasn't signaled in time.
+ */
+int host1x_fence_wait(const struct host1x_fence *fence, uint32_t timeout)
+{
+	uint32_t value;
+	int err;
+
+	if (!fence->client)
+		return 0;
+
+	err = fence->client->wait(fence->client, fence->value, timeout);
+
+	if (fence->client->callbacks &&
+	    fence->client->read(fence->client, &value) == 0)
+		host1x_client_dispatch(fence->client, value);
+
+	return err;
+}
+
+/*
+ * Waits up to @timeout milliseconds until any of the fences is signaled
+ * and stores the index of the first signaled fence in @index. Engines run
+ * their jobs in order, so only the fence closest to its syncpoint needs to
+ * be waited for as long as all fences belong to the same client.
+ */
+int host1x_fence_wait_any(const struct host1x_fence *fences,
+			  unsigned int count, uint32_t timeout,
+			  unsigned int *index)
+{
+	uint64_t deadline = host1x_fence_time_ms() + timeout;
+	const struct host1x_fence *next;
+	uint32_t distance, value, slice;
+	bool shared;
+	unsigned int i;
+	uint64_t now;
+	int err;
+
+	if (!count)
+		return -EINVAL;
+
+	while (true) {
+		shared = true;
+		next = NULL;
+
+		for (i = 0; i < count; i++) {
+			if (!fences[i].client) {
+				*index = i;
+				return 0;
+			}
+
+			err = host1x_client_read(fences[i].client, &value);
+			if (err < 0)
+				return err;
+
+			if (host1x_syncpt_reached(value, fences[i].value)) {
+				*index = i;
+				return 0;
+			}
+
+			if (fences[i].client != fences[0].client)
+				shared = false;
+
+			if (!next || fences[i].value - value < distance) {
+				distance = fences[i].value - value;
+				next = &fences[i];
+			}
+		}
+
+		if (timeout == ~0u) {
+			slice = shared ? ~0u : HOST1X_FENCE_WAIT_SLICE;
+		} else {
+			now = host1x_fence_time_ms();
+			if (timeout == 0 || now >= deadline)
+				return -EAGAIN;
+
+			slice = deadline - now;
+			if (!shared && slice > HOST1X_FENCE_WAIT_SLICE)
+				slice = HOST1X_FENCE_WAIT_SLICE;
+		}
+
+		err = next->client->wait(next->client, next->value, slice);
+		if (err < 0 && err != -EAGAIN && err != -ETIMEDOUT)
+			return err;
+	}
+}
+
+/*
+ * Makes @func run once the fence is signaled. The callback runs right away
+ * if it already is, otherwise from the next poll or wait on a fence of the
+ * same client that observes the signal, or from host1x_client_poll().
+ */
+int host1x_fence_add_callback(const struct host1x_fence *fence,
+			      host1x_fence_func_t func, void *data)
+{
+	struct host1x_fence_cb *cb, **cbp;
+	int err;
+
+	err = host1x_fence_poll(fence);
+	if (err < 0)
+		return err;
+
+	if (err > 0) {
+		func(fence, data);
+		return 0;
+	}
+
+	cb = calloc(1, sizeof(*cb));
+	if (!cb)
+		return -ENOMEM;
+
+	cb->fence = *fence;
+	cb->func = func;
+	cb->data = data;
+
+	for (cbp = &fence->client->callbacks; *cbp; cbp = &(*cbp)->next)
+		;
+
+	*cbp = cb;
+
+	return 0;
+}
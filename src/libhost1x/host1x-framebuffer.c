@@ -29,30 +29,6 @@
 
 #include "host1x-private.h"
 
-#if 0
-static void detile(void *target, struct host1x_pixelbuffer *pb,
-		   unsigned int tx, unsigned int ty)
-{
-	const unsigned int nx = pb->pitch / tx, ny = pb->height / ty;
-	const unsigned int size = tx * ty, pitch = tx * nx;
-	const void *source = pb->bo->ptr;
-	unsigned int i, j, k;
-
-	for (j = 0; j < ny; j++) {
-		for (i = 0; i < nx; i++) {
-			unsigned int to = (j * nx * size) + (i * tx);
-			unsigned int so = (j * nx + i) * size;
-
-			for (k = 0; k < ty; k++) {
-				memcpy(target + to + k * pitch,
-				       source + so + k * tx,
-				       tx);
-			}
-		}
-	}
-}
-#endif
-
 struct host1x_framebuffer *host1x_framebuffer_create(struct host1x *host1x,
 						     unsigned int width,
 						     unsigned int height,
@@ -121,108 +97,115 @@ int host1x_framebuffer_save(struct host1x *host1x,
 			    struct host1x_framebuffer *fb,
 			    const char *path)
 {
-	struct host1x_pixelbuffer *tiled_pixbuf = fb->pixbuf;
-	struct host1x_pixelbuffer *detiled_pixbuf;
+	struct host1x_pixelbuffer *pixbuf = fb->pixbuf;
+	uint8_t *detiled = NULL;
+	unsigned int pitch, i;
 	png_structp png;
 	png_bytep *rows;
 	png_infop info;
-	unsigned int i;
-	void *buffer;
+	uint8_t *buffer;
+	void *map;
 	FILE *fp;
 	int err;
 
-	if (PIX_BUF_FORMAT_BITS(tiled_pixbuf->format) != 32) {
+	if (PIX_BUF_FORMAT_BITS(pixbuf->format) != 32) {
 		host1x_error("%u bits per pixel not supported\n",
-			     PIX_BUF_FORMAT_BITS(tiled_pixbuf->format));
+			     PIX_BUF_FORMAT_BITS(pixbuf->format));
 		return -EINVAL;
 	}
 
-	fp = fopen(path, "wb");
-	if (!fp) {
-		host1x_error("Failed to write `%s'\n", path);
-		return -errno;
-	}
-
-	png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-	if (!png)
-		return -ENOMEM;
-
-	info = png_create_info_struct(png);
-	if (!info)
-		return -ENOMEM;
-
-	if (setjmp(png_jmpbuf(png)))
-		return -EIO;
-
-	png_init_io(png, fp);
+	err = HOST1X_BO_MMAP(pixbuf->bo, &map);
+	if (err < 0)
+		return -EFAULT;
 
-	if (setjmp(png_jmpbuf(png)))
-		return -EIO;
+	err = HOST1X_BO_INVALIDATE(pixbuf->bo, pixbuf->bo->offset,
+				   pixbuf->bo->size - pixbuf->bo->offset);
+	if (err < 0)
+		return -EFAULT;
 
-	png_set_IHDR(png, info, tiled_pixbuf->width, tiled_pixbuf->height,
-		     8, PNG_COLOR_TYPE_RGBA,
-		     PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
-		     PNG_FILTER_TYPE_BASE);
-	png_write_info(png, info);
+	map = (uint8_t *)map + pixbuf->bo->offset;
 
-	if (setjmp(png_jmpbuf(png))) {
-		host1x_error("Failed to write IHDR\n");
-		return -EIO;
-	}
+	/*
+	 * The rows are set up before libpng may longjmp() out, the error
+	 * path below relies on them not changing afterwards.
+	 */
+	if (pixbuf->layout == PIX_BUF_LAYOUT_TILED_16x16) {
+		pitch = pixbuf->width * 4;
 
-	if (tiled_pixbuf->layout == PIX_BUF_LAYOUT_TILED_16x16) {
-		detiled_pixbuf = host1x_pixelbuffer_create(host1x,
-							tiled_pixbuf->width,
-							tiled_pixbuf->height,
-							tiled_pixbuf->width * 4,
-							tiled_pixbuf->format,
-							PIX_BUF_LAYOUT_LINEAR);
-		if (!detiled_pixbuf)
+		detiled = malloc(pitch * pixbuf->height);
+		if (!detiled) {
+			host1x_error("Out-of-memory\n");
 			return -ENOMEM;
+		}
 
-		err = host1x_gr2d_blit(host1x->gr2d,
-				       tiled_pixbuf,
-				       detiled_pixbuf,
-				       0, 0, 0, 0,
-				       tiled_pixbuf->width,
-				       tiled_pixbuf->height);
-		if (err < 0)
-			return -EFAULT;
+		err = host1x_detile_rect(detiled, pitch, map, pixbuf->pitch,
+					 pixbuf->format, 0, 0,
+					 pixbuf->width, pixbuf->height);
+		if (err < 0) {
+			free(detiled);
+			return err;
+		}
+
+		buffer = detiled;
 	} else {
-		detiled_pixbuf = tiled_pixbuf;
+		pitch = pixbuf->pitch;
+		buffer = map;
 	}
 
-	err = HOST1X_BO_MMAP(detiled_pixbuf->bo, &buffer);
-	if (err < 0)
-		return -EFAULT;
-
-	err = HOST1X_BO_INVALIDATE(detiled_pixbuf->bo,
-				   detiled_pixbuf->bo->offset,
-				   detiled_pixbuf->bo->size);
-	if (err < 0)
-		return -EFAULT;
-
-	rows = malloc(detiled_pixbuf->height * sizeof(png_bytep));
+	rows = malloc(pixbuf->height * sizeof(png_bytep));
 	if (!rows) {
 		host1x_error("Out-of-memory\n");
+		free(detiled);
 		return -ENOMEM;
 	}
 
-	for (i = 0; i < detiled_pixbuf->height; i++)
-		rows[detiled_pixbuf->height - i - 1] =
-					buffer + i * detiled_pixbuf->pitch;
+	for (i = 0; i < pixbuf->height; i++)
+		rows[pixbuf->height - i - 1] = buffer + i * pitch;
 
-	png_write_image(png, rows);
+	fp = fopen(path, "wb");
+	if (!fp) {
+		host1x_error("Failed to write `%s'\n", path);
+		err = -errno;
+		goto free_rows;
+	}
 
-	if (setjmp(png_jmpbuf(png)))
-		return -EIO;
+	png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	if (!png) {
+		err = -ENOMEM;
+		goto close_file;
+	}
+
+	info = png_create_info_struct(png);
+	if (!info) {
+		png_destroy_write_struct(&png, NULL);
+		err = -ENOMEM;
+		goto close_file;
+	}
+
+	if (setjmp(png_jmpbuf(png))) {
+		host1x_error("Failed to write `%s'\n", path);
+		png_destroy_write_struct(&png, &info);
+		err = -EIO;
+		goto close_file;
+	}
 
+	png_init_io(png, fp);
+	png_set_IHDR(png, info, pixbuf->width, pixbuf->height,
+		     8, PNG_COLOR_TYPE_RGBA,
+		     PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
+		     PNG_FILTER_TYPE_BASE);
+	png_write_info(png, info);
+	png_write_image(png, rows);
 	png_write_end(png, NULL);
+	png_destroy_write_struct(&png, &info);
 
-	if (detiled_pixbuf != tiled_pixbuf)
-		host1x_pixelbuffer_free(detiled_pixbuf);
+	err = 0;
 
+close_file:
 	fclose(fp);
+free_rows:
+	free(detiled);
+	free(rows);
 
-	return 0;
+	return err;
 }
@@ -55,7 +55,7 @@ static int host1x_gr2d_test(struct host1x_gr2d *gr2d)
 	if (!job)
 		return -ENOMEM;
 
-	pb = HOST1X_JOB_APPEND(job, gr2d->commands, 0);
+	pb = host1x_cmdring_append(gr2d->commands, job);
 	if (!pb) {
 		host1x_job_free(job);
 		return -ENOMEM;
@@ -65,7 +65,7 @@ static int host1x_gr2d_test(struct host1x_gr2d *gr2d)
 	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x000, 0x0001));
 	host1x_pushbuf_push(pb, 0x000001 << 8 | syncpt->id);
 
-	err = HOST1X_CLIENT_SUBMIT(gr2d->client, job);
+	err = host1x_cmdring_submit(gr2d->commands, job);
 	if (err < 0) {
 		host1x_job_free(job);
 		return err;
@@ -73,7 +73,7 @@ static int host1x_gr2d_test(struct host1x_gr2d *gr2d)
 
 	host1x_job_free(job);
 
-	err = HOST1X_CLIENT_FLUSH(gr2d->client, &fence);
+	err = host1x_cmdring_flush(gr2d->commands, &fence);
 	if (err < 0)
 		return err;
 
@@ -88,18 +88,14 @@ int host1x_gr2d_init(struct host1x *host1x, struct host1x_gr2d *gr2d)
 {
 	int err;
 
-	gr2d->commands = HOST1X_BO_CREATE(host1x, 8 * 4096,
-					  NVHOST_BO_FLAG_COMMAND_BUFFER);
+	gr2d->commands = host1x_cmdring_create(host1x, gr2d->client, 4,
+					       8 * 4096);
 	if (!gr2d->commands)
 		return -ENOMEM;
 
-	err = HOST1X_BO_MMAP(gr2d->commands, NULL);
-	if (err < 0)
-		return err;
-
 	gr2d->scratch = HOST1X_BO_CREATE(host1x, 64, NVHOST_BO_FLAG_SCRATCH);
 	if (!gr2d->scratch) {
-		host1x_bo_free(gr2d->commands);
+		host1x_cmdring_free(gr2d->commands);
 		return -ENOMEM;
 	}
 
@@ -116,7 +112,7 @@ int host1x_gr2d_init(struct host1x *host1x, struct host1x_gr2d *gr2d)
 
 void host1x_gr2d_exit(struct host1x_gr2d *gr2d)
 {
-	host1x_bo_free(gr2d->commands);
+	host1x_cmdring_free(gr2d->commands);
 	host1x_bo_free(gr2d->scratch);
 }
 
@@ -139,13 +135,14 @@ int host1x_gr2d_clear_rect(struct host1x_gr2d *gr2d,
 	struct host1x_job *job;
 	unsigned tiled = 0;
 	uint32_t fence;
+	uint32_t *ptr;
 	int err;
 
 	job = HOST1X_JOB_CREATE(syncpt->id, 1);
 	if (!job)
 		return -ENOMEM;
 
-	pb = HOST1X_JOB_APPEND(job, gr2d->commands, 0);
+	pb = host1x_cmdring_append(gr2d->commands, job);
 	if (!pb) {
 		host1x_job_free(job);
 		return -ENOMEM;
@@ -167,32 +164,41 @@ int host1x_gr2d_clear_rect(struct host1x_gr2d *gr2d,
 		return -EINVAL;
 	}
 
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_SETCL(0, 0x51, 0));
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_MASK(0x09, 9));
-	host1x_pushbuf_push(pb, 0x0000003a);
-	host1x_pushbuf_push(pb, 0x00000000);
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_MASK(0x1e, 7));
-	host1x_pushbuf_push(pb, 0x00000000);
-	host1x_pushbuf_push(pb, /* controlmain */
+	ptr = host1x_pushbuf_reserve(pb, 20);
+	if (!ptr) {
+		host1x_job_free(job);
+		return -ENOMEM;
+	}
+
+	*ptr++ = HOST1X_OPCODE_SETCL(0, 0x51, 0);
+	*ptr++ = HOST1X_OPCODE_MASK(0x09, 9);
+	*ptr++ = 0x0000003a;
+	*ptr++ = 0x00000000;
+	*ptr++ = HOST1X_OPCODE_MASK(0x1e, 7);
+	*ptr++ = 0x00000000;
+	*ptr++ = /* controlmain */
 			(PIX_BUF_FORMAT_BYTES(pixbuf->format) >> 1) << 16 |
 			1 << 6 | /* srcsld */
-			1 << 2 /* turbofill */);
-	host1x_pushbuf_push(pb, 0x000000cc);
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_MASK(0x2b, 9));
-	HOST1X_PUSHBUF_RELOCATE(pb, pixbuf->bo, pixbuf->bo->offset, 0);
-	host1x_pushbuf_push(pb, 0xdeadbeef);
-	host1x_pushbuf_push(pb, pixbuf->pitch);
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x35, 1));
-	host1x_pushbuf_push(pb, color);
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x46, 1));
-	host1x_pushbuf_push(pb, tiled << 20); /* tilemode */
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_MASK(0x38, 5));
-	host1x_pushbuf_push(pb, height << 16 | width);
-	host1x_pushbuf_push(pb, y << 16 | x);
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x00, 1));
-	host1x_pushbuf_push(pb, 0x000001 << 8 | syncpt->id);
-
-	err = HOST1X_CLIENT_SUBMIT(gr2d->client, job);
+			1 << 2 /* turbofill */;
+	*ptr++ = 0x000000cc;
+	*ptr++ = HOST1X_OPCODE_MASK(0x2b, 9);
+	HOST1X_PUSHBUF_RELOCATE_WORD(pb, ptr, pixbuf->bo, pixbuf->bo->offset,
+				     0);
+	*ptr++ = 0xdeadbeef;
+	*ptr++ = pixbuf->pitch;
+	*ptr++ = HOST1X_OPCODE_NONINCR(0x35, 1);
+	*ptr++ = color;
+	*ptr++ = HOST1X_OPCODE_NONINCR(0x46, 1);
+	*ptr++ = tiled << 20; /* tilemode */
+	*ptr++ = HOST1X_OPCODE_MASK(0x38, 5);
+	*ptr++ = height << 16 | width;
+	*ptr++ = y << 16 | x;
+	*ptr++ = HOST1X_OPCODE_NONINCR(0x00, 1);
+	*ptr++ = 0x000001 << 8 | syncpt->id;
+
+	host1x_pushbuf_commit(pb, ptr - pb->ptr);
+
+	err = host1x_cmdring_submit(gr2d->commands, job);
 	if (err < 0) {
 		host1x_job_free(job);
 		return err;
@@ -200,7 +206,7 @@ int host1x_gr2d_clear_rect(struct host1x_gr2d *gr2d,
 
 	host1x_job_free(job);
 
-	err = HOST1X_CLIENT_FLUSH(gr2d->client, &fence);
+	err = host1x_cmdring_flush(gr2d->commands, &fence);
 	if (err < 0)
 		return err;
 
@@ -213,12 +219,13 @@ int host1x_gr2d_clear_rect(struct host1x_gr2d *gr2d,
 	return 0;
 }
 
-int host1x_gr2d_blit(struct host1x_gr2d *gr2d,
-		     struct host1x_pixelbuffer *src,
-		     struct host1x_pixelbuffer *dst,
-		     unsigned int sx, unsigned int sy,
-		     unsigned int dx, unsigned int dy,
-		     unsigned int width, int height)
+static int gr2d_blit_submit(struct host1x_gr2d *gr2d,
+			    struct host1x_pixelbuffer *src,
+			    struct host1x_pixelbuffer *dst,
+			    unsigned int sx, unsigned int sy,
+			    unsigned int dx, unsigned int dy,
+			    unsigned int width, int height,
+			    uint32_t *fence)
 {
 	struct host1x_bo *src_orig = src->bo->wrapped ?: src->bo;
 	struct host1x_bo *dst_orig = dst->bo->wrapped ?: dst->bo;
@@ -231,7 +238,7 @@ int host1x_gr2d_blit(struct host1x_gr2d *gr2d,
 	unsigned xdir = 0;
 	unsigned ydir = 0;
 	unsigned bytes;
-	uint32_t fence;
+	uint32_t *ptr;
 	int err;
 
 	if (PIX_BUF_FORMAT_BYTES(src->format) !=
@@ -348,52 +355,60 @@ yflip_setup:
 	if (!job)
 		return -ENOMEM;
 
-	pb = HOST1X_JOB_APPEND(job, gr2d->commands, 0);
+	pb = host1x_cmdring_append(gr2d->commands, job);
 	if (!pb) {
 		host1x_job_free(job);
 		return -ENOMEM;
 	}
 
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_SETCL(0, 0x51, 0));
+	ptr = host1x_pushbuf_reserve(pb, 20);
+	if (!ptr) {
+		host1x_job_free(job);
+		return -ENOMEM;
+	}
+
+	*ptr++ = HOST1X_OPCODE_SETCL(0, 0x51, 0);
 
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_MASK(0x009, 0x9));
-	host1x_pushbuf_push(pb, 0x0000003a); /* trigger */
-	host1x_pushbuf_push(pb, 0x00000000); /* cmdsel */
+	*ptr++ = HOST1X_OPCODE_MASK(0x009, 0x9);
+	*ptr++ = 0x0000003a; /* trigger */
+	*ptr++ = 0x00000000; /* cmdsel */
 
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_MASK(0x01e, 0x7));
-	host1x_pushbuf_push(pb, 0x00000000); /* controlsecond */
+	*ptr++ = HOST1X_OPCODE_MASK(0x01e, 0x7);
+	*ptr++ = 0x00000000; /* controlsecond */
 	/*
 	 * [20:20] source color depth (0: mono, 1: same)
 	 * [17:16] destination color depth (0: 8 bpp, 1: 16 bpp, 2: 32 bpp)
 	 */
-	host1x_pushbuf_push(pb, /* controlmain */
+	*ptr++ = /* controlmain */
 			1 << 20 |
 			(bytes >> 1) << 16 |
-			yflip << 14 | ydir << 10 | xdir << 9);
-	host1x_pushbuf_push(pb, 0x000000cc); /* ropfade */
+			yflip << 14 | ydir << 10 | xdir << 9;
+	*ptr++ = 0x000000cc; /* ropfade */
 
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x046, 1));
+	*ptr++ = HOST1X_OPCODE_NONINCR(0x046, 1);
 	/*
 	 * [20:20] destination write tile mode (0: linear, 1: tiled)
 	 * [ 0: 0] tile mode Y/RGB (0: linear, 1: tiled)
 	 */
-	host1x_pushbuf_push(pb, dst_tiled << 20 | src_tiled); /* tilemode */
-
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_MASK(0x02b, 0xe149));
-	HOST1X_PUSHBUF_RELOCATE(pb, dst->bo, dst->bo->offset, 0);
-	host1x_pushbuf_push(pb, 0xdeadbeef); /* dstba */
-	host1x_pushbuf_push(pb, dst->pitch); /* dstst */
-	HOST1X_PUSHBUF_RELOCATE(pb, src->bo, src->bo->offset, 0);
-	host1x_pushbuf_push(pb, 0xdeadbeef); /* srcba */
-	host1x_pushbuf_push(pb, src->pitch); /* srcst */
-	host1x_pushbuf_push(pb, height << 16 | width); /* dstsize */
-	host1x_pushbuf_push(pb, sy << 16 | sx); /* srcps */
-	host1x_pushbuf_push(pb, dy << 16 | dx); /* dstps */
-
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x000, 1));
-	host1x_pushbuf_push(pb, 0x000001 << 8 | syncpt->id);
+	*ptr++ = dst_tiled << 20 | src_tiled; /* tilemode */
 
-	err = HOST1X_CLIENT_SUBMIT(gr2d->client, job);
+	*ptr++ = HOST1X_OPCODE_MASK(0x02b, 0xe149);
+	HOST1X_PUSHBUF_RELOCATE_WORD(pb, ptr, dst->bo, dst->bo->offset, 0);
+	*ptr++ = 0xdeadbeef; /* dstba */
+	*ptr++ = dst->pitch; /* dstst */
+	HOST1X_PUSHBUF_RELOCATE_WORD(pb, ptr, src->bo, src->bo->offset, 0);
+	*ptr++ = 0xdeadbeef; /* srcba */
+	*ptr++ = src->pitch; /* srcst */
+	*ptr++ = height << 16 | width; /* dstsize */
+	*ptr++ = sy << 16 | sx; /* srcps */
+	*ptr++ = dy << 16 | dx; /* dstps */
+
+	*ptr++ = HOST1X_OPCODE_NONINCR(0x000, 1);
+	*ptr++ = 0x000001 << 8 | syncpt->id;
+
+	host1x_pushbuf_commit(pb, ptr - pb->ptr);
+
+	err = host1x_cmdring_submit(gr2d->commands, job);
 	if (err < 0) {
 		host1x_job_free(job);
 		return err;
@@ -401,7 +416,21 @@ yflip_setup:
 
 	host1x_job_free(job);
 
-	err = HOST1X_CLIENT_FLUSH(gr2d->client, &fence);
+	return host1x_cmdring_flush(gr2d->commands, fence);
+}
+
+int host1x_gr2d_blit(struct host1x_gr2d *gr2d,
+		     struct host1x_pixelbuffer *src,
+		     struct host1x_pixelbuffer *dst,
+		     unsigned int sx, unsigned int sy,
+		     unsigned int dx, unsigned int dy,
+		     unsigned int width, int height)
+{
+	uint32_t fence;
+	int err;
+
+	err = gr2d_blit_submit(gr2d, src, dst, sx, sy, dx, dy, width, height,
+			       &fence);
 	if (err < 0)
 		return err;
 
@@ -414,20 +443,46 @@ yflip_setup:
 	return 0;
 }
 
+/*
+ * Like host1x_gr2d_blit() but returns once the blit is submitted, @fence
+ * is signaled when it is done. The BO guards of @dst aren't checked.
+ */
+int host1x_gr2d_blit_async(struct host1x_gr2d *gr2d,
+			   struct host1x_pixelbuffer *src,
+			   struct host1x_pixelbuffer *dst,
+			   unsigned int sx, unsigned int sy,
+			   unsigned int dx, unsigned int dy,
+			   unsigned int width, int height,
+			   struct host1x_fence *fence)
+{
+	uint32_t value;
+	int err;
+
+	err = gr2d_blit_submit(gr2d, src, dst, sx, sy, dx, dy, width, height,
+			       &value);
+	if (err < 0)
+		return err;
+
+	fence->client = gr2d->client;
+	fence->value = value;
+
+	return 0;
+}
+
 static uint32_t sb_offset(struct host1x_pixelbuffer *pixbuf,
 			  uint32_t xpos, uint32_t ypos)
 {
 	uint32_t offset;
 	uint32_t bytes_per_pixel = PIX_BUF_FORMAT_BYTES(pixbuf->format);
-	uint32_t pixels_per_line = pixbuf->pitch / bytes_per_pixel;
 	uint32_t xb;
 
 	if (pixbuf->layout == PIX_BUF_LAYOUT_LINEAR) {
 		offset = ypos * pixbuf->pitch;
 		offset += xpos * bytes_per_pixel;
 	} else {
+		/* a row of tiles spans 16 lines of the pitch */
 		xb = xpos * bytes_per_pixel;
-		offset = 16 * pixels_per_line * (ypos / 16);
+		offset = 16 * pixbuf->pitch * (ypos / 16);
 		offset += 256 * (xb / 16);
 		offset += 16 * (ypos % 16);
 		offset += xb % 16;
@@ -459,6 +514,7 @@ int host1x_gr2d_surface_blit(struct host1x_gr2d *gr2d,
 	unsigned hfen = 1;
 	unsigned vfen = 1;
 	uint32_t fence;
+	uint32_t *ptr;
 	int err;
 
 	switch (src->layout) {
@@ -581,79 +637,89 @@ int host1x_gr2d_surface_blit(struct host1x_gr2d *gr2d,
 	if (!job)
 		return -ENOMEM;
 
-	pb = HOST1X_JOB_APPEND(job, gr2d->commands, 0);
+	pb = host1x_cmdring_append(gr2d->commands, job);
 	if (!pb) {
 		host1x_job_free(job);
 		return -ENOMEM;
 	}
 
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_SETCL(0, 0x52, 0));
+	ptr = host1x_pushbuf_reserve(pb, 29);
+	if (!ptr) {
+		host1x_job_free(job);
+		return -ENOMEM;
+	}
 
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_MASK(0x009, 0xF09));
-	host1x_pushbuf_push(pb, 0x00000038); /* trigger */
-	host1x_pushbuf_push(pb, 0x00000001); /* cmdsel */
-	host1x_pushbuf_push(pb, FLOAT_TO_FIXED_6_12(inv_scale_y)); /* vdda */
-	host1x_pushbuf_push(pb, FLOAT_TO_FIXED_0_8(sy)); /* vddaini */
-	host1x_pushbuf_push(pb, FLOAT_TO_FIXED_6_12(inv_scale_x)); /* hdda */
-	host1x_pushbuf_push(pb, FLOAT_TO_FIXED_0_8(sx)); /* hddainils */
+	*ptr++ = HOST1X_OPCODE_SETCL(0, 0x52, 0);
 
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_MASK(0x15, 0x787));
+	*ptr++ = HOST1X_OPCODE_MASK(0x009, 0xF09);
+	*ptr++ = 0x00000038; /* trigger */
+	*ptr++ = 0x00000001; /* cmdsel */
+	*ptr++ = FLOAT_TO_FIXED_6_12(inv_scale_y); /* vdda */
+	*ptr++ = FLOAT_TO_FIXED_0_8(sy); /* vddaini */
+	*ptr++ = FLOAT_TO_FIXED_6_12(inv_scale_x); /* hdda */
+	*ptr++ = FLOAT_TO_FIXED_0_8(sx); /* hddainils */
+
+	*ptr++ = HOST1X_OPCODE_MASK(0x15, 0x787);
 	/* CSC RGB -> RGB coefficients */
-	host1x_pushbuf_push(pb,
+	*ptr++ = /* cscfirst */
 			/* cvr */ FLOAT_TO_FIXED_2_7(1.0f) << 12 |
-			/* cub */ FLOAT_TO_FIXED_2_7(1.0f)); /* cscfirst */
-	host1x_pushbuf_push(pb,
+			/* cub */ FLOAT_TO_FIXED_2_7(1.0f);
+	*ptr++ = /* cscsecond */
 			/* cyx */ FLOAT_TO_FIXED_1_7(1.0f) << 24 |
 			/* cur */ FLOAT_TO_FIXED_2_7(0.0f) << 12 |
-			/* cug */ FLOAT_TO_FIXED_1_7(0.0f)); /* cscsecond */
-	host1x_pushbuf_push(pb,
+			/* cug */ FLOAT_TO_FIXED_1_7(0.0f);
+	*ptr++ = /* cscthird */
 			/* cvb */ FLOAT_TO_FIXED_2_7(0.0f) << 16 |
-			/* cvg */ FLOAT_TO_FIXED_1_7(0.0f)); /* cscthird */
+			/* cvg */ FLOAT_TO_FIXED_1_7(0.0f);
 
-	host1x_pushbuf_push(pb, dst_fmt << 8 | src_fmt); /* sbformat */
-	host1x_pushbuf_push(pb, /* controlsb */
-			    hftype << 20 | vfen << 18 | vftype << 16);
-	host1x_pushbuf_push(pb, 0x00000000); /* controlsecond */
+	*ptr++ = dst_fmt << 8 | src_fmt; /* sbformat */
+	*ptr++ = /* controlsb */
+			hftype << 20 | vfen << 18 | vftype << 16;
+	*ptr++ = 0x00000000; /* controlsecond */
 	/*
 	 * [20:20] source color depth (0: mono, 1: same)
 	 * [17:16] destination color depth (0: 8 bpp, 1: 16 bpp, 2: 32 bpp)
 	 */
-	host1x_pushbuf_push(pb, /* controlmain */
+	*ptr++ = /* controlmain */
 			1 << 28 | 1 << 27 |
 			(PIX_BUF_FORMAT_BYTES(dst->format) >> 1) << 16 |
-			yflip << 14);
+			yflip << 14;
 
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_MASK(0x046, 0xD));
+	*ptr++ = HOST1X_OPCODE_MASK(0x046, 0xD);
 	/*
 	 * [20:20] destination write tile mode (0: linear, 1: tiled)
 	 * [ 0: 0] tile mode Y/RGB (0: linear, 1: tiled)
 	 */
-	host1x_pushbuf_push(pb, dst_tiled << 20 | src_tiled); /* tilemode */
-	HOST1X_PUSHBUF_RELOCATE(pb, src->bo,
-				src->bo->offset + sb_offset(src, sx, sy), 0);
-	host1x_pushbuf_push(pb, 0xdeadbeef); /* srcba_sb_surfbase */
-	HOST1X_PUSHBUF_RELOCATE(pb, dst->bo,
-				dst->bo->offset + sb_offset(dst, dx, dy) +
-				yflip * dst->pitch * dst_height, 0);
-	host1x_pushbuf_push(pb, 0xdeadbeef); /* dstba_sb_surfbase */
-
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_MASK(0x02b, 0x3149));
-	HOST1X_PUSHBUF_RELOCATE(pb, dst->bo,
-				dst->bo->offset + sb_offset(dst, dx, dy) +
-				yflip * dst->pitch * dst_height, 0);
-	host1x_pushbuf_push(pb, 0xdeadbeef); /* dstba */
-	host1x_pushbuf_push(pb, dst->pitch); /* dstst */
-	HOST1X_PUSHBUF_RELOCATE(pb, src->bo,
-				src->bo->offset + sb_offset(src, sx, sy), 0);
-	host1x_pushbuf_push(pb, 0xdeadbeef); /* srcba */
-	host1x_pushbuf_push(pb, src->pitch); /* srcst */
-	host1x_pushbuf_push(pb, src_height << 16 | src_width); /* srcsize */
-	host1x_pushbuf_push(pb, dst_height << 16 | dst_width); /* dstsize */
-
-	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x000, 1));
-	host1x_pushbuf_push(pb, 0x000001 << 8 | syncpt->id);
-
-	err = HOST1X_CLIENT_SUBMIT(gr2d->client, job);
+	*ptr++ = dst_tiled << 20 | src_tiled; /* tilemode */
+	HOST1X_PUSHBUF_RELOCATE_WORD(pb, ptr, src->bo,
+				     src->bo->offset + sb_offset(src, sx, sy), 0);
+	*ptr++ = 0xdeadbeef; /* srcba_sb_surfbase */
+	HOST1X_PUSHBUF_RELOCATE_WORD(pb, ptr, dst->bo,
+				     dst->bo->offset +
+				     sb_offset(dst, dx, dy + yflip * dst_height),
+				     0);
+	*ptr++ = 0xdeadbeef; /* dstba_sb_surfbase */
+
+	*ptr++ = HOST1X_OPCODE_MASK(0x02b, 0x3149);
+	HOST1X_PUSHBUF_RELOCATE_WORD(pb, ptr, dst->bo,
+				     dst->bo->offset +
+				     sb_offset(dst, dx, dy + yflip * dst_height),
+				     0);
+	*ptr++ = 0xdeadbeef; /* dstba */
+	*ptr++ = dst->pitch; /* dstst */
+	HOST1X_PUSHBUF_RELOCATE_WORD(pb, ptr, src->bo,
+				     src->bo->offset + sb_offset(src, sx, sy), 0);
+	*ptr++ = 0xdeadbeef; /* srcba */
+	*ptr++ = src->pitch; /* srcst */
+	*ptr++ = src_height << 16 | src_width; /* srcsize */
+	*ptr++ = dst_height << 16 | dst_width; /* dstsize */
+
+	*ptr++ = HOST1X_OPCODE_NONINCR(0x000, 1);
+	*ptr++ = 0x000001 << 8 | syncpt->id;
+
+	host1x_pushbuf_commit(pb, ptr - pb->ptr);
+
+	err = host1x_cmdring_submit(gr2d->commands, job);
 	if (err < 0) {
 		host1x_job_free(job);
 		return err;
@@ -661,7 +727,7 @@ int host1x_gr2d_surface_blit(struct host1x_gr2d *gr2d,
 
 	host1x_job_free(job);
 
-	err = HOST1X_CLIENT_FLUSH(gr2d->client, &fence);
+	err = host1x_cmdring_flush(gr2d->commands, &fence);
 	if (err < 0)
 		return err;
 
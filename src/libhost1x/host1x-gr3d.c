@@ -48,7 +48,7 @@ static int host1x_gr3d_test(struct host1x_gr3d *gr3d)
 	if (!job)
 		return -ENOMEM;
 
-	pb = HOST1X_JOB_APPEND(job, gr3d->commands, 0);
+	pb = host1x_cmdring_append(gr3d->commands, job);
 	if (!pb) {
 		host1x_job_free(job);
 		return -ENOMEM;
@@ -58,7 +58,7 @@ static int host1x_gr3d_test(struct host1x_gr3d *gr3d)
 	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x000, 0x0001));
 	host1x_pushbuf_push(pb, 0x000001 << 8 | syncpt->id);
 
-	err = HOST1X_CLIENT_SUBMIT(gr3d->client, job);
+	err = host1x_cmdring_submit(gr3d->commands, job);
 	if (err < 0) {
 		host1x_job_free(job);
 		return err;
@@ -66,7 +66,7 @@ static int host1x_gr3d_test(struct host1x_gr3d *gr3d)
 
 	host1x_job_free(job);
 
-	err = HOST1X_CLIENT_FLUSH(gr3d->client, &fence);
+	err = host1x_cmdring_flush(gr3d->commands, &fence);
 	if (err < 0)
 		return err;
 
@@ -273,7 +273,7 @@ static int host1x_gr3d_reset(struct host1x_gr3d *gr3d)
 	if (!job)
 		return -ENOMEM;
 
-	pb = HOST1X_JOB_APPEND(job, gr3d->commands, 0);
+	pb = host1x_cmdring_append(gr3d->commands, job);
 	if (!pb)
 		return -ENOMEM;
 
@@ -281,11 +281,11 @@ static int host1x_gr3d_reset(struct host1x_gr3d *gr3d)
 	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x00, 0x01));
 	host1x_pushbuf_push(pb, 0x000001 << 8 | syncpt->id);
 
-	err = HOST1X_CLIENT_SUBMIT(gr3d->client, job);
+	err = host1x_cmdring_submit(gr3d->commands, job);
 	if (err < 0)
 		return err;
 
-	err = HOST1X_CLIENT_FLUSH(gr3d->client, &fence);
+	err = host1x_cmdring_flush(gr3d->commands, &fence);
 	if (err < 0)
 		return err;
 
@@ -300,28 +300,22 @@ int host1x_gr3d_init(struct host1x *host1x, struct host1x_gr3d *gr3d)
 {
 	int err;
 
-	gr3d->commands = host1x_bo_create(host1x, 32 * 4096,
-					  NVHOST_BO_FLAG_COMMAND_BUFFER);
+	gr3d->commands = host1x_cmdring_create(host1x, gr3d->client, 4,
+					       8 * 4096);
 	if (!gr3d->commands)
 		return -ENOMEM;
 
-	err = HOST1X_BO_MMAP(gr3d->commands, NULL);
-	if (err < 0) {
-		host1x_bo_free(gr3d->commands);
-		return err;
-	}
-
 	gr3d->attributes = host1x_bo_create(host1x, 12 * 4096,
 					    NVHOST_BO_FLAG_ATTRIBUTES);
 	if (!gr3d->attributes) {
-		host1x_bo_free(gr3d->commands);
+		host1x_cmdring_free(gr3d->commands);
 		return -ENOMEM;
 	}
 
 	err = HOST1X_BO_MMAP(gr3d->attributes, NULL);
 	if (err < 0) {
 		host1x_bo_free(gr3d->attributes);
-		host1x_bo_free(gr3d->commands);
+		host1x_cmdring_free(gr3d->commands);
 		return err;
 	}
 
@@ -330,7 +324,7 @@ int host1x_gr3d_init(struct host1x *host1x, struct host1x_gr3d *gr3d)
 		if (err < 0) {
 			host1x_error("host1x_gr3d_test() failed: %d\n", err);
 			host1x_bo_free(gr3d->attributes);
-			host1x_bo_free(gr3d->commands);
+			host1x_cmdring_free(gr3d->commands);
 			return err;
 		}
 	}
@@ -338,7 +332,7 @@ int host1x_gr3d_init(struct host1x *host1x, struct host1x_gr3d *gr3d)
 	err = host1x_gr3d_reset(gr3d);
 	if (err < 0) {
 		host1x_bo_free(gr3d->attributes);
-		host1x_bo_free(gr3d->commands);
+		host1x_cmdring_free(gr3d->commands);
 		return err;
 	}
 
@@ -348,7 +342,7 @@ int host1x_gr3d_init(struct host1x *host1x, struct host1x_gr3d *gr3d)
 void host1x_gr3d_exit(struct host1x_gr3d *gr3d)
 {
 	host1x_bo_free(gr3d->attributes);
-	host1x_bo_free(gr3d->commands);
+	host1x_cmdring_free(gr3d->commands);
 }
 
 int host1x_gr3d_triangle(struct host1x_gr3d *gr3d,
@@ -424,7 +418,7 @@ int host1x_gr3d_triangle(struct host1x_gr3d *gr3d,
 	    commands: 103
 	*/
 
-	pb = HOST1X_JOB_APPEND(job, gr3d->commands, 0);
+	pb = host1x_cmdring_append(gr3d->commands, job);
 	if (!pb) {
 		host1x_job_free(job);
 		return -ENOMEM;
@@ -671,7 +665,7 @@ int host1x_gr3d_triangle(struct host1x_gr3d *gr3d,
 	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x00, 0x01));
 	host1x_pushbuf_push(pb, 0x000001 << 8 | syncpt->id);
 
-	err = HOST1X_CLIENT_SUBMIT(gr3d->client, job);
+	err = host1x_cmdring_submit(gr3d->commands, job);
 	if (err < 0) {
 		host1x_job_free(job);
 		return err;
@@ -679,7 +673,7 @@ int host1x_gr3d_triangle(struct host1x_gr3d *gr3d,
 
 	host1x_job_free(job);
 
-	err = HOST1X_CLIENT_FLUSH(gr3d->client, &fence);
+	err = host1x_cmdring_flush(gr3d->commands, &fence);
 	if (err < 0)
 		return err;
 
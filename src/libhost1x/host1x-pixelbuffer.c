@@ -87,6 +87,10 @@ void host1x_pixelbuffer_free(struct host1x_pixelbuffer *pixbuf)
 	free(pixbuf);
 }
 
+/*
+ * Loads @data into the pixelbuffer, converting pitch and layout on the CPU
+ * if they differ.
+ */
 int host1x_pixelbuffer_load_data(struct host1x *host1x,
 				 struct host1x_pixelbuffer *pixbuf,
 				 void *data,
@@ -95,8 +99,11 @@ int host1x_pixelbuffer_load_data(struct host1x *host1x,
 				 enum pixel_format data_format,
 				 enum layout_format data_layout)
 {
-	struct host1x_pixelbuffer *tmp;
-	bool blit = false;
+	unsigned int row_bytes = pixbuf->width;
+	unsigned int rows = pixbuf->height;
+	unsigned int pitch, i;
+	unsigned long size;
+	uint8_t *dst;
 	void *map;
 	int err;
 
@@ -110,52 +117,76 @@ int host1x_pixelbuffer_load_data(struct host1x *host1x,
 		return -1;
 	}
 
-	if (pixbuf->layout != data_layout) {
-		host1x_info("blit cause: pixbuf->layout (%u) != data_layout (%u)\n",
-			    pixbuf->layout, data_layout);
-		blit = true;
-	}
-
-	if (pixbuf->pitch != data_pitch) {
-		host1x_info("blit cause: pixbuf->pitch (%u) != data_pitch (%u)\n",
-			    pixbuf->pitch, data_pitch);
-		blit = true;
+	if (PIX_BUF_FORMAT_COMPRESSED(data_format)) {
+		row_bytes = ALIGN(row_bytes, PIX_BUF_FORMAT_TEXEL_WIDTH(data_format)) /
+			    PIX_BUF_FORMAT_TEXEL_WIDTH(data_format);
+		rows = ALIGN(rows, PIX_BUF_FORMAT_TEXEL_HEIGHT(data_format)) /
+		       PIX_BUF_FORMAT_TEXEL_HEIGHT(data_format);
 	}
 
-	if (blit) {
-		host1x_info("using 2-pass blit-load\n");
+	row_bytes *= PIX_BUF_FORMAT_BYTES(data_format);
 
-		tmp = host1x_pixelbuffer_create(host1x,
-						pixbuf->width, pixbuf->height,
-						data_pitch, data_format,
-						data_layout);
-		if (!tmp)
-			return -1;
-	} else {
-		host1x_info("using direct load\n");
-		tmp = pixbuf;
+	if (data_layout == PIX_BUF_LAYOUT_LINEAR && rows &&
+	    data_size < (unsigned long)data_pitch * (rows - 1) + row_bytes) {
+		host1x_error("invalid: data_size %lu too small for %u rows of pitch %u\n",
+			     data_size, rows, data_pitch);
+		return -1;
 	}
 
-	err = HOST1X_BO_MMAP(tmp->bo, &map);
+	err = HOST1X_BO_MMAP(pixbuf->bo, &map);
 	if (err)
 		return err;
 
-	host1x_info("loading data\n");
-	memcpy(map + tmp->bo->offset, data, data_size);
+	dst = (uint8_t *)map + pixbuf->bo->offset;
 
-	HOST1X_BO_FLUSH(tmp->bo, tmp->bo->offset, data_size);
+	/* tiled data is converted in units of whole tile rows */
+	if (pixbuf->layout == PIX_BUF_LAYOUT_TILED_16x16)
+		size = (unsigned long)pixbuf->pitch * ALIGN(rows, 16);
+	else
+		size = (unsigned long)pixbuf->pitch * rows;
 
-	if (blit) {
-		host1x_info("blitting\n");
-		err = host1x_gr2d_blit(host1x->gr2d, tmp, pixbuf,
-				       0, 0, 0, 0,
+	if (pixbuf->layout == data_layout && pixbuf->pitch == data_pitch) {
+		host1x_info("using direct load\n");
+		size = MIN(size, data_size);
+		memcpy(dst, data, size);
+	} else if (pixbuf->layout == data_layout) {
+		host1x_info("using pitch conversion\n");
+
+		/* a tile row is as contiguous as a line of linear data */
+		if (data_layout == PIX_BUF_LAYOUT_TILED_16x16) {
+			pitch = MIN(pixbuf->pitch, data_pitch) * 16;
+			rows = ALIGN(rows, 16) / 16;
+
+			for (i = 0; i < rows; i++)
+				memcpy(dst + i * pixbuf->pitch * 16,
+				       (uint8_t *)data + i * data_pitch * 16,
+				       pitch);
+		} else {
+			for (i = 0; i < rows; i++)
+				memcpy(dst + i * pixbuf->pitch,
+				       (uint8_t *)data + i * data_pitch,
+				       row_bytes);
+		}
+	} else if (pixbuf->layout == PIX_BUF_LAYOUT_TILED_16x16) {
+		host1x_info("using CPU tiling\n");
+		err = host1x_tile_rect(dst, pixbuf->pitch, data, data_pitch,
+				       data_format, 0, 0,
 				       pixbuf->width, pixbuf->height);
-		host1x_pixelbuffer_free(tmp);
+	} else {
+		host1x_info("using CPU detiling\n");
+		err = host1x_detile_rect(dst, pixbuf->pitch, data, data_pitch,
+					 data_format, 0, 0,
+					 pixbuf->width, pixbuf->height);
 	}
 
+	if (err)
+		return err;
+
+	HOST1X_BO_FLUSH(pixbuf->bo, pixbuf->bo->offset, size);
+
 	host1x_info("success\n");
 
-	return err;
+	return 0;
 }
 
 void host1x_pixelbuffer_setup_guard(struct host1x_pixelbuffer *pixbuf)
@@ -79,6 +79,17 @@ struct host1x_overlay {
 		   bool vsync, bool reflect_y);
 };
 
+/*
+ * Callback that runs once its fence is signaled. Pending callbacks are
+ * checked whenever a fence of the client is polled or waited for.
+ */
+struct host1x_fence_cb {
+	struct host1x_fence_cb *next;
+	struct host1x_fence fence;
+	host1x_fence_func_t func;
+	void *data;
+};
+
 struct host1x_client {
 	struct host1x_syncpt *syncpts;
 	unsigned int num_syncpts;
@@ -87,11 +98,53 @@ struct host1x_client {
 	int (*flush)(struct host1x_client *client, uint32_t *fence);
 	int (*wait)(struct host1x_client *client, uint32_t fence,
 		    uint32_t timeout);
+	int (*read)(struct host1x_client *client, uint32_t *value);
+
+	struct host1x_fence_cb *callbacks;
+};
+
+static inline bool host1x_syncpt_reached(uint32_t value, uint32_t thresh)
+{
+	return (int32_t)(value - thresh) >= 0;
+}
+
+/*
+ * Command buffer segments are reused once the engine signalled the fence of
+ * the last job that was fetched from them. Only the most recently appended
+ * pushbuf of a ring is open; it is closed, and its words are accounted to
+ * the segment, when it's submitted, its job is freed or the next pushbuf is
+ * appended.
+ */
+struct host1x_cmdring_segment {
+	struct host1x_bo *bo;
+	unsigned long used;
+	uint32_t fence;
+	bool pending;
+	bool busy;
 };
 
+struct host1x_cmdring {
+	struct host1x *host1x;
+	struct host1x_client *client;
+
+	struct host1x_cmdring_segment *segments;
+	unsigned int num_segments;
+	unsigned int current;
+	size_t segment_size;
+
+	struct host1x_job *job;
+	unsigned int index;
+};
+
+int host1x_cmdring_wait(struct host1x_cmdring *ring,
+			struct host1x_cmdring_segment *seg);
+void host1x_cmdring_close(struct host1x_cmdring *ring, struct host1x_job *job);
+int host1x_cmdring_grow(struct host1x_cmdring *ring, struct host1x_pushbuf *pb,
+			unsigned long words);
+
 struct host1x_gr2d {
 	struct host1x_client *client;
-	struct host1x_bo *commands;
+	struct host1x_cmdring *commands;
 	struct host1x_bo *scratch;
 };
 
@@ -100,7 +153,7 @@ void host1x_gr2d_exit(struct host1x_gr2d *gr2d);
 
 struct host1x_gr3d {
 	struct host1x_client *client;
-	struct host1x_bo *commands;
+	struct host1x_cmdring *commands;
 	struct host1x_bo *attributes;
 };
 
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * CPU conversion between linear and 16x16 tiled pixel data. A tile is 16
+ * lines of 16 bytes stored contiguously, tiles of a tile row are laid out
+ * left to right and a tile row spans 16 lines of the surface pitch. The
+ * tiling is byte based and doesn't depend on the pixel size; compressed
+ * formats are tiled as rows of 4x4 blocks.
+ *
+ * Rectangles are processed one tile row at a time, full tiles are moved
+ * with one vector load and store per tile line. Large rectangles are split
+ * across threads by tile rows.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HOST1X_TILING_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define HOST1X_TILING_SSE2 1
+#endif
+
+#include "host1x-private.h"
+
+#define TILE_LINE_BYTES			16
+#define TILE_LINES			16
+#define TILE_BYTES			(TILE_LINE_BYTES * TILE_LINES)
+
+/* below that, starting threads costs more than it gains */
+#define TILING_THREADED_MIN_SIZE	(512 * 1024)
+#define TILING_MAX_THREADS		8
+
+struct tiling_job {
+	uint8_t *tiled;
+	uint8_t *linear;
+	unsigned int tiled_pitch;
+	unsigned int linear_pitch;
+
+	/* rectangle within the tiled surface, in bytes and lines */
+	unsigned int xb;
+	unsigned int width;
+	unsigned int y;
+	unsigned int height;
+
+	bool detile;
+
+	/* tile rows handled by one thread */
+	unsigned int first_row;
+	unsigned int last_row;
+};
+
+static inline void tile_line_move(uint8_t *dst, const uint8_t *src)
+{
+#if defined(HOST1X_TILING_NEON)
+	vst1q_u8(dst, vld1q_u8(src));
+#elif defined(HOST1X_TILING_SSE2)
+	_mm_storeu_si128((__m128i *)dst,
+			 _mm_loadu_si128((const __m128i *)src));
+#else
+	memcpy(dst, src, TILE_LINE_BYTES);
+#endif
+}
+
+/* tiles are contiguous and thus aligned as well as the surface is */
+static void tile_full(uint8_t *tile, const uint8_t *linear,
+		      unsigned int pitch)
+{
+	unsigned int i;
+
+	for (i = 0; i < TILE_LINES; i++)
+		tile_line_move(tile + i * TILE_LINE_BYTES, linear + i * pitch);
+}
+
+static void detile_full(uint8_t *linear, const uint8_t *tile,
+			unsigned int pitch)
+{
+	unsigned int i;
+
+	for (i = 0; i < TILE_LINES; i++)
+		tile_line_move(linear + i * pitch, tile + i * TILE_LINE_BYTES);
+}
+
+static void tiling_row(const struct tiling_job *job, unsigned int row)
+{
+	unsigned int y0 = MAX(job->y, row * TILE_LINES);
+	unsigned int y1 = MIN(job->y + job->height, (row + 1) * TILE_LINES);
+	unsigned int end = job->xb + job->width;
+	unsigned int xb = job->xb;
+	unsigned int chunk, y;
+	uint8_t *tile_row;
+	uint8_t *tiled;
+	uint8_t *linear;
+
+	tile_row = job->tiled + row * TILE_LINES * job->tiled_pitch +
+		   (y0 % TILE_LINES) * TILE_LINE_BYTES;
+
+	while (xb < end) {
+		chunk = MIN(end - xb, TILE_LINE_BYTES - xb % TILE_LINE_BYTES);
+		tiled = tile_row + (xb / TILE_LINE_BYTES) * TILE_BYTES +
+			xb % TILE_LINE_BYTES;
+		linear = job->linear + (y0 - job->y) * job->linear_pitch +
+			 xb - job->xb;
+
+		if (chunk == TILE_LINE_BYTES && y1 - y0 == TILE_LINES) {
+			if (job->detile)
+				detile_full(linear, tiled, job->linear_pitch);
+			else
+				tile_full(tiled, linear, job->linear_pitch);
+		} else {
+			for (y = y0; y < y1; y++) {
+				if (job->detile)
+					memcpy(linear, tiled, chunk);
+				else
+					memcpy(tiled, linear, chunk);
+
+				tiled += TILE_LINE_BYTES;
+				linear += job->linear_pitch;
+			}
+		}
+
+		xb += chunk;
+	}
+}
+
+static void *tiling_thread(void *arg)
+{
+	struct tiling_job *job = arg;
+	unsigned int row;
+
+	for (row = job->first_row; row < job->last_row; row++)
+		tiling_row(job, row);
+
+	return NULL;
+}
+
+static unsigned int tiling_num_threads(unsigned long size,
+				       unsigned int rows)
+{
+	const char *str;
+	long num;
+
+	if (size < TILING_THREADED_MIN_SIZE)
+		return 1;
+
+	str = getenv("HOST1X_TILING_THREADS");
+	if (str)
+		num = strtol(str, NULL, 0);
+	else
+		num = sysconf(_SC_NPROCESSORS_ONLN);
+
+	num = MIN(MAX(num, 1), TILING_MAX_THREADS);
+
+	return MIN((unsigned int)num, rows);
+}
+
+static int tiling_run(void *tiled, unsigned int tiled_pitch,
+		      void *linear, unsigned int linear_pitch,
+		      enum pixel_format format,
+		      unsigned int x, unsigned int y,
+		      unsigned int width, unsigned int height,
+		      bool detile)
+{
+	struct tiling_job jobs[TILING_MAX_THREADS];
+	pthread_t threads[TILING_MAX_THREADS];
+	unsigned int bytes = PIX_BUF_FORMAT_BYTES(format);
+	unsigned int first_row, rows, count, started, i;
+	struct tiling_job job;
+
+	if (!bytes) {
+		host1x_error("Invalid format 0x%08x\n", format);
+		return -EINVAL;
+	}
+
+	if (tiled_pitch % TILE_LINE_BYTES) {
+		host1x_error("Tiled pitch %u isn't a multiple of %u\n",
+			     tiled_pitch, TILE_LINE_BYTES);
+		return -EINVAL;
+	}
+
+	/* compressed data is tiled as rows of blocks */
+	if (PIX_BUF_FORMAT_COMPRESSED(format)) {
+		unsigned int tw = PIX_BUF_FORMAT_TEXEL_WIDTH(format);
+		unsigned int th = PIX_BUF_FORMAT_TEXEL_HEIGHT(format);
+
+		if (x % tw || y % th) {
+			host1x_error("Rectangle %ux%u at %u,%u isn't block aligned\n",
+				     width, height, x, y);
+			return -EINVAL;
+		}
+
+		x /= tw;
+		y /= th;
+		width = ALIGN(width, tw) / tw;
+		height = ALIGN(height, th) / th;
+	}
+
+	if ((x + width) * bytes > tiled_pitch) {
+		host1x_error("Rectangle %ux%u at %u,%u exceeds pitch %u\n",
+			     width, height, x, y, tiled_pitch);
+		return -EINVAL;
+	}
+
+	if (!width || !height)
+		return 0;
+
+	job.tiled = tiled;
+	job.linear = linear;
+	job.tiled_pitch = tiled_pitch;
+	job.linear_pitch = linear_pitch;
+	job.xb = x * bytes;
+	job.width = width * bytes;
+	job.y = y;
+	job.height = height;
+	job.detile = detile;
+
+	first_row = y / TILE_LINES;
+	rows = ALIGN(y + height, TILE_LINES) / TILE_LINES - first_row;
+	count = tiling_num_threads((unsigned long)job.width * height, rows);
+
+	for (i = 0; i < count; i++) {
+		jobs[i] = job;
+		jobs[i].first_row = first_row + rows * i / count;
+		jobs[i].last_row = first_row + rows * (i + 1) / count;
+	}
+
+	/* the calling thread takes the first share */
+	for (started = 1; started < count; started++)
+		if (pthread_create(&threads[started], NULL, tiling_thread,
+				   &jobs[started]))
+			break;
+
+	tiling_thread(&jobs[0]);
+
+	/* and the shares of the threads that failed to start */
+	for (i = started; i < count; i++)
+		tiling_thread(&jobs[i]);
+
+	for (i = 1; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	return 0;
+}
+
+int host1x_tile_rect(void *tiled, unsigned int tiled_pitch,
+		     const void *linear, unsigned int linear_pitch,
+		     enum pixel_format format,
+		     unsigned int x, unsigned int y,
+		     unsigned int width, unsigned int height)
+{
+	return tiling_run(tiled, tiled_pitch, (void *)linear, linear_pitch,
+			  format, x, y, width, height, false);
+}
+
+int host1x_detile_rect(void *linear, unsigned int linear_pitch,
+		       const void *tiled, unsigned int tiled_pitch,
+		       enum pixel_format format,
+		       unsigned int x, unsigned int y,
+		       unsigned int width, unsigned int height)
+{
+	return tiling_run((void *)tiled, tiled_pitch, linear, linear_pitch,
+			  format, x, y, width, height, true);
+}
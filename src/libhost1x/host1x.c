@@ -269,6 +269,10 @@ void host1x_job_free(struct host1x_job *job)
 
 	for (i = 0; i < job->num_pushbufs; i++) {
 		struct host1x_pushbuf *pb = &job->pushbufs[i];
+
+		if (pb->ring)
+			host1x_cmdring_close(pb->ring, job);
+
 		free(pb->relocs);
 	}
 
@@ -276,59 +280,107 @@ void host1x_job_free(struct host1x_job *job)
 	free(job);
 }
 
+/*
+ * Make sure that @count more pushbufs can be appended to the job without
+ * reallocating the pushbuf array, which grows geometrically.
+ */
+int host1x_job_reserve_pushbufs(struct host1x_job *job, unsigned int count)
+{
+	struct host1x_pushbuf *pushbufs;
+	unsigned int max = job->max_pushbufs ?: 2;
+
+	if (job->num_pushbufs + count <= job->max_pushbufs)
+		return 0;
+
+	while (max < job->num_pushbufs + count)
+		max *= 2;
+
+	pushbufs = realloc(job->pushbufs, max * sizeof(*pushbufs));
+	if (!pushbufs)
+		return -ENOMEM;
+
+	job->pushbufs = pushbufs;
+	job->max_pushbufs = max;
+
+	return 0;
+}
+
 struct host1x_pushbuf *host1x_job_append(struct host1x_job *job,
 					 struct host1x_bo *bo,
 					 unsigned long offset)
 {
 	struct host1x_pushbuf *pb;
-	size_t size;
 
 	if (!bo->ptr)
 		return NULL;
 
-	size = (job->num_pushbufs + 1) * sizeof(*pb);
-
-	pb = realloc(job->pushbufs, size);
-	if (!pb)
+	if (host1x_job_reserve_pushbufs(job, 1) < 0)
 		return NULL;
 
-	job->pushbufs = pb;
-
 	pb = &job->pushbufs[job->num_pushbufs++];
 	memset(pb, 0, sizeof(*pb));
 
 	pb->ptr = bo->ptr + offset;
+	pb->end = bo->ptr + (bo->size & ~3ul);
 	pb->offset = offset;
 	pb->bo = bo;
 
 	return pb;
 }
 
-int host1x_pushbuf_push(struct host1x_pushbuf *pb, uint32_t word)
+int host1x_pushbuf_grow(struct host1x_pushbuf *pb, unsigned long words)
 {
-	*pb->ptr++ = word;
-	pb->length++;
+	if (pb->ring)
+		return host1x_cmdring_grow(pb->ring, pb, words);
 
-	return 0;
+	host1x_error("pushbuf overflow: %lu + %lu words at offset %lu of %zu "
+		     "bytes\n", pb->length, words, pb->offset, pb->bo->size);
+
+	return -ENOSPC;
 }
 
-int host1x_pushbuf_relocate(struct host1x_pushbuf *pb, struct host1x_bo *target,
-			    unsigned long offset, unsigned long shift)
+/*
+ * Make sure that @count more relocations can be added without reallocating
+ * the relocation array, which grows geometrically.
+ */
+int host1x_pushbuf_reserve_relocs(struct host1x_pushbuf *pb,
+				  unsigned long count)
 {
-	struct host1x_pushbuf_reloc *reloc;
-	size_t size;
+	struct host1x_pushbuf_reloc *relocs;
+	unsigned long max = pb->max_relocs ?: 8;
+
+	if (pb->num_relocs + count <= pb->max_relocs)
+		return 0;
 
-	size = (pb->num_relocs + 1) * sizeof(*reloc);
+	while (max < pb->num_relocs + count)
+		max *= 2;
 
-	reloc = realloc(pb->relocs, size);
-	if (!reloc)
+	relocs = realloc(pb->relocs, max * sizeof(*relocs));
+	if (!relocs)
 		return -ENOMEM;
 
-	pb->relocs = reloc;
+	pb->relocs = relocs;
+	pb->max_relocs = max;
+
+	return 0;
+}
+
+int host1x_pushbuf_relocate_word(struct host1x_pushbuf *pb, uint32_t *word,
+				 struct host1x_bo *target,
+				 unsigned long offset, unsigned long shift)
+{
+	struct host1x_pushbuf_reloc *reloc;
+	int err;
+
+	if (pb->num_relocs == pb->max_relocs) {
+		err = host1x_pushbuf_reserve_relocs(pb, 1);
+		if (err < 0)
+			return err;
+	}
 
 	reloc = &pb->relocs[pb->num_relocs++];
 
-	reloc->source_offset = host1x_bo_get_offset(pb->bo, pb->ptr);
+	reloc->source_offset = host1x_bo_get_offset(pb->bo, word);
 	reloc->target_handle = target->handle;
 	reloc->target_offset = offset;
 	reloc->shift = shift;
@@ -336,6 +388,12 @@ int host1x_pushbuf_relocate(struct host1x_pushbuf *pb, struct host1x_bo *target,
 	return 0;
 }
 
+int host1x_pushbuf_relocate(struct host1x_pushbuf *pb, struct host1x_bo *target,
+			    unsigned long offset, unsigned long shift)
+{
+	return host1x_pushbuf_relocate_word(pb, pb->ptr, target, offset, shift);
+}
+
 int host1x_client_submit(struct host1x_client *client, struct host1x_job *job)
 {
 	return client->submit(client, job);
@@ -356,6 +356,14 @@ static int nvhost_client_wait(struct host1x_client *client, uint32_t fence,
 	return 0;
 }
 
+static int nvhost_client_read(struct host1x_client *client, uint32_t *value)
+{
+	struct nvhost_client *nvhost = to_nvhost_client(client);
+
+	return nvhost_ctrl_read_syncpt(nvhost->ctrl, client->syncpts[0].id,
+				       value);
+}
+
 int nvhost_client_init(struct nvhost_client *client, struct nvmap *nvmap,
 		       struct nvhost_ctrl *ctrl, int fd)
 {
@@ -389,6 +397,7 @@ int nvhost_client_init(struct nvhost_client *client, struct nvmap *nvmap,
 	client->base.submit = nvhost_client_submit;
 	client->base.flush = nvhost_client_flush;
 	client->base.wait = nvhost_client_wait;
+	client->base.read = nvhost_client_read;
 
 	return 0;
 }
@@ -346,6 +346,7 @@ void cdma_parse_commands(uint32_t *commands, unsigned int count,
 		default:
 			if (print)
 				printf("\n");
+			stream.position++;
 			break;
 		}
 	}
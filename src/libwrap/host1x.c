@@ -33,6 +33,7 @@
 
 #include "cdma_parser.h"
 #include "disasm.h"
+#include "hash.h"
 #include "host1x.h"
 #include "syscall.h"
 #include "recorder.h"
@@ -55,6 +56,8 @@ struct drm_context {
 struct host1x_file {
 	struct list_head bos;
 	struct list_head contexts;
+	struct hash_table bo_table;
+	struct hash_table context_table;
 	struct file file;
 
 	struct rec_ctx *rec_ctx;
@@ -64,6 +67,7 @@ struct host1x_bo {
 	int id;
 	size_t size;
 	char *mapped;
+	uint64_t offset;
 
 	struct list_head list;
 
@@ -121,26 +125,34 @@ static struct host1x_bo *host1x_bo_new(struct host1x_file *host1x,
 	return bo;
 }
 
-static void host1x_bo_free(struct host1x_bo *bo)
+static void host1x_bo_free(struct host1x_file *host1x, struct host1x_bo *bo)
 {
 	if (bo->mapped)
 		munmap_orig(bo->mapped, bo->size);
 
+	if (hash_table_lookup(&host1x->bo_table, bo->id) == bo)
+		hash_table_remove(&host1x->bo_table, bo->id);
+
 	record_destroy_bo(bo->rec_bo);
 	list_del(&bo->list);
 	free(bo);
 }
 
-static struct host1x_bo *host1x_file_lookup_bo(struct host1x_file *host1x,
-					       unsigned long id)
+static void host1x_file_add_bo(struct host1x_file *host1x,
+			       struct host1x_bo *bo)
 {
-	struct host1x_bo *bo;
+	if (hash_table_insert(&host1x->bo_table, bo->id, bo) < 0) {
+		fprintf(stderr, "out of memory\n");
+		abort();
+	}
 
-	list_for_each_entry(bo, &host1x->bos, list)
-		if (bo->id == id)
-			return bo;
+	list_add_tail(&bo->list, &host1x->bos);
+}
 
-	return NULL;
+static struct host1x_bo *host1x_file_lookup_bo(struct host1x_file *host1x,
+					       unsigned long id)
+{
+	return hash_table_lookup(&host1x->bo_table, id);
 }
 
 static struct drm_context *host1x_context_new(unsigned long id, uint32_t client)
@@ -159,8 +171,12 @@ static struct drm_context *host1x_context_new(unsigned long id, uint32_t client)
 	return ctx;
 }
 
-static void host1x_context_free(struct drm_context *ctx)
+static void host1x_context_free(struct host1x_file *host1x,
+				struct drm_context *ctx)
 {
+	if (hash_table_lookup(&host1x->context_table, ctx->id) == ctx)
+		hash_table_remove(&host1x->context_table, ctx->id);
+
 	record_job_ctx_destroy(ctx->rec_job_ctx);
 	list_del(&ctx->list);
 	free(ctx);
@@ -169,13 +185,7 @@ static void host1x_context_free(struct drm_context *ctx)
 static struct drm_context *host1x_file_lookup_context(struct host1x_file *host1x,
 						       unsigned long id)
 {
-	struct drm_context *ctx;
-
-	list_for_each_entry(ctx, &host1x->contexts, list)
-		if (ctx->id == id)
-			return ctx;
-
-	return NULL;
+	return hash_table_lookup(&host1x->context_table, id);
 }
 
 static void host1x_gem_flags_to_string(char *str, uint32_t flags)
@@ -458,10 +468,12 @@ static int host1x_file_enter_ioctl(struct file *file, unsigned long request,
 		break;
 
 	case DRM_IOCTL_TEGRA_SYNCPT_WAIT:
+		record_call_enter(REC_CALL_WAIT);
 		host1x_file_enter_ioctl_syncpt_wait(host1x, arg);
 		break;
 
 	case DRM_IOCTL_TEGRA_SUBMIT:
+		record_call_enter(REC_CALL_GPU);
 		host1x_file_enter_ioctl_submit(host1x, arg);
 		break;
 
@@ -474,14 +486,17 @@ static int host1x_file_enter_ioctl(struct file *file, unsigned long request,
 		break;
 
 	case DRM_IOCTL_MODE_SETPLANE:
+		record_call_enter(REC_CALL_GPU);
 		host1x_file_enter_ioctl_mode_setplane(host1x, arg);
 		break;
 
 	case DRM_IOCTL_MODE_SETCRTC:
+		record_call_enter(REC_CALL_GPU);
 		host1x_file_enter_ioctl_mode_setcrtc(host1x, arg);
 		break;
 
 	case DRM_IOCTL_MODE_PAGE_FLIP:
+		record_call_enter(REC_CALL_GPU);
 		host1x_file_enter_ioctl_mode_page_flip(host1x, arg);
 		break;
 
@@ -515,7 +530,7 @@ static void host1x_file_leave_ioctl_gem_create(struct host1x_file *host1x,
 		abort();
 	}
 
-	list_add_tail(&bo->list, &host1x->bos);
+	host1x_file_add_bo(host1x, bo);
 }
 
 static void host1x_file_leave_ioctl_gem_mmap(struct host1x_file *host1x,
@@ -533,6 +548,8 @@ static void host1x_file_leave_ioctl_gem_mmap(struct host1x_file *host1x,
 		abort();
 	}
 
+	bo->offset = args->offset;
+
 	if (!bo->mapped) {
 		bo->mapped = mmap_orig(NULL, bo->size, PROT_READ,
 					   MAP_SHARED, host1x->file.fd,
@@ -594,6 +611,11 @@ static void host1x_file_leave_ioctl_open_channel(struct host1x_file *host1x,
 		abort();
 	}
 
+	if (hash_table_insert(&host1x->context_table, ctx->id, ctx) < 0) {
+		fprintf(stderr, "out of memory\n");
+		abort();
+	}
+
 	list_add_tail(&ctx->list, &host1x->contexts);
 }
 
@@ -611,7 +633,7 @@ static void host1x_file_leave_ioctl_close_channel(struct host1x_file *host1x,
 		abort();
 	}
 
-	host1x_context_free(ctx);
+	host1x_context_free(host1x, ctx);
 }
 
 static void host1x_file_leave_ioctl_get_syncpt(struct host1x_file *host1x,
@@ -688,7 +710,7 @@ static void host1x_file_leave_ioctl_create_dumb(struct host1x_file *host1x,
 		abort();
 	}
 
-	list_add_tail(&bo->list, &host1x->bos);
+	host1x_file_add_bo(host1x, bo);
 }
 
 static void host1x_file_leave_ioctl_mmap_dumb(struct host1x_file *host1x,
@@ -706,6 +728,8 @@ static void host1x_file_leave_ioctl_mmap_dumb(struct host1x_file *host1x,
 		abort();
 	}
 
+	bo->offset = args->offset;
+
 	if (!bo->mapped) {
 		bo->mapped = mmap_orig(NULL, bo->size, PROT_READ,
 					   MAP_SHARED, host1x->file.fd,
@@ -730,7 +754,7 @@ static void host1x_file_leave_ioctl_destroy_dumb(struct host1x_file *host1x,
 		abort();
 	}
 
-	host1x_bo_free(bo);
+	host1x_bo_free(host1x, bo);
 }
 
 static void host1x_file_leave_ioctl_gem_close(struct host1x_file *host1x,
@@ -747,7 +771,7 @@ static void host1x_file_leave_ioctl_gem_close(struct host1x_file *host1x,
 		abort();
 	}
 
-	host1x_bo_free(bo);
+	host1x_bo_free(host1x, bo);
 }
 
 static void host1x_file_leave_ioctl_addfb(struct host1x_file *host1x,
@@ -848,7 +872,7 @@ static void host1x_file_leave_ioctl_gem_open(struct host1x_file *host1x,
 		abort();
 	}
 
-	list_add_tail(&bo->list, &host1x->bos);
+	host1x_file_add_bo(host1x, bo);
 }
 
 static int host1x_file_leave_ioctl(struct file *file, unsigned long request,
@@ -871,6 +895,7 @@ static int host1x_file_leave_ioctl(struct file *file, unsigned long request,
 
 	case DRM_IOCTL_TEGRA_SYNCPT_WAIT:
 		host1x_file_leave_ioctl_syncpt_wait(host1x, arg);
+		record_call_leave(REC_CALL_WAIT);
 		break;
 
 	case DRM_IOCTL_TEGRA_OPEN_CHANNEL:
@@ -887,6 +912,7 @@ static int host1x_file_leave_ioctl(struct file *file, unsigned long request,
 
 	case DRM_IOCTL_TEGRA_SUBMIT:
 		host1x_file_leave_ioctl_submit(host1x, arg);
+		record_call_leave(REC_CALL_GPU);
 		break;
 
 	case DRM_IOCTL_TEGRA_GET_SYNCPT_BASE:
@@ -929,6 +955,12 @@ static int host1x_file_leave_ioctl(struct file *file, unsigned long request,
 		host1x_file_leave_ioctl_gem_open(host1x, arg);
 		break;
 
+	case DRM_IOCTL_MODE_SETPLANE:
+	case DRM_IOCTL_MODE_SETCRTC:
+	case DRM_IOCTL_MODE_PAGE_FLIP:
+		record_call_leave(REC_CALL_GPU);
+		break;
+
 	default:
 		break;
 	}
@@ -943,10 +975,13 @@ static void host1x_file_release(struct file *file)
 	struct drm_context *ctx, *ctx_tmp;
 
 	list_for_each_entry_safe(bo, bo_tmp, &host1x->bos, list)
-		host1x_bo_free(bo);
+		host1x_bo_free(host1x, bo);
 
 	list_for_each_entry_safe(ctx, ctx_tmp, &host1x->contexts, list)
-		host1x_context_free(ctx);
+		host1x_context_free(host1x, ctx);
+
+	hash_table_fini(&host1x->bo_table);
+	hash_table_fini(&host1x->context_table);
 
 	record_destroy_ctx(host1x->rec_ctx);
 
@@ -954,9 +989,28 @@ static void host1x_file_release(struct file *file)
 	free(host1x);
 }
 
+/* writes of the application to its BO mappings are tracked for recording */
+static void host1x_file_mmap(struct file *file, void *addr, size_t length,
+			     int prot, int flags, off_t offset)
+{
+	struct host1x_file *host1x = to_host1x_file(file);
+	struct host1x_bo *bo;
+
+	if (!(prot & PROT_WRITE) || !(flags & MAP_SHARED))
+		return;
+
+	list_for_each_entry(bo, &host1x->bos, list) {
+		if (bo->mapped && bo->offset == (uint64_t)offset) {
+			record_track_bo_writes(bo->rec_bo, addr, length);
+			return;
+		}
+	}
+}
+
 static const struct file_ops host1x_file_ops = {
 	.enter_ioctl = host1x_file_enter_ioctl,
 	.leave_ioctl = host1x_file_leave_ioctl,
+	.mmap = host1x_file_mmap,
 	.release = host1x_file_release,
 };
 
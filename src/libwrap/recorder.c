@@ -23,6 +23,9 @@
 
 #define _LARGEFILE64_SOURCE
 
+#include <sched.h>
+#include <sys/mman.h>
+
 #ifdef ENABLE_ZLIB
 #include <zlib.h>
 #endif
@@ -44,92 +47,738 @@ static unsigned long calc_page_checksum(void *page_data, size_t size)
 	return 0;
 }
 
-static void record_write_data(void *data, size_t size)
+#ifdef ENABLE_ZLIB
+static size_t compress_data_zlib(z_stream *strm, void *in, void *out,
+				 size_t in_size, size_t out_size)
+{
+	int ret;
+
+	ret = deflateReset(strm);
+	assert(ret == Z_OK);
+
+	strm->avail_in = in_size;
+	strm->next_in = in;
+	strm->avail_out = out_size;
+	strm->next_out = out;
+
+	ret = deflate(strm, Z_FINISH);
+
+	/* incompressible data doesn't fit, it's stored uncompressed */
+	if (ret == Z_OK || ret == Z_BUF_ERROR)
+		return 0;
+
+	if (ret != Z_STREAM_END) {
+		fprintf(stderr, "%s: ERROR: deflate failed: %d\n",
+			__func__, ret);
+		abort();
+	}
+
+	if (strm->total_out >= in_size)
+		return 0;
+
+	return strm->total_out;
+}
+#endif
+
+#ifdef ENABLE_LZ4
+static size_t compress_data_lz4(void *in, void *out,
+				size_t in_size, size_t out_size)
+{
+	return LZ4_compress_default(in, out, in_size, out_size);
+}
+#endif
+
+/* compression state of a worker, set up once per thread */
+struct rec_compressor {
+#ifdef ENABLE_ZLIB
+	z_stream strm;
+#endif
+};
+
+static size_t compress_data(struct rec_compressor *comp, void *in, void *out,
+			    size_t in_size, size_t out_size)
+{
+#ifdef ENABLE_LZ4
+	if (compression == REC_LZ4)
+		return compress_data_lz4(in, out, in_size, out_size);
+#endif
+
+#ifdef ENABLE_ZLIB
+	if (compression == REC_ZLIB)
+		return compress_data_zlib(&comp->strm, in, out,
+					  in_size, out_size);
+#endif
+
+	return 0;
+}
+
+static inline uint64_t record_rotl(uint64_t x, unsigned int r)
 {
-	int ret = fwrite(data, size, 1, rec.fout);
+	return (x << r) | (x >> (64 - r));
+}
+
+/*
+ * Content hash of a page for the deduplication. The key and the check are
+ * two independent 64bit hashes, pages are only considered equal if both
+ * match.
+ */
+static void record_page_hash(const uint8_t *data, uint64_t *hash,
+			     uint64_t *check)
+{
+	uint64_t h1 = 0x9e3779b97f4a7c15ull;
+	uint64_t h2 = 0xc2b2ae3d27d4eb4full;
+	unsigned int i;
+	uint64_t word;
+
+	for (i = 0; i < 4096; i += sizeof(word)) {
+		memcpy(&word, data + i, sizeof(word));
+
+		h1 = record_rotl(h1 ^ word, 31) * 0xff51afd7ed558ccdull;
+		h2 = record_rotl(h2 + word, 27) * 0xc4ceb9fe1a85ec53ull;
+	}
+
+	h1 ^= h1 >> 33;
+	h1 *= 0xff51afd7ed558ccdull;
+	h1 ^= h1 >> 33;
+
+	h2 ^= h2 >> 29;
+	h2 *= 0xc4ceb9fe1a85ec53ull;
+	h2 ^= h2 >> 32;
+
+	*hash = h1;
+	*check = h2;
+}
+
+static void *record_grow(void *array, unsigned int *max, size_t size)
+{
+	*max = *max ? *max * 2 : 256;
+
+	array = realloc(array, *max * size);
+	assert(array != NULL);
+
+	return array;
+}
+
+/*
+ * The application thread doesn't compress or write anything. Actions are
+ * appended to the chunk that is being filled and loaded pages are copied
+ * into the arena of the chunk. Sealed chunks are compressed by the workers
+ * and written out in order by the writer thread, while the application
+ * fills the other chunk.
+ */
+static void record_write_file(const void *data, size_t size)
+{
+	int ret;
+
+	if (!size)
+		return;
+
+	ret = fwrite(data, size, 1, rec.fout);
 	if (ret != 1) {
 		fprintf(stderr, "%s: size %zu: Failed: %d (%s)\n",
 			__func__, size, ret, strerror(errno));
 		abort();
 	}
+
+	rec.offset += size;
 }
 
-static void record_write_action(struct record_act *r)
+/* called by the writer, resolves the record offset that the mark stands for */
+static void record_resolve_mark(struct rec_mark *mark)
 {
-	size_t size = sizeof(r->act);
-	void *data = r;
+	struct record_keyframe *keyframe;
+	struct record_act r;
+	uint64_t end;
 
-	switch (r->act) {
-	case REC_START:
-		size += sizeof(r->data.header);
-		break;
+	pthread_mutex_lock(&rec.index_lock);
 
-	case REC_INFO:
-		size += sizeof(r->data.record_info);
+	switch (mark->type) {
+	case REC_MARK_FRAME:
+		rec.frames[mark->index] = rec.offset;
 		break;
 
-	case REC_CTX_CREATE:
-		size += sizeof(r->data.ctx_create);
+	case REC_MARK_KEYFRAME_START:
+		rec.keyframes[mark->index].offset = rec.offset;
 		break;
 
-	case REC_CTX_DESTROY:
-		size += sizeof(r->data.ctx_destroy);
-		break;
+	case REC_MARK_KEYFRAME_END:
+		/* patch the size of the keyframe into its action */
+		keyframe = &rec.keyframes[mark->index];
+		end = rec.offset;
 
-	case REC_BO_CREATE:
-		size += sizeof(r->data.bo_create);
-		break;
+		r.act = REC_KEYFRAME;
+		r.data.keyframe.frame = keyframe->frame;
+		r.data.keyframe.size = end - keyframe->offset -
+				       sizeof(r.act) - sizeof(r.data.keyframe);
 
-	case REC_BO_DESTROY:
-		size += sizeof(r->data.bo_destroy);
-		break;
+		fseeko64(rec.fout, keyframe->offset, SEEK_SET);
+		record_write_file(&r, sizeof(r.act) + sizeof(r.data.keyframe));
+		fseeko64(rec.fout, end, SEEK_SET);
 
-	case REC_BO_LOAD_DATA:
-		size += sizeof(r->data.bo_load);
+		rec.offset = end;
 		break;
+	}
 
-	case REC_BO_SET_FLAGS:
-		size += sizeof(r->data.bo_set_flags);
-		break;
+	pthread_mutex_unlock(&rec.index_lock);
+}
 
-	case REC_ADD_FRAMEBUFFER:
-		size += sizeof(r->data.add_framebuffer);
-		break;
+/*
+ * Pages whose content is in the record already are written as a reference
+ * to the action that holds the data.
+ */
+static bool record_write_page_ref(struct rec_chunk_page *page)
+{
+	struct rec_page_ref *ref;
+	struct record_act r;
+	int err;
 
-	case REC_DEL_FRAMEBUFFER:
-		size += sizeof(r->data.del_framebuffer);
-		break;
+	ref = hash_table_lookup(&rec.page_refs, page->hash);
 
-	case REC_DISP_FRAMEBUFFER:
-		size += sizeof(r->data.disp_framebuffer);
-		break;
+	if (ref && ref->check == page->check) {
+		r.act = REC_BO_LOAD_REF;
+		r.data.bo_load_ref.id = page->r.data.bo_load.id;
+		r.data.bo_load_ref.ctx_id = page->r.data.bo_load.ctx_id;
+		r.data.bo_load_ref.page_id = page->r.data.bo_load.page_id;
+		r.data.bo_load_ref.offset = ref->offset;
 
-	case REC_JOB_CTX_CREATE:
-		size += sizeof(r->data.job_ctx_create);
-		break;
+		record_write_file(&r, sizeof(r.act) +
+				  sizeof(r.data.bo_load_ref));
+		return true;
+	}
 
-	case REC_JOB_CTX_DESTROY:
-		size += sizeof(r->data.job_ctx_destroy);
-		break;
+	if (!ref) {
+		ref = malloc(sizeof(*ref));
+		assert(ref != NULL);
 
-	case REC_JOB_SUBMIT:
-		size += sizeof(r->data.job_submit);
-		break;
+		err = hash_table_insert(&rec.page_refs, page->hash, ref);
+		assert(err == 0);
+	}
+
+	/* the page is written next, later copies refer to it */
+	ref->check = page->check;
+	ref->offset = rec.offset;
+
+	return false;
+}
+
+static void record_write_chunk(struct rec_chunk *chunk)
+{
+	struct rec_chunk_page *page;
+	struct rec_mark *mark;
+	unsigned int p = 0, m = 0;
+	size_t pos = 0;
+	uint16_t size;
+
+	while (p < chunk->num_pages || m < chunk->num_marks) {
+		/* marks go before the pages that were queued after them */
+		if (m < chunk->num_marks && chunk->marks[m].num_pages <= p) {
+			mark = &chunk->marks[m++];
+
+			record_write_file(chunk->data + pos, mark->pos - pos);
+			pos = mark->pos;
+
+			record_resolve_mark(mark);
+			continue;
+		}
+
+		page = &chunk->pages[p];
+		size = page->r.data.bo_load.data_size;
+
+		record_write_file(chunk->data + pos, page->pos - pos);
+		pos = page->pos;
+
+		if (record_write_page_ref(page)) {
+			p++;
+			continue;
+		}
+
+		record_write_file(&page->r, sizeof(page->r.act) +
+				  sizeof(page->r.data.bo_load));
+
+		/* size 0 means go uncompressed */
+		record_write_file(size ? page->compressed : chunk->arena[p].data,
+				  size ?: 4096);
+		p++;
+	}
+
+	record_write_file(chunk->data + pos, chunk->size - pos);
+}
+
+static void *record_writer(void *arg)
+{
+	struct rec_chunk *chunk;
+
+	pthread_mutex_lock(&rec.pipe_lock);
+
+	for (;;) {
+		if (rec.written == rec.sealed) {
+			if (rec.stop)
+				break;
+
+			pthread_cond_wait(&rec.pipe_done, &rec.pipe_lock);
+			continue;
+		}
+
+		chunk = &rec.chunks[rec.written % REC_NUM_CHUNKS];
+
+		if (chunk->compressed < chunk->num_pages) {
+			pthread_cond_wait(&rec.pipe_done, &rec.pipe_lock);
+			continue;
+		}
+
+		pthread_mutex_unlock(&rec.pipe_lock);
+
+		record_write_chunk(chunk);
+
+		pthread_mutex_lock(&rec.pipe_lock);
+
+		/* workers look at all chunks in flight, reset it locked */
+		chunk->size = 0;
+		chunk->num_pages = 0;
+		chunk->num_marks = 0;
+		chunk->claimed = 0;
+		chunk->compressed = 0;
+
+		rec.written++;
+		pthread_cond_signal(&rec.pipe_free);
+	}
 
-	default:
+	pthread_mutex_unlock(&rec.pipe_lock);
+
+	return NULL;
+}
+
+/*
+ * Workers claim batches of pages of the oldest sealed chunk that has pages
+ * left. The compression state is reused for all pages of a worker instead
+ * of being set up for every page.
+ */
+static void *record_worker(void *arg)
+{
+	struct rec_compressor comp;
+	struct rec_chunk *chunk;
+	unsigned int first, count, i;
+	unsigned long seq;
+
+#ifdef ENABLE_ZLIB
+	memset(&comp.strm, 0, sizeof(comp.strm));
+
+	if (deflateInit(&comp.strm, Z_BEST_SPEED) != Z_OK) {
+		fprintf(stderr, "%s: ERROR: deflateInit failed\n", __func__);
+		abort();
+	}
+#endif
+
+	pthread_mutex_lock(&rec.pipe_lock);
+
+	for (;;) {
+		chunk = NULL;
+
+		for (seq = rec.written; seq < rec.sealed; seq++) {
+			chunk = &rec.chunks[seq % REC_NUM_CHUNKS];
+
+			if (chunk->claimed < chunk->num_pages)
+				break;
+
+			chunk = NULL;
+		}
+
+		if (!chunk) {
+			if (rec.stop)
+				break;
+
+			pthread_cond_wait(&rec.pipe_work, &rec.pipe_lock);
+			continue;
+		}
+
+		first = chunk->claimed;
+		count = chunk->num_pages - first;
+		if (count > REC_WORKER_BATCH)
+			count = REC_WORKER_BATCH;
+
+		chunk->claimed += count;
+
+		pthread_mutex_unlock(&rec.pipe_lock);
+
+		for (i = first; i < first + count; i++) {
+			struct rec_chunk_page *page = &chunk->pages[i];
+
+			record_page_hash(chunk->arena[i].data, &page->hash,
+					 &page->check);
+
+			page->r.data.bo_load.data_size =
+				compress_data(&comp, chunk->arena[i].data,
+					      page->compressed, 4096,
+					      sizeof(page->compressed));
+		}
+
+		pthread_mutex_lock(&rec.pipe_lock);
+
+		chunk->compressed += count;
+		if (chunk->compressed == chunk->num_pages)
+			pthread_cond_signal(&rec.pipe_done);
+	}
+
+	pthread_mutex_unlock(&rec.pipe_lock);
+
+#ifdef ENABLE_ZLIB
+	deflateEnd(&comp.strm);
+#endif
+
+	return NULL;
+}
+
+static struct rec_chunk *record_chunk(void)
+{
+	return &rec.chunks[rec.sealed % REC_NUM_CHUNKS];
+}
+
+/*
+ * Hands the filled chunk over to the workers and the writer, blocks while
+ * the other chunk is still in flight.
+ */
+static void record_seal_chunk(void)
+{
+	struct rec_chunk *chunk = record_chunk();
+
+	if (!chunk->size && !chunk->num_pages && !chunk->num_marks)
+		return;
+
+	pthread_mutex_lock(&rec.pipe_lock);
+
+	rec.sealed++;
+	pthread_cond_broadcast(&rec.pipe_work);
+	pthread_cond_signal(&rec.pipe_done);
+
+	while (rec.sealed - rec.written >= REC_NUM_CHUNKS)
+		pthread_cond_wait(&rec.pipe_free, &rec.pipe_lock);
+
+	pthread_mutex_unlock(&rec.pipe_lock);
+}
+
+static void record_write_data(void *data, size_t size)
+{
+	struct rec_chunk *chunk = record_chunk();
+
+	if (chunk->size + size > chunk->max_size) {
+		while (chunk->size + size > chunk->max_size)
+			chunk->max_size = chunk->max_size ?
+					  chunk->max_size * 2 : REC_CHUNK_SIZE;
+
+		chunk->data = realloc(chunk->data, chunk->max_size);
+		assert(chunk->data != NULL);
+	}
+
+	memcpy(chunk->data + chunk->size, data, size);
+	chunk->size += size;
+
+	if (chunk->size >= REC_CHUNK_SIZE)
+		record_seal_chunk();
+}
+
+static void record_write_action(struct record_act *r)
+{
+	size_t size = record_action_size(r->act);
+
+	if (!size) {
 		fprintf(stderr, "%s: ERROR: invalid action %u\n",
 			__func__, r->act);
 		abort();
 	}
 
-	record_write_data(data, size);
+	record_write_data(r, sizeof(r->act) + size);
+}
+
+/* the mark is resolved once everything written before it is in the file */
+static void record_mark(enum rec_mark_type type, unsigned int index)
+{
+	struct rec_chunk *chunk = record_chunk();
+	struct rec_mark *mark;
+
+	if (chunk->num_marks == chunk->max_marks)
+		chunk->marks = record_grow(chunk->marks, &chunk->max_marks,
+					   sizeof(*chunk->marks));
+
+	mark = &chunk->marks[chunk->num_marks++];
+	mark->pos = chunk->size;
+	mark->num_pages = chunk->num_pages;
+	mark->type = type;
+	mark->index = index;
+}
+
+/* returns the arena page that the next page load is snapshotted into */
+static uint8_t *record_page_slot(void)
+{
+	struct rec_chunk *chunk = record_chunk();
+
+	if (chunk->num_pages == REC_CHUNK_PAGES) {
+		record_seal_chunk();
+		chunk = record_chunk();
+	}
+
+	return chunk->arena[chunk->num_pages].data;
+}
+
+/* queues the snapshot in the page slot for loading into the BO page */
+static void record_load_page(struct bo_rec *bo, unsigned int page)
+{
+	struct rec_chunk *chunk = record_chunk();
+	struct rec_chunk_page *p = &chunk->pages[chunk->num_pages++];
+
+	p->pos = chunk->size;
+	p->r.act = REC_BO_LOAD_DATA;
+	p->r.data.bo_load.id = bo->id;
+	p->r.data.bo_load.page_id = page;
+	p->r.data.bo_load.ctx_id = bo->ctx->id;
+}
+
+static void record_start_pipeline(void)
+{
+	struct rec_chunk *chunk;
+	sigset_t set, old;
+	unsigned int i;
+	long cpus;
+	char *str;
+	int err;
+
+	for (i = 0; i < REC_NUM_CHUNKS; i++) {
+		chunk = &rec.chunks[i];
+
+		chunk->arena = malloc(sizeof(*chunk->arena) * REC_CHUNK_PAGES);
+		chunk->pages = malloc(sizeof(*chunk->pages) * REC_CHUNK_PAGES);
+		assert(chunk->arena != NULL && chunk->pages != NULL);
+	}
+
+	pthread_mutex_init(&rec.index_lock, NULL);
+	pthread_mutex_init(&rec.pipe_lock, NULL);
+	pthread_cond_init(&rec.pipe_work, NULL);
+	pthread_cond_init(&rec.pipe_done, NULL);
+	pthread_cond_init(&rec.pipe_free, NULL);
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	rec.num_workers = cpus > 1 ? cpus - 1 : 1;
+
+	str = getenv("LIBWRAP_RECORD_THREADS");
+	if (str)
+		rec.num_workers = strtoul(str, NULL, 0);
+
+	if (rec.num_workers < 1)
+		rec.num_workers = 1;
+	if (rec.num_workers > REC_MAX_WORKERS)
+		rec.num_workers = REC_MAX_WORKERS;
+
+	/* signals of the application shouldn't end up in our threads */
+	sigfillset(&set);
+	pthread_sigmask(SIG_SETMASK, &set, &old);
+
+	err = pthread_create(&rec.writer, NULL, record_writer, NULL);
+
+	for (i = 0; !err && i < rec.num_workers; i++)
+		err = pthread_create(&rec.workers[i], NULL, record_worker, NULL);
+
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (err) {
+		fprintf(stderr, "%s: Failed to create threads: %s\n",
+			__func__, strerror(err));
+		abort();
+	}
+}
+
+/* writes out everything that was recorded and stops the threads */
+static void record_stop_pipeline(void)
+{
+	unsigned int i;
+
+	record_seal_chunk();
+
+	pthread_mutex_lock(&rec.pipe_lock);
+	rec.stop = true;
+	pthread_cond_broadcast(&rec.pipe_work);
+	pthread_cond_signal(&rec.pipe_done);
+	pthread_mutex_unlock(&rec.pipe_lock);
+
+	pthread_join(rec.writer, NULL);
+
+	for (i = 0; i < rec.num_workers; i++)
+		pthread_join(rec.workers[i], NULL);
+}
+
+/* remembers where the frame that is recorded next starts */
+static void record_add_frame(void)
+{
+	pthread_mutex_lock(&rec.index_lock);
+
+	if (rec.num_frames == rec.max_frames)
+		rec.frames = record_grow(rec.frames, &rec.max_frames,
+					 sizeof(*rec.frames));
+
+	pthread_mutex_unlock(&rec.index_lock);
+
+	record_mark(REC_MARK_FRAME, rec.num_frames++);
+}
+
+static void record_finish(void)
+{
+	struct record_trailer trailer;
+	struct record_act r;
+	uint64_t offset;
+
+	if (!rec.enabled)
+		return;
+
+	record_stop_pipeline();
+
+	offset = rec.offset;
+
+	/* the last entry is the end of the last frame */
+	r.act = REC_INDEX;
+	r.data.index.num_frames = rec.num_frames - 1;
+	r.data.index.num_keyframes = rec.num_keyframes;
+
+	record_write_file(&r, sizeof(r.act) + sizeof(r.data.index));
+	record_write_file(rec.frames, sizeof(*rec.frames) * rec.num_frames);
+
+	if (rec.num_keyframes)
+		record_write_file(rec.keyframes,
+				  sizeof(*rec.keyframes) * rec.num_keyframes);
+
+	trailer.index_offset = offset;
+	memcpy(trailer.magic, REC_INDEX_MAGIC, sizeof(trailer.magic));
+
+	record_write_file(&trailer, sizeof(trailer));
+
+	fclose(rec.fout);
+	rec.enabled = false;
+}
+
+/*
+ * Application writes to BOs are tracked by write-protecting the application's
+ * mappings: the first write to a page faults, the handler marks the page as
+ * dirty and unprotects it. Capturing a BO then only needs to look at the
+ * pages that were written since the previous capture and protects them
+ * again.
+ *
+ * The kernel doesn't fault on protected pages, syscalls that write into a
+ * tracked mapping fail with EFAULT instead. Hence tracking is only enabled
+ * with LIBWRAP_RECORD_WRITE_TRACKING=1, for applications that only write
+ * to their BO mappings with the CPU.
+ *
+ * The handler may interrupt a thread that holds any lock, so it looks the
+ * mapping up in the published table without locking.
+ */
+static void record_segv_handler(int sig, siginfo_t *info, void *context)
+{
+	struct sigaction *old = &rec.old_segv;
+	struct rec_mapping_table *table;
+	uint8_t *addr = info->si_addr;
+	struct rec_mapping *map;
+	bool found = false;
+	unsigned int i, page;
+
+	__atomic_fetch_add(&rec.mapping_readers, 1, __ATOMIC_SEQ_CST);
+
+	table = __atomic_load_n(&rec.mapping_table, __ATOMIC_SEQ_CST);
+
+	for (i = 0; table && i < table->count; i++) {
+		map = table->maps[i];
+
+		if (addr < map->addr || addr >= map->addr + map->size)
+			continue;
+
+		page = (addr - map->addr) / 4096;
+
+		__atomic_fetch_or(&map->bo->dirty[page / REC_BITS_PER_LONG],
+				  1UL << (page % REC_BITS_PER_LONG),
+				  __ATOMIC_ACQ_REL);
+
+		mprotect(map->addr + page * 4096, 4096,
+			 PROT_READ | PROT_WRITE);
+
+		found = true;
+		break;
+	}
+
+	__atomic_fetch_sub(&rec.mapping_readers, 1, __ATOMIC_SEQ_CST);
+
+	if (found)
+		return;
+
+	/* not ours, let the faulting access hit the previous handler */
+	if (old->sa_flags & SA_SIGINFO) {
+		old->sa_sigaction(sig, info, context);
+	} else if (old->sa_handler != SIG_DFL && old->sa_handler != SIG_IGN) {
+		old->sa_handler(sig);
+	} else {
+		sigaction(SIGSEGV, old, NULL);
+	}
+}
+
+static void record_install_segv_handler(void)
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = record_segv_handler;
+	sa.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+
+	if (sigaction(SIGSEGV, &sa, &rec.old_segv) < 0) {
+		fprintf(stderr, "%s: Failed to install SIGSEGV handler: %s\n",
+			__func__, strerror(errno));
+		rec.write_tracking = false;
+	}
+}
+
+/*
+ * Publishes the current list of mappings to the fault handler and frees
+ * the mappings on @dead once the handlers are done with the previous table.
+ * Called with the mappings lock held.
+ */
+static void record_publish_mappings(struct list_head *dead)
+{
+	struct rec_mapping_table *table, *old;
+	struct rec_mapping *map, *tmp;
+	unsigned int count = 0;
+
+	list_for_each_entry(map, &rec.mappings, node)
+		count++;
+
+	table = malloc(sizeof(*table) + count * sizeof(table->maps[0]));
+	assert(table != NULL);
+
+	table->count = 0;
+
+	list_for_each_entry(map, &rec.mappings, node)
+		table->maps[table->count++] = map;
+
+	old = __atomic_exchange_n(&rec.mapping_table, table, __ATOMIC_SEQ_CST);
+
+	while (__atomic_load_n(&rec.mapping_readers, __ATOMIC_SEQ_CST))
+		sched_yield();
+
+	free(old);
+
+	if (!dead)
+		return;
+
+	list_for_each_entry_safe(map, tmp, dead, node)
+		free(map);
+}
+
+/* called with the mappings lock held, the mapping is moved to @dead */
+static void record_unmap(struct rec_mapping *map, struct list_head *dead)
+{
+	list_del(&map->node);
+	list_del(&map->bo_node);
+	list_add_tail(&map->node, dead);
 }
 
 static bool record_start(void)
 {
 	struct record_act r;
 	uint8_t buf[4096];
-	char *path;
+	char *path, *str;
 
 	path = getenv("LIBWRAP_RECORD_PATH");
 	if (!path)
@@ -145,6 +794,29 @@ static bool record_start(void)
 	memset(buf, 0, 4096);
 	rec.zeroed_page_chksum = calc_page_checksum(buf, 4096);
 
+	INIT_LIST_HEAD(&rec.ctxs);
+	INIT_LIST_HEAD(&rec.bos);
+	INIT_LIST_HEAD(&rec.job_ctxs);
+
+	rec.keyframe_interval = REC_KEYFRAME_INTERVAL;
+
+	str = getenv("LIBWRAP_RECORD_KEYFRAMES");
+	if (str)
+		rec.keyframe_interval = strtoul(str, NULL, 0);
+
+	str = getenv("LIBWRAP_RECORD_WRITE_TRACKING");
+	rec.write_tracking = str && strtoul(str, NULL, 0);
+
+	INIT_LIST_HEAD(&rec.mappings);
+	pthread_mutex_init(&rec.mappings_lock, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &rec.start_time);
+
+	record_start_pipeline();
+
+	if (rec.write_tracking)
+		record_install_segv_handler();
+
 	r.act = REC_START;
 	r.data.header.version = REC_VER;
 	strncpy(r.data.header.magic, REC_MAGIC, sizeof(r.data.header.magic));
@@ -163,6 +835,9 @@ static bool record_start(void)
 	r.data.record_info.compression = compression;
 
 	record_write_action(&r);
+	record_add_frame();
+
+	atexit(record_finish);
 
 	fprintf(stderr, "libwrap recording started on %s to %s\n",
 		r.data.record_info.drm ? "DRM" : "NVHOST", path);
@@ -181,6 +856,76 @@ bool recorder_enabled(void)
 	return rec.enabled;
 }
 
+static uint64_t record_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - rec.start_time.tv_sec) * 1000000000ull +
+	       now.tv_nsec - rec.start_time.tv_nsec;
+}
+
+void record_call_enter(enum rec_call call)
+{
+	if (!recorder_enabled())
+		return;
+
+	switch (call) {
+	case REC_CALL_GPU:
+		rec.call_time = record_time();
+		break;
+
+	case REC_CALL_WAIT:
+		rec.wait_start = record_time();
+		break;
+	}
+}
+
+void record_call_leave(enum rec_call call)
+{
+	if (!recorder_enabled())
+		return;
+
+	switch (call) {
+	case REC_CALL_GPU:
+		rec.resume_time = record_time();
+		break;
+
+	case REC_CALL_WAIT:
+		rec.wait_time += record_time() - rec.wait_start;
+		break;
+	}
+}
+
+/*
+ * Stamps the job or display that is recorded next. Calls that didn't go
+ * through record_call_enter() are stamped with the current time.
+ */
+static void record_write_timestamp(void)
+{
+	struct record_act r;
+	uint64_t time = rec.call_time;
+	uint64_t gap, wait;
+
+	if (time <= rec.resume_time)
+		time = record_time();
+
+	gap = time - rec.resume_time;
+	wait = rec.wait_time < gap ? rec.wait_time : gap;
+
+	r.act = REC_TIMESTAMP;
+	r.data.timestamp.time = time;
+	r.data.timestamp.cpu_gap = gap - wait;
+	r.data.timestamp.wait = wait;
+
+	record_write_action(&r);
+
+	/* until the call returns */
+	rec.resume_time = time;
+	rec.wait_time = 0;
+}
+
 struct rec_ctx *record_create_ctx(void)
 {
 	struct record_act r;
@@ -193,6 +938,7 @@ struct rec_ctx *record_create_ctx(void)
 	assert(ctx != NULL);
 
 	ctx->id = rec.ctx_cnt++;
+	list_add_tail(&ctx->node, &rec.ctxs);
 
 	r.act = REC_CTX_CREATE;
 	r.data.ctx_create.id = ctx->id;
@@ -212,6 +958,7 @@ void record_destroy_ctx(struct rec_ctx *ctx)
 	r.act = REC_CTX_DESTROY;
 	r.data.ctx_destroy.id = ctx->id;
 
+	list_del(&ctx->node);
 	free(ctx);
 
 	record_write_action(&r);
@@ -241,6 +988,13 @@ struct bo_rec *record_create_bo(struct rec_ctx *ctx, size_t size,
 	for (i = 0; i < bo->num_pages; i++)
 		bo->page_meta[i].chksum = rec.zeroed_page_chksum;
 
+	bo->dirty = calloc((bo->num_pages + REC_BITS_PER_LONG - 1) /
+				REC_BITS_PER_LONG, sizeof(*bo->dirty));
+	assert(bo->dirty != NULL);
+
+	INIT_LIST_HEAD(&bo->mappings);
+	list_add_tail(&bo->node, &rec.bos);
+
 	r.act = REC_BO_CREATE;
 	r.data.bo_create.id = bo->id;
 	r.data.bo_create.ctx_id = bo->ctx->id;
@@ -260,9 +1014,80 @@ void record_set_bo_data(struct bo_rec *bo, void *data)
 	bo->page_data = data;
 }
 
+void record_track_bo_writes(struct bo_rec *bo, void *addr, size_t size)
+{
+	struct rec_mapping *map;
+
+	if (!recorder_enabled() || !rec.write_tracking)
+		return;
+
+	if (size > bo->num_pages * 4096)
+		size = bo->num_pages * 4096;
+
+	map = calloc(1, sizeof(*map));
+	assert(map != NULL);
+
+	map->bo = bo;
+	map->addr = addr;
+	map->size = size;
+
+	pthread_mutex_lock(&rec.mappings_lock);
+
+	/*
+	 * Whatever was written before the tracking started is unknown,
+	 * so treat all pages as dirty.
+	 */
+	memset(bo->dirty, 0xff, (bo->num_pages + REC_BITS_PER_LONG - 1) /
+				REC_BITS_PER_LONG * sizeof(*bo->dirty));
+
+	if (mprotect(addr, size, PROT_READ) < 0) {
+		pthread_mutex_unlock(&rec.mappings_lock);
+		fprintf(stderr, "%s: Failed to protect BO mapping: %s\n",
+			__func__, strerror(errno));
+		free(map);
+		return;
+	}
+
+	list_add_tail(&map->node, &rec.mappings);
+	list_add_tail(&map->bo_node, &bo->mappings);
+	bo->write_tracked = true;
+
+	record_publish_mappings(NULL);
+
+	pthread_mutex_unlock(&rec.mappings_lock);
+}
+
+void record_untrack_writes(void *addr, size_t size)
+{
+	struct rec_mapping *map, *tmp;
+	uint8_t *start = addr;
+	LIST_HEAD(dead);
+
+	if (!rec.enabled || !rec.write_tracking)
+		return;
+
+	pthread_mutex_lock(&rec.mappings_lock);
+
+	/*
+	 * The BO stays write-tracked, its dirty pages are captured and
+	 * without a mapping it can't be written by the CPU anymore.
+	 */
+	list_for_each_entry_safe(map, tmp, &rec.mappings, node)
+		if (start < map->addr + map->size &&
+		    start + size > map->addr)
+			record_unmap(map, &dead);
+
+	if (!list_empty(&dead))
+		record_publish_mappings(&dead);
+
+	pthread_mutex_unlock(&rec.mappings_lock);
+}
+
 void record_destroy_bo(struct bo_rec *bo)
 {
+	struct rec_mapping *map;
 	struct record_act r;
+	LIST_HEAD(dead);
 
 	if (!recorder_enabled())
 		return;
@@ -271,111 +1096,123 @@ void record_destroy_bo(struct bo_rec *bo)
 	r.data.bo_destroy.id = bo->id;
 	r.data.bo_destroy.ctx_id = bo->ctx->id;
 
+	if (rec.displayed == bo)
+		rec.displayed = NULL;
+
+	pthread_mutex_lock(&rec.mappings_lock);
+
+	/* the application may keep using its mappings of the BO */
+	while (!list_empty(&bo->mappings)) {
+		map = list_entry(bo->mappings.next, struct rec_mapping,
+				 bo_node);
+		mprotect(map->addr, map->size, PROT_READ | PROT_WRITE);
+		record_unmap(map, &dead);
+	}
+
+	if (!list_empty(&dead))
+		record_publish_mappings(&dead);
+
+	pthread_mutex_unlock(&rec.mappings_lock);
+
+	list_del(&bo->node);
+	free(bo->page_meta);
+	free(bo->dirty);
 	free(bo);
 
 	record_write_action(&r);
 }
 
-#ifdef ENABLE_ZLIB
-static size_t compress_data_zlib(void *in, void *out,
-				 size_t in_size, size_t out_size)
+static bool check_and_load_page(struct bo_rec *bo, unsigned int page)
 {
-	z_stream strm;
-	int ret;
+	unsigned long chksum;
+	uint8_t *slot;
 
-	strm.zalloc = Z_NULL;
-	strm.zfree = Z_NULL;
-	strm.opaque = Z_NULL;
-	strm.avail_in = in_size;
-	strm.next_in = in;
-	strm.avail_out = out_size;
-	strm.next_out = out;
+	slot = record_page_slot();
+	memcpy(slot, bo->page_data[page].data, 4096);
 
-	ret = deflateInit(&strm, Z_BEST_SPEED);
-	assert(ret == Z_OK);
+	chksum = calc_page_checksum(slot, 4096);
 
-	ret = deflate(&strm, Z_FINISH);
-	if (ret != Z_STREAM_END) {
-		fprintf(stderr, "%s: ERROR: deflate failed: %d\n",
-			__func__, ret);
-		abort();
-	}
+#ifdef ENABLE_ZLIB
+	if (chksum == bo->page_meta[page].chksum)
+		return false;
+#endif
 
-	ret = deflateEnd(&strm);
-	assert(ret == Z_OK);
+	record_load_page(bo, page);
 
-	if (strm.total_out >= in_size)
-		return 0;
+	bo->page_meta[page].chksum = chksum;
 
-	return strm.total_out;
+	return true;
 }
-#endif
 
-#ifdef ENABLE_LZ4
-static size_t compress_data_lz4(void *in, void *out,
-				size_t in_size, size_t out_size)
+/* protects the pages again in all tracked mappings of the BO */
+static void record_protect_pages(struct bo_rec *bo, unsigned int first,
+				 unsigned int count)
 {
-	return LZ4_compress_default(in, out, in_size, out_size);
+	size_t start = first * 4096, end = (first + count) * 4096;
+	struct rec_mapping *map;
+
+	list_for_each_entry(map, &bo->mappings, bo_node) {
+		if (start >= map->size)
+			continue;
+
+		mprotect(map->addr + start,
+			 (end < map->size ? end : map->size) - start, PROT_READ);
+	}
 }
-#endif
 
-static size_t compress_data(void *in, void *out,
-			    size_t in_size, size_t out_size)
+/*
+ * Only the pages that were written since the previous capture are looked
+ * at. The dirty bits are taken and the pages protected before they are
+ * read, so a concurrent write either lands before the read or faults and
+ * marks the page for the next capture.
+ */
+static void record_capture_dirty_pages(struct bo_rec *bo)
 {
-#ifdef ENABLE_LZ4
-	if (compression == REC_LZ4)
-		return compress_data_lz4(in, out, in_size, out_size);
-#endif
+	unsigned int num_longs = (bo->num_pages + REC_BITS_PER_LONG - 1) /
+				 REC_BITS_PER_LONG;
+	unsigned int i, k, first, count;
+	unsigned long bits;
 
-#ifdef ENABLE_ZLIB
-	if (compression == REC_ZLIB)
-		return compress_data_zlib(in, out, in_size, out_size);
-#endif
+	for (i = 0; i < num_longs; i++) {
+		if (!__atomic_load_n(&bo->dirty[i], __ATOMIC_ACQUIRE))
+			continue;
 
-	return 0;
-}
+		pthread_mutex_lock(&rec.mappings_lock);
 
-static bool check_and_load_page(struct bo_rec *bo, unsigned int page)
-{
-	struct record_act r;
-	unsigned long chksum;
-	uint16_t data_size;
-	uint8_t compressed[3328];
-	uint8_t buf[4096];
-	void *data;
+		bits = __atomic_exchange_n(&bo->dirty[i], 0, __ATOMIC_ACQ_REL);
 
-	memcpy(buf, bo->page_data[page].data, 4096);
+		for (k = 0; k < REC_BITS_PER_LONG; k += count) {
+			count = 1;
 
-	chksum = calc_page_checksum(buf, 4096);
+			if (!(bits & (1UL << k)))
+				continue;
 
-#ifdef ENABLE_ZLIB
-	if (chksum == bo->page_meta[page].chksum)
-		return false;
-#endif
+			while (k + count < REC_BITS_PER_LONG &&
+			       (bits & (1UL << (k + count))))
+				count++;
 
-	/* size 0 means go uncompressed */
-	data_size = compress_data(buf, compressed, 4096, 3328);
-	data = data_size ? compressed : buf;
+			first = i * REC_BITS_PER_LONG + k;
+			if (first >= bo->num_pages)
+				break;
 
-	r.act = REC_BO_LOAD_DATA;
-	r.data.bo_load.id = bo->id;
-	r.data.bo_load.page_id = page;
-	r.data.bo_load.ctx_id = bo->ctx->id;
-	r.data.bo_load.data_size = data_size;
+			if (first + count > bo->num_pages)
+				count = bo->num_pages - first;
 
-	record_write_action(&r);
-	record_write_data(data, data_size ?: 4096);
+			record_protect_pages(bo, first, count);
+		}
 
-	bo->page_meta[page].chksum = chksum;
+		pthread_mutex_unlock(&rec.mappings_lock);
 
-	return true;
+		for (k = 0; k < REC_BITS_PER_LONG; k++)
+			if (bits & (1UL << k) &&
+			    i * REC_BITS_PER_LONG + k < bo->num_pages)
+				check_and_load_page(bo, i * REC_BITS_PER_LONG + k);
+	}
 }
 
 void record_capture_bo_data(struct bo_rec *bo, bool force)
 {
-	unsigned int hpage[3];
 	unsigned int i;
-	bool dirty = false;
 
 	if (!recorder_enabled())
 		return;
@@ -388,28 +1225,126 @@ void record_capture_bo_data(struct bo_rec *bo, bool force)
 	else if (!force && bo->is_framebuffer)
 		return;
 
+	bo->captured = true;
+
+	if (bo->write_tracked && !force) {
+		record_capture_dirty_pages(bo);
+		return;
+	}
+
+	if (bo->write_tracked) {
+		pthread_mutex_lock(&rec.mappings_lock);
+		memset(bo->dirty, 0, (bo->num_pages + REC_BITS_PER_LONG - 1) /
+				REC_BITS_PER_LONG * sizeof(*bo->dirty));
+		record_protect_pages(bo, 0, bo->num_pages);
+		pthread_mutex_unlock(&rec.mappings_lock);
+	}
+
 	/*
-	 * Lame heuristics.. check first, middle and last pages for changes
-	 * and if these pages aren't changed, assume BO isn't changed at all.
+	 * BOs that the application didn't map through the wrapped file can
+	 * be changed behind our back, compare the checksums of all pages.
 	 */
-	hpage[0] = 0;
-	hpage[1] = bo->num_pages / 2;
-	hpage[2] = bo->num_pages - 1;
-
-	if (!force && bo->num_pages > 4) {
-		dirty |= check_and_load_page(bo, hpage[0]);
-		dirty |= check_and_load_page(bo, hpage[1]);
-		dirty |= check_and_load_page(bo, hpage[2]);
-	} else {
-		force = true;
+	for (i = 0; i < bo->num_pages; i++)
+		check_and_load_page(bo, i);
+}
+
+/*
+ * Writes the actions that recreate all live objects and load the contents
+ * of all mapped BOs. The page checksums aren't touched, the keyframe is
+ * skipped when the record is replayed from the start.
+ */
+static void record_write_keyframe(void)
+{
+	static const uint8_t zeroes[4096];
+	struct job_ctx_rec *job_ctx;
+	struct record_act r;
+	struct rec_ctx *ctx;
+	struct bo_rec *bo;
+	unsigned int i;
+
+	pthread_mutex_lock(&rec.index_lock);
+
+	if (rec.num_keyframes == rec.max_keyframes)
+		rec.keyframes = record_grow(rec.keyframes, &rec.max_keyframes,
+					    sizeof(*rec.keyframes));
+
+	rec.keyframes[rec.num_keyframes].frame = rec.num_frames - 1;
+
+	pthread_mutex_unlock(&rec.index_lock);
+
+	/* the writer fills in the offset and patches the size */
+	record_mark(REC_MARK_KEYFRAME_START, rec.num_keyframes);
+
+	r.act = REC_KEYFRAME;
+	r.data.keyframe.frame = rec.num_frames - 1;
+	r.data.keyframe.size = 0;
+
+	record_write_action(&r);
+
+	list_for_each_entry(ctx, &rec.ctxs, node) {
+		r.act = REC_CTX_CREATE;
+		r.data.ctx_create.id = ctx->id;
+
+		record_write_action(&r);
 	}
 
-	if (force || dirty)
-		for (i = 0; i < bo->num_pages; i++)
-			if (force || (i != hpage[0] && i != hpage[1] && i != hpage[2]))
-				check_and_load_page(bo, i);
+	list_for_each_entry(bo, &rec.bos, node) {
+		r.act = REC_BO_CREATE;
+		r.data.bo_create.id = bo->id;
+		r.data.bo_create.ctx_id = bo->ctx->id;
+		r.data.bo_create.num_pages = bo->num_pages;
+		r.data.bo_create.flags = bo->flags;
 
-	bo->captured = true;
+		record_write_action(&r);
+
+		if (!bo->page_data)
+			continue;
+
+		for (i = 0; i < bo->num_pages; i++) {
+			uint8_t *slot = record_page_slot();
+
+			memcpy(slot, bo->page_data[i].data, 4096);
+
+			if (memcmp(slot, zeroes, 4096))
+				record_load_page(bo, i);
+		}
+	}
+
+	list_for_each_entry(bo, &rec.bos, node) {
+		if (!bo->is_framebuffer)
+			continue;
+
+		r.act = REC_ADD_FRAMEBUFFER;
+		r.data.add_framebuffer.bo_id = bo->id;
+		r.data.add_framebuffer.ctx_id = bo->ctx->id;
+		r.data.add_framebuffer.width = bo->width;
+		r.data.add_framebuffer.height = bo->height;
+		r.data.add_framebuffer.pitch = bo->pitch;
+		r.data.add_framebuffer.format = bo->format;
+		r.data.add_framebuffer.flags = bo->fb_flags;
+
+		record_write_action(&r);
+	}
+
+	list_for_each_entry(job_ctx, &rec.job_ctxs, node) {
+		r.act = REC_JOB_CTX_CREATE;
+		r.data.job_ctx_create.id = job_ctx->id;
+		r.data.job_ctx_create.gr2d = job_ctx->gr2d;
+
+		record_write_action(&r);
+	}
+
+	/* keyframes start with the frame that was displayed last */
+	if (rec.displayed) {
+		r.act = REC_DISP_FRAMEBUFFER;
+		r.data.disp_framebuffer.bo_id = rec.displayed->id;
+		r.data.disp_framebuffer.ctx_id = rec.displayed->ctx->id;
+
+		record_write_action(&r);
+	}
+
+	record_mark(REC_MARK_KEYFRAME_END, rec.num_keyframes);
+	rec.num_keyframes++;
 }
 
 void record_set_bo_flags(struct bo_rec *bo, uint32_t flags)
@@ -437,6 +1372,7 @@ void record_add_framebuffer(struct bo_rec *bo, uint32_t flags)
 		return;
 
 	bo->is_framebuffer = true;
+	bo->fb_flags = flags;
 
 	r.act = REC_ADD_FRAMEBUFFER;
 	r.data.add_framebuffer.bo_id = bo->id;
@@ -460,6 +1396,9 @@ void record_del_framebuffer(struct bo_rec *bo)
 	bo->is_framebuffer = false;
 	bo->fb_id = 0;
 
+	if (rec.displayed == bo)
+		rec.displayed = NULL;
+
 	r.act = REC_DEL_FRAMEBUFFER;
 	r.data.del_framebuffer.bo_id = bo->id;
 	r.data.del_framebuffer.ctx_id = bo->ctx->id;
@@ -474,11 +1413,23 @@ void record_display_framebuffer(struct bo_rec *bo)
 	if (!recorder_enabled())
 		return;
 
+	record_write_timestamp();
+
 	r.act = REC_DISP_FRAMEBUFFER;
 	r.data.disp_framebuffer.bo_id = bo->id;
 	r.data.disp_framebuffer.ctx_id = bo->ctx->id;
 
 	record_write_action(&r);
+
+	rec.displayed = bo;
+	record_add_frame();
+
+	if (rec.keyframe_interval &&
+	    (rec.num_frames - 1) % rec.keyframe_interval == 0)
+		record_write_keyframe();
+
+	/* don't keep a displayed frame back until the chunk fills up */
+	record_seal_chunk();
 }
 
 struct job_ctx_rec *record_job_ctx_create(bool gr2d)
@@ -494,6 +1445,7 @@ struct job_ctx_rec *record_job_ctx_create(bool gr2d)
 
 	ctx->id = rec.job_ctx_cnt++;
 	ctx->gr2d = gr2d;
+	list_add_tail(&ctx->node, &rec.job_ctxs);
 
 	r.act = REC_JOB_CTX_CREATE;
 	r.data.job_ctx_create.id = ctx->id;
@@ -514,6 +1466,7 @@ void record_job_ctx_destroy(struct job_ctx_rec *ctx)
 	r.act = REC_JOB_CTX_DESTROY;
 	r.data.job_ctx_destroy.id = ctx->id;
 
+	list_del(&ctx->node);
 	free(ctx);
 
 	record_write_action(&r);
@@ -526,6 +1479,8 @@ void record_job_submit(struct job_rec *job)
 	if (!recorder_enabled())
 		return;
 
+	record_write_timestamp();
+
 	r.act = REC_JOB_SUBMIT;
 	r.data.job_submit.job_ctx_id = job->ctx->id;
 	r.data.job_submit.num_gathers = job->num_gathers;
@@ -26,16 +26,22 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "hash.h"
+#include "list.h"
 #include "record_replay.h"
 
 struct rec_ctx {
+	struct list_head node;
 	unsigned int id;
 };
 
@@ -47,7 +53,33 @@ struct rec_page_meta {
 	unsigned long chksum;
 };
 
+#define REC_BITS_PER_LONG	(sizeof(unsigned long) * 8)
+
+/*
+ * Writable mapping of a BO by the application. Its pages are kept read-only
+ * until the application writes to them, the write fault marks the page as
+ * dirty in the BO and makes it writable again.
+ */
+struct rec_mapping {
+	struct list_head node;
+	struct list_head bo_node;
+	struct bo_rec *bo;
+	uint8_t *addr;
+	size_t size;
+};
+
+/*
+ * Snapshot of the tracked mappings for the write fault handler, which can't
+ * take locks. It's replaced as a whole whenever a mapping is added or
+ * removed, the previous snapshot is freed once no handler looks at it.
+ */
+struct rec_mapping_table {
+	unsigned int count;
+	struct rec_mapping *maps[];
+};
+
 struct bo_rec {
+	struct list_head node;
 	struct rec_page_meta *page_meta;
 	struct bo_page *page_data;
 	struct rec_ctx *ctx;
@@ -60,10 +92,17 @@ struct bo_rec {
 	uint32_t format;
 	uint32_t flags;
 	bool is_framebuffer;
+	uint32_t fb_flags;
 	unsigned int fb_id;
+
+	/* pages written through a tracked mapping since the last capture */
+	unsigned long *dirty;
+	struct list_head mappings;
+	bool write_tracked;
 };
 
 struct job_ctx_rec {
+	struct list_head node;
 	unsigned int id;
 	bool gr2d;
 };
@@ -80,25 +119,157 @@ struct job_rec {
 	struct job_ctx_rec *ctx;
 };
 
-#define REC_VER		0x0004
+/*
+ * Recording pipeline: the action stream is cut into chunks. A chunk carries
+ * the serialized actions and snapshots of the loaded pages, whose actions
+ * and compressed data are inserted at @pos of the action bytes once the
+ * workers compressed them.
+ */
+#define REC_CHUNK_PAGES		256
+#define REC_CHUNK_SIZE		(1024 * 1024)
+#define REC_NUM_CHUNKS		2
+#define REC_MAX_WORKERS		8
+
+/* pages that a worker claims at once */
+#define REC_WORKER_BATCH	16
+
+enum rec_mark_type {
+	REC_MARK_FRAME,
+	REC_MARK_KEYFRAME_START,
+	REC_MARK_KEYFRAME_END,
+};
+
+/* record offset that is only known once the chunk is written out */
+struct rec_mark {
+	size_t pos;
+	unsigned int num_pages;
+	enum rec_mark_type type;
+	unsigned int index;
+};
+
+struct rec_chunk_page {
+	size_t pos;
+	struct record_act r;
+	uint8_t compressed[3328];
+
+	/* content hash, see record_page_hash() */
+	uint64_t hash;
+	uint64_t check;
+};
+
+/* where the data of a page content went into the record first */
+struct rec_page_ref {
+	uint64_t check;
+	uint64_t offset;
+};
+
+struct rec_chunk {
+	uint8_t *data;
+	size_t size;
+	size_t max_size;
+
+	struct bo_page *arena;
+	struct rec_chunk_page *pages;
+	unsigned int num_pages;
+
+	struct rec_mark *marks;
+	unsigned int num_marks;
+	unsigned int max_marks;
+
+	/* pages handed out to and finished by the workers */
+	unsigned int claimed;
+	unsigned int compressed;
+};
+
+/* frames between keyframes, unless set by LIBWRAP_RECORD_KEYFRAMES */
+#define REC_KEYFRAME_INTERVAL	300
 
 struct recorder {
 	bool inited;
 	bool enabled;
 
 	FILE *fout;
+	uint64_t offset;
 	unsigned int ctx_cnt;
 	unsigned int bos_cnt;
 	unsigned int job_ctx_cnt;
 	unsigned long zeroed_page_chksum;
+
+	/* live objects, recreated by keyframes */
+	struct list_head ctxs;
+	struct list_head bos;
+	struct list_head job_ctxs;
+	struct bo_rec *displayed;
+
+	/* frame index that is written once recording ends */
+	uint64_t *frames;
+	unsigned int num_frames;
+	unsigned int max_frames;
+
+	struct record_keyframe *keyframes;
+	unsigned int num_keyframes;
+	unsigned int max_keyframes;
+	unsigned int keyframe_interval;
+
+	/* protects the index against the writer filling in offsets */
+	pthread_mutex_t index_lock;
+
+	/* chunks are filled in sequence, @sealed and @written count them */
+	struct rec_chunk chunks[REC_NUM_CHUNKS];
+	unsigned long sealed;
+	unsigned long written;
+	bool stop;
+	pthread_mutex_t pipe_lock;
+	pthread_cond_t pipe_work;
+	pthread_cond_t pipe_done;
+	pthread_cond_t pipe_free;
+	pthread_t writer;
+	pthread_t workers[REC_MAX_WORKERS];
+	unsigned int num_workers;
+
+	/* page contents written so far, keyed by hash, used by the writer */
+	struct hash_table page_refs;
+
+	/*
+	 * Timing of the application's GPU calls, in nanoseconds since the
+	 * recording started. @call_time is when the current job or display
+	 * call was entered, @resume_time when the previous one returned.
+	 */
+	struct timespec start_time;
+	uint64_t call_time;
+	uint64_t resume_time;
+	uint64_t wait_start;
+	uint64_t wait_time;
+
+	/*
+	 * Tracked application mappings. The list is changed under the lock,
+	 * write faults look up the published table and are counted in
+	 * @mapping_readers while they do.
+	 */
+	bool write_tracking;
+	struct list_head mappings;
+	pthread_mutex_t mappings_lock;
+	struct rec_mapping_table *mapping_table;
+	unsigned int mapping_readers;
+	struct sigaction old_segv;
+};
+
+/* application calls whose timing goes into the record */
+enum rec_call {
+	REC_CALL_GPU,	/* job submissions and displays */
+	REC_CALL_WAIT,	/* syncpoint waits */
 };
 
 bool recorder_enabled(void);
+void record_call_enter(enum rec_call call);
+void record_call_leave(enum rec_call call);
 struct rec_ctx *record_create_ctx(void);
 void record_destroy_ctx(struct rec_ctx *ctx);
 struct bo_rec *record_create_bo(struct rec_ctx *ctx, size_t size,
 				uint32_t flags);
 void record_set_bo_data(struct bo_rec *bo, void *data);
+void record_track_bo_writes(struct bo_rec *bo, void *addr, size_t size);
+void record_untrack_writes(void *addr, size_t size);
 void record_destroy_bo(struct bo_rec *bo);
 void record_capture_bo_data(struct bo_rec *bo, bool force);
 void record_set_bo_flags(struct bo_rec *bo, uint32_t flags);
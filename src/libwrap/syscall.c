@@ -37,13 +37,20 @@
 #include <time.h>
 
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 
 #include "host1x.h"
 #include "nvhost.h"
+#include "recorder.h"
 #include "syscall.h"
 #include "utils.h"
 #include "list.h"
 
+/*
+ * Serializes the ioctl handlers of the wrapped files and protects the table
+ * that maps fds to wrapped files, which open() and close() of other threads
+ * modify.
+ */
 static pthread_mutex_t ioctl_lock = PTHREAD_MUTEX_INITIALIZER;
 static bool initialized = false;
 bool libwrap_verbose = true;
@@ -69,6 +76,17 @@ static void *dlsym_helper(const char *name)
 	return dlsym(libc, name);
 }
 
+static struct file *lookup_file(int fd)
+{
+	struct file *file;
+
+	pthread_mutex_lock(&ioctl_lock);
+	file = file_lookup(fd);
+	pthread_mutex_unlock(&ioctl_lock);
+
+	return file;
+}
+
 static void init_verbosity(void)
 {
 	const char *str = getenv("LIBWRAP_SILENT");
@@ -107,8 +125,11 @@ int open(const char *pathname, int flags, ...)
 		ret = orig(pathname, flags);
 	}
 
-	if (ret >= 0)
+	if (ret >= 0) {
+		pthread_mutex_lock(&ioctl_lock);
 		file_open(pathname, ret);
+		pthread_mutex_unlock(&ioctl_lock);
+	}
 
 	PRINTF("%s() = %d\n", __func__, ret);
 	return ret;
@@ -144,8 +165,11 @@ int open64(const char *pathname, int flags, ...)
 		ret = orig(pathname, flags);
 	}
 
-	if (ret >= 0)
+	if (ret >= 0) {
+		pthread_mutex_lock(&ioctl_lock);
 		file_open(pathname, ret);
+		pthread_mutex_unlock(&ioctl_lock);
+	}
 
 	PRINTF("%s() = %d\n", __func__, ret);
 	return ret;
@@ -162,7 +186,10 @@ int close(int fd)
 	PRINTF("%s(fd=%d)\n", __func__, fd);
 
 	ret = orig(fd);
+
+	pthread_mutex_lock(&ioctl_lock);
 	file_close(fd);
+	pthread_mutex_unlock(&ioctl_lock);
 
 	PRINTF("%s() = %d\n", __func__, ret);
 	return ret;
@@ -204,9 +231,13 @@ int fcntl(int fd, int cmd, ...)
 		if (cmd == F_DUPFD ||
 		    cmd == F_DUPFD_CLOEXEC) {
 			if (ret >= 0) {
+				pthread_mutex_lock(&ioctl_lock);
+
 				file = file_lookup(fd);
 				if (file)
 					file_dup(file, ret);
+
+				pthread_mutex_unlock(&ioctl_lock);
 			}
 		}
 	} else {
@@ -247,7 +278,7 @@ ssize_t write(int fd, const void *buffer, size_t size)
 	print_hexdump(stdout, DUMP_PREFIX_OFFSET, "  ", buffer, size, 16,
 		      true);
 
-	file = file_lookup(fd);
+	file = lookup_file(fd);
 
 	if (file && file->ops && file->ops->write)
 		file->ops->write(file, buffer, size);
@@ -285,7 +316,7 @@ int ioctl(int fd, unsigned long request, ...)
 	if (!orig)
 		orig = dlsym_helper(__func__);
 
-	file = file_lookup(fd);
+	file = lookup_file(fd);
 	if (file) {
 		unsigned int i;
 
@@ -346,6 +377,7 @@ void *mmap_orig(void *addr, size_t length, int prot, int flags, int fd, off_t of
 
 void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
 {
+	struct file *file;
 	void *ret;
 
 	PRINTF("%s(addr=%p, length=%zu, prot=%#x, flags=%#x, fd=%d, offset=%lu)\n",
@@ -353,6 +385,13 @@ void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
 
 	ret = mmap_orig(addr, length, prot, flags, fd, offset);
 
+	if (ret != MAP_FAILED) {
+		file = lookup_file(fd);
+
+		if (file && file->ops && file->ops->mmap)
+			file->ops->mmap(file, ret, length, prot, flags, offset);
+	}
+
 	PRINTF("%s() = %p\n", __func__, ret);
 	return ret;
 }
@@ -373,6 +412,8 @@ int munmap(void *addr, size_t length)
 
 	PRINTF("%s(addr=%p, length=%zu)\n", __func__, addr, length);
 
+	record_untrack_writes(addr, length);
+
 	ret = munmap_orig(addr, length);
 
 	PRINTF("%s() = %d\n", __func__, ret);
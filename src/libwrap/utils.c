@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "hash.h"
 #include "utils.h"
 
 struct file_table_entry {
@@ -39,6 +40,9 @@ struct file_table_entry {
 static LIST_HEAD(file_table);
 static LIST_HEAD(files);
 
+/* maps the original and the duplicated fds to their file */
+static struct hash_table file_fds;
+
 void print_hexdump(FILE *fp, int prefix_type, const char *prefix,
 		   const void *buffer, size_t size, size_t columns,
 		   bool ascii)
@@ -115,6 +119,12 @@ struct file *file_open(const char *path, int fd)
 			for (i = 0; i < ARRAY_SIZE(file->dup_fds); i++)
 				file->dup_fds[i] = -1;
 
+			if (hash_table_insert(&file_fds, fd, file) < 0) {
+				fprintf(stderr, "out of memory\n");
+				file_put(file);
+				return NULL;
+			}
+
 			list_add_tail(&file->list, &files);
 			return file;
 		}
@@ -127,19 +137,10 @@ struct file *file_open(const char *path, int fd)
 
 struct file *file_lookup(int fd)
 {
-	struct file *file;
-	unsigned int i;
+	if (fd < 0)
+		return NULL;
 
-	list_for_each_entry(file, &files, list) {
-		if (file->fd == fd)
-			return file;
-
-		for (i = 0; i < ARRAY_SIZE(file->dup_fds); i++)
-			if (file->dup_fds[i] == fd)
-				return file;
-	}
-
-	return NULL;
+	return hash_table_lookup(&file_fds, fd);
 }
 
 struct file *file_find(const char *path)
@@ -155,42 +156,31 @@ struct file *file_find(const char *path)
 
 void file_close(int fd)
 {
-	struct file *file;
+	struct file *file = file_lookup(fd);
 	unsigned int i;
 
-	list_for_each_entry(file, &files, list) {
-		if (file->fd == fd) {
-			file->fd = -1;
-
-			for (i = 0; i < ARRAY_SIZE(file->dup_fds); i++)
-				if (file->dup_fds[i] >= 0)
-					return;
+	if (!file)
+		return;
 
-			PRINTF("closing %s\n", file->path);
-			list_del(&file->list);
-			file_put(file);
-			return;
-		}
+	hash_table_remove(&file_fds, fd);
 
-		for (i = 0; i < ARRAY_SIZE(file->dup_fds); i++) {
-			if (file->dup_fds[i] != fd)
-				continue;
+	if (file->fd == fd)
+		file->fd = -1;
 
+	for (i = 0; i < ARRAY_SIZE(file->dup_fds); i++)
+		if (file->dup_fds[i] == fd)
 			file->dup_fds[i] = -1;
 
-			if (file->fd != -1)
-				return;
-
-			for (i = 0; i < ARRAY_SIZE(file->dup_fds); i++)
-				if (file->dup_fds[i] != -1)
-					return;
+	if (file->fd != -1)
+		return;
 
-			PRINTF("closing %s\n", file->path);
-			list_del(&file->list);
-			file_put(file);
+	for (i = 0; i < ARRAY_SIZE(file->dup_fds); i++)
+		if (file->dup_fds[i] != -1)
 			return;
-		}
-	}
+
+	PRINTF("closing %s\n", file->path);
+	list_del(&file->list);
+	file_put(file);
 }
 
 void file_table_register(const struct file_table *table, unsigned int count)
@@ -220,6 +210,9 @@ void file_dup(struct file *file, int fd)
 
 	for (i = 0; i < ARRAY_SIZE(file->dup_fds); i++) {
 		if (file->dup_fds[i] < 0) {
+			if (hash_table_insert(&file_fds, fd, file) < 0)
+				break;
+
 			PRINTF("duplicating %s\n", file->path);
 			file->dup_fds[i] = fd;
 			return;
@@ -78,6 +78,8 @@ struct file_ops {
 	int (*leave_ioctl)(struct file *file, unsigned long request, void *arg);
 	ssize_t (*write)(struct file *file, const void *buffer, size_t size);
 	ssize_t (*read)(struct file *file, void *buffer, size_t size);
+	void (*mmap)(struct file *file, void *addr, size_t length, int prot,
+		     int flags, off_t offset);
 	void (*release)(struct file *file);
 };
 
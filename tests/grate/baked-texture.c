@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Loads textures baked by tools/texbake, see baked_tests.sh, and compares
+ * them against the same image loaded and transcoded by DevIL:
+ *	baked-texture image.png dxt5.tex etc1.tex
+ *
+ * The BO of a baked texture must hold the same bytes as the transcoded
+ * one. Copies of the first texture that are truncated or carry a wrong
+ * magic must be rejected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "baked_texture.h"
+#include "grate.h"
+
+static int read_header(const char *path, struct baked_texture_header *hdr,
+		       struct baked_texture_level *level)
+{
+	FILE *fp;
+	int ret;
+
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+
+	ret = fread(hdr, sizeof(*hdr), 1, fp) == 1 &&
+	      fread(level, sizeof(*level), 1, fp) == 1 ? 0 : -1;
+
+	fclose(fp);
+
+	return ret;
+}
+
+static int compare_bos(struct grate_texture *baked,
+		       struct grate_texture *loaded, size_t size)
+{
+	struct host1x_pixelbuffer *a = grate_texture_pixbuf(baked);
+	struct host1x_pixelbuffer *b = grate_texture_pixbuf(loaded);
+	void *map_a, *map_b;
+
+	if (a->pitch != b->pitch || a->format != b->format ||
+	    a->layout != b->layout) {
+		fprintf(stderr, "pixbufs differ: pitch %u/%u format %u/%u\n",
+			a->pitch, b->pitch, a->format, b->format);
+		return -1;
+	}
+
+	if (HOST1X_BO_MMAP(a->bo, &map_a) || HOST1X_BO_MMAP(b->bo, &map_b))
+		return -1;
+
+	if (HOST1X_BO_INVALIDATE(a->bo, a->bo->offset, size) ||
+	    HOST1X_BO_INVALIDATE(b->bo, b->bo->offset, size))
+		return -1;
+
+	if (memcmp((uint8_t *)map_a + a->bo->offset,
+		   (uint8_t *)map_b + b->bo->offset, size)) {
+		fprintf(stderr, "texel data differs\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int test_baked(struct grate *grate, const char *image,
+		      const char *path)
+{
+	struct grate_texture *baked, *loaded;
+	struct baked_texture_header hdr;
+	struct baked_texture_level level;
+	int err;
+
+	if (read_header(path, &hdr, &level) < 0) {
+		fprintf(stderr, "failed to read %s\n", path);
+		return -1;
+	}
+
+	baked = grate_create_baked_texture(grate, path);
+	loaded = grate_create_texture2(grate, image, hdr.format, hdr.layout);
+	if (!baked || !loaded) {
+		fprintf(stderr, "failed to load %s\n", path);
+		return -1;
+	}
+
+	err = compare_bos(baked, loaded, level.size);
+
+	grate_texture_free(loaded);
+	grate_texture_free(baked);
+
+	if (err < 0)
+		fprintf(stderr, "%s doesn't match %s\n", path, image);
+
+	return err;
+}
+
+/* writes a copy of @path cut to @size, with the first byte xored by @magic */
+static int write_copy(const char *path, const char *copy, size_t size,
+		      uint8_t magic)
+{
+	uint8_t *data;
+	size_t len;
+	FILE *fp;
+	int ret;
+
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+
+	data = malloc(size);
+	len = data ? fread(data, 1, size, fp) : 0;
+	fclose(fp);
+
+	if (len != size) {
+		free(data);
+		return -1;
+	}
+
+	data[0] ^= magic;
+
+	fp = fopen(copy, "w");
+	if (!fp) {
+		free(data);
+		return -1;
+	}
+
+	ret = fwrite(data, 1, size, fp) == size ? 0 : -1;
+	free(data);
+
+	if (fclose(fp))
+		ret = -1;
+
+	return ret;
+}
+
+static int test_invalid(struct grate *grate, const char *path)
+{
+	char copy[] = "/tmp/baked-texture-XXXXXX";
+	struct baked_texture_header hdr;
+	struct baked_texture_level level;
+	struct grate_texture *tex;
+	int fd, err = -1;
+
+	if (read_header(path, &hdr, &level) < 0)
+		return -1;
+
+	fd = mkstemp(copy);
+	if (fd < 0)
+		return -1;
+
+	close(fd);
+
+	/* the payload of the level ends one byte past the end of the file */
+	if (write_copy(path, copy, level.offset + level.size - 1, 0) < 0)
+		goto out;
+
+	tex = grate_create_baked_texture(grate, copy);
+	if (tex) {
+		fprintf(stderr, "truncated texture loaded\n");
+		grate_texture_free(tex);
+		goto out;
+	}
+
+	if (write_copy(path, copy, level.offset + level.size, 0xff) < 0)
+		goto out;
+
+	tex = grate_create_baked_texture(grate, copy);
+	if (tex) {
+		fprintf(stderr, "texture with a bad magic loaded\n");
+		grate_texture_free(tex);
+		goto out;
+	}
+
+	err = 0;
+out:
+	unlink(copy);
+
+	return err;
+}
+
+int main(int argc, char *argv[])
+{
+	struct grate_options options;
+	struct grate *grate;
+	int i;
+
+	if (!grate_parse_command_line(&options, argc, argv))
+		return 1;
+
+	if (argc - optind < 2) {
+		fprintf(stderr, "usage: %s image baked...\n", argv[0]);
+		return 1;
+	}
+
+	grate = grate_init(&options);
+	if (!grate)
+		return 1;
+
+	for (i = optind + 1; i < argc; i++)
+		if (test_baked(grate, argv[optind], argv[i]) < 0)
+			return 1;
+
+	if (test_invalid(grate, argv[optind + 1]) < 0)
+		return 1;
+
+	grate_exit(grate);
+
+	printf("test passed\n");
+
+	return 0;
+}
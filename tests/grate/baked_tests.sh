@@ -0,0 +1,12 @@
+DIR=$(dirname $0)
+IMAGE=$DIR/../../data/tegra.png
+TEX=$(mktemp -d)
+
+export GRATE_ETC1_QUALITY=fast
+
+	$DIR/../../tools/texbake --input $IMAGE --output $TEX/dxt5.tex --format dxt5 \
+&&	$DIR/../../tools/texbake --input $IMAGE --output $TEX/etc1.tex --format etc1 --etc1-quality fast \
+&&	$DIR/baked-texture $IMAGE $TEX/dxt5.tex $TEX/etc1.tex \
+&&	echo "All tests passed"
+
+rm -rf $TEX
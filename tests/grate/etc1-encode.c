@@ -0,0 +1,370 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Encodes a test image at every quality tier and thread count. Results must
+ * not depend on the number of threads, better tiers must not be worse than
+ * faster ones, and the pixel indices picked by the vectorized error search
+ * must be the closest colors of their sub-block palettes.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "etc1.h"
+
+#define WIDTH	101
+#define HEIGHT	67
+
+static const int modifiers[8][4] = {
+	{  2,   8,  -2,   -8 },
+	{  5,  17,  -5,  -17 },
+	{  9,  29,  -9,  -29 },
+	{ 13,  42, -13,  -42 },
+	{ 18,  60, -18,  -60 },
+	{ 24,  80, -24,  -80 },
+	{ 33, 106, -33, -106 },
+	{ 47, 183, -47, -183 },
+};
+
+static const char *tiers[] = {
+	[ETC1_QUALITY_FAST] = "fast",
+	[ETC1_QUALITY_MEDIUM] = "medium",
+	[ETC1_QUALITY_BEST] = "best",
+};
+
+static int clamp(int v)
+{
+	return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+/* the error measure of the encoder */
+static unsigned int error(const uint8_t *a, const uint8_t *b)
+{
+	int dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+
+	return 3 * dr * dr + 6 * dg * dg + db * db;
+}
+
+/* smooth gradients, a noisy band and hard edges */
+static void fill_image(uint8_t *pixels)
+{
+	unsigned int x, y;
+	uint32_t seed = 1;
+
+	for (y = 0; y < HEIGHT; y++) {
+		for (x = 0; x < WIDTH; x++) {
+			uint8_t *p = pixels + (y * WIDTH + x) * 3;
+
+			seed = seed * 1103515245 + 12345;
+
+			if (y < 24) {
+				p[0] = x * 255 / WIDTH;
+				p[1] = y * 10;
+				p[2] = 255 - x * 2;
+			} else if (y < 48) {
+				p[0] = seed >> 24;
+				p[1] = seed >> 16;
+				p[2] = seed >> 8;
+			} else {
+				p[0] = (x / 3 + y / 5) & 1 ? 250 : 10;
+				p[1] = x & 8 ? 200 : 40;
+				p[2] = y & 4 ? 128 : 0;
+			}
+		}
+	}
+}
+
+static void to_rgb565(uint8_t *out, const uint8_t *pixels)
+{
+	unsigned int i;
+
+	for (i = 0; i < WIDTH * HEIGHT; i++) {
+		const uint8_t *p = pixels + i * 3;
+		uint16_t c = (p[0] >> 3) << 11 | (p[1] >> 2) << 5 | p[2] >> 3;
+
+		out[i * 2 + 0] = c & 0xff;
+		out[i * 2 + 1] = c >> 8;
+	}
+}
+
+static unsigned long image_error(const uint8_t *etc, const uint8_t *pixels)
+{
+	uint8_t *decoded = malloc(WIDTH * HEIGHT * 3);
+	unsigned long sum = 0;
+	unsigned int i;
+
+	etc1_decode_image(etc, decoded, WIDTH, HEIGHT, 3, WIDTH * 3);
+
+	for (i = 0; i < WIDTH * HEIGHT; i++)
+		sum += error(decoded + i * 3, pixels + i * 3);
+
+	free(decoded);
+
+	return sum;
+}
+
+static void palette_color(uint8_t *c, const unsigned int *base,
+			  unsigned int table, unsigned int index)
+{
+	unsigned int i;
+
+	for (i = 0; i < 3; i++)
+		c[i] = clamp(base[i] + modifiers[table][index]);
+}
+
+/* error of the closest color of a palette */
+static unsigned int palette_error(const uint8_t *p, const unsigned int *base,
+				  unsigned int table)
+{
+	unsigned int min = ~0u;
+	unsigned int i;
+	uint8_t c[3];
+
+	for (i = 0; i < 4; i++) {
+		palette_color(c, base, table, i);
+
+		if (error(c, p) < min)
+			min = error(c, p);
+	}
+
+	return min;
+}
+
+static uint32_t read_be32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static unsigned int expand4(uint32_t v)
+{
+	return (v & 0xf) * 0x11;
+}
+
+static unsigned int expand5(uint32_t v)
+{
+	v &= 0x1f;
+
+	return (v << 3) | (v >> 2);
+}
+
+static unsigned int expand_diff(uint32_t base, uint32_t diff)
+{
+	int delta = (int)((diff & 7) ^ 4) - 4;
+
+	return expand5((base & 0x1f) + delta);
+}
+
+/*
+ * Checks that every valid pixel of a block uses the closest color of its
+ * sub-block palette and, if @best, that no other modifier table would have
+ * fit a sub-block better.
+ */
+static bool check_block(const uint8_t *block, const uint8_t *pixels,
+			unsigned int bx, unsigned int by, bool best)
+{
+	uint32_t high = read_be32(block);
+	uint32_t low = read_be32(block + 4);
+	bool flip = high & 1;
+	unsigned int base[2][3];
+	unsigned int score[2] = { 0, 0 };
+	unsigned int optimal[2][8];
+	unsigned int s, t, i, x, y;
+
+	if (high & 2) {
+		for (i = 0; i < 3; i++) {
+			base[0][i] = expand5(high >> (27 - i * 8));
+			base[1][i] = expand_diff(high >> (27 - i * 8),
+						 high >> (24 - i * 8));
+		}
+	} else {
+		for (i = 0; i < 3; i++) {
+			base[0][i] = expand4(high >> (28 - i * 8));
+			base[1][i] = expand4(high >> (24 - i * 8));
+		}
+	}
+
+	memset(optimal, 0, sizeof(optimal));
+
+	for (y = 0; y < 4; y++) {
+		for (x = 0; x < 4; x++) {
+			const uint8_t *p = pixels +
+					   ((by + y) * WIDTH + bx + x) * 3;
+			unsigned int k = x * 4 + y;
+			unsigned int idx = ((low >> k) & 1) |
+					   ((low >> (k + 15)) & 2);
+			unsigned int min;
+			uint8_t c[3];
+
+			if (bx + x >= WIDTH || by + y >= HEIGHT)
+				continue;
+
+			s = flip ? y >= 2 : x >= 2;
+			t = (high >> (5 - s * 3)) & 7;
+			min = palette_error(p, base[s], t);
+
+			palette_color(c, base[s], t, idx);
+
+			if (error(c, p) != min) {
+				fprintf(stderr, "block %u,%u: pixel %u,%u "
+					"isn't the closest color\n",
+					bx, by, x, y);
+				return false;
+			}
+
+			score[s] += min;
+
+			for (t = 0; t < 8; t++)
+				optimal[s][t] += palette_error(p, base[s], t);
+		}
+	}
+
+	if (!best)
+		return true;
+
+	for (s = 0; s < 2; s++) {
+		for (t = 0; t < 8; t++) {
+			if (optimal[s][t] < score[s]) {
+				fprintf(stderr, "block %u,%u: table %u fits "
+					"sub-block %u better\n", bx, by, t, s);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool check_image(const uint8_t *etc, const uint8_t *pixels, bool best)
+{
+	unsigned int bx, by;
+
+	for (by = 0; by < HEIGHT; by += 4) {
+		for (bx = 0; bx < WIDTH; bx += 4) {
+			if (!check_block(etc, pixels, bx, by, best))
+				return false;
+
+			etc += ETC1_ENCODED_BLOCK_SIZE;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	static const unsigned int threads[] = { 2, 3, 5, 0 };
+	unsigned int size = etc1_get_encoded_data_size(WIDTH, HEIGHT);
+	uint8_t *pixels = malloc(WIDTH * HEIGHT * 3);
+	uint8_t *rgb565 = malloc(WIDTH * HEIGHT * 2);
+	uint8_t *ref = malloc(size);
+	uint8_t *etc[3], *etc565 = malloc(size);
+	unsigned long err[3];
+	unsigned int q, i;
+	bool ok = true;
+
+	fill_image(pixels);
+	to_rgb565(rgb565, pixels);
+
+	if (etc1_encode_image(pixels, WIDTH, HEIGHT, 3, WIDTH * 3, ref)) {
+		fprintf(stderr, "etc1_encode_image() failed\n");
+		return 1;
+	}
+
+	for (q = ETC1_QUALITY_FAST; q <= ETC1_QUALITY_BEST; q++) {
+		etc[q] = malloc(size);
+
+		if (etc1_encode_image_mt(pixels, WIDTH, HEIGHT, 3, WIDTH * 3,
+					 etc[q], q, 1) ||
+		    etc1_encode_image_mt(rgb565, WIDTH, HEIGHT, 2, WIDTH * 2,
+					 etc565, q, 1)) {
+			fprintf(stderr, "%s: encoding failed\n", tiers[q]);
+			return 1;
+		}
+
+		for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+			uint8_t *out = malloc(size);
+
+			etc1_encode_image_mt(pixels, WIDTH, HEIGHT, 3,
+					     WIDTH * 3, out, q, threads[i]);
+			if (memcmp(out, etc[q], size)) {
+				fprintf(stderr, "%s: %u threads differ\n",
+					tiers[q], threads[i]);
+				ok = false;
+			}
+
+			etc1_encode_image_mt(rgb565, WIDTH, HEIGHT, 2,
+					     WIDTH * 2, out, q, threads[i]);
+			if (memcmp(out, etc565, size)) {
+				fprintf(stderr, "%s: %u threads differ (565)\n",
+					tiers[q], threads[i]);
+				ok = false;
+			}
+
+			free(out);
+		}
+
+		if (!check_image(etc[q], pixels, q == ETC1_QUALITY_BEST))
+			ok = false;
+
+		err[q] = image_error(etc[q], pixels);
+		printf("%s: error %lu\n", tiers[q], err[q]);
+	}
+
+	if (memcmp(ref, etc[ETC1_QUALITY_BEST], size)) {
+		fprintf(stderr, "etc1_encode_image() differs from %s\n",
+			tiers[ETC1_QUALITY_BEST]);
+		ok = false;
+	}
+
+	if (err[ETC1_QUALITY_BEST] > err[ETC1_QUALITY_MEDIUM] ||
+	    err[ETC1_QUALITY_MEDIUM] > err[ETC1_QUALITY_FAST]) {
+		fprintf(stderr, "better tiers have larger errors\n");
+		ok = false;
+	}
+
+	if (!etc1_encode_image_mt(pixels, WIDTH, HEIGHT, 3, WIDTH * 3, ref,
+				  ETC1_QUALITY_BEST + 1, 1) ||
+	    !etc1_encode_image_mt(pixels, WIDTH, HEIGHT, 4, WIDTH * 4, ref,
+				  ETC1_QUALITY_BEST, 1)) {
+		fprintf(stderr, "invalid arguments accepted\n");
+		ok = false;
+	}
+
+	for (q = ETC1_QUALITY_FAST; q <= ETC1_QUALITY_BEST; q++)
+		free(etc[q]);
+
+	free(etc565);
+	free(ref);
+	free(rgb565);
+	free(pixels);
+
+	if (!ok)
+		return 1;
+
+	printf("test passed\n");
+
+	return 0;
+}
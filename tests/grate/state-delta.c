@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Records draws that change only part of the GR3D state, including program,
+ * uniform and scissor changes, a second context and a batch boundary, and
+ * checks the rendered pixels once everything has been flushed.
+ */
+
+#include <stdio.h>
+
+#include "grate.h"
+#include "tgr_3d.xml.h"
+
+#define SIZE	64
+
+#define RED	0xff0000ff
+#define YELLOW	0xff00ffff
+#define BLUE	0xffff0000
+#define WHITE	0xffffffff
+#define BLACK	0xff000000
+
+static const char *vs_asm =
+	".attributes\n"
+	"	[0] = \"position\";\n"
+	"	[1] = \"color\";\n"
+	".exports\n"
+	"	[0] = \"gl_Position\";\n"
+	"	[7] = \"vcolor\";\n"
+	".asm\n"
+	"EXEC(export[0]=vector)\n"
+	"	MOVv r0.xyzw, a[0].xyzw\n"
+	"	NOPs\n"
+	";\n"
+	"EXEC(export[7]=vector)\n"
+	"	MOVv r0.xyzw, a[1].xyzw\n"
+	"	NOPs\n"
+	";\n";
+
+/* writes the interpolated vertex color */
+static const char *fs_color_asm =
+	"alu_buffer_size = 1\n"
+	"pseq_to_dw_exec_nb = 1\n"
+	".asm\n"
+	"EXEC\n"
+	"	MFU:	sfu: rcp r4\n"
+	"		mul0: bar, sfu, bar0\n"
+	"		mul1: bar, sfu, bar1\n"
+	"		ipl: t0.fp20, t0.fp20, t0.fp20, t0.fp20\n"
+	"	TEX:	NOP\n"
+	"	ALU:\n"
+	"		ALU0:	MAD  r3.*h,  r3, #1, #0, #1\n"
+	"		ALU1:	MAD  r3.l*,  r2, #1, #0, #1\n"
+	"		ALU2:	MAD  r2.*h,  r0, #1, #0, #1\n"
+	"		ALU3:	MAD  r2.l*,  r1, #1, #0, #1\n"
+	"	DW:	store rt1, r2, r3\n"
+	";\n";
+
+/* writes the color given by the uniforms */
+static const char *fs_uniform_asm =
+	"alu_buffer_size = 1\n"
+	"pseq_to_dw_exec_nb = 1\n"
+	".uniforms\n"
+	"	[0].l  = \"alpha\";\n"
+	"	[2]    = \"blue\";\n"
+	"	[31].l = \"green\";\n"
+	"	[31].h = \"red\";\n"
+	".asm\n"
+	"EXEC\n"
+	"	ALU:\n"
+	"		ALU0:	MAD  r3.*h,  u0.l,  #1, #0, #1\n"
+	"		ALU1:	MAD  r3.l*,  u2,    #1, #0, #1\n"
+	"		ALU2:	MAD  r2.*h,  u31.l, #1, #0, #1\n"
+	"		ALU3:	MAD  r2.l*,  u31.h, #1, #0, #1\n"
+	"	DW:	store rt1, r2, r3\n"
+	";\n";
+
+static const char *linker_asm =
+	"LINK fp20, fp20, fp20, fp20, tram0.yxzw, export1";
+
+/* one quad per quadrant: top-left, top-right, bottom-left, bottom-right */
+static const float vertices[] = {
+	-1.0f, -1.0f, 0.0f, 1.0f,   0.0f, -1.0f, 0.0f, 1.0f,
+	 0.0f,  0.0f, 0.0f, 1.0f,  -1.0f,  0.0f, 0.0f, 1.0f,
+
+	 0.0f, -1.0f, 0.0f, 1.0f,   1.0f, -1.0f, 0.0f, 1.0f,
+	 1.0f,  0.0f, 0.0f, 1.0f,   0.0f,  0.0f, 0.0f, 1.0f,
+
+	-1.0f,  0.0f, 0.0f, 1.0f,   0.0f,  0.0f, 0.0f, 1.0f,
+	 0.0f,  1.0f, 0.0f, 1.0f,  -1.0f,  1.0f, 0.0f, 1.0f,
+
+	 0.0f,  0.0f, 0.0f, 1.0f,   1.0f,  0.0f, 0.0f, 1.0f,
+	 1.0f,  1.0f, 0.0f, 1.0f,   0.0f,  1.0f, 0.0f, 1.0f,
+};
+
+static const float colors[] = {
+	0.0f, 0.0f, 1.0f, 1.0f,  0.0f, 0.0f, 1.0f, 1.0f,
+	0.0f, 0.0f, 1.0f, 1.0f,  0.0f, 0.0f, 1.0f, 1.0f,
+	0.0f, 0.0f, 1.0f, 1.0f,  0.0f, 0.0f, 1.0f, 1.0f,
+	0.0f, 0.0f, 1.0f, 1.0f,  0.0f, 0.0f, 1.0f, 1.0f,
+	0.0f, 0.0f, 1.0f, 1.0f,  0.0f, 0.0f, 1.0f, 1.0f,
+	0.0f, 0.0f, 1.0f, 1.0f,  0.0f, 0.0f, 1.0f, 1.0f,
+	0.0f, 0.0f, 1.0f, 1.0f,  0.0f, 0.0f, 1.0f, 1.0f,
+	0.0f, 0.0f, 1.0f, 1.0f,  0.0f, 0.0f, 1.0f, 1.0f,
+};
+
+static const unsigned short indices[4][6] = {
+	{  0,  1,  2,  0,  2,  3 },
+	{  4,  5,  6,  4,  6,  7 },
+	{  8,  9, 10,  8, 10, 11 },
+	{ 12, 13, 14, 12, 14, 15 },
+};
+
+static struct grate_program *create_program(struct grate *grate,
+					    const char *fs_asm)
+{
+	struct grate_shader *vs, *fs, *linker;
+	struct grate_program *program;
+
+	vs = grate_shader_parse_vertex_asm(vs_asm);
+	fs = grate_shader_parse_fragment_asm(fs_asm);
+	linker = grate_shader_parse_linker_asm(linker_asm);
+	if (!vs || !fs || !linker)
+		return NULL;
+
+	program = grate_program_new(grate, vs, fs, linker);
+	if (program)
+		grate_program_link(program);
+
+	return program;
+}
+
+static struct grate_3d_ctx *create_ctx(struct grate *grate,
+				       struct grate_program *program,
+				       struct host1x_pixelbuffer *pixbuf,
+				       struct host1x_bo *vertices_bo,
+				       struct host1x_bo *colors_bo)
+{
+	struct grate_3d_ctx *ctx;
+	int location;
+
+	ctx = grate_3d_alloc_ctx(grate);
+	if (!ctx)
+		return NULL;
+
+	grate_3d_ctx_bind_program(ctx, program);
+	grate_3d_ctx_set_depth_range(ctx, 0.0f, 1.0f);
+	grate_3d_ctx_set_dither(ctx, 0x779);
+	grate_3d_ctx_set_point_params(ctx, 0x1401);
+	grate_3d_ctx_set_point_size(ctx, 1.0f);
+	grate_3d_ctx_set_line_params(ctx, 0x2);
+	grate_3d_ctx_set_line_width(ctx, 1.0f);
+	grate_3d_ctx_set_viewport_bias(ctx, 0.0f, 0.0f, 0.5f);
+	grate_3d_ctx_set_viewport_scale(ctx, SIZE, SIZE, 0.5f);
+	grate_3d_ctx_use_guardband(ctx, true);
+	grate_3d_ctx_set_front_direction_is_cw(ctx, false);
+	grate_3d_ctx_set_cull_face(ctx, GRATE_3D_CTX_CULL_FACE_NONE);
+	grate_3d_ctx_set_scissor(ctx, 0, SIZE, 0, SIZE);
+	grate_3d_ctx_set_point_coord_range(ctx, 0.0f, 1.0f, 0.0f, 1.0f);
+	grate_3d_ctx_set_polygon_offset(ctx, 0.0f, 0.0f);
+	grate_3d_ctx_set_provoking_vtx_last(ctx, true);
+
+	location = grate_get_attribute_location(program, "position");
+	grate_3d_ctx_vertex_attrib_float_pointer(ctx, location, 4,
+						 vertices_bo);
+	grate_3d_ctx_enable_vertex_attrib_array(ctx, location);
+
+	location = grate_get_attribute_location(program, "color");
+	grate_3d_ctx_vertex_attrib_float_pointer(ctx, location, 4, colors_bo);
+	grate_3d_ctx_enable_vertex_attrib_array(ctx, location);
+
+	grate_3d_ctx_bind_render_target(ctx, 1, pixbuf);
+	grate_3d_ctx_enable_render_target(ctx, 1);
+
+	return ctx;
+}
+
+static void set_color(struct grate_3d_ctx *ctx, struct grate_program *program,
+		      float red, float green, float blue, float alpha)
+{
+	static const char * const names[] = { "red", "green", "blue", "alpha" };
+	float values[] = { red, green, blue, alpha };
+	unsigned int i;
+
+	for (i = 0; i < 4; i++)
+		grate_3d_ctx_set_fragment_float_uniform(ctx,
+			grate_get_fragment_uniform_location(program, names[i]),
+			values[i]);
+}
+
+static void draw(struct grate_3d_ctx *ctx, struct host1x_bo *indices_bo)
+{
+	grate_3d_draw_elements(ctx, TGR3D_PRIMITIVE_TYPE_TRIANGLES,
+			       indices_bo, TGR3D_INDEX_MODE_UINT16, 6);
+}
+
+static bool check_pixel(const uint32_t *pixels, unsigned int x,
+			unsigned int y, uint32_t expected)
+{
+	uint32_t pixel = pixels[y * SIZE + x];
+
+	if (pixel == expected)
+		return true;
+
+	fprintf(stderr, "pixel %u,%u: 0x%08x != 0x%08x\n", x, y, pixel,
+		expected);
+
+	return false;
+}
+
+int main(int argc, char *argv[])
+{
+	struct grate_program *uniform_program, *color_program;
+	struct host1x_bo *vertices_bo, *colors_bo, *indices_bo[4];
+	struct grate_3d_ctx *ctx, *ctx2;
+	struct host1x_pixelbuffer *pixbuf;
+	struct grate_options options;
+	struct grate_framebuffer *fb;
+	struct grate *grate;
+	uint32_t *pixels;
+	bool ok = true;
+	unsigned int i;
+
+	if (!grate_parse_command_line(&options, argc, argv))
+		return 1;
+
+	grate = grate_init(&options);
+	if (!grate)
+		return 1;
+
+	fb = grate_framebuffer_create(grate, SIZE, SIZE, PIX_BUF_FMT_RGBA8888,
+				      PIX_BUF_LAYOUT_LINEAR,
+				      GRATE_SINGLE_BUFFERED);
+	if (!fb)
+		return 1;
+
+	grate_clear_color(grate, 0.0f, 0.0f, 0.0f, 1.0f);
+	grate_bind_framebuffer(grate, fb);
+	grate_clear(grate);
+
+	uniform_program = create_program(grate, fs_uniform_asm);
+	color_program = create_program(grate, fs_color_asm);
+	if (!uniform_program || !color_program) {
+		fprintf(stderr, "failed to create programs\n");
+		return 1;
+	}
+
+	vertices_bo = grate_create_attrib_bo_from_data(grate, vertices);
+	colors_bo = grate_create_attrib_bo_from_data(grate, colors);
+
+	for (i = 0; i < 4; i++)
+		indices_bo[i] = grate_create_attrib_bo_from_data(grate,
+								 indices[i]);
+
+	pixbuf = grate_get_draw_pixbuf(fb);
+
+	ctx = create_ctx(grate, uniform_program, pixbuf, vertices_bo,
+			 colors_bo);
+	ctx2 = create_ctx(grate, color_program, pixbuf, vertices_bo,
+			  colors_bo);
+	if (!ctx || !ctx2)
+		return 1;
+
+	/* only the FS uniforms change between the first two draws */
+	set_color(ctx, uniform_program, 1.0f, 0.0f, 0.0f, 1.0f);
+	draw(ctx, indices_bo[0]);
+
+	set_color(ctx, uniform_program, 0.0f, 1.0f, 0.0f, 1.0f);
+	draw(ctx, indices_bo[1]);
+
+	/* another context in the same batch, then back to the first one */
+	draw(ctx2, indices_bo[2]);
+
+	set_color(ctx, uniform_program, 1.0f, 1.0f, 1.0f, 1.0f);
+	grate_3d_ctx_set_scissor(ctx, 0, SIZE * 3 / 4, 0, SIZE);
+	draw(ctx, indices_bo[3]);
+
+	/* the next batch has to start over with the complete state */
+	grate_flush(grate);
+
+	grate_3d_ctx_bind_program(ctx, uniform_program);
+	grate_3d_ctx_set_scissor(ctx, 0, SIZE, 0, SIZE);
+	set_color(ctx, uniform_program, 1.0f, 1.0f, 0.0f, 1.0f);
+	draw(ctx, indices_bo[1]);
+
+	grate_finish(grate);
+
+	pixels = grate_framebuffer_data(fb, true);
+	if (!pixels)
+		return 1;
+
+	ok &= check_pixel(pixels, SIZE / 4, SIZE / 4, RED);
+	ok &= check_pixel(pixels, SIZE * 3 / 4, SIZE / 4, YELLOW);
+	ok &= check_pixel(pixels, SIZE / 4, SIZE * 3 / 4, BLUE);
+	ok &= check_pixel(pixels, SIZE * 5 / 8, SIZE * 3 / 4, WHITE);
+	ok &= check_pixel(pixels, SIZE * 7 / 8, SIZE * 3 / 4, BLACK);
+
+	grate_exit(grate);
+
+	if (!ok)
+		return 1;
+
+	printf("test passed\n");
+
+	return 0;
+}
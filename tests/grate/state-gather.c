@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Switches between state objects that scissor the draws to one quadrant
+ * each, so that every draw gathers a state object and its pushbuf array
+ * keeps growing, over several batches, and checks the color each quadrant
+ * ended up with.
+ */
+
+#include <stdio.h>
+
+#include "grate.h"
+#include "grate-3d-ctx.h"
+#include "tgr_3d.xml.h"
+
+#define SIZE		64
+#define NUM_DRAWS	37
+
+static const char *vs_asm =
+	".attributes\n"
+	"	[0] = \"position\";\n"
+	"	[1] = \"color\";\n"
+	".exports\n"
+	"	[0] = \"gl_Position\";\n"
+	"	[7] = \"vcolor\";\n"
+	".asm\n"
+	"EXEC(export[0]=vector)\n"
+	"	MOVv r0.xyzw, a[0].xyzw\n"
+	"	NOPs\n"
+	";\n"
+	"EXEC(export[7]=vector)\n"
+	"	MOVv r0.xyzw, a[1].xyzw\n"
+	"	NOPs\n"
+	";\n";
+
+/* writes the color given by the uniforms */
+static const char *fs_uniform_asm =
+	"alu_buffer_size = 1\n"
+	"pseq_to_dw_exec_nb = 1\n"
+	".uniforms\n"
+	"	[0].l  = \"alpha\";\n"
+	"	[2]    = \"blue\";\n"
+	"	[31].l = \"green\";\n"
+	"	[31].h = \"red\";\n"
+	".asm\n"
+	"EXEC\n"
+	"	ALU:\n"
+	"		ALU0:	MAD  r3.*h,  u0.l,  #1, #0, #1\n"
+	"		ALU1:	MAD  r3.l*,  u2,    #1, #0, #1\n"
+	"		ALU2:	MAD  r2.*h,  u31.l, #1, #0, #1\n"
+	"		ALU3:	MAD  r2.l*,  u31.h, #1, #0, #1\n"
+	"	DW:	store rt1, r2, r3\n"
+	";\n";
+
+static const char *linker_asm =
+	"LINK fp20, fp20, fp20, fp20, tram0.yxzw, export1";
+
+static const float vertices[] = {
+	-1.0f, -1.0f, 0.0f, 1.0f,   1.0f, -1.0f, 0.0f, 1.0f,
+	 1.0f,  1.0f, 0.0f, 1.0f,  -1.0f,  1.0f, 0.0f, 1.0f,
+};
+
+static const unsigned short indices[] = { 0, 1, 2, 0, 2, 3 };
+
+static const struct {
+	float red, green, blue;
+	uint32_t pixel;
+} palette[] = {
+	{ 1.0f, 0.0f, 0.0f, 0xff0000ff },
+	{ 0.0f, 1.0f, 0.0f, 0xff00ff00 },
+	{ 0.0f, 0.0f, 1.0f, 0xffff0000 },
+	{ 1.0f, 1.0f, 0.0f, 0xff00ffff },
+	{ 1.0f, 1.0f, 1.0f, 0xffffffff },
+};
+
+static void set_color(struct grate_3d_ctx *ctx, struct grate_program *program,
+		      unsigned int index)
+{
+	static const char * const names[] = { "red", "green", "blue", "alpha" };
+	float values[] = {
+		palette[index].red,
+		palette[index].green,
+		palette[index].blue,
+		1.0f,
+	};
+	unsigned int i;
+
+	for (i = 0; i < 4; i++)
+		grate_3d_ctx_set_fragment_float_uniform(ctx,
+			grate_get_fragment_uniform_location(program, names[i]),
+			values[i]);
+}
+
+int main(int argc, char *argv[])
+{
+	struct grate_3d_state *states[4];
+	struct host1x_bo *vertices_bo, *indices_bo;
+	struct grate_shader *vs, *fs, *linker;
+	struct host1x_pixelbuffer *pixbuf;
+	struct grate_program *program;
+	struct grate_options options;
+	struct grate_framebuffer *fb;
+	struct grate_3d_ctx *ctx;
+	uint32_t expected[4] = { 0xff000000, 0xff000000,
+				 0xff000000, 0xff000000 };
+	struct grate *grate;
+	uint32_t *pixels;
+	unsigned int i, q;
+	bool ok = true;
+	int location;
+
+	if (!grate_parse_command_line(&options, argc, argv))
+		return 1;
+
+	grate = grate_init(&options);
+	if (!grate)
+		return 1;
+
+	fb = grate_framebuffer_create(grate, SIZE, SIZE, PIX_BUF_FMT_RGBA8888,
+				      PIX_BUF_LAYOUT_LINEAR,
+				      GRATE_SINGLE_BUFFERED);
+	if (!fb)
+		return 1;
+
+	grate_clear_color(grate, 0.0f, 0.0f, 0.0f, 1.0f);
+	grate_bind_framebuffer(grate, fb);
+	grate_clear(grate);
+
+	vs = grate_shader_parse_vertex_asm(vs_asm);
+	fs = grate_shader_parse_fragment_asm(fs_uniform_asm);
+	linker = grate_shader_parse_linker_asm(linker_asm);
+	if (!vs || !fs || !linker)
+		return 1;
+
+	program = grate_program_new(grate, vs, fs, linker);
+	if (!program)
+		return 1;
+
+	grate_program_link(program);
+
+	vertices_bo = grate_create_attrib_bo_from_data(grate, vertices);
+	indices_bo = grate_create_attrib_bo_from_data(grate, indices);
+	pixbuf = grate_get_draw_pixbuf(fb);
+
+	ctx = grate_3d_alloc_ctx(grate);
+	if (!ctx)
+		return 1;
+
+	grate_3d_ctx_bind_program(ctx, program);
+	grate_3d_ctx_set_depth_range(ctx, 0.0f, 1.0f);
+	grate_3d_ctx_set_dither(ctx, 0x779);
+	grate_3d_ctx_set_point_params(ctx, 0x1401);
+	grate_3d_ctx_set_point_size(ctx, 1.0f);
+	grate_3d_ctx_set_line_params(ctx, 0x2);
+	grate_3d_ctx_set_line_width(ctx, 1.0f);
+	grate_3d_ctx_set_viewport_bias(ctx, 0.0f, 0.0f, 0.5f);
+	grate_3d_ctx_set_viewport_scale(ctx, SIZE, SIZE, 0.5f);
+	grate_3d_ctx_use_guardband(ctx, true);
+	grate_3d_ctx_set_front_direction_is_cw(ctx, false);
+	grate_3d_ctx_set_cull_face(ctx, GRATE_3D_CTX_CULL_FACE_NONE);
+	grate_3d_ctx_set_point_coord_range(ctx, 0.0f, 1.0f, 0.0f, 1.0f);
+	grate_3d_ctx_set_polygon_offset(ctx, 0.0f, 0.0f);
+	grate_3d_ctx_set_provoking_vtx_last(ctx, true);
+
+	location = grate_get_attribute_location(program, "position");
+	grate_3d_ctx_vertex_attrib_float_pointer(ctx, location, 4,
+						 vertices_bo);
+	grate_3d_ctx_enable_vertex_attrib_array(ctx, location);
+
+	grate_3d_ctx_bind_render_target(ctx, 1, pixbuf);
+	grate_3d_ctx_enable_render_target(ctx, 1);
+
+	/* quadrant q is scissored to by state q */
+	for (q = 0; q < 4; q++) {
+		grate_3d_ctx_set_scissor(ctx, (q % 2) * SIZE / 2, SIZE / 2,
+					 (q / 2) * SIZE / 2, SIZE / 2);
+
+		states[q] = grate_3d_create_state(ctx);
+		if (!states[q])
+			return 1;
+	}
+
+	for (i = 0; i < NUM_DRAWS; i++) {
+		q = (i * 3) % 4;
+
+		grate_3d_ctx_bind_state(ctx, states[q]);
+		set_color(ctx, program, i % 5);
+		grate_3d_draw_elements(ctx, TGR3D_PRIMITIVE_TYPE_TRIANGLES,
+				       indices_bo, TGR3D_INDEX_MODE_UINT16, 6);
+
+		expected[q] = palette[i % 5].pixel;
+
+		/* later batches gather the states again */
+		if (i % 16 == 15)
+			grate_flush(grate);
+	}
+
+	grate_finish(grate);
+
+	pixels = grate_framebuffer_data(fb, true);
+	if (!pixels)
+		return 1;
+
+	for (q = 0; q < 4; q++) {
+		unsigned int x = (q % 2) * SIZE / 2 + SIZE / 4;
+		unsigned int y = (q / 2) * SIZE / 2 + SIZE / 4;
+		uint32_t pixel = pixels[y * SIZE + x];
+
+		if (pixel != expected[q]) {
+			fprintf(stderr, "quadrant %u: 0x%08x != 0x%08x\n", q,
+				pixel, expected[q]);
+			ok = false;
+		}
+	}
+
+	for (q = 0; q < 4; q++)
+		grate_3d_free_state(states[q]);
+
+	grate_exit(grate);
+
+	if (!ok)
+		return 1;
+
+	printf("test passed\n");
+
+	return 0;
+}
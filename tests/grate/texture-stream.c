@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Streams a few textures in different formats and layouts. They must
+ * sample the placeholder until the stream polled them in, and then hold
+ * the same texels as the image loaded synchronously. Textures that are
+ * freed while their upload is in flight must be dropped quietly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "grate.h"
+
+#define TIMEOUT_MS	30000
+
+static const struct {
+	const char *path;
+	enum pixel_format format;
+	enum layout_format layout;
+} textures[] = {
+	{ "data/tegra.png", PIX_BUF_FMT_RGBA8888, PIX_BUF_LAYOUT_LINEAR },
+	{ "data/checkerboard.png", PIX_BUF_FMT_RGBA8888,
+	  PIX_BUF_LAYOUT_TILED_16x16 },
+	{ "data/tegra.png", PIX_BUF_FMT_DXT1, PIX_BUF_LAYOUT_LINEAR },
+	{ "data/checkerboard.png", PIX_BUF_FMT_ETC1, PIX_BUF_LAYOUT_LINEAR },
+	/* tiled compressed textures are loaded by the CPU */
+	{ "data/tegra.png", PIX_BUF_FMT_DXT5, PIX_BUF_LAYOUT_TILED_16x16 },
+};
+
+#define NUM_TEXTURES	(sizeof(textures) / sizeof(textures[0]))
+
+static unsigned int elapsed_ms(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000 +
+	       (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/* copies the texels out, without the padding of the rows and tiles */
+static int read_texels(struct host1x_pixelbuffer *pixbuf, uint8_t *texels,
+		       unsigned int pitch, unsigned int rows)
+{
+	unsigned int tw = PIX_BUF_FORMAT_TEXEL_WIDTH(pixbuf->format);
+	unsigned int th = PIX_BUF_FORMAT_TEXEL_HEIGHT(pixbuf->format);
+	unsigned int y;
+	uint8_t *map;
+	int err;
+
+	err = HOST1X_BO_MMAP(pixbuf->bo, (void **)&map);
+	if (err)
+		return err;
+
+	err = HOST1X_BO_INVALIDATE(pixbuf->bo, pixbuf->bo->offset,
+				   pixbuf->bo->size - pixbuf->bo->offset);
+	if (err)
+		return err;
+
+	map += pixbuf->bo->offset;
+
+	if (pixbuf->layout == PIX_BUF_LAYOUT_TILED_16x16)
+		return host1x_detile_rect(texels, pitch, map, pixbuf->pitch,
+					  pixbuf->format, 0, 0,
+					  ALIGN(pixbuf->width, tw),
+					  rows * th);
+
+	for (y = 0; y < rows; y++)
+		memcpy(texels + y * pitch, map + y * pixbuf->pitch, pitch);
+
+	return 0;
+}
+
+static int compare_texels(struct grate *grate, struct grate_texture *tex,
+			  unsigned int i)
+{
+	struct host1x_pixelbuffer *a, *b;
+	struct grate_texture *loaded;
+	unsigned int tw, th, pitch, rows;
+	uint8_t *texels_a, *texels_b;
+	int err = -1;
+
+	loaded = grate_create_texture2(grate, textures[i].path,
+				       textures[i].format,
+				       textures[i].layout);
+	if (!loaded)
+		return -1;
+
+	a = grate_texture_pixbuf(tex);
+	b = grate_texture_pixbuf(loaded);
+
+	if (a->width != b->width || a->height != b->height ||
+	    a->format != b->format || a->layout != b->layout) {
+		fprintf(stderr, "texture %u is %ux%u, expected %ux%u\n",
+			i, a->width, a->height, b->width, b->height);
+		grate_texture_free(loaded);
+		return -1;
+	}
+
+	tw = PIX_BUF_FORMAT_TEXEL_WIDTH(a->format);
+	th = PIX_BUF_FORMAT_TEXEL_HEIGHT(a->format);
+	pitch = ALIGN(a->width, tw) / tw * PIX_BUF_FORMAT_BYTES(a->format);
+	rows = ALIGN(a->height, th) / th;
+
+	texels_a = malloc(pitch * rows);
+	texels_b = malloc(pitch * rows);
+
+	if (!texels_a || !texels_b ||
+	    read_texels(a, texels_a, pitch, rows) ||
+	    read_texels(b, texels_b, pitch, rows))
+		goto out;
+
+	if (memcmp(texels_a, texels_b, pitch * rows)) {
+		fprintf(stderr, "texture %u: texels differ\n", i);
+		goto out;
+	}
+
+	err = 0;
+out:
+	free(texels_b);
+	free(texels_a);
+	grate_texture_free(loaded);
+
+	return err;
+}
+
+int main(int argc, char *argv[])
+{
+	struct grate_texture *tex[NUM_TEXTURES], *freed[2];
+	struct host1x_pixelbuffer *placeholder;
+	struct grate_options options;
+	unsigned int i, ready = 0;
+	struct timespec start;
+	struct grate *grate;
+	int ret;
+
+	if (!grate_parse_command_line(&options, argc, argv))
+		return 1;
+
+	/* the dummy backend completes the blits late, like the hardware */
+	setenv("HOST1X_DUMMY_LATENCY", "20000", 1);
+
+	grate = grate_init(&options);
+	if (!grate)
+		return 1;
+
+	for (i = 0; i < NUM_TEXTURES; i++) {
+		tex[i] = grate_create_texture_async(grate, textures[i].path,
+						    textures[i].format,
+						    textures[i].layout);
+		if (!tex[i])
+			return 1;
+	}
+
+	placeholder = grate_texture_pixbuf(tex[0]);
+
+	for (i = 0; i < NUM_TEXTURES; i++) {
+		if (grate_texture_ready(tex[i]) ||
+		    grate_texture_pixbuf(tex[i]) != placeholder) {
+			fprintf(stderr, "texture %u ready before a poll\n", i);
+			return 1;
+		}
+	}
+
+	/* one is freed before any worker got to it, one after a poll */
+	for (i = 0; i < 2; i++) {
+		freed[i] = grate_create_texture_async(grate, textures[i].path,
+						      textures[i].format,
+						      textures[i].layout);
+		if (!freed[i])
+			return 1;
+	}
+
+	grate_texture_free(freed[0]);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (ready < NUM_TEXTURES) {
+		ret = grate_texture_stream_poll(grate);
+		if (ret < 0) {
+			fprintf(stderr, "poll failed: %d\n", ret);
+			return 1;
+		}
+
+		if (freed[1]) {
+			if (grate_texture_ready(freed[1]))
+				ret--;
+
+			grate_texture_free(freed[1]);
+			freed[1] = NULL;
+		}
+
+		ready += ret;
+
+		if (ready > NUM_TEXTURES) {
+			fprintf(stderr, "%u textures got ready\n", ready);
+			return 1;
+		}
+
+		if (elapsed_ms(&start) > TIMEOUT_MS) {
+			fprintf(stderr, "%u of %zu textures got ready\n",
+				ready, NUM_TEXTURES);
+			return 1;
+		}
+
+		usleep(1000);
+	}
+
+	for (i = 0; i < NUM_TEXTURES; i++) {
+		if (!grate_texture_ready(tex[i]) ||
+		    grate_texture_pixbuf(tex[i]) == placeholder) {
+			fprintf(stderr, "texture %u isn't ready\n", i);
+			return 1;
+		}
+
+		if (compare_texels(grate, tex[i], i) < 0)
+			return 1;
+	}
+
+	/* the freed textures must not show up late */
+	for (i = 0; i < 10; i++) {
+		ret = grate_texture_stream_poll(grate);
+		if (ret) {
+			fprintf(stderr, "freed texture got ready\n");
+			return 1;
+		}
+
+		usleep(1000);
+	}
+
+	for (i = 0; i < NUM_TEXTURES; i++)
+		grate_texture_free(tex[i]);
+
+	grate_exit(grate);
+
+	printf("test passed\n");
+
+	return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Builds a job on a command ring of two small segments that takes more
+ * space than the whole ring, growing pushbufs across the wrap point, and
+ * checks that none of its commands got overwritten before the submission.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "host1x.h"
+#include "host1x-private.h"
+
+#define SEGMENT_SIZE	4096
+#define NUM_PUSHBUFS	6
+#define NUM_WORDS	700
+
+static int check(struct host1x_job *job, const unsigned int *first)
+{
+	unsigned int i, k;
+
+	for (i = 0; i < job->num_pushbufs; i++) {
+		struct host1x_pushbuf *pb = &job->pushbufs[i];
+		uint32_t *words = pb->bo->ptr + pb->offset;
+
+		if (pb->length < NUM_WORDS) {
+			host1x_error("pushbuf %u has %lu words\n", i,
+				     pb->length);
+			return -1;
+		}
+
+		for (k = 0; k < NUM_WORDS; k++) {
+			uint32_t expected = HOST1X_OPCODE_EXTEND(0, first[i] + k);
+
+			if (words[k] != expected) {
+				host1x_error("pushbuf %u word %u 0x%08x != "
+					     "0x%08x\n", i, k, words[k],
+					     expected);
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int first[NUM_PUSHBUFS], value = 0, i, k;
+	struct host1x_options options = {};
+	struct host1x_syncpt *syncpt;
+	struct host1x_cmdring *ring;
+	struct host1x_pushbuf *pb;
+	struct host1x_gr2d *gr2d;
+	struct host1x_job *job;
+	struct host1x *host1x;
+	uint32_t fence;
+	int err;
+
+	options.display_id = -1;
+	options.fd = -1;
+
+	host1x = host1x_open(&options);
+	if (!host1x) {
+		fprintf(stderr, "host1x_open() failed\n");
+		return 1;
+	}
+
+	gr2d = host1x_get_gr2d(host1x);
+	if (!gr2d) {
+		fprintf(stderr, "host1x_get_gr2d() failed\n");
+		return 1;
+	}
+
+	syncpt = &gr2d->client->syncpts[0];
+
+	ring = host1x_cmdring_create(host1x, gr2d->client, 2, SEGMENT_SIZE);
+	if (!ring)
+		return 1;
+
+	job = HOST1X_JOB_CREATE(syncpt->id, 1);
+	if (!job)
+		return 1;
+
+	/*
+	 * Every pushbuf takes most of a segment and starts behind the previous
+	 * one, so all but the first overflow into the next segment and the
+	 * ring wraps around a few times.
+	 */
+	for (i = 0; i < NUM_PUSHBUFS; i++) {
+		pb = host1x_cmdring_append(ring, job);
+		if (!pb)
+			return 1;
+
+		first[i] = value;
+
+		for (k = 0; k < NUM_WORDS; k++) {
+			err = host1x_pushbuf_push(pb,
+					HOST1X_OPCODE_EXTEND(0, value++));
+			if (err < 0)
+				return 1;
+		}
+	}
+
+	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x000, 1));
+	host1x_pushbuf_push(pb, 0x000001 << 8 | syncpt->id);
+
+	if (check(job, first) < 0)
+		return 1;
+
+	err = host1x_cmdring_submit(ring, job);
+	if (err < 0)
+		return 1;
+
+	host1x_job_free(job);
+
+	err = host1x_cmdring_flush(ring, &fence);
+	if (err < 0)
+		return 1;
+
+	err = HOST1X_CLIENT_WAIT(gr2d->client, fence, ~0u);
+	if (err < 0)
+		return 1;
+
+	host1x_cmdring_free(ring);
+	host1x_close(host1x);
+
+	host1x_info("test passed\n");
+
+	return 0;
+}
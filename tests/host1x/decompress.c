@@ -0,0 +1,477 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Decodes random DXT1/3/5 and ETC1 blocks and compares them against plain
+ * implementations of the formats, then expands whole images with clipped
+ * edge blocks and linear and tiled pixelbuffers.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host1x.h"
+
+#define NUM_BLOCKS	4096
+
+/* a 4x4 block of RGBA8888 pixels */
+typedef uint8_t ref_block[4][4][4];
+
+static uint32_t seed = 1;
+
+static uint8_t random_byte(void)
+{
+	seed = seed * 1103515245 + 12345;
+
+	return seed >> 16;
+}
+
+static void random_block(uint8_t *block, unsigned int size)
+{
+	unsigned int i;
+
+	for (i = 0; i < size; i++)
+		block[i] = random_byte();
+}
+
+static uint64_t read_le64(const uint8_t *p, unsigned int bytes)
+{
+	uint64_t v = 0;
+
+	while (bytes--)
+		v = v << 8 | p[bytes];
+
+	return v;
+}
+
+static void set_pixel(ref_block out, unsigned int x, unsigned int y,
+		      unsigned int r, unsigned int g, unsigned int b,
+		      unsigned int a)
+{
+	out[y][x][0] = r;
+	out[y][x][1] = g;
+	out[y][x][2] = b;
+	out[y][x][3] = a;
+}
+
+/*
+ * Colors are expanded to 8bit by bit replication, the interpolated colors
+ * are computed from the expanded ones and rounded down.
+ */
+static void ref_dxt_color(const uint8_t *block, ref_block out, bool dxt1)
+{
+	unsigned int c[2] = { block[0] | block[1] << 8,
+			      block[2] | block[3] << 8 };
+	unsigned int pal[4][4];
+	unsigned int i, x, y;
+
+	for (i = 0; i < 2; i++) {
+		unsigned int r = c[i] >> 11, g = (c[i] >> 5) & 63;
+		unsigned int b = c[i] & 31;
+
+		pal[i][0] = r << 3 | r >> 2;
+		pal[i][1] = g << 2 | g >> 4;
+		pal[i][2] = b << 3 | b >> 2;
+		pal[i][3] = 255;
+	}
+
+	for (i = 0; i < 4; i++) {
+		if (!dxt1 || c[0] > c[1]) {
+			pal[2][i] = (2 * pal[0][i] + pal[1][i]) / 3;
+			pal[3][i] = (pal[0][i] + 2 * pal[1][i]) / 3;
+		} else {
+			pal[2][i] = (pal[0][i] + pal[1][i]) / 2;
+			pal[3][i] = 0;
+		}
+	}
+
+	if (dxt1 && c[0] <= c[1])
+		pal[2][3] = 255;
+
+	for (y = 0; y < 4; y++) {
+		for (x = 0; x < 4; x++) {
+			unsigned int idx = (block[4 + y] >> (x * 2)) & 3;
+
+			set_pixel(out, x, y, pal[idx][0], pal[idx][1],
+				  pal[idx][2], dxt1 ? pal[idx][3] : 0);
+		}
+	}
+}
+
+static void ref_dxt1(const uint8_t *block, ref_block out)
+{
+	ref_dxt_color(block, out, true);
+}
+
+static void ref_dxt3(const uint8_t *block, ref_block out)
+{
+	uint64_t alpha = read_le64(block, 8);
+	unsigned int i;
+
+	ref_dxt_color(block + 8, out, false);
+
+	for (i = 0; i < 16; i++)
+		out[i / 4][i % 4][3] = ((alpha >> (i * 4)) & 15) * 17;
+}
+
+static void ref_dxt5(const uint8_t *block, ref_block out)
+{
+	uint64_t bits = read_le64(block + 2, 6);
+	unsigned int a0 = block[0], a1 = block[1];
+	unsigned int pal[8], i;
+
+	pal[0] = a0;
+	pal[1] = a1;
+
+	for (i = 2; i < 8; i++) {
+		if (a0 > a1)
+			pal[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+		else if (i < 6)
+			pal[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+		else
+			pal[i] = i == 6 ? 0 : 255;
+	}
+
+	ref_dxt_color(block + 8, out, false);
+
+	for (i = 0; i < 16; i++)
+		out[i / 4][i % 4][3] = pal[(bits >> (i * 3)) & 7];
+}
+
+static const int etc1_modifiers[8][4] = {
+	{  2,   8,  -2,   -8 },
+	{  5,  17,  -5,  -17 },
+	{  9,  29,  -9,  -29 },
+	{ 13,  42, -13,  -42 },
+	{ 18,  60, -18,  -60 },
+	{ 24,  80, -24,  -80 },
+	{ 33, 106, -33, -106 },
+	{ 47, 183, -47, -183 },
+};
+
+/* 5bit base plus 3bit delta of a differential block, -1 if out of range */
+static int etc1_diff(const uint8_t *block, unsigned int c)
+{
+	int delta = block[c] & 7;
+
+	if (delta >= 4)
+		delta -= 8;
+
+	delta += block[c] >> 3;
+
+	return delta < 0 || delta > 31 ? -1 : delta;
+}
+
+/* ETC1 blocks as defined by the format, bytes in big-endian order */
+static void ref_etc1(const uint8_t *block, ref_block out)
+{
+	bool flip = block[3] & 1;
+	unsigned int base[2][3];
+	unsigned int c, s, x, y;
+
+	for (c = 0; c < 3; c++) {
+		if (block[3] & 2) {
+			unsigned int b0 = block[c] >> 3;
+			unsigned int b1 = etc1_diff(block, c);
+
+			base[0][c] = b0 << 3 | b0 >> 2;
+			base[1][c] = b1 << 3 | b1 >> 2;
+		} else {
+			base[0][c] = (block[c] >> 4) * 17;
+			base[1][c] = (block[c] & 15) * 17;
+		}
+	}
+
+	for (y = 0; y < 4; y++) {
+		for (x = 0; x < 4; x++) {
+			unsigned int k = x * 4 + y;
+			unsigned int lsb = (block[7 - k / 8] >> (k % 8)) & 1;
+			unsigned int msb = (block[5 - k / 8] >> (k % 8)) & 1;
+			unsigned int table;
+			int mod, v[3];
+
+			s = flip ? y / 2 : x / 2;
+			table = s ? (block[3] >> 2) & 7 : block[3] >> 5;
+			mod = etc1_modifiers[table][msb << 1 | lsb];
+
+			for (c = 0; c < 3; c++) {
+				v[c] = base[s][c] + mod;
+				v[c] = v[c] < 0 ? 0 : v[c] > 255 ? 255 : v[c];
+			}
+
+			set_pixel(out, x, y, v[0], v[1], v[2], 255);
+		}
+	}
+}
+
+/* differential blocks whose second base color overflows aren't ETC1 */
+static void random_etc1_block(uint8_t *block)
+{
+	do {
+		random_block(block, 8);
+	} while ((block[3] & 2) && (etc1_diff(block, 0) < 0 ||
+				    etc1_diff(block, 1) < 0 ||
+				    etc1_diff(block, 2) < 0));
+}
+
+/* GR3D takes the bytes of an ETC1 block in reverse order */
+static void etc1_to_tegra(uint8_t *dst, const uint8_t *block)
+{
+	unsigned int i;
+
+	for (i = 0; i < 8; i++)
+		dst[i] = block[7 - i];
+}
+
+static const struct format {
+	const char *name;
+	enum pixel_format format;
+	void (*decompress)(const void *block, void *dst, unsigned int pitch);
+	void (*ref)(const uint8_t *block, ref_block out);
+} formats[] = {
+	{ "DXT1", PIX_BUF_FMT_DXT1, host1x_decompress_dxt1_block, ref_dxt1 },
+	{ "DXT3", PIX_BUF_FMT_DXT3, host1x_decompress_dxt3_block, ref_dxt3 },
+	{ "DXT5", PIX_BUF_FMT_DXT5, host1x_decompress_dxt5_block, ref_dxt5 },
+	{ "ETC1", PIX_BUF_FMT_ETC1, host1x_decompress_etc1_block, ref_etc1 },
+};
+
+/* random data in the layout the decoders take */
+static void random_data(const struct format *fmt, uint8_t *data,
+			unsigned int num_blocks)
+{
+	unsigned int size = PIX_BUF_FORMAT_BYTES(fmt->format);
+	uint8_t block[8];
+	unsigned int i;
+
+	for (i = 0; i < num_blocks; i++, data += size) {
+		if (fmt->format == PIX_BUF_FMT_ETC1) {
+			random_etc1_block(block);
+			etc1_to_tegra(data, block);
+		} else {
+			random_block(data, size);
+		}
+	}
+}
+
+static void ref_decompress(const struct format *fmt, const uint8_t *data,
+			   ref_block out)
+{
+	uint8_t block[8];
+
+	if (fmt->format == PIX_BUF_FMT_ETC1) {
+		etc1_to_tegra(block, data);
+		data = block;
+	}
+
+	fmt->ref(data, out);
+}
+
+static bool untouched(const uint8_t *p, unsigned int size)
+{
+	while (size--)
+		if (*p++ != 0xcd)
+			return false;
+
+	return true;
+}
+
+/* blocks written with a pitch wider than a block, gaps must stay intact */
+static int test_blocks(const struct format *fmt)
+{
+	unsigned int size = PIX_BUF_FORMAT_BYTES(fmt->format);
+	uint8_t data[NUM_BLOCKS * 16];
+	uint8_t pixels[4 * 36];
+	ref_block ref;
+	unsigned int i, y;
+
+	random_data(fmt, data, NUM_BLOCKS);
+
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		memset(pixels, 0xcd, sizeof(pixels));
+		fmt->decompress(data + i * size, pixels + 1, 36);
+		ref_decompress(fmt, data + i * size, ref);
+
+		for (y = 0; y < 4; y++) {
+			if (memcmp(pixels + y * 36 + 1, ref[y], 16) ||
+			    !untouched(pixels + y * 36, 1) ||
+			    !untouched(pixels + y * 36 + 17, 19)) {
+				host1x_error("%s: block %u row %u differs\n",
+					     fmt->name, i, y);
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* @pixels holds @width x @height pixels of @blocks, 64 pixels per line */
+static int check_image(const struct format *fmt, const uint8_t *blocks,
+		       unsigned int pitch, const uint8_t *pixels,
+		       unsigned int width, unsigned int height,
+		       const char *what)
+{
+	unsigned int size = PIX_BUF_FORMAT_BYTES(fmt->format);
+	unsigned int x, y;
+	ref_block ref;
+
+	for (y = 0; y < 64; y++) {
+		for (x = 0; x < 64; x++) {
+			const uint8_t *p = pixels + y * 64 * 4 + x * 4;
+
+			if (x >= width || y >= height) {
+				if (!untouched(p, 4))
+					goto fail;
+				continue;
+			}
+
+			ref_decompress(fmt, blocks + y / 4 * pitch +
+					    x / 4 * size, ref);
+
+			if (memcmp(p, ref[y % 4][x % 4], 4))
+				goto fail;
+		}
+	}
+
+	return 0;
+
+fail:
+	host1x_error("%s: %s: pixel %u,%u differs\n", fmt->name, what, x, y);
+	return -1;
+}
+
+static int test_image(const struct format *fmt)
+{
+	static const unsigned int sizes[][2] = {
+		{ 64, 64 }, { 13, 10 }, { 3, 1 }, { 61, 62 },
+	};
+	unsigned int pitch = 16 * PIX_BUF_FORMAT_BYTES(fmt->format) + 8;
+	uint8_t blocks[16 * 16 * 16 + 16 * 8];
+	uint8_t pixels[64 * 64 * 4];
+	unsigned int i;
+	int err;
+
+	random_data(fmt, blocks, sizeof(blocks) /
+		    PIX_BUF_FORMAT_BYTES(fmt->format));
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		memset(pixels, 0xcd, sizeof(pixels));
+
+		err = host1x_decompress_image(blocks, pitch, fmt->format,
+					      sizes[i][0], sizes[i][1],
+					      pixels, 64 * 4);
+		if (err < 0) {
+			host1x_error("%s: host1x_decompress_image() failed: "
+				     "%d\n", fmt->name, err);
+			return err;
+		}
+
+		if (check_image(fmt, blocks, pitch, pixels, sizes[i][0],
+				sizes[i][1], "image"))
+			return -1;
+	}
+
+	return 0;
+}
+
+static int test_pixelbuffer(struct host1x *host1x, const struct format *fmt,
+			    enum layout_format layout)
+{
+	unsigned int pitch = 16 * PIX_BUF_FORMAT_BYTES(fmt->format);
+	uint8_t blocks[16 * 16 * 16];
+	uint8_t pixels[64 * 64 * 4];
+	struct host1x_pixelbuffer *pixbuf;
+	int err;
+
+	pixbuf = host1x_pixelbuffer_create(host1x, 61, 58, pitch, fmt->format,
+					   layout);
+	if (!pixbuf) {
+		host1x_error("host1x_pixelbuffer_create() failed\n");
+		return -1;
+	}
+
+	random_data(fmt, blocks, 16 * 16);
+
+	err = host1x_pixelbuffer_load_data(host1x, pixbuf, blocks, pitch,
+					   sizeof(blocks), fmt->format,
+					   PIX_BUF_LAYOUT_LINEAR);
+	if (err < 0) {
+		host1x_error("host1x_pixelbuffer_load_data() failed: %d\n",
+			     err);
+		return err;
+	}
+
+	memset(pixels, 0xcd, sizeof(pixels));
+
+	err = host1x_pixelbuffer_decompress(pixbuf, pixels, 64 * 4);
+	if (err < 0) {
+		host1x_error("host1x_pixelbuffer_decompress() failed: %d\n",
+			     err);
+		return err;
+	}
+
+	err = check_image(fmt, blocks, pitch, pixels, 61, 58,
+			  layout == PIX_BUF_LAYOUT_LINEAR ? "linear" : "tiled");
+
+	host1x_pixelbuffer_free(pixbuf);
+
+	return err;
+}
+
+int main(int argc, char *argv[])
+{
+	struct host1x_options options = {};
+	struct host1x *host1x;
+	unsigned int i;
+	uint8_t pixel;
+
+	options.display_id = -1;
+	options.fd = -1;
+
+	host1x = host1x_open(&options);
+	if (!host1x) {
+		host1x_error("host1x_open() failed\n");
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		if (test_blocks(&formats[i]) || test_image(&formats[i]) ||
+		    test_pixelbuffer(host1x, &formats[i],
+				     PIX_BUF_LAYOUT_LINEAR) ||
+		    test_pixelbuffer(host1x, &formats[i],
+				     PIX_BUF_LAYOUT_TILED_16x16))
+			return 1;
+	}
+
+	if (host1x_decompress_image(&pixel, 1, PIX_BUF_FMT_RGBA8888, 1, 1,
+				    &pixel, 4) != -EINVAL) {
+		host1x_error("uncompressed format accepted\n");
+		return 1;
+	}
+
+	host1x_close(host1x);
+
+	host1x_info("test passed\n");
+
+	return 0;
+}
@@ -0,0 +1,370 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Runs jobs on the dummy engines with a latency and checks polling,
+ * waiting with a timeout, waiting for any of several fences of one and of
+ * both clients, and fence callbacks.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "host1x.h"
+#include "host1x-private.h"
+
+/* time every job takes, in milliseconds */
+#define LATENCY		50
+
+struct test {
+	struct host1x *host1x;
+	struct host1x_client *gr2d;
+	struct host1x_client *gr3d;
+	struct host1x_bo *bo;
+};
+
+static uint64_t time_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000ull + ts.tv_nsec / 1000000;
+}
+
+/* submits a job that increments the syncpoint of @client once */
+static int submit(struct test *test, struct host1x_client *client,
+		  struct host1x_fence *fence)
+{
+	struct host1x_syncpt *syncpt = &client->syncpts[0];
+	struct host1x_pushbuf *pb;
+	struct host1x_job *job;
+	int err;
+
+	job = HOST1X_JOB_CREATE(syncpt->id, 1);
+	if (!job)
+		return -ENOMEM;
+
+	pb = HOST1X_JOB_APPEND(job, test->bo, 0);
+	if (!pb) {
+		host1x_job_free(job);
+		return -ENOMEM;
+	}
+
+	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x000, 1));
+	host1x_pushbuf_push(pb, 0x000001 << 8 | syncpt->id);
+
+	err = host1x_client_submit(client, job);
+	host1x_job_free(job);
+	if (err < 0)
+		return err;
+
+	fence->client = client;
+
+	return host1x_client_flush(client, &fence->value);
+}
+
+static int test_poll(struct test *test)
+{
+	struct host1x_fence fence;
+	uint64_t start;
+	int err;
+
+	start = time_ms();
+
+	err = submit(test, test->gr2d, &fence);
+	if (err < 0)
+		return err;
+
+	err = host1x_fence_poll(&fence);
+	if (err < 0)
+		return err;
+
+	if (err > 0 && time_ms() - start < LATENCY) {
+		host1x_error("fence signaled after %llu ms\n",
+			     (unsigned long long)(time_ms() - start));
+		return -1;
+	}
+
+	err = host1x_fence_wait(&fence, ~0u);
+	if (err < 0)
+		return err;
+
+	if (time_ms() - start < LATENCY) {
+		host1x_error("wait returned after %llu ms\n",
+			     (unsigned long long)(time_ms() - start));
+		return -1;
+	}
+
+	if (host1x_fence_poll(&fence) != 1) {
+		host1x_error("fence not signaled after wait\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int test_timeout(struct test *test)
+{
+	struct host1x_fence fence;
+	unsigned int index;
+	int err;
+
+	err = submit(test, test->gr3d, &fence);
+	if (err < 0)
+		return err;
+
+	if (host1x_fence_wait(&fence, 1) >= 0 ||
+	    host1x_fence_wait_any(&fence, 1, 0, &index) >= 0) {
+		host1x_error("wait didn't time out\n");
+		return -1;
+	}
+
+	return host1x_fence_wait(&fence, ~0u);
+}
+
+/* waits for any of @count fences and expects @expected to be signaled first */
+static int wait_any(struct host1x_fence *fences, unsigned int count,
+		    unsigned int expected, const char *what)
+{
+	unsigned int index, i;
+	int err;
+
+	err = host1x_fence_wait_any(fences, count, ~0u, &index);
+	if (err < 0)
+		return err;
+
+	if (index != expected) {
+		host1x_error("%s: got fence %u instead of %u\n", what, index,
+			     expected);
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (i != expected && host1x_fence_poll(&fences[i]) != 0) {
+			host1x_error("%s: fence %u signaled too early\n",
+				     what, i);
+			return -1;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		err = host1x_fence_wait(&fences[i], ~0u);
+		if (err < 0)
+			return err;
+	}
+
+	return 0;
+}
+
+/* jobs of one client complete in order, one latency apart */
+static int test_wait_any(struct test *test)
+{
+	struct host1x_fence jobs[3], fences[3];
+	unsigned int i;
+	int err;
+
+	for (i = 0; i < 3; i++) {
+		err = submit(test, test->gr2d, &jobs[i]);
+		if (err < 0)
+			return err;
+	}
+
+	fences[0] = jobs[2];
+	fences[1] = jobs[0];
+	fences[2] = jobs[1];
+
+	return wait_any(fences, 3, 1, "gr2d");
+}
+
+/*
+ * The second job of @late completes a latency after the only job of
+ * @early, which was submitted last.
+ */
+static int test_wait_any_clients(struct test *test,
+				 struct host1x_client *late,
+				 struct host1x_client *early,
+				 const char *what)
+{
+	struct host1x_fence fences[2];
+	int err;
+
+	err = submit(test, late, &fences[0]);
+	if (err < 0)
+		return err;
+
+	err = submit(test, late, &fences[0]);
+	if (err < 0)
+		return err;
+
+	err = submit(test, early, &fences[1]);
+	if (err < 0)
+		return err;
+
+	return wait_any(fences, 2, 1, what);
+}
+
+struct record {
+	unsigned int order[8];
+	unsigned int count;
+};
+
+static void record_callback(const struct host1x_fence *fence, void *data)
+{
+	struct record *record = data;
+
+	if (record->count < 8)
+		record->order[record->count] = fence->value;
+
+	record->count++;
+}
+
+static int test_callbacks(struct test *test)
+{
+	struct record gr2d = { .count = 0 }, gr3d = { .count = 0 };
+	struct host1x_fence fences[3], other;
+	unsigned int i;
+	int err;
+
+	for (i = 0; i < 3; i++) {
+		err = submit(test, test->gr2d, &fences[i]);
+		if (err < 0)
+			return err;
+	}
+
+	err = submit(test, test->gr3d, &other);
+	if (err < 0)
+		return err;
+
+	/* added in reverse, they still run in the order of completion */
+	for (i = 3; i-- > 0; ) {
+		err = host1x_fence_add_callback(&fences[i], record_callback,
+						&gr2d);
+		if (err < 0)
+			return err;
+	}
+
+	err = host1x_fence_add_callback(&other, record_callback, &gr3d);
+	if (err < 0)
+		return err;
+
+	if (gr2d.count || gr3d.count) {
+		host1x_error("callbacks ran before their fences\n");
+		return -1;
+	}
+
+	err = host1x_fence_wait(&fences[2], ~0u);
+	if (err < 0)
+		return err;
+
+	if (gr2d.count != 3 || gr2d.order[0] != fences[0].value ||
+	    gr2d.order[1] != fences[1].value ||
+	    gr2d.order[2] != fences[2].value) {
+		host1x_error("gr2d callbacks ran %u times, out of order\n",
+			     gr2d.count);
+		return -1;
+	}
+
+	/* the gr3d job completed too, polling its client runs the callback */
+	if (gr3d.count || host1x_client_poll(test->gr3d) != 1 ||
+	    gr3d.count != 1) {
+		host1x_error("gr3d callback ran %u times\n", gr3d.count);
+		return -1;
+	}
+
+	/* callbacks of signaled fences run right away */
+	err = host1x_fence_add_callback(&fences[0], record_callback, &gr2d);
+	if (err < 0)
+		return err;
+
+	host1x_fence_wait(&fences[2], ~0u);
+	host1x_fence_poll(&other);
+	host1x_client_poll(test->gr2d);
+
+	if (gr2d.count != 4 || gr3d.count != 1) {
+		host1x_error("callbacks ran %u and %u times\n", gr2d.count,
+			     gr3d.count);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct host1x_options options = {};
+	struct host1x_gr2d *gr2d;
+	struct host1x_gr3d *gr3d;
+	struct test test;
+	char latency[16];
+	int err;
+
+	/* the dummy engines take microseconds */
+	snprintf(latency, sizeof(latency), "%u", LATENCY * 1000);
+	setenv("HOST1X_DUMMY_LATENCY", latency, 1);
+
+	options.display_id = -1;
+	options.fd = -1;
+
+	test.host1x = host1x_open(&options);
+	if (!test.host1x) {
+		host1x_error("host1x_open() failed\n");
+		return 1;
+	}
+
+	gr2d = host1x_get_gr2d(test.host1x);
+	gr3d = host1x_get_gr3d(test.host1x);
+	if (!gr2d || !gr3d) {
+		host1x_error("failed to get the clients\n");
+		return 1;
+	}
+
+	test.gr2d = gr2d->client;
+	test.gr3d = gr3d->client;
+
+	test.bo = HOST1X_BO_CREATE(test.host1x, 4096,
+				   NVHOST_BO_FLAG_COMMAND_BUFFER);
+	if (!test.bo)
+		return 1;
+
+	err = HOST1X_BO_MMAP(test.bo, NULL);
+	if (err < 0)
+		return 1;
+
+	if (test_poll(&test) < 0 || test_timeout(&test) < 0 ||
+	    test_wait_any(&test) < 0 ||
+	    test_wait_any_clients(&test, test.gr2d, test.gr3d,
+				  "gr2d, gr3d") < 0 ||
+	    test_wait_any_clients(&test, test.gr3d, test.gr2d,
+				  "gr3d, gr2d") < 0 ||
+	    test_callbacks(&test) < 0)
+		return 1;
+
+	host1x_bo_free(test.bo);
+	host1x_close(test.host1x);
+
+	host1x_info("test passed\n");
+
+	return 0;
+}
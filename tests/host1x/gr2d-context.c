@@ -100,7 +100,7 @@ static void prepare_context(struct ctx2d *ctx,
 	if (!job)
 		abort();
 
-	pb = HOST1X_JOB_APPEND(job, ctx->gr2d->commands, 0);
+	pb = host1x_cmdring_append(ctx->gr2d->commands, job);
 	if (!pb)
 		abort();
 
@@ -142,13 +142,13 @@ static void prepare_context(struct ctx2d *ctx,
 	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x000, 1));
 	host1x_pushbuf_push(pb, 0x000001 << 8 | syncpt->id);
 
-	err = HOST1X_CLIENT_SUBMIT(ctx->gr2d->client, job);
+	err = host1x_cmdring_submit(ctx->gr2d->commands, job);
 	if (err < 0)
 		abort();
 
 	host1x_job_free(job);
 
-	err = HOST1X_CLIENT_FLUSH(ctx->gr2d->client, &fence);
+	err = host1x_cmdring_flush(ctx->gr2d->commands, &fence);
 	if (err < 0)
 		abort();
 }
@@ -165,7 +165,7 @@ static void exec_context(struct ctx2d *ctx, unsigned int dx, unsigned int dy)
 	if (!job)
 		abort();
 
-	pb = HOST1X_JOB_APPEND(job, ctx->gr2d->commands, 0);
+	pb = host1x_cmdring_append(ctx->gr2d->commands, job);
 	if (!pb)
 		abort();
 
@@ -175,13 +175,13 @@ static void exec_context(struct ctx2d *ctx, unsigned int dx, unsigned int dy)
 	host1x_pushbuf_push(pb, HOST1X_OPCODE_NONINCR(0x000, 1));
 	host1x_pushbuf_push(pb, 0x000001 << 8 | syncpt->id);
 
-	err = HOST1X_CLIENT_SUBMIT(ctx->gr2d->client, job);
+	err = host1x_cmdring_submit(ctx->gr2d->commands, job);
 	if (err < 0)
 		abort();
 
 	host1x_job_free(job);
 
-	err = HOST1X_CLIENT_FLUSH(ctx->gr2d->client, &fence);
+	err = host1x_cmdring_flush(ctx->gr2d->commands, &fence);
 	if (err < 0)
 		abort();
 
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Blits into 16x16 tiled pixelbuffers at origins that aren't tile aligned,
+ * with and without vertical flip, and checks the result through the CPU
+ * detiler.
+ */
+
+#include <stdlib.h>
+
+#include "host1x.h"
+
+#define SRC_WIDTH	64
+#define SRC_HEIGHT	48
+#define DST_WIDTH	96
+#define DST_HEIGHT	80
+
+static uint32_t pattern(unsigned int x, unsigned int y)
+{
+	return 0xab000000 | y << 8 | x;
+}
+
+static int check(struct host1x_pixelbuffer *dst, uint32_t *pixels,
+		 unsigned int dx, unsigned int dy,
+		 unsigned int width, unsigned int height, bool yflip,
+		 const char *what)
+{
+	unsigned int x, y, sy;
+	void *map;
+	int err;
+
+	err = HOST1X_BO_MMAP(dst->bo, &map);
+	if (err < 0)
+		return err;
+
+	HOST1X_BO_INVALIDATE(dst->bo, dst->bo->offset,
+			     dst->pitch * ALIGN(dst->height, 16));
+
+	err = host1x_detile_rect(pixels, DST_WIDTH * 4,
+				 map + dst->bo->offset, dst->pitch,
+				 dst->format, 0, 0, DST_WIDTH, DST_HEIGHT);
+	if (err < 0)
+		return err;
+
+	for (y = 0; y < DST_HEIGHT; y++) {
+		for (x = 0; x < DST_WIDTH; x++) {
+			uint32_t expected = 0;
+
+			if (x >= dx && x < dx + width &&
+			    y >= dy && y < dy + height) {
+				sy = yflip ? height - 1 - (y - dy) : y - dy;
+				expected = pattern(x - dx, sy);
+			}
+
+			if (pixels[y * DST_WIDTH + x] != expected) {
+				host1x_error("%s: pixel %u,%u 0x%08x != 0x%08x\n",
+					     what, x, y,
+					     pixels[y * DST_WIDTH + x],
+					     expected);
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct {
+		unsigned int dx, dy, width, height;
+		bool yflip;
+	} rects[] = {
+		{  0,  0, 64, 48, false },
+		{  5,  3, 37, 21, false },
+		{  5,  3, 37, 21, true },
+		{ 17, 30, 20, 33, true },
+		{ 31, 15,  1, 17, false },
+	};
+	struct host1x_pixelbuffer *src, *dst;
+	struct host1x_options options = {};
+	struct host1x_gr2d *gr2d;
+	struct host1x *host1x;
+	uint32_t *pixels;
+	unsigned int i, x, y;
+	void *smap;
+	int height;
+	int err;
+
+	options.display_id = -1;
+	options.fd = -1;
+
+	host1x = host1x_open(&options);
+	if (!host1x) {
+		host1x_error("host1x_open() failed\n");
+		return 1;
+	}
+
+	gr2d = host1x_get_gr2d(host1x);
+	if (!gr2d) {
+		host1x_error("host1x_get_gr2d() failed\n");
+		return 1;
+	}
+
+	src = host1x_pixelbuffer_create(host1x, SRC_WIDTH, SRC_HEIGHT,
+					SRC_WIDTH * 4, PIX_BUF_FMT_RGBA8888,
+					PIX_BUF_LAYOUT_LINEAR);
+	dst = host1x_pixelbuffer_create(host1x, DST_WIDTH, DST_HEIGHT,
+					DST_WIDTH * 4, PIX_BUF_FMT_RGBA8888,
+					PIX_BUF_LAYOUT_TILED_16x16);
+	pixels = malloc(DST_WIDTH * DST_HEIGHT * 4);
+	if (!src || !dst || !pixels) {
+		host1x_error("allocation failed\n");
+		return 1;
+	}
+
+	HOST1X_BO_MMAP(src->bo, &smap);
+	smap += src->bo->offset;
+
+	for (y = 0; y < SRC_HEIGHT; y++)
+		for (x = 0; x < SRC_WIDTH; x++)
+			((uint32_t *)smap)[y * SRC_WIDTH + x] = pattern(x, y);
+
+	HOST1X_BO_FLUSH(src->bo, src->bo->offset, src->pitch * SRC_HEIGHT);
+
+	for (i = 0; i < sizeof(rects) / sizeof(rects[0]); i++) {
+		height = rects[i].yflip ? -(int)rects[i].height :
+					  (int)rects[i].height;
+
+		err = host1x_gr2d_clear(gr2d, dst, 0);
+		if (err < 0) {
+			host1x_error("host1x_gr2d_clear() failed: %d\n", err);
+			return 1;
+		}
+
+		err = host1x_gr2d_surface_blit(gr2d, src, dst,
+					       0, 0, rects[i].width,
+					       rects[i].height,
+					       rects[i].dx, rects[i].dy,
+					       rects[i].width, height);
+		if (err < 0) {
+			host1x_error("host1x_gr2d_surface_blit() failed: %d\n",
+				     err);
+			return 1;
+		}
+
+		if (check(dst, pixels, rects[i].dx, rects[i].dy,
+			  rects[i].width, rects[i].height, rects[i].yflip,
+			  "surface blit"))
+			return 1;
+
+		err = host1x_gr2d_clear(gr2d, dst, 0);
+		if (err < 0) {
+			host1x_error("host1x_gr2d_clear() failed: %d\n", err);
+			return 1;
+		}
+
+		err = host1x_gr2d_blit(gr2d, src, dst, 0, 0,
+				       rects[i].dx, rects[i].dy,
+				       rects[i].width, height);
+		if (err < 0) {
+			host1x_error("host1x_gr2d_blit() failed: %d\n", err);
+			return 1;
+		}
+
+		if (check(dst, pixels, rects[i].dx, rects[i].dy,
+			  rects[i].width, rects[i].height, rects[i].yflip,
+			  "blit"))
+			return 1;
+	}
+
+	free(pixels);
+	host1x_close(host1x);
+
+	host1x_info("test passed\n");
+
+	return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Draws a triangle with a scissor and viewport that exceed the render target
+ * and checks that only the pixels inside of it change, compared to the same
+ * triangle drawn into a target that's large enough. Guards are disabled so
+ * that writes past the surface would land outside of its BO.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host1x.h"
+
+#define SIZE		64
+#define VIEWPORT	128
+
+static int readback(struct host1x_pixelbuffer *pixbuf, uint32_t *pixels)
+{
+	void *map;
+	int err;
+
+	err = HOST1X_BO_MMAP(pixbuf->bo, &map);
+	if (err < 0)
+		return err;
+
+	HOST1X_BO_INVALIDATE(pixbuf->bo, pixbuf->bo->offset,
+			     pixbuf->pitch * ALIGN(pixbuf->height, 16));
+
+	return host1x_detile_rect(pixels, SIZE * 4, map + pixbuf->bo->offset,
+				  pixbuf->pitch, pixbuf->format, 0, 0,
+				  SIZE, SIZE);
+}
+
+static int draw(struct host1x_gr2d *gr2d, struct host1x_gr3d *gr3d,
+		struct host1x_pixelbuffer *pixbuf, uint32_t *pixels)
+{
+	unsigned int width = pixbuf->width;
+	unsigned int height = pixbuf->height;
+	int err;
+
+	err = host1x_gr2d_clear(gr2d, pixbuf, 0xff000000);
+	if (err < 0) {
+		host1x_error("host1x_gr2d_clear() failed: %d\n", err);
+		return err;
+	}
+
+	/* the scissor and viewport are taken from the pixelbuffer size */
+	pixbuf->width = VIEWPORT;
+	pixbuf->height = VIEWPORT;
+
+	err = host1x_gr3d_triangle(gr3d, pixbuf);
+
+	pixbuf->width = width;
+	pixbuf->height = height;
+
+	if (err < 0) {
+		host1x_error("host1x_gr3d_triangle() failed: %d\n", err);
+		return err;
+	}
+
+	return readback(pixbuf, pixels);
+}
+
+int main(int argc, char *argv[])
+{
+	struct host1x_pixelbuffer *small, *large;
+	struct host1x_options options = {};
+	uint32_t *expected, *pixels;
+	struct host1x_gr2d *gr2d;
+	struct host1x_gr3d *gr3d;
+	struct host1x *host1x;
+	unsigned int i;
+
+	options.display_id = -1;
+	options.fd = -1;
+
+	host1x_pixelbuffer_disable_bo_guard();
+
+	host1x = host1x_open(&options);
+	if (!host1x) {
+		host1x_error("host1x_open() failed\n");
+		return 1;
+	}
+
+	gr2d = host1x_get_gr2d(host1x);
+	gr3d = host1x_get_gr3d(host1x);
+	if (!gr2d || !gr3d) {
+		host1x_error("host1x_get_gr2d/gr3d() failed\n");
+		return 1;
+	}
+
+	small = host1x_pixelbuffer_create(host1x, SIZE, SIZE, SIZE * 4,
+					  PIX_BUF_FMT_RGBA8888,
+					  PIX_BUF_LAYOUT_TILED_16x16);
+	large = host1x_pixelbuffer_create(host1x, VIEWPORT, VIEWPORT,
+					  VIEWPORT * 4, PIX_BUF_FMT_RGBA8888,
+					  PIX_BUF_LAYOUT_TILED_16x16);
+	expected = malloc(SIZE * SIZE * 4);
+	pixels = malloc(SIZE * SIZE * 4);
+	if (!small || !large || !expected || !pixels) {
+		host1x_error("allocation failed\n");
+		return 1;
+	}
+
+	if (draw(gr2d, gr3d, large, expected) < 0 ||
+	    draw(gr2d, gr3d, small, pixels) < 0)
+		return 1;
+
+	for (i = 0; i < SIZE * SIZE; i++) {
+		if (pixels[i] != expected[i]) {
+			host1x_error("pixel %u,%u 0x%08x != 0x%08x\n",
+				     i % SIZE, i / SIZE, pixels[i],
+				     expected[i]);
+			return 1;
+		}
+	}
+
+	/* make sure the triangle reaches into the checked area at all */
+	for (i = 0; i < SIZE * SIZE; i++)
+		if (expected[i] != 0xff000000)
+			break;
+
+	if (i == SIZE * SIZE) {
+		host1x_error("triangle doesn't cover the render target\n");
+		return 1;
+	}
+
+	free(pixels);
+	free(expected);
+	host1x_close(host1x);
+
+	host1x_info("test passed\n");
+
+	return 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Tiles and detiles whole surfaces and sub-rectangles of every pixel size
+ * and compressed formats, on one and several threads, and compares the
+ * result with the 16x16 tiled layout computed byte by byte.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host1x.h"
+
+static const struct surface {
+	const char *name;
+	enum pixel_format format;
+	unsigned int width;
+	unsigned int height;
+} surfaces[] = {
+	{ "A8",       PIX_BUF_FMT_A8,        83,  45 },
+	{ "RGB565",   PIX_BUF_FMT_RGB565,    61,  37 },
+	{ "RGBA8888", PIX_BUF_FMT_RGBA8888,  45,  50 },
+	{ "DXT1",     PIX_BUF_FMT_DXT1,     130, 100 },
+	{ "DXT5",     PIX_BUF_FMT_DXT5,     150, 138 },
+	{ "ETC1",     PIX_BUF_FMT_ETC1,      62,  71 },
+	/* large enough to be split across threads */
+	{ "RGBA8888", PIX_BUF_FMT_RGBA8888, 1000, 300 },
+};
+
+struct layout {
+	const struct surface *surface;
+
+	/* in units of pixels or blocks */
+	unsigned int tw, th;
+	unsigned int cols, rows;
+	unsigned int bytes;
+
+	unsigned int linear_pitch;
+	unsigned int tiled_pitch;
+	unsigned long tiled_size;
+};
+
+static uint8_t pattern(unsigned int xb, unsigned int y)
+{
+	return (xb * 0x9e3779b1u ^ y * 0x85ebca6bu) >> 24;
+}
+
+static unsigned long tiled_offset(const struct layout *l, unsigned int xb,
+				  unsigned int y)
+{
+	return (unsigned long)(y / 16) * 16 * l->tiled_pitch +
+	       xb / 16 * 256 + y % 16 * 16 + xb % 16;
+}
+
+static void setup_layout(struct layout *l, const struct surface *s)
+{
+	l->surface = s;
+	l->tw = PIX_BUF_FORMAT_TEXEL_WIDTH(s->format);
+	l->th = PIX_BUF_FORMAT_TEXEL_HEIGHT(s->format);
+	l->cols = ALIGN(s->width, l->tw) / l->tw;
+	l->rows = ALIGN(s->height, l->th) / l->th;
+	l->bytes = PIX_BUF_FORMAT_BYTES(s->format);
+
+	/* a linear pitch that isn't a multiple of a tile line */
+	l->linear_pitch = l->cols * l->bytes + 5;
+	l->tiled_pitch = ALIGN(l->cols * l->bytes, 64);
+	l->tiled_size = (unsigned long)l->tiled_pitch * ALIGN(l->rows, 16);
+}
+
+/*
+ * Tiles the rectangle at @x,@y of @w x @h blocks (or pixels) and checks that
+ * exactly the rectangle was written, then detiles it again into a linear
+ * buffer and checks that as well.
+ */
+static int test_rect(const struct layout *l, const uint8_t *linear,
+		     uint8_t *tiled, uint8_t *out,
+		     unsigned int x, unsigned int y,
+		     unsigned int w, unsigned int h)
+{
+	const struct surface *s = l->surface;
+	unsigned int px = x * l->tw, py = y * l->th;
+	unsigned int pw, ph, xb, yb;
+	unsigned long offset;
+	bool inside;
+	int err;
+
+	w = MIN(w, l->cols - x);
+	h = MIN(h, l->rows - y);
+
+	/* the last column and row of blocks may be partially covered */
+	pw = MIN(w * l->tw, s->width - px);
+	ph = MIN(h * l->th, s->height - py);
+	offset = (unsigned long)y * l->linear_pitch + x * l->bytes;
+
+	memset(tiled, 0xcd, l->tiled_size);
+	memset(out, 0xcd, l->linear_pitch * l->rows);
+
+	err = host1x_tile_rect(tiled, l->tiled_pitch, linear + offset,
+			       l->linear_pitch, s->format, px, py, pw, ph);
+	if (err < 0) {
+		host1x_error("%s: host1x_tile_rect() failed: %d\n", s->name,
+			     err);
+		return err;
+	}
+
+	err = host1x_detile_rect(out + offset, l->linear_pitch, tiled,
+				 l->tiled_pitch, s->format, px, py, pw, ph);
+	if (err < 0) {
+		host1x_error("%s: host1x_detile_rect() failed: %d\n", s->name,
+			     err);
+		return err;
+	}
+
+	for (yb = 0; yb < ALIGN(l->rows, 16); yb++) {
+		for (xb = 0; xb < l->tiled_pitch; xb++) {
+			uint8_t t = tiled[tiled_offset(l, xb, yb)];
+			uint8_t o = 0xcd;
+
+			inside = xb >= x * l->bytes &&
+				 xb < (x + w) * l->bytes &&
+				 yb >= y && yb < y + h;
+
+			if (xb < l->cols * l->bytes && yb < l->rows)
+				o = out[yb * l->linear_pitch + xb];
+
+			if (t != (inside ? pattern(xb, yb) : 0xcd) ||
+			    o != (inside ? pattern(xb, yb) : 0xcd)) {
+				host1x_error("%s: rect %u,%u %ux%u: byte %u,%u "
+					     "differs\n", s->name, x, y, w, h,
+					     xb, yb);
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int test_surface(const struct layout *l)
+{
+	const unsigned int rects[][4] = {
+		{ 0, 0, l->cols, l->rows },
+		{ 0, 0, 1, 1 },
+		{ 1, 1, l->cols - 2, l->rows - 2 },
+		{ l->cols / 2, l->rows / 3, l->cols - l->cols / 2, 1 },
+		{ 3, 0, 1, l->rows },
+		{ 15, 15, 2, 2 },
+		{ l->cols - 1, l->rows - 1, 1, 1 },
+	};
+	uint8_t *linear, *tiled, *out;
+	unsigned int x, y, i;
+	int err = 0;
+
+	linear = malloc(l->linear_pitch * l->rows);
+	tiled = malloc(l->tiled_size);
+	out = malloc(l->linear_pitch * l->rows);
+	if (!linear || !tiled || !out) {
+		host1x_error("allocation failed\n");
+		return -ENOMEM;
+	}
+
+	for (y = 0; y < l->rows; y++)
+		for (x = 0; x < l->linear_pitch; x++)
+			linear[y * l->linear_pitch + x] = pattern(x, y);
+
+	for (i = 0; i < sizeof(rects) / sizeof(rects[0]) && !err; i++)
+		err = test_rect(l, linear, tiled, out, rects[i][0],
+				rects[i][1], rects[i][2], rects[i][3]);
+
+	free(out);
+	free(tiled);
+	free(linear);
+
+	return err;
+}
+
+static int test_invalid(void)
+{
+	static uint8_t buf[64 * 16];
+
+	/* the tiled pitch must be a multiple of a tile line */
+	if (host1x_tile_rect(buf, 40, buf, 40, PIX_BUF_FMT_A8,
+			     0, 0, 4, 4) != -EINVAL)
+		return -1;
+
+	/* compressed rectangles must be block aligned */
+	if (host1x_detile_rect(buf, 64, buf, 64, PIX_BUF_FMT_DXT1,
+			       2, 0, 4, 4) != -EINVAL)
+		return -1;
+
+	/* and must not exceed the tiled pitch */
+	if (host1x_tile_rect(buf, 64, buf, 64, PIX_BUF_FMT_RGBA8888,
+			     8, 0, 9, 1) != -EINVAL)
+		return -1;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const char *threads[] = { "1", "4" };
+	struct layout layout;
+	unsigned int i, j;
+
+	for (i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+		setenv("HOST1X_TILING_THREADS", threads[i], 1);
+
+		for (j = 0; j < sizeof(surfaces) / sizeof(surfaces[0]); j++) {
+			setup_layout(&layout, &surfaces[j]);
+
+			if (test_surface(&layout))
+				return 1;
+		}
+	}
+
+	if (test_invalid()) {
+		host1x_error("invalid rectangle accepted\n");
+		return 1;
+	}
+
+	host1x_info("test passed\n");
+
+	return 0;
+}
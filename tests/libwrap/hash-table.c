@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Exercises the hash table used by the recorder and the tools. Keys are
+ * picked to collide, so that removals happen from the middle of probe
+ * chains, including chains that wrap around the end of the table, and
+ * every remaining key has to stay reachable after the backward shift.
+ * The table is then grown while keys keep getting removed.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "hash.h"
+
+#define MAX_KEYS	1024
+
+struct key {
+	uint64_t key;
+	bool present;
+};
+
+static struct key keys[MAX_KEYS];
+static unsigned int num_keys;
+static uint32_t next_lo;
+
+/* the value of a key is its slot in @keys, offset to be non-NULL */
+static void *key_value(unsigned int i)
+{
+	return &keys[i];
+}
+
+static int check_table(struct hash_table *ht)
+{
+	unsigned int i, count = 0;
+	void *value;
+
+	for (i = 0; i < num_keys; i++) {
+		value = hash_table_lookup(ht, keys[i].key);
+
+		if (keys[i].present) {
+			if (value != key_value(i)) {
+				fprintf(stderr, "key %#llx lost\n",
+					(unsigned long long)keys[i].key);
+				return -1;
+			}
+
+			count++;
+		} else if (value) {
+			fprintf(stderr, "removed key %#llx found\n",
+				(unsigned long long)keys[i].key);
+			return -1;
+		}
+	}
+
+	if (ht->count != count) {
+		fprintf(stderr, "count is %u, expected %u\n", ht->count, count);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int add_key(struct hash_table *ht, uint64_t key)
+{
+	unsigned int i = num_keys++;
+	int err;
+
+	keys[i].key = key;
+	keys[i].present = true;
+
+	err = hash_table_insert(ht, key, key_value(i));
+	if (err < 0) {
+		fprintf(stderr, "insert failed: %d\n", err);
+		return -1;
+	}
+
+	return check_table(ht);
+}
+
+static int remove_key(struct hash_table *ht, unsigned int i)
+{
+	hash_table_remove(ht, keys[i].key);
+	keys[i].present = false;
+
+	return check_table(ht);
+}
+
+/* adds @n new keys that hash to @index in the table's current size */
+static int add_colliding(struct hash_table *ht, unsigned int index,
+			 unsigned int n, unsigned int *first)
+{
+	uint64_t key;
+
+	*first = num_keys;
+
+	while (n) {
+		key = hash_key(0x1234, next_lo++);
+
+		if (hash_index(ht, key) != index)
+			continue;
+
+		if (add_key(ht, key) < 0)
+			return -1;
+
+		n--;
+	}
+
+	return 0;
+}
+
+static unsigned int slot_of(struct hash_table *ht, unsigned int i)
+{
+	unsigned int j;
+
+	for (j = 0; j < ht->size; j++)
+		if (ht->entries[j].value == key_value(i))
+			return j;
+
+	return ~0u;
+}
+
+static int test_chains(struct hash_table *ht)
+{
+	unsigned int last = ht->size - 1;
+	unsigned int a, b, c, i;
+
+	/*
+	 * Five keys homed at the next to last slot wrap around to slots 0
+	 * to 2, keys homed at 0 and 1 queue up behind them.
+	 */
+	if (add_colliding(ht, last - 1, 5, &a) < 0 ||
+	    add_colliding(ht, 0, 2, &b) < 0 ||
+	    add_colliding(ht, 1, 2, &c) < 0)
+		return -1;
+
+	if (slot_of(ht, a + 2) != 0 || slot_of(ht, c + 1) != 6) {
+		fprintf(stderr, "keys not placed as expected\n");
+		return -1;
+	}
+
+	/* from the middle of the chain, before the wrap-around */
+	if (remove_key(ht, a + 1) < 0)
+		return -1;
+
+	/* the entry that wrapped, keys homed at 0 and 1 must shift back */
+	if (remove_key(ht, a + 2) < 0)
+		return -1;
+
+	/* the head of the chain */
+	if (remove_key(ht, a) < 0)
+		return -1;
+
+	/* a key homed after the wrap-around, from the middle */
+	if (remove_key(ht, b) < 0)
+		return -1;
+
+	/* a key that isn't in the table must not disturb anything */
+	hash_table_remove(ht, hash_key(0xdead, 0xbeef));
+	if (check_table(ht) < 0)
+		return -1;
+
+	/* reinsertion must reuse the freed slots */
+	keys[a + 1].present = true;
+	if (hash_table_insert(ht, keys[a + 1].key, key_value(a + 1)) < 0 ||
+	    check_table(ht) < 0)
+		return -1;
+
+	for (i = a; i < num_keys; i++)
+		if (keys[i].present && remove_key(ht, i) < 0)
+			return -1;
+
+	return 0;
+}
+
+static int test_grow(struct hash_table *ht)
+{
+	unsigned int size = ht->size;
+	unsigned int i, first;
+
+	/* grow twice, removing every third key on the way */
+	while (ht->size < size * 4) {
+		if (add_colliding(ht, hash_index(ht, next_lo) & ~7u, 3,
+				  &first) < 0)
+			return -1;
+
+		if (remove_key(ht, first + 1) < 0)
+			return -1;
+	}
+
+	/* collide and wrap around in the grown table */
+	if (test_chains(ht) < 0)
+		return -1;
+
+	for (i = 0; i < num_keys; i++)
+		if (keys[i].present && remove_key(ht, i) < 0)
+			return -1;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct hash_table ht = { 0 };
+
+	if (hash_table_lookup(&ht, 0)) {
+		fprintf(stderr, "empty table isn't empty\n");
+		return 1;
+	}
+
+	hash_table_remove(&ht, 0);
+
+	if (add_key(&ht, hash_key(1, 1)) < 0 || remove_key(&ht, 0) < 0)
+		return 1;
+
+	if (test_chains(&ht) < 0)
+		return 1;
+
+	if (test_grow(&ht) < 0)
+		return 1;
+
+	if (ht.count) {
+		fprintf(stderr, "%u keys left\n", ht.count);
+		return 1;
+	}
+
+	hash_table_fini(&ht);
+
+	printf("test passed\n");
+
+	return 0;
+}
@@ -0,0 +1,10 @@
+DIR=$(dirname $0)
+REC=$(mktemp)
+SUMS=$(mktemp)
+
+	$DIR/record-writes $REC | grep checksum > $SUMS \
+&&	$DIR/../../tools/replay --recfile $REC < /dev/null | grep checksum | cmp -s - $SUMS \
+&&	$DIR/../../tools/replay --recfile $REC --start-frame 2 < /dev/null | grep checksum | cmp -s - $SUMS \
+&&	echo "All tests passed"
+
+rm -f $REC $SUMS
@@ -0,0 +1,449 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Exercises the tracking of application writes to BO mappings by the
+ * recorder. Without LIBWRAP_RECORD_WRITE_TRACKING the mappings must stay
+ * writable by the kernel. With it, threads keep writing to a tracked
+ * mapping while other mappings are tracked and untracked and the BO is
+ * captured, which has the fault handler look up mappings concurrently
+ * with the updates of the table.
+ *
+ * A page content that two BOs hold must be stored once, the second BO
+ * loads it by a REC_BO_LOAD_REF. With a path given, that record is kept
+ * there and the checksums that replay prints for the BOs are printed, so
+ * that load_ref_tests.sh can check that replay rebuilds them.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "recorder.h"
+
+#define NUM_PAGES	8
+#define NUM_WRITERS	4
+#define NUM_ROUNDS	2000
+
+/* DRM_FORMAT_XBGR8888 */
+#define FB_FORMAT	0x34324258
+
+#define REF_PAGE_A	(NUM_PAGES - 1)
+#define REF_PAGE_B	1
+
+struct bo {
+	struct bo_rec *rec;
+	uint8_t *data;
+	int fd;
+};
+
+static bool stop;
+
+/* the BO data is shared by the recorder's view and the application's */
+static int bo_create(struct rec_ctx *ctx, struct bo *bo)
+{
+	size_t size = NUM_PAGES * 4096;
+
+	bo->fd = memfd_create("bo", 0);
+	if (bo->fd < 0 || ftruncate(bo->fd, size) < 0)
+		return -1;
+
+	bo->data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			bo->fd, 0);
+	if (bo->data == MAP_FAILED)
+		return -1;
+
+	bo->rec = record_create_bo(ctx, size, 0);
+	if (!bo->rec)
+		return -1;
+
+	record_set_bo_data(bo->rec, bo->data);
+
+	return 0;
+}
+
+static uint8_t *bo_map(struct bo *bo)
+{
+	size_t size = NUM_PAGES * 4096;
+	uint8_t *map;
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, bo->fd, 0);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	record_track_bo_writes(bo->rec, map, size);
+
+	return map;
+}
+
+static void bo_unmap(uint8_t *map)
+{
+	record_untrack_writes(map, NUM_PAGES * 4096);
+	munmap(map, NUM_PAGES * 4096);
+}
+
+static bool page_dirty(struct bo *bo, unsigned int page)
+{
+	return bo->rec->dirty[page / REC_BITS_PER_LONG] &
+		(1UL << (page % REC_BITS_PER_LONG));
+}
+
+/* the kernel doesn't fault on protected pages, it fails with EFAULT */
+static int kernel_write(uint8_t *map)
+{
+	int fds[2];
+	ssize_t ret;
+
+	if (pipe(fds) < 0)
+		return -1;
+
+	write(fds[1], "grate", 5);
+	ret = read(fds[0], map, 5);
+
+	close(fds[0]);
+	close(fds[1]);
+
+	return ret == 5 ? 0 : -1;
+}
+
+static int test_untracked(void)
+{
+	struct rec_ctx *ctx;
+	struct bo bo;
+	uint8_t *map;
+
+	ctx = record_create_ctx();
+	if (!ctx || bo_create(ctx, &bo) < 0)
+		return 1;
+
+	map = bo_map(&bo);
+	if (!map)
+		return 1;
+
+	if (kernel_write(map) < 0) {
+		fprintf(stderr, "kernel write to untracked mapping failed\n");
+		return 1;
+	}
+
+	bo_unmap(map);
+
+	return 0;
+}
+
+static void *writer(void *data)
+{
+	uint32_t *word = data;
+	uint32_t value = 0;
+
+	while (!__atomic_load_n(&stop, __ATOMIC_RELAXED))
+		*word = value++;
+
+	return NULL;
+}
+
+static int test_tracked(void)
+{
+	pthread_t threads[NUM_WRITERS];
+	struct rec_ctx *ctx;
+	struct bo bo, other;
+	unsigned int i;
+	uint8_t *map;
+
+	ctx = record_create_ctx();
+	if (!ctx || bo_create(ctx, &bo) < 0 || bo_create(ctx, &other) < 0)
+		return 1;
+
+	map = bo_map(&bo);
+	if (!map)
+		return 1;
+
+	record_capture_bo_data(bo.rec, true);
+
+	if (kernel_write(map) == 0) {
+		fprintf(stderr, "kernel write to tracked mapping succeeded\n");
+		return 1;
+	}
+
+	for (i = 0; i < NUM_WRITERS; i++)
+		pthread_create(&threads[i], NULL, writer, map + i * 4096);
+
+	for (i = 0; i < NUM_ROUNDS; i++) {
+		uint8_t *tmp = bo_map(&other);
+
+		if (!tmp)
+			return 1;
+
+		tmp[(i % NUM_PAGES) * 4096] = i;
+		bo_unmap(tmp);
+
+		record_capture_bo_data(bo.rec, false);
+	}
+
+	__atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+
+	for (i = 0; i < NUM_WRITERS; i++)
+		pthread_join(threads[i], NULL);
+
+	record_capture_bo_data(bo.rec, false);
+
+	map[NUM_PAGES / 2 * 4096 + 1] = 1;
+
+	for (i = 0; i < NUM_PAGES; i++) {
+		if (page_dirty(&bo, i) != (i == NUM_PAGES / 2)) {
+			fprintf(stderr, "page %u is %sdirty\n", i,
+				page_dirty(&bo, i) ? "" : "not ");
+			return 1;
+		}
+	}
+
+	bo_unmap(map);
+	record_destroy_bo(other.rec);
+	record_destroy_bo(bo.rec);
+	record_destroy_ctx(ctx);
+
+	return 0;
+}
+
+/* the same page content goes into a different page of each BO */
+static void fill_page(uint8_t *data, unsigned int page)
+{
+	uint32_t *words = (uint32_t *)(data + page * 4096);
+	unsigned int i;
+
+	for (i = 0; i < 1024; i++)
+		words[i] = i * 0x9e3779b9;
+}
+
+/* FNV-1a of a BO with @page filled, as printed by replay */
+static unsigned long long bo_checksum(unsigned int page)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	uint8_t *data;
+	size_t i;
+
+	data = calloc(NUM_PAGES, 4096);
+	if (!data)
+		return 0;
+
+	fill_page(data, page);
+
+	for (i = 0; i < NUM_PAGES * 4096; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	free(data);
+
+	return hash;
+}
+
+/*
+ * Every frame gets a keyframe, so that the keyframe of the last frame
+ * lies past the data that the BOs reference.
+ */
+static int test_load_ref(void)
+{
+	static uint8_t fb_data[4096];
+	struct bo_rec *fb;
+	struct rec_ctx *ctx;
+	struct bo a, b;
+
+	setenv("LIBWRAP_RECORD_KEYFRAMES", "1", 1);
+
+	ctx = record_create_ctx();
+	if (!ctx || bo_create(ctx, &a) < 0 || bo_create(ctx, &b) < 0)
+		return 1;
+
+	fb = record_create_bo(ctx, sizeof(fb_data), 0);
+	if (!fb)
+		return 1;
+
+	record_set_bo_data(fb, fb_data);
+	fb->width = 32;
+	fb->height = 32;
+	fb->pitch = 128;
+	fb->format = FB_FORMAT;
+	record_add_framebuffer(fb, 0);
+
+	fill_page(a.data, REF_PAGE_A);
+	record_capture_bo_data(a.rec, true);
+	record_display_framebuffer(fb);
+
+	fill_page(b.data, REF_PAGE_B);
+	record_capture_bo_data(b.rec, true);
+	record_display_framebuffer(fb);
+
+	record_destroy_bo(a.rec);
+	record_destroy_bo(b.rec);
+	record_display_framebuffer(fb);
+
+	return 0;
+}
+
+/*
+ * Outside of the keyframes, the page of the first BO must be stored once
+ * and the page of the second BO must refer to it. The BOs are numbered in
+ * the order they were created.
+ */
+static int check_load_ref(const char *path)
+{
+	unsigned int a_data = 0, a_refs = 0, b_data = 0, b_refs = 0;
+	uint64_t data_offset = 0, ref_offset = 0;
+	struct record_act r;
+	size_t skip;
+	off_t pos;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp)
+		return 1;
+
+	while (1) {
+		pos = ftello(fp);
+
+		if (fread(&r.act, sizeof(r.act), 1, fp) != 1 ||
+		    fread(&r.data, record_action_size(r.act), 1, fp) != 1)
+			break;
+
+		skip = 0;
+
+		switch (r.act) {
+		case REC_BO_LOAD_DATA:
+			skip = r.data.bo_load.data_size ?: 4096;
+
+			if (r.data.bo_load.id == 0 &&
+			    r.data.bo_load.page_id == REF_PAGE_A) {
+				data_offset = pos;
+				a_data++;
+			}
+
+			if (r.data.bo_load.id == 1 &&
+			    r.data.bo_load.page_id == REF_PAGE_B)
+				b_data++;
+			break;
+
+		case REC_BO_LOAD_REF:
+			if (r.data.bo_load_ref.id == 0 &&
+			    r.data.bo_load_ref.page_id == REF_PAGE_A)
+				a_refs++;
+
+			if (r.data.bo_load_ref.id == 1 &&
+			    r.data.bo_load_ref.page_id == REF_PAGE_B) {
+				ref_offset = r.data.bo_load_ref.offset;
+				b_refs++;
+			}
+			break;
+
+		case REC_KEYFRAME:
+			skip = r.data.keyframe.size;
+			break;
+		}
+
+		if (r.act == REC_INDEX || fseeko(fp, skip, SEEK_CUR) < 0)
+			break;
+	}
+
+	fclose(fp);
+
+	if (r.act != REC_INDEX) {
+		fprintf(stderr, "record isn't finished\n");
+		return 1;
+	}
+
+	if (a_data != 1 || a_refs || b_data || b_refs != 1) {
+		fprintf(stderr, "pages loaded by data %u and %u times, "
+			"by reference %u and %u times\n",
+			a_data, b_data, a_refs, b_refs);
+		return 1;
+	}
+
+	if (ref_offset != data_offset) {
+		fprintf(stderr, "reference to %llu, data at %llu\n",
+			(unsigned long long)ref_offset,
+			(unsigned long long)data_offset);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int run(const char *path, bool write_tracking, int (*test)(void))
+{
+	int status;
+	pid_t pid;
+
+	pid = fork();
+	if (pid < 0)
+		return 1;
+
+	if (pid == 0) {
+		setenv("LIBWRAP_RECORD_PATH", path, 1);
+
+		if (write_tracking)
+			setenv("LIBWRAP_RECORD_WRITE_TRACKING", "1", 1);
+
+		exit(test());
+	}
+
+	if (waitpid(pid, &status, 0) < 0)
+		return 1;
+
+	return !WIFEXITED(status) || WEXITSTATUS(status);
+}
+
+int main(int argc, char *argv[])
+{
+	char path[] = "/tmp/record-writes-XXXXXX";
+	const char *ref_path = argc == 2 ? argv[1] : path;
+	int fd, err;
+
+	fd = mkstemp(path);
+	if (fd < 0)
+		return 1;
+
+	close(fd);
+
+	err = run(path, false, test_untracked) ||
+	      run(path, true, test_tracked) ||
+	      run(ref_path, false, test_load_ref) ||
+	      check_load_ref(ref_path);
+
+	unlink(path);
+
+	if (err)
+		return 1;
+
+	/* in the order the BOs are destroyed */
+	if (argc == 2) {
+		printf("    checksum: 0x%016llx\n", bo_checksum(REF_PAGE_A));
+		printf("    checksum: 0x%016llx\n", bo_checksum(REF_PAGE_B));
+	}
+
+	printf("test passed\n");
+
+	return 0;
+}
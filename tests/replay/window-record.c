@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Writes a record with a job whose gathers end right before the first
+ * boundary of the read window of the replay tool, so that its relocations
+ * cross into the next window. The keyframe in front of the job is skipped
+ * by the replay and is left as a hole in the file.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "host1x.h"
+#include "record_replay.h"
+
+/* size of the read window of the replay tool */
+#define REC_WINDOW_SIZE		(64 << 20)
+
+static int fd;
+
+static void write_act(struct record_act *r, const void *payload,
+		      size_t size)
+{
+	size_t len = sizeof(r->act) + record_action_size(r->act);
+
+	if (write(fd, r, len) != len ||
+	    (size && write(fd, payload, size) != size)) {
+		perror("write");
+		exit(1);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct record_gather gather = {
+		.id = 1,
+		.ctx_id = 1,
+		.num_words = 3,
+	};
+	struct record_reloc relocs[2] = {
+		{ .id = 1, .ctx_id = 1, .gather_id = 1, .patch_offset = 4 },
+		{ .id = 1, .ctx_id = 1, .gather_id = 1, .patch_offset = 8 },
+	};
+	uint32_t page[1024] = {
+		HOST1X_OPCODE_INCR(0x000, 2), 0xdeadbeef, 0xdeadbeef,
+	};
+	struct record_act r;
+	off_t pos, end;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s path\n", argv[0]);
+		return 1;
+	}
+
+	fd = open(argv[1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	memset(&r, 0, sizeof(r));
+	r.act = REC_START;
+	memcpy(r.data.header.magic, REC_MAGIC, strlen(REC_MAGIC));
+	r.data.header.version = REC_VER;
+	write_act(&r, NULL, 0);
+
+	memset(&r, 0, sizeof(r));
+	r.act = REC_INFO;
+	r.data.record_info.drm = 1;
+	r.data.record_info.compression = REC_UNCOMPRESSED;
+	write_act(&r, NULL, 0);
+
+	r.act = REC_CTX_CREATE;
+	r.data.ctx_create.id = 1;
+	write_act(&r, NULL, 0);
+
+	r.act = REC_BO_CREATE;
+	r.data.bo_create.id = 1;
+	r.data.bo_create.ctx_id = 1;
+	r.data.bo_create.num_pages = 1;
+	r.data.bo_create.flags = 0;
+	write_act(&r, NULL, 0);
+
+	r.act = REC_BO_LOAD_DATA;
+	r.data.bo_load.id = 1;
+	r.data.bo_load.ctx_id = 1;
+	r.data.bo_load.page_id = 0;
+	r.data.bo_load.data_size = 0;
+	write_act(&r, page, sizeof(page));
+
+	r.act = REC_JOB_CTX_CREATE;
+	r.data.job_ctx_create.id = 1;
+	r.data.job_ctx_create.gr2d = 1;
+	write_act(&r, NULL, 0);
+
+	/* the relocations start 4 bytes before the end of the window */
+	end = REC_WINDOW_SIZE - 4;
+	end -= sizeof(gather);
+	end -= sizeof(r.act) + record_action_size(REC_JOB_SUBMIT);
+
+	pos = lseek(fd, 0, SEEK_CUR);
+	pos += sizeof(r.act) + record_action_size(REC_KEYFRAME);
+
+	r.act = REC_KEYFRAME;
+	r.data.keyframe.frame = 0;
+	r.data.keyframe.size = end - pos;
+	write_act(&r, NULL, 0);
+
+	if (lseek(fd, end, SEEK_SET) != end) {
+		perror("lseek");
+		return 1;
+	}
+
+	r.act = REC_JOB_SUBMIT;
+	r.data.job_submit.job_ctx_id = 1;
+	r.data.job_submit.num_gathers = 1;
+	r.data.job_submit.num_relocs = 2;
+	r.data.job_submit.num_syncpt_incrs = 1;
+	write_act(&r, &gather, sizeof(gather));
+
+	if (write(fd, relocs, sizeof(relocs)) != sizeof(relocs)) {
+		perror("write");
+		return 1;
+	}
+
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,8 @@
+DIR=$(dirname $0)
+REC=$(mktemp)
+
+	$DIR/window-record $REC \
+&&	$DIR/../../tools/replay --recfile $REC --benchmark | grep -q "1 jobs" \
+&&	echo "All tests passed"
+
+rm -f $REC
@@ -0,0 +1,892 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Offline statistics of a record, nothing is submitted to the GPU:
+ *	tools/analyzer --recfile /path/record.bin
+ *
+ * Prints per-frame counts of jobs, gathers, relocations, command words,
+ * register writes, redundant register writes (the register held the value
+ * already), shader uploads and bytes uploaded into BOs. The per-register
+ * counts of the whole record follow, sorted by the number of writes.
+ *
+ *	--csv		print the per-frame table as CSV
+ *	--top N		print only the N most written registers
+ *
+ * Register values are tracked per job context and class, a value patched
+ * by a relocation is identified by the BO and offset it points at.
+ * Keyframes are skipped, they repeat what the record did before.
+ */
+
+#define _LARGEFILE64_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef ENABLE_LZ4
+#include <lz4.h>
+#endif
+
+#include "../src/libwrap/cdma_parser.h"
+
+#include "hash.h"
+#include "host1x.h"
+#include "record_replay.h"
+#include "tgr_3d.xml.h"
+
+#define NUM_REGS	0x1000
+
+struct an_bo {
+	uint8_t *data;
+	unsigned int num_pages;
+};
+
+/* register file of a class as seen by a job context */
+struct an_regs {
+	uint32_t values[NUM_REGS];
+	uint8_t valid[NUM_REGS];
+};
+
+struct an_class {
+	uint32_t classid;
+	uint64_t writes[NUM_REGS];
+	uint64_t redundant[NUM_REGS];
+};
+
+struct an_frame {
+	unsigned int jobs;
+	unsigned int gathers;
+	unsigned int relocs;
+	uint64_t words;
+	uint64_t writes;
+	uint64_t redundant;
+	unsigned int shader_uploads;
+	uint64_t shader_words;
+	uint64_t upload_bytes;
+	uint64_t stored_bytes;
+};
+
+struct an_reg_name {
+	uint32_t offset;
+	unsigned int count;
+	unsigned int stride;
+	const char *name;
+};
+
+#define REG(name) \
+	{ TGR3D_ ## name, 1, 1, #name }
+#define REG_ARRAY(name) \
+	{ TGR3D_ ## name(0), TGR3D_ ## name ## __LEN, \
+	  TGR3D_ ## name ## __ESIZE, #name }
+
+static const struct an_reg_name gr3d_regs[] = {
+	REG(INCR_SYNCPT),
+	REG(WAIT_SYNCPT),
+	REG(WAIT_SYNCPT_BASE),
+	REG(LOAD_SYNCPT_BASE),
+	REG(INCR_SYNCPT_BASE),
+	REG(INDOFF2),
+	REG(INDOFF),
+	REG_ARRAY(ATTRIB_PTR),
+	REG_ARRAY(ATTRIB_MODE),
+	REG(VP_ATTRIB_IN_OUT_SELECT),
+	REG(INDEX_PTR),
+	REG(DRAW_PARAMS),
+	REG(DRAW_PRIMITIVES),
+	REG(VP_UPLOAD_INST_ID),
+	REG(VP_UPLOAD_INST),
+	REG(VP_UPLOAD_CONST_ID),
+	REG(VP_UPLOAD_CONST),
+	REG_ARRAY(LINKER_INSTRUCTION),
+	REG(CULL_FACE_LINKER_SETUP),
+	REG(POLYGON_OFFSET_UNITS),
+	REG(POLYFON_OFFSET_FACTOR),
+	REG(POINT_PARAMS),
+	REG(POINT_SIZE),
+	REG(POINT_COORD_RANGE_MAX_S),
+	REG(POINT_COORD_RANGE_MAX_T),
+	REG(POINT_COORD_RANGE_MIN_S),
+	REG(POINT_COORD_RANGE_MIN_T),
+	REG(LINE_PARAMS),
+	REG(HALF_LINE_WIDTH),
+	REG(SCISSOR_HORIZ),
+	REG(SCISSOR_VERT),
+	REG(VIEWPORT_X_BIAS),
+	REG(VIEWPORT_Y_BIAS),
+	REG(VIEWPORT_Z_BIAS),
+	REG(VIEWPORT_X_SCALE),
+	REG(VIEWPORT_Y_SCALE),
+	REG(VIEWPORT_Z_SCALE),
+	REG(GUARDBAND_WIDTH),
+	REG(GUARDBAND_HEIGHT),
+	REG(GUARDBAND_DEPTH),
+	REG(STENCIL_FRONT1),
+	REG(STENCIL_BACK1),
+	REG(STENCIL_PARAMS),
+	REG(DEPTH_TEST_PARAMS),
+	REG(DEPTH_RANGE_NEAR),
+	REG(DEPTH_RANGE_FAR),
+	REG(FP_PSEQ_UPLOAD_INST_BUFFER_FLUSH),
+	REG(FP_PSEQ_ENGINE_INST),
+	REG(FP_PSEQ_UPLOAD_INST_ID),
+	REG(FP_PSEQ_UPLOAD_INST),
+	REG(FP_PSEQ_QUAD_ID),
+	REG(FP_PSEQ_DW_CFG),
+	REG(FP_UPLOAD_MFU_SCHED_ID),
+	REG(FP_UPLOAD_MFU_SCHED),
+	REG(FP_UPLOAD_MFU_INST_ID),
+	REG(FP_UPLOAD_MFU_INST),
+	REG(FP_UPLOAD_TEX_INST_ID),
+	REG(FP_UPLOAD_TEX_INST),
+	REG_ARRAY(TEXTURE_POINTER),
+	REG_ARRAY(TEXTURE_DESC1),
+	REG_ARRAY(TEXTURE_DESC2),
+	REG(FP_UPLOAD_ALU_SCHED_ID),
+	REG(FP_UPLOAD_ALU_SCHED),
+	REG(FP_UPLOAD_ALU_INST_ID),
+	REG(FP_UPLOAD_ALU_INST),
+	REG(FP_UPLOAD_ALU_INST_COMPLEMENT),
+	REG_ARRAY(FP_CONST),
+	REG(FP_UPLOAD_DW_INST_ID),
+	REG(FP_UPLOAD_DW_INST),
+	REG(RT_ENABLE),
+	REG(FDC_CONTROL),
+	REG_ARRAY(RT_PTR),
+	REG_ARRAY(RT_PARAMS),
+	REG(ALU_BUFFER_SIZE),
+	REG(TRAM_SETUP),
+	REG(FP_UPLOAD_INST_ID_COMMON),
+	REG(DITHER),
+	REG(STENCIL_FRONT2),
+	REG(STENCIL_BACK2),
+};
+
+#undef REG
+#undef REG_ARRAY
+
+static FILE *fin;
+static enum record_compression compression;
+
+static struct hash_table bo_table;
+static struct hash_table regs_table;
+static struct an_class *classes;
+static unsigned int num_classes;
+
+static struct an_frame *frames;
+static unsigned int num_frames;
+static unsigned int max_frames;
+
+static struct an_frame *frame;
+static unsigned int job_ctx_id;
+static unsigned int skipped_keyframes;
+
+static const char *reg_name(uint32_t classid, uint32_t offset, char *buf,
+			    size_t size)
+{
+	const struct an_reg_name *reg;
+	unsigned int i, index;
+
+	if (classid != HOST1X_CLASS_GR3D)
+		goto unknown;
+
+	for (i = 0; i < sizeof(gr3d_regs) / sizeof(gr3d_regs[0]); i++) {
+		reg = &gr3d_regs[i];
+
+		if (offset < reg->offset ||
+		    offset >= reg->offset + reg->count * reg->stride ||
+		    (offset - reg->offset) % reg->stride)
+			continue;
+
+		if (reg->count == 1)
+			return reg->name;
+
+		index = (offset - reg->offset) / reg->stride;
+		snprintf(buf, size, "%s[%u]", reg->name, index);
+
+		return buf;
+	}
+
+unknown:
+	snprintf(buf, size, "0x%03x", offset);
+
+	return buf;
+}
+
+/*
+ * Writes to these registers have an effect even if the value doesn't
+ * change: syncpoint methods, draws, cache flushes and the upload FIFOs.
+ */
+static bool reg_has_side_effects(uint32_t classid, uint32_t offset)
+{
+	if (offset <= TGR3D_INCR_SYNCPT_BASE)
+		return true;
+
+	if (classid != HOST1X_CLASS_GR3D)
+		return false;
+
+	switch (offset) {
+	case TGR3D_DRAW_PRIMITIVES:
+	case TGR3D_VP_UPLOAD_INST_ID:
+	case TGR3D_VP_UPLOAD_INST:
+	case TGR3D_VP_UPLOAD_CONST_ID:
+	case TGR3D_VP_UPLOAD_CONST:
+	case TGR3D_FP_PSEQ_UPLOAD_INST_BUFFER_FLUSH:
+	case TGR3D_FP_PSEQ_UPLOAD_INST_ID:
+	case TGR3D_FP_PSEQ_UPLOAD_INST:
+	case TGR3D_FP_UPLOAD_MFU_SCHED_ID:
+	case TGR3D_FP_UPLOAD_MFU_SCHED:
+	case TGR3D_FP_UPLOAD_MFU_INST_ID:
+	case TGR3D_FP_UPLOAD_MFU_INST:
+	case TGR3D_FP_UPLOAD_TEX_INST_ID:
+	case TGR3D_FP_UPLOAD_TEX_INST:
+	case TGR3D_FP_UPLOAD_ALU_SCHED_ID:
+	case TGR3D_FP_UPLOAD_ALU_SCHED:
+	case TGR3D_FP_UPLOAD_ALU_INST_ID:
+	case TGR3D_FP_UPLOAD_ALU_INST:
+	case TGR3D_FP_UPLOAD_ALU_INST_COMPLEMENT:
+	case TGR3D_FP_UPLOAD_DW_INST_ID:
+	case TGR3D_FP_UPLOAD_DW_INST:
+	case TGR3D_FP_UPLOAD_INST_ID_COMMON:
+	case TGR3D_FDC_CONTROL:
+		return true;
+	}
+
+	return false;
+}
+
+static bool reg_is_shader_upload(uint32_t classid, uint32_t offset)
+{
+	if (classid != HOST1X_CLASS_GR3D)
+		return false;
+
+	switch (offset) {
+	case TGR3D_VP_UPLOAD_INST_ID:
+	case TGR3D_FP_PSEQ_UPLOAD_INST_ID:
+	case TGR3D_FP_UPLOAD_INST_ID_COMMON:
+		return true;
+	}
+
+	return false;
+}
+
+static bool reg_is_shader_word(uint32_t classid, uint32_t offset)
+{
+	if (classid != HOST1X_CLASS_GR3D)
+		return false;
+
+	switch (offset) {
+	case TGR3D_VP_UPLOAD_INST:
+	case TGR3D_FP_PSEQ_UPLOAD_INST:
+	case TGR3D_FP_UPLOAD_MFU_SCHED:
+	case TGR3D_FP_UPLOAD_MFU_INST:
+	case TGR3D_FP_UPLOAD_TEX_INST:
+	case TGR3D_FP_UPLOAD_ALU_SCHED:
+	case TGR3D_FP_UPLOAD_ALU_INST:
+	case TGR3D_FP_UPLOAD_ALU_INST_COMPLEMENT:
+	case TGR3D_FP_UPLOAD_DW_INST:
+		return true;
+	}
+
+	return false;
+}
+
+static struct an_class *lookup_class(uint32_t classid)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_classes; i++)
+		if (classes[i].classid == classid)
+			return &classes[i];
+
+	classes = realloc(classes, sizeof(*classes) * (num_classes + 1));
+	assert(classes != NULL);
+
+	memset(&classes[num_classes], 0, sizeof(*classes));
+	classes[num_classes].classid = classid;
+
+	return &classes[num_classes++];
+}
+
+static struct an_regs *lookup_regs(unsigned int job_ctx, uint32_t classid)
+{
+	struct an_regs *regs;
+	int err;
+
+	regs = hash_table_lookup(&regs_table, hash_key(job_ctx, classid));
+	if (regs)
+		return regs;
+
+	regs = calloc(1, sizeof(*regs));
+	assert(regs != NULL);
+
+	err = hash_table_insert(&regs_table, hash_key(job_ctx, classid), regs);
+	assert(err == 0);
+
+	return regs;
+}
+
+static void register_write(void *opaque, uint32_t classid, uint32_t offset,
+			   uint32_t value)
+{
+	struct an_class *class = lookup_class(classid);
+	struct an_regs *regs = lookup_regs(job_ctx_id, classid);
+
+	offset &= NUM_REGS - 1;
+
+	class->writes[offset]++;
+	frame->writes++;
+
+	if (reg_is_shader_upload(classid, offset))
+		frame->shader_uploads++;
+
+	if (reg_is_shader_word(classid, offset))
+		frame->shader_words++;
+
+	if (!reg_has_side_effects(classid, offset) && regs->valid[offset] &&
+	    regs->values[offset] == value) {
+		class->redundant[offset]++;
+		frame->redundant++;
+	}
+
+	regs->values[offset] = value;
+	regs->valid[offset] = 1;
+}
+
+static struct an_frame *next_frame(void)
+{
+	if (num_frames == max_frames) {
+		max_frames = max_frames ? max_frames * 2 : 256;
+
+		frames = realloc(frames, sizeof(*frames) * max_frames);
+		assert(frames != NULL);
+	}
+
+	memset(&frames[num_frames], 0, sizeof(*frames));
+
+	return &frames[num_frames++];
+}
+
+static int rec_read(void *data, size_t size)
+{
+	if (!size)
+		return 1;
+
+	return fread(data, size, 1, fin);
+}
+
+static int decompress_data(void *in, void *out, size_t in_size)
+{
+#ifdef ENABLE_ZLIB
+	uLongf size = 4096;
+
+	if (compression == REC_ZLIB)
+		return uncompress(out, &size, in, in_size) == Z_OK &&
+		       size == 4096;
+#endif
+
+#ifdef ENABLE_LZ4
+	if (compression == REC_LZ4)
+		return LZ4_decompress_safe(in, out, in_size, 4096) == 4096;
+#endif
+
+	return 0;
+}
+
+/* reads the data of a page load, the file position is right after its action */
+static int read_page(void *dest, unsigned int size)
+{
+	uint8_t compressed[4096];
+
+	if (!size)
+		return rec_read(dest, 4096);
+
+	if (size > sizeof(compressed) || rec_read(compressed, size) != 1)
+		return 0;
+
+	return decompress_data(compressed, dest, size);
+}
+
+static void *lookup_page(unsigned int id, unsigned int ctx_id,
+			 unsigned int page)
+{
+	struct an_bo *bo = hash_table_lookup(&bo_table, hash_key(ctx_id, id));
+
+	if (!bo || page >= bo->num_pages)
+		return NULL;
+
+	return bo->data + page * 4096;
+}
+
+static int load_page(struct record_act *r)
+{
+	void *dest = lookup_page(r->data.bo_load.id, r->data.bo_load.ctx_id,
+				 r->data.bo_load.page_id);
+	unsigned int size = r->data.bo_load.data_size;
+
+	if (!dest)
+		return 0;
+
+	frame->upload_bytes += 4096;
+	frame->stored_bytes += size ?: 4096;
+
+	return read_page(dest, size);
+}
+
+static int load_page_ref(struct record_act *r)
+{
+	void *dest = lookup_page(r->data.bo_load_ref.id,
+				 r->data.bo_load_ref.ctx_id,
+				 r->data.bo_load_ref.page_id);
+	struct record_act data;
+	off64_t pos;
+	int ret;
+
+	if (!dest)
+		return 0;
+
+	frame->upload_bytes += 4096;
+
+	pos = ftello64(fin);
+
+	if (fseeko64(fin, r->data.bo_load_ref.offset, SEEK_SET) < 0)
+		return 0;
+
+	ret = rec_read(&data, sizeof(data.act) + sizeof(data.data.bo_load));
+	if (ret == 1 && data.act == REC_BO_LOAD_DATA)
+		ret = read_page(dest, data.data.bo_load.data_size);
+	else
+		ret = 0;
+
+	if (fseeko64(fin, pos, SEEK_SET) < 0)
+		return 0;
+
+	return ret;
+}
+
+/*
+ * Stands in for the address a relocation patches into the commands. The
+ * target is keyed like in the BO table, the offset into it is mixed in.
+ */
+static uint32_t reloc_value(struct record_reloc *reloc)
+{
+	uint64_t key = hash_key(reloc->ctx_id, reloc->id);
+
+	key ^= reloc->offset * 0x9e3779b97f4a7c15ull;
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+
+	return key;
+}
+
+static int submit_job(struct record_act *r, bool gr2d)
+{
+	unsigned int num_gathers = r->data.job_submit.num_gathers;
+	unsigned int num_relocs = r->data.job_submit.num_relocs;
+	struct record_gather *gathers;
+	struct record_reloc *relocs;
+	uint32_t classid, *words;
+	unsigned int i, k;
+	struct an_bo *bo;
+	size_t size;
+	int ret = 1;
+
+	gathers = calloc(num_gathers ?: 1, sizeof(*gathers));
+	relocs = calloc(num_relocs ?: 1, sizeof(*relocs));
+	assert(gathers != NULL && relocs != NULL);
+
+	if (rec_read(gathers, sizeof(*gathers) * num_gathers) != 1 ||
+	    rec_read(relocs, sizeof(*relocs) * num_relocs) != 1) {
+		ret = 0;
+		goto out;
+	}
+
+	frame->jobs++;
+	frame->gathers += num_gathers;
+	frame->relocs += num_relocs;
+
+	job_ctx_id = r->data.job_submit.job_ctx_id;
+	classid = gr2d ? HOST1X_CLASS_GR2D : HOST1X_CLASS_GR3D;
+
+	for (i = 0; i < num_gathers; i++) {
+		bo = hash_table_lookup(&bo_table, hash_key(gathers[i].ctx_id,
+							   gathers[i].id));
+		size = gathers[i].num_words * 4;
+
+		if (!bo || gathers[i].offset + size >
+				(size_t)bo->num_pages * 4096) {
+			fprintf(stderr, "Invalid gather %u\n", i);
+			ret = 0;
+			goto out;
+		}
+
+		/*
+		 * The parser doesn't check the opcodes against the end of
+		 * the gather, give it room for the largest one.
+		 */
+		words = calloc(gathers[i].num_words + 0x10000, 4);
+		assert(words != NULL);
+
+		memcpy(words, bo->data + gathers[i].offset, size);
+
+		for (k = 0; k < num_relocs; k++) {
+			uint32_t patch = relocs[k].patch_offset;
+
+			if (relocs[k].gather_id != gathers[i].id ||
+			    patch < gathers[i].offset ||
+			    patch + 4 > gathers[i].offset + size)
+				continue;
+
+			words[(patch - gathers[i].offset) / 4] =
+				reloc_value(&relocs[k]);
+		}
+
+		frame->words += gathers[i].num_words;
+
+		cdma_parse_commands(words, gathers[i].num_words, false,
+				    &classid, NULL, register_write);
+		free(words);
+	}
+
+out:
+	free(gathers);
+	free(relocs);
+
+	return ret;
+}
+
+static void print_frames(bool csv)
+{
+	struct an_frame total = {};
+	struct an_frame *f;
+	unsigned int i;
+
+	if (csv)
+		printf("frame,jobs,gathers,relocs,words,writes,redundant,"
+		       "shader_uploads,shader_words,upload_bytes,"
+		       "stored_bytes\n");
+	else
+		printf("%6s %6s %7s %7s %9s %9s %9s %7s %8s %11s %11s\n",
+		       "frame", "jobs", "gathers", "relocs", "words",
+		       "writes", "redundant", "shaders", "sh_words",
+		       "upload", "stored");
+
+	for (i = 0; i < num_frames; i++) {
+		f = &frames[i];
+
+		/* the last frame wasn't displayed, skip it if it's empty */
+		if (i == num_frames - 1 && !f->jobs && !f->upload_bytes)
+			break;
+
+		printf(csv ? "%u,%u,%u,%u,%llu,%llu,%llu,%u,%llu,%llu,%llu\n" :
+		       "%6u %6u %7u %7u %9llu %9llu %9llu %7u %8llu %11llu %11llu\n",
+		       i, f->jobs, f->gathers, f->relocs,
+		       (unsigned long long)f->words,
+		       (unsigned long long)f->writes,
+		       (unsigned long long)f->redundant, f->shader_uploads,
+		       (unsigned long long)f->shader_words,
+		       (unsigned long long)f->upload_bytes,
+		       (unsigned long long)f->stored_bytes);
+
+		total.jobs += f->jobs;
+		total.gathers += f->gathers;
+		total.relocs += f->relocs;
+		total.words += f->words;
+		total.writes += f->writes;
+		total.redundant += f->redundant;
+		total.shader_uploads += f->shader_uploads;
+		total.shader_words += f->shader_words;
+		total.upload_bytes += f->upload_bytes;
+		total.stored_bytes += f->stored_bytes;
+	}
+
+	if (csv)
+		return;
+
+	printf("%6s %6u %7u %7u %9llu %9llu %9llu %7u %8llu %11llu %11llu\n",
+	       "total", total.jobs, total.gathers, total.relocs,
+	       (unsigned long long)total.words,
+	       (unsigned long long)total.writes,
+	       (unsigned long long)total.redundant, total.shader_uploads,
+	       (unsigned long long)total.shader_words,
+	       (unsigned long long)total.upload_bytes,
+	       (unsigned long long)total.stored_bytes);
+
+	if (total.writes)
+		printf("\n%.1f%% of the register writes are redundant\n",
+		       100.0 * total.redundant / total.writes);
+
+	if (skipped_keyframes)
+		printf("%u keyframes skipped\n", skipped_keyframes);
+}
+
+struct an_reg_stat {
+	uint32_t classid;
+	uint32_t offset;
+	uint64_t writes;
+	uint64_t redundant;
+};
+
+static int compare_reg_stats(const void *a, const void *b)
+{
+	const struct an_reg_stat *ra = a, *rb = b;
+
+	if (ra->writes != rb->writes)
+		return ra->writes < rb->writes ? 1 : -1;
+
+	if (ra->classid != rb->classid)
+		return ra->classid < rb->classid ? -1 : 1;
+
+	return ra->offset < rb->offset ? -1 : ra->offset > rb->offset;
+}
+
+static void print_registers(unsigned int top)
+{
+	struct an_reg_stat *stats;
+	unsigned int i, k, count = 0;
+	char buf[64];
+
+	stats = calloc(num_classes * NUM_REGS + 1, sizeof(*stats));
+	assert(stats != NULL);
+
+	for (i = 0; i < num_classes; i++) {
+		for (k = 0; k < NUM_REGS; k++) {
+			if (!classes[i].writes[k])
+				continue;
+
+			stats[count].classid = classes[i].classid;
+			stats[count].offset = k;
+			stats[count].writes = classes[i].writes[k];
+			stats[count].redundant = classes[i].redundant[k];
+			count++;
+		}
+	}
+
+	qsort(stats, count, sizeof(*stats), compare_reg_stats);
+
+	if (top && top < count)
+		count = top;
+
+	printf("\n%5s %-36s %11s %11s %7s\n",
+	       "class", "register", "writes", "redundant", "%");
+
+	for (i = 0; i < count; i++)
+		printf("%5x %-36s %11llu %11llu %6.1f%%\n",
+		       stats[i].classid,
+		       reg_name(stats[i].classid, stats[i].offset,
+				buf, sizeof(buf)),
+		       (unsigned long long)stats[i].writes,
+		       (unsigned long long)stats[i].redundant,
+		       100.0 * stats[i].redundant / stats[i].writes);
+
+	free(stats);
+}
+
+int main(int argc, char *argv[])
+{
+	struct hash_table job_ctx_gr2d = {};
+	unsigned int top = 0;
+	struct record_act r;
+	const char *path = NULL;
+	bool csv = false;
+	struct an_bo *bo;
+	size_t size;
+	int c, ret;
+
+	do {
+		struct option long_options[] =
+		{
+			{"recfile",	required_argument, NULL, 0},
+			{"csv",		no_argument,       NULL, 0},
+			{"top",		required_argument, NULL, 0},
+			{ /* Sentinel */ }
+		};
+		int option_index = 0;
+
+		c = getopt_long(argc, argv, "h", long_options, &option_index);
+
+		switch (c) {
+		case 0:
+			switch (option_index) {
+			case 0:
+				path = optarg;
+				break;
+
+			case 1:
+				csv = true;
+				break;
+
+			case 2:
+				top = strtoul(optarg, NULL, 0);
+				break;
+
+			default:
+				return 0;
+			}
+
+		case -1:
+			break;
+
+		default:
+			fprintf(stderr, "Invalid arguments\n\n");
+			return 1;
+		}
+	} while (c != -1);
+
+	if (!path) {
+		fprintf(stderr, "'--recfile path' is missing\n\n");
+		return 1;
+	}
+
+	fin = fopen64(path, "r");
+	if (!fin) {
+		fprintf(stderr, "Failed to open %s: %s\n", path,
+			strerror(errno));
+		return 1;
+	}
+
+	frame = next_frame();
+
+	while (rec_read(&r.act, sizeof(r.act)) == 1) {
+		size = record_action_size(r.act);
+		if (!size) {
+			fprintf(stderr, "Invalid action %u\n", r.act);
+			return 1;
+		}
+
+		if (rec_read(&r.data, size) != 1)
+			break;
+
+		switch (r.act) {
+		case REC_START:
+			if (strncmp(r.data.header.magic, REC_MAGIC,
+				    sizeof(r.data.header.magic)) ||
+			    r.data.header.version < REC_MIN_VER ||
+			    r.data.header.version > REC_VER) {
+				fprintf(stderr, "Invalid record\n");
+				return 1;
+			}
+			break;
+
+		case REC_INFO:
+			compression = r.data.record_info.compression;
+			break;
+
+		case REC_BO_CREATE:
+			bo = calloc(1, sizeof(*bo));
+			assert(bo != NULL);
+
+			bo->num_pages = r.data.bo_create.num_pages;
+			bo->data = calloc(bo->num_pages ?: 1, 4096);
+			assert(bo->data != NULL);
+
+			ret = hash_table_insert(&bo_table,
+					hash_key(r.data.bo_create.ctx_id,
+						 r.data.bo_create.id), bo);
+			assert(ret == 0);
+			break;
+
+		case REC_BO_DESTROY:
+			bo = hash_table_lookup(&bo_table,
+					hash_key(r.data.bo_destroy.ctx_id,
+						 r.data.bo_destroy.id));
+			hash_table_remove(&bo_table,
+					hash_key(r.data.bo_destroy.ctx_id,
+						 r.data.bo_destroy.id));
+			if (bo) {
+				free(bo->data);
+				free(bo);
+			}
+			break;
+
+		case REC_BO_LOAD_DATA:
+			if (load_page(&r) != 1)
+				goto err_data;
+			break;
+
+		case REC_BO_LOAD_REF:
+			if (load_page_ref(&r) != 1)
+				goto err_data;
+			break;
+
+		case REC_JOB_CTX_CREATE:
+			/* the table only takes non-NULL values */
+			ret = hash_table_insert(&job_ctx_gr2d,
+					r.data.job_ctx_create.id,
+					r.data.job_ctx_create.gr2d ?
+						(void *)2 : (void *)1);
+			assert(ret == 0);
+			break;
+
+		case REC_JOB_SUBMIT:
+			ret = submit_job(&r, hash_table_lookup(&job_ctx_gr2d,
+					r.data.job_submit.job_ctx_id) ==
+					(void *)2);
+			if (ret != 1)
+				goto err_data;
+			break;
+
+		case REC_DISP_FRAMEBUFFER:
+			frame = next_frame();
+			break;
+
+		case REC_KEYFRAME:
+			skipped_keyframes++;
+
+			if (fseeko64(fin, r.data.keyframe.size, SEEK_CUR) < 0)
+				goto err_data;
+			break;
+
+		case REC_INDEX:
+			goto done;
+
+		default:
+			break;
+		}
+	}
+
+done:
+	print_frames(csv);
+
+	if (!csv)
+		print_registers(top);
+
+	fclose(fin);
+
+	return 0;
+
+err_data:
+	fprintf(stderr, "Failed to read the data of action %u\n", r.act);
+	fclose(fin);
+
+	return 1;
+}
@@ -356,7 +356,7 @@ int main(int argc, char *argv[])
 	grate_3d_draw_elements(ctx, TGR3D_PRIMITIVE_TYPE_TRIANGLES,
 			       bo, TGR3D_INDEX_MODE_UINT16,
 			       ARRAY_SIZE(indices));
-	grate_flush(grate);
+	grate_finish(grate);
 
 	fb_data = grate_framebuffer_data(fb, true);
 	if (!fb_data)
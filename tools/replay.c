@@ -27,16 +27,46 @@
  * Make a record:
  *	LIBWRAP_RECORD_PATH=/path/record.bin LD_PRELOAD=libgrate-wrap.so /path/app
  *
+ * LIBWRAP_RECORD_WRITE_TRACKING=1 makes the recorder only capture the BO
+ * pages that the application wrote to, instead of comparing all pages. It
+ * write-protects the BO mappings of the application, so syscalls that have
+ * the kernel write into them fail. Only use it for applications that write
+ * to their BOs with the CPU alone.
+ *
  * Replay a record:
  *	tools/replay --recfile /path/record.bin
+ *
+ * Replay frames 1000 to 1009 of a record:
+ *	tools/replay --recfile /path/record.bin --start-frame 1000 --frames 10
+ *
+ * Pages are decompressed by one thread per CPU in the background, use
+ * --threads to change the number of threads, 0 decompresses the pages
+ * in line with the replay.
+ *
+ * Benchmark a record 5 times and write the per-frame statistics to a CSV
+ * file, a .json file name selects JSON output:
+ *	tools/replay --recfile /path/record.bin --benchmark --loops 5 \
+ *		--benchmark-output results.csv
+ *
+ * Replay a record at the pace it was recorded at, here twice as fast, and
+ * report the frames that fall behind by more than 2 ms:
+ *	tools/replay --recfile /path/record.bin --pace 2 --pace-threshold 2
  */
 
 #define _LARGEFILE64_SOURCE
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #ifdef ENABLE_ZLIB
 #include <zlib.h>
@@ -49,18 +79,16 @@
 #include <libdrm/drm_fourcc.h>
 
 #include "grate.h"
+#include "hash.h"
 #include "host1x-private.h"
-#include "list.h"
 #include "record_replay.h"
 #include "tegra_drm.h"
 
 struct rep_ctx {
-	struct list_head node;
 	unsigned int id;
 };
 
 struct rep_bo {
-	struct list_head node;
 	struct host1x_bo *bo;
 	unsigned int refcnt;
 	unsigned int ctx_id;
@@ -70,7 +98,6 @@ struct rep_bo {
 };
 
 struct rep_framebuffer {
-	struct list_head node;
 	struct host1x_framebuffer *hfb;
 	unsigned int bo_id;
 	unsigned int ctx_id;
@@ -82,17 +109,150 @@ struct rep_framebuffer {
 };
 
 struct rep_job_ctx {
-	struct list_head node;
 	unsigned int id;
 	bool gr2d;
 };
 
-static LIST_HEAD(ctx_list);
-static LIST_HEAD(bo_list);
-static LIST_HEAD(fb_list);
-static LIST_HEAD(job_ctx_list);
+/* BOs and framebuffers are keyed by (ctx_id, id) */
+static struct hash_table ctx_table;
+static struct hash_table bo_table;
+static struct hash_table fb_table;
+static struct hash_table job_ctx_table;
+
+/*
+ * The record is read through a window of the file that is mapped on demand,
+ * records of long captures are too large to be mapped as a whole on 32bit
+ * systems.
+ */
+#define REC_WINDOW_SIZE		(64 << 20)
+
+struct rec_window {
+	uint8_t *ptr;
+	uint64_t start;
+	size_t size;
+};
+
+static int recfd = -1;
+static uint64_t rec_size;
+static uint64_t rec_pos;
+static struct rec_window rec_window;
+
+/* frames before the start frame are replayed silently */
+static bool fast_forward;
+static unsigned int frame;
+static uint64_t keyframe_offset;
+static uint64_t keyframe_end;
+
+static struct record_keyframe *keyframes;
+static unsigned int num_keyframes;
+
+/*
+ * Per-frame statistics of the benchmark mode. The CPU time of a job covers
+ * building and submitting it, the GPU time runs from the submission to the
+ * job's fence, jobs are waited for one by one so that is the distance to
+ * the fence of the previous job too.
+ */
+struct bench_frame {
+	unsigned int loop;
+	unsigned int frame;
+	double time;
+	unsigned int jobs;
+	double cpu_time;
+	double gpu_time;
+	uint64_t upload;
+};
+
+struct bench {
+	bool enabled;
+	const char *output;
+	unsigned int loops;
+	unsigned int loop;
+
+	/* where the measured part of the record starts */
+	uint64_t loop_pos;
+	unsigned int loop_frame;
 
-static FILE *recfile;
+	struct timespec frame_start;
+	struct bench_frame current;
+
+	struct bench_frame *frames;
+	unsigned int num_frames;
+	unsigned int max_frames;
+
+	double *job_cpu_times;
+	double *job_gpu_times;
+	unsigned int num_jobs;
+	unsigned int max_jobs;
+};
+
+static struct bench bench = {
+	.loops = 1,
+};
+
+/*
+ * Pacing mode: every job and display of a record with timestamps is held
+ * back until its recorded time, divided by @speed. A frame on which the
+ * replay falls further behind than @threshold ms is reported with the GPU
+ * time the replay spent on it and with how the application spent the time
+ * of the frame in the recording. The replay waits for every job, so it
+ * can't overlap CPU and GPU work like the application may have done.
+ */
+struct pace {
+	bool enabled;
+	double speed;
+	double threshold;
+
+	/* the recorded @base time is replayed at @start */
+	bool started;
+	bool stamped;
+	uint64_t base;
+	struct timespec start;
+	uint64_t time;
+
+	/* recorded time of the previous display and the frame so far */
+	uint64_t frame_time;
+	double cpu_time;
+	double wait_time;
+	double gpu_time;
+	double lag;
+	double frame_lag;
+
+	unsigned int frames;
+	unsigned int late_frames;
+	unsigned int gpu_frames;
+	unsigned int cpu_frames;
+	double max_lag;
+};
+
+static struct pace pace = {
+	.speed = 1.0,
+	.threshold = 1.0,
+};
+
+#define rep_printf(fmt, ...)					\
+	do {							\
+		if (!fast_forward && !bench.enabled &&		\
+		    !pace.enabled)				\
+			printf(fmt, ##__VA_ARGS__);		\
+	} while (0)
+
+static bool bench_measuring(void)
+{
+	return bench.enabled && !fast_forward;
+}
+
+/* objects outlive the repetitions of the benchmark but the last one */
+static bool bench_keep_objects(void)
+{
+	return bench.enabled && bench.loop + 1 < bench.loops;
+}
+
+static double bench_time_ms(const struct timespec *start,
+			    const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * 1000.0 +
+	       (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
 
 static struct host1x *host1x;
 static struct host1x_display *display;
@@ -118,28 +278,244 @@ static const char *str_actions[] = {
 	[REC_JOB_CTX_CREATE] = "REC_JOB_CTX_CREATE",
 	[REC_JOB_CTX_DESTROY] = "REC_JOB_CTX_DESTROY",
 	[REC_JOB_SUBMIT] = "REC_JOB_SUBMIT",
+	[REC_KEYFRAME] = "REC_KEYFRAME",
+	[REC_INDEX] = "REC_INDEX",
+	[REC_BO_LOAD_REF] = "REC_BO_LOAD_REF",
+	[REC_TIMESTAMP] = "REC_TIMESTAMP",
 };
 
+/*
+ * Returns a pointer to the @size bytes of the record at @pos and advances
+ * @pos past them, NULL if the record ends before.
+ */
+static void *rec_window_map(struct rec_window *w, uint64_t *pos, size_t size)
+{
+	uint64_t start, end;
+	void *ptr;
+
+	if (*pos + size > rec_size)
+		return NULL;
+
+	if (!w->ptr || *pos < w->start || *pos + size > w->start + w->size) {
+		if (w->ptr)
+			munmap(w->ptr, w->size);
+
+		start = *pos & ~((uint64_t)sysconf(_SC_PAGESIZE) - 1);
+		end = start + REC_WINDOW_SIZE;
+
+		if (end < *pos + size)
+			end = *pos + size;
+
+		if (end > rec_size)
+			end = rec_size;
+
+		ptr = mmap64(NULL, end - start, PROT_READ, MAP_PRIVATE, recfd,
+			     start);
+		if (ptr == MAP_FAILED) {
+			w->ptr = NULL;
+			return NULL;
+		}
+
+		madvise(ptr, end - start, MADV_SEQUENTIAL);
+
+		w->ptr = ptr;
+		w->start = start;
+		w->size = end - start;
+	}
+
+	ptr = w->ptr + (*pos - w->start);
+	*pos += size;
+
+	return ptr;
+}
+
+static void *rec_map(size_t size)
+{
+	return rec_window_map(&rec_window, &rec_pos, size);
+}
+
+static int rec_read(void *data, size_t size)
+{
+	void *ptr = rec_map(size);
+
+	if (!ptr)
+		return 0;
+
+	memcpy(data, ptr, size);
+
+	return 1;
+}
+
+static int rec_open(const char *path)
+{
+	struct stat64 st;
+
+	recfd = open(path, O_RDONLY | O_LARGEFILE);
+	if (recfd < 0)
+		return -errno;
+
+	if (fstat64(recfd, &st) < 0)
+		return -errno;
+
+	rec_size = st.st_size;
+
+	return 0;
+}
+
+/* size of the payload that follows the data of an action */
+static uint64_t rec_payload_size(struct record_act *r)
+{
+	switch (r->act) {
+	case REC_BO_LOAD_DATA:
+		return r->data.bo_load.data_size ?: 4096;
+
+	case REC_JOB_SUBMIT:
+		return r->data.job_submit.num_gathers *
+				sizeof(struct record_gather) +
+		       r->data.job_submit.num_relocs *
+				sizeof(struct record_reloc);
+
+	case REC_KEYFRAME:
+		return r->data.keyframe.size;
+
+	case REC_INDEX:
+		return (r->data.index.num_frames + 1) * sizeof(uint64_t) +
+		       r->data.index.num_keyframes *
+				sizeof(struct record_keyframe) +
+		       sizeof(struct record_trailer);
+
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Finds the keyframes of a record that wasn't finished, by walking all
+ * actions without replaying them.
+ */
+static void rec_scan_keyframes(void)
+{
+	unsigned int max_keyframes = 0;
+	struct record_act r;
+	uint64_t offset;
+	size_t size;
+
+	while (true) {
+		offset = rec_pos;
+
+		if (!rec_read(&r.act, sizeof(r.act)))
+			break;
+
+		size = record_action_size(r.act);
+		if (!size || !rec_read(&r.data, size))
+			break;
+
+		if (r.act == REC_KEYFRAME) {
+			if (num_keyframes == max_keyframes) {
+				max_keyframes = max_keyframes * 2 ?: 64;
+				keyframes = realloc(keyframes, max_keyframes *
+						    sizeof(*keyframes));
+				assert(keyframes != NULL);
+			}
+
+			keyframes[num_keyframes].frame = r.data.keyframe.frame;
+			keyframes[num_keyframes].offset = offset;
+			num_keyframes++;
+		}
+
+		rec_pos += rec_payload_size(&r);
+	}
+}
+
+static void rec_load_index(void)
+{
+	struct record_trailer trailer;
+	uint64_t start = rec_pos;
+	struct record_act r;
+	size_t size;
+
+	if (rec_size < start + sizeof(trailer))
+		return;
+
+	rec_pos = rec_size - sizeof(trailer);
+
+	if (!rec_read(&trailer, sizeof(trailer)) ||
+	    memcmp(trailer.magic, REC_INDEX_MAGIC, sizeof(trailer.magic)))
+		goto scan;
+
+	rec_pos = trailer.index_offset;
+
+	if (!rec_read(&r.act, sizeof(r.act)) || r.act != REC_INDEX ||
+	    !rec_read(&r.data, sizeof(r.data.index)))
+		goto scan;
+
+	rec_pos += (r.data.index.num_frames + 1) * sizeof(uint64_t);
+
+	size = r.data.index.num_keyframes * sizeof(*keyframes);
+	keyframes = malloc(size);
+	assert(size == 0 || keyframes != NULL);
+
+	if (!rec_read(keyframes, size))
+		goto scan;
+
+	num_keyframes = r.data.index.num_keyframes;
+	rec_pos = start;
+
+	return;
+
+scan:
+	fprintf(stderr, "Record has no index, scanning for keyframes\n");
+
+	rec_pos = start;
+	rec_scan_keyframes();
+	rec_pos = start;
+}
+
+/*
+ * Positions the record at the last keyframe before @start_frame, the frames
+ * up to @start_frame are then replayed silently.
+ */
+static void rec_seek(unsigned int start_frame)
+{
+	struct record_keyframe *kf = NULL;
+	unsigned int i;
+
+	rec_load_index();
+
+	for (i = 0; i < num_keyframes; i++)
+		if (keyframes[i].frame <= start_frame)
+			kf = &keyframes[i];
+
+	if (kf) {
+		fprintf(stderr, "Seeking to keyframe of frame %u\n", kf->frame);
+		rec_pos = kf->offset;
+		keyframe_offset = kf->offset;
+		frame = kf->frame;
+	}
+
+	fast_forward = frame < start_frame;
+}
+
 static void create_context(unsigned int id)
 {
-	struct rep_ctx *ctx = calloc(1, sizeof(*ctx));
+	struct rep_ctx *ctx;
+	int err;
+
+	if (bench.enabled && hash_table_lookup(&ctx_table, id))
+		return;
+
+	ctx = calloc(1, sizeof(*ctx));
 	assert(ctx != NULL);
 
 	ctx->id = id;
 
-	INIT_LIST_HEAD(&ctx->node);
-	list_add_tail(&ctx->node, &ctx_list);
+	err = hash_table_insert(&ctx_table, id, ctx);
+	assert(err == 0);
 }
 
 static struct rep_ctx *lookup_context(unsigned int id)
 {
-	struct rep_ctx *ctx;
-
-	list_for_each_entry(ctx, &ctx_list, node)
-		if (ctx->id == id)
-			return ctx;
-
-	return NULL;
+	return hash_table_lookup(&ctx_table, id);
 }
 
 static void destroy_context(unsigned int id)
@@ -147,7 +523,10 @@ static void destroy_context(unsigned int id)
 	struct rep_ctx *ctx = lookup_context(id);
 	assert(ctx != NULL);
 
-	list_del(&ctx->node);
+	if (bench_keep_objects())
+		return;
+
+	hash_table_remove(&ctx_table, id);
 	free(ctx);
 }
 
@@ -156,10 +535,15 @@ static void create_bo(unsigned int id, unsigned int ctx_id,
 {
 	struct rep_ctx *ctx;
 	struct rep_bo *rbo;
+	int err;
 
 	ctx = lookup_context(ctx_id);
 	assert(ctx != NULL);
 
+	if (bench.enabled &&
+	    hash_table_lookup(&bo_table, hash_key(ctx_id, id)))
+		return;
+
 	rbo = calloc(1, sizeof(*rbo));
 	assert(rbo != NULL);
 
@@ -170,25 +554,40 @@ static void create_bo(unsigned int id, unsigned int ctx_id,
 		rbo->flags |= HOST1X_BO_CREATE_FLAG_BOTTOM_UP;
 
 	rbo->id = id;
+	rbo->ctx_id = ctx_id;
 	rbo->bo = HOST1X_BO_CREATE(host1x, size, rbo->flags);
 	assert(rbo->bo != NULL);
 
 	HOST1X_BO_MMAP(rbo->bo, (void *)&rbo->map);
 	assert(rbo->map != NULL);
 
-	INIT_LIST_HEAD(&rbo->node);
-	list_add_tail(&rbo->node, &bo_list);
+	err = hash_table_insert(&bo_table, hash_key(ctx_id, id), rbo);
+	assert(err == 0);
 }
 
 static struct rep_bo *lookup_bo(unsigned int id, unsigned int ctx_id)
 {
-	struct rep_bo *rbo;
+	return hash_table_lookup(&bo_table, hash_key(ctx_id, id));
+}
+
+/*
+ * FNV-1a hash of the BO contents, printed when the BO is destroyed so that
+ * the data a replay rebuilt can be compared against the application's.
+ */
+static uint64_t bo_checksum(unsigned int id, unsigned int ctx_id)
+{
+	struct rep_bo *rbo = lookup_bo(id, ctx_id);
+	uint64_t hash = 0xcbf29ce484222325ull;
+	size_t i;
 
-	list_for_each_entry(rbo, &bo_list, node)
-		if (rbo->id == id)
-			return rbo;
+	assert(rbo != NULL);
 
-	return NULL;
+	for (i = 0; i < rbo->bo->size; i++) {
+		hash ^= (uint8_t)rbo->map[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
 }
 
 static void destroy_bo(unsigned int id, unsigned int ctx_id)
@@ -196,7 +595,10 @@ static void destroy_bo(unsigned int id, unsigned int ctx_id)
 	struct rep_bo *rbo = lookup_bo(id, ctx_id);
 	assert(rbo != NULL);
 
-	list_del(&rbo->node);
+	if (bench_keep_objects())
+		return;
+
+	hash_table_remove(&bo_table, hash_key(ctx_id, id));
 	free(rbo);
 }
 
@@ -269,11 +671,279 @@ static int decompress_data(void *in, void *out,
 	return 0;
 }
 
+/*
+ * Compressed pages are decompressed ahead of time by a pipeline: a reader
+ * thread walks the record ahead of the replay and queues the compressed
+ * pages into a ring of slots, a pool of workers decompresses them and
+ * load_bo() takes the decoded pages out of the ring in record order. The
+ * ring positions are advanced atomically, the semaphores only put threads
+ * to sleep while the ring is full or empty.
+ */
+#define PREFETCH_SLOTS		256
+
+struct prefetch_slot {
+	uint64_t offset;
+	unsigned int size;
+	sem_t done;
+	uint8_t in[4096];
+	uint8_t out[4096];
+};
+
+static struct prefetch_slot *prefetch_slots;
+static pthread_t prefetch_reader_thread;
+static bool prefetch_reader_running;
+static pthread_t *prefetch_workers;
+static unsigned int prefetch_num_workers;
+static unsigned int prefetch_head;
+static unsigned int prefetch_decode;
+static unsigned int prefetch_tail;
+static uint64_t prefetch_pos;
+static sem_t prefetch_free;
+static sem_t prefetch_work;
+static bool prefetch_stop;
+
+static bool prefetch_stopped(void)
+{
+	return __atomic_load_n(&prefetch_stop, __ATOMIC_ACQUIRE);
+}
+
+static void prefetch_queue(uint64_t offset, void *data, unsigned int size)
+{
+	struct prefetch_slot *slot;
+
+	while (sem_wait(&prefetch_free) < 0)
+		;
+
+	if (prefetch_stopped())
+		return;
+
+	slot = &prefetch_slots[prefetch_head++ % PREFETCH_SLOTS];
+	slot->offset = offset;
+	slot->size = size;
+	memcpy(slot->in, data, size);
+
+	sem_post(&prefetch_work);
+}
+
+/*
+ * Walks the record the same way the replay does, keyframes that the replay
+ * skips are skipped here too.
+ */
+static void *prefetch_reader(void *arg)
+{
+	struct rec_window window = {};
+	uint64_t pos = prefetch_pos;
+	struct record_act r;
+	uint64_t offset;
+	void *data;
+	size_t size;
+
+	while (!prefetch_stopped()) {
+		offset = pos;
+
+		data = rec_window_map(&window, &pos, sizeof(r.act));
+		if (!data)
+			break;
+
+		memcpy(&r.act, data, sizeof(r.act));
+
+		size = record_action_size(r.act);
+		if (!size)
+			break;
+
+		data = rec_window_map(&window, &pos, size);
+		if (!data)
+			break;
+
+		memcpy(&r.data, data, size);
+
+		if (r.act == REC_KEYFRAME && offset == keyframe_offset)
+			continue;
+
+		if (r.act == REC_BO_LOAD_DATA && r.data.bo_load.data_size) {
+			size = r.data.bo_load.data_size;
+
+			data = rec_window_map(&window, &pos, size);
+			if (!data)
+				break;
+
+			prefetch_queue(pos - size, data, size);
+			continue;
+		}
+
+		pos += rec_payload_size(&r);
+	}
+
+	/* terminate the ring for load_bo() */
+	if (!prefetch_stopped())
+		prefetch_queue(UINT64_MAX, NULL, 0);
+
+	if (window.ptr)
+		munmap(window.ptr, window.size);
+
+	return NULL;
+}
+
+static void *prefetch_worker(void *arg)
+{
+	struct prefetch_slot *slot;
+	unsigned int index;
+
+	while (true) {
+		while (sem_wait(&prefetch_work) < 0)
+			;
+
+		if (prefetch_stopped())
+			break;
+
+		/* slots are queued in order, so this one is filled already */
+		index = __atomic_fetch_add(&prefetch_decode, 1, __ATOMIC_ACQ_REL);
+		slot = &prefetch_slots[index % PREFETCH_SLOTS];
+
+		if (slot->size)
+			decompress_data(slot->in, slot->out, slot->size, 4096);
+
+		sem_post(&slot->done);
+	}
+
+	return NULL;
+}
+
+static void prefetch_finish(void)
+{
+	unsigned int i;
+
+	__atomic_store_n(&prefetch_stop, true, __ATOMIC_RELEASE);
+
+	/* wake up the reader if it waits for a free slot */
+	if (prefetch_reader_running) {
+		sem_post(&prefetch_free);
+		pthread_join(prefetch_reader_thread, NULL);
+		prefetch_reader_running = false;
+	}
+
+	for (i = 0; i < prefetch_num_workers; i++)
+		sem_post(&prefetch_work);
+
+	for (i = 0; i < prefetch_num_workers; i++)
+		pthread_join(prefetch_workers[i], NULL);
+
+	prefetch_num_workers = 0;
+
+	free(prefetch_workers);
+	free(prefetch_slots);
+	prefetch_workers = NULL;
+	prefetch_slots = NULL;
+}
+
+static int prefetch_start(uint64_t pos, unsigned int num_workers)
+{
+	unsigned int i;
+	int err;
+
+	if (!num_workers || compression == REC_UNCOMPRESSED)
+		return 0;
+
+	prefetch_head = 0;
+	prefetch_decode = 0;
+	prefetch_tail = 0;
+	prefetch_stop = false;
+
+	prefetch_slots = calloc(PREFETCH_SLOTS, sizeof(*prefetch_slots));
+	prefetch_workers = calloc(num_workers, sizeof(*prefetch_workers));
+	if (!prefetch_slots || !prefetch_workers) {
+		err = ENOMEM;
+		goto err_finish;
+	}
+
+	for (i = 0; i < PREFETCH_SLOTS; i++)
+		sem_init(&prefetch_slots[i].done, 0, 0);
+
+	sem_init(&prefetch_free, 0, PREFETCH_SLOTS);
+	sem_init(&prefetch_work, 0, 0);
+
+	for (i = 0; i < num_workers; i++) {
+		err = pthread_create(&prefetch_workers[i], NULL,
+				     prefetch_worker, NULL);
+		if (err)
+			goto err_finish;
+
+		prefetch_num_workers++;
+	}
+
+	prefetch_pos = pos;
+
+	err = pthread_create(&prefetch_reader_thread, NULL, prefetch_reader,
+			     NULL);
+	if (err)
+		goto err_finish;
+
+	prefetch_reader_running = true;
+
+	return 0;
+
+err_finish:
+	prefetch_finish();
+
+	return -err;
+}
+
+static int prefetch_restart(uint64_t pos)
+{
+	unsigned int num_workers = prefetch_num_workers;
+
+	if (!prefetch_slots)
+		return 0;
+
+	prefetch_finish();
+
+	return prefetch_start(pos, num_workers);
+}
+
+/*
+ * Takes the decoded page of the data at @offset out of the ring, returns
+ * false if the page wasn't prefetched.
+ */
+static bool prefetch_take(uint64_t offset, void *dest)
+{
+	struct prefetch_slot *slot;
+
+	if (!prefetch_slots)
+		return false;
+
+	while (true) {
+		slot = &prefetch_slots[prefetch_tail % PREFETCH_SLOTS];
+
+		while (sem_wait(&slot->done) < 0)
+			;
+
+		if (slot->offset >= offset)
+			break;
+
+		/* data that the replay skipped */
+		prefetch_tail++;
+		sem_post(&prefetch_free);
+	}
+
+	if (slot->offset != offset) {
+		/* keep the slot for the next page */
+		sem_post(&slot->done);
+		return false;
+	}
+
+	memcpy(dest, slot->out, 4096);
+
+	prefetch_tail++;
+	sem_post(&prefetch_free);
+
+	return true;
+}
+
 static int load_bo(unsigned int id, unsigned int ctx_id,
 		   unsigned int page, unsigned int size)
 {
 	struct rep_bo *rbo = lookup_bo(id, ctx_id);
-	uint8_t compressed[size];
+	void *compressed;
 	void *dest;
 	int ret;
 
@@ -281,17 +951,120 @@ static int load_bo(unsigned int id, unsigned int ctx_id,
 
 	dest = rbo->map + page * 4096;
 
-	if (size) {
-		ret = fread(compressed, size, 1, recfile);
+	if (bench_measuring())
+		bench.current.upload += 4096;
+
+	if (size && prefetch_take(rec_pos, dest)) {
+		rec_pos += size;
+		ret = 1;
+	} else if (size) {
+		compressed = rec_map(size);
+		ret = compressed ? 1 : 0;
 		if (ret == 1)
 			ret = decompress_data(compressed, dest, size, 4096);
 	} else {
-		ret = fread(dest, 4096, 1, recfile);
+		ret = rec_read(dest, 4096);
 	}
 
 	return ret;
 }
 
+/*
+ * Decoded pages that were referenced by REC_BO_LOAD_REF, keyed by the offset
+ * of the action holding the data. Once the cache is full, the page that was
+ * cached first is dropped.
+ */
+#define PAGE_CACHE_SIZE		4096
+
+struct page_cache_entry {
+	uint64_t offset;
+	uint8_t data[4096];
+};
+
+static struct hash_table page_cache;
+static struct page_cache_entry *page_cache_entries[PAGE_CACHE_SIZE];
+static unsigned int page_cache_next;
+
+/* referenced data lies anywhere before, it has a window of its own */
+static struct rec_window ref_window;
+
+static struct page_cache_entry *page_cache_load(uint64_t offset)
+{
+	struct page_cache_entry *entry;
+	uint64_t pos = offset;
+	struct record_act r;
+	void *data;
+	int err;
+
+	entry = hash_table_lookup(&page_cache, offset);
+	if (entry)
+		return entry;
+
+	data = rec_window_map(&ref_window, &pos,
+			      sizeof(r.act) + sizeof(r.data.bo_load));
+	if (!data)
+		return NULL;
+
+	memcpy(&r, data, sizeof(r.act) + sizeof(r.data.bo_load));
+
+	if (r.act != REC_BO_LOAD_DATA)
+		return NULL;
+
+	data = rec_window_map(&ref_window, &pos,
+			      r.data.bo_load.data_size ?: 4096);
+	if (!data)
+		return NULL;
+
+	entry = page_cache_entries[page_cache_next % PAGE_CACHE_SIZE];
+	if (entry) {
+		hash_table_remove(&page_cache, entry->offset);
+	} else {
+		entry = malloc(sizeof(*entry));
+		if (!entry)
+			return NULL;
+
+		page_cache_entries[page_cache_next % PAGE_CACHE_SIZE] = entry;
+	}
+
+	page_cache_next++;
+
+	entry->offset = offset;
+
+	if (r.data.bo_load.data_size) {
+		if (decompress_data(data, entry->data,
+				    r.data.bo_load.data_size, 4096) != 1)
+			return NULL;
+	} else {
+		memcpy(entry->data, data, 4096);
+	}
+
+	err = hash_table_insert(&page_cache, offset, entry);
+	if (err < 0)
+		return NULL;
+
+	return entry;
+}
+
+static int load_bo_ref(unsigned int id, unsigned int ctx_id,
+		       unsigned int page, uint64_t offset)
+{
+	struct rep_bo *rbo = lookup_bo(id, ctx_id);
+	struct page_cache_entry *entry;
+
+	assert(rbo != NULL);
+
+	if (bench_measuring())
+		bench.current.upload += 4096;
+
+	entry = page_cache_load(offset);
+	if (!entry)
+		return 0;
+
+	memcpy(rbo->map + page * 4096, entry->data, 4096);
+
+	return 1;
+}
+
 static void set_bo_flags(unsigned int id, unsigned int ctx_id, uint32_t flags)
 {
 	struct rep_bo *rbo = lookup_bo(id, ctx_id);
@@ -313,6 +1086,10 @@ static void create_framebuffer(unsigned int bo_id, unsigned int ctx_id,
 
 	assert(rbo != NULL);
 
+	if (bench.enabled &&
+	    hash_table_lookup(&fb_table, hash_key(ctx_id, bo_id)))
+		return;
+
 	hfb = calloc(1, sizeof(*hfb));
 	assert(hfb != NULL);
 
@@ -372,20 +1149,14 @@ static void create_framebuffer(unsigned int bo_id, unsigned int ctx_id,
 	rfb->pitch = pitch;
 	rfb->reflect_y = !!(rbo->flags & HOST1X_BO_CREATE_FLAG_BOTTOM_UP);
 
-	INIT_LIST_HEAD(&rfb->node);
-	list_add_tail(&rfb->node, &fb_list);
+	err = hash_table_insert(&fb_table, hash_key(ctx_id, bo_id), rfb);
+	assert(err == 0);
 }
 
 static struct rep_framebuffer *lookup_framebuffer(unsigned int bo_id,
 						  unsigned int ctx_id)
 {
-	struct rep_framebuffer *rfb;
-
-	list_for_each_entry(rfb, &fb_list, node)
-		if (rfb->bo_id == bo_id && rfb->ctx_id == ctx_id)
-			return rfb;
-
-	return NULL;
+	return hash_table_lookup(&fb_table, hash_key(ctx_id, bo_id));
 }
 
 static void destroy_framebuffer(unsigned int bo_id, unsigned int ctx_id)
@@ -393,7 +1164,10 @@ static void destroy_framebuffer(unsigned int bo_id, unsigned int ctx_id)
 	struct rep_framebuffer *rfb = lookup_framebuffer(bo_id, ctx_id);
 	assert(rfb != NULL);
 
-	list_del(&rfb->node);
+	if (bench_keep_objects())
+		return;
+
+	hash_table_remove(&fb_table, hash_key(ctx_id, bo_id));
 	free(rfb->hfb->pixbuf);
 	free(rfb->hfb);
 	free(rfb);
@@ -408,9 +1182,10 @@ static void display_framebuffer(unsigned int bo_id, unsigned int ctx_id)
 	assert(rfb != NULL);
 	int err;
 
-	printf("    displaying fb bo_id: %u\n", rfb->bo_id);
+	rep_printf("    displaying fb bo_id: %u\n", rfb->bo_id);
 
-	if (displayed_fb == rfb)
+	/* headless, e.g. the dummy backend has no display */
+	if (displayed_fb == rfb || fast_forward || !overlay)
 		return;
 
 	err = host1x_overlay_set(overlay, rfb->hfb, 0, 0,
@@ -423,25 +1198,25 @@ static void display_framebuffer(unsigned int bo_id, unsigned int ctx_id)
 
 static void create_job_context(unsigned int id, bool gr2d)
 {
-	struct rep_job_ctx *job_ctx = calloc(1, sizeof(*job_ctx));
+	struct rep_job_ctx *job_ctx;
+	int err;
+
+	if (bench.enabled && hash_table_lookup(&job_ctx_table, id))
+		return;
+
+	job_ctx = calloc(1, sizeof(*job_ctx));
 	assert(job_ctx != NULL);
 
 	job_ctx->id = id;
 	job_ctx->gr2d = gr2d;
 
-	INIT_LIST_HEAD(&job_ctx->node);
-	list_add_tail(&job_ctx->node, &job_ctx_list);
+	err = hash_table_insert(&job_ctx_table, id, job_ctx);
+	assert(err == 0);
 }
 
 static struct rep_job_ctx *lookup_job_context(unsigned int id)
 {
-	struct rep_job_ctx *job_ctx;
-
-	list_for_each_entry(job_ctx, &job_ctx_list, node)
-		if (job_ctx->id == id)
-			return job_ctx;
-
-	return NULL;
+	return hash_table_lookup(&job_ctx_table, id);
 }
 
 static void destroy_job_context(unsigned int id)
@@ -449,10 +1224,38 @@ static void destroy_job_context(unsigned int id)
 	struct rep_job_ctx *job_ctx = lookup_job_context(id);
 	assert(job_ctx != NULL);
 
-	list_del(&job_ctx->node);
+	if (bench_keep_objects())
+		return;
+
+	hash_table_remove(&job_ctx_table, id);
 	free(job_ctx);
 }
 
+static void bench_add_job(double cpu_time, double gpu_time)
+{
+	unsigned int max;
+
+	if (bench.num_jobs == bench.max_jobs) {
+		max = bench.max_jobs * 2 ?: 1024;
+
+		bench.job_cpu_times = realloc(bench.job_cpu_times,
+					      max * sizeof(double));
+		bench.job_gpu_times = realloc(bench.job_gpu_times,
+					      max * sizeof(double));
+		assert(bench.job_cpu_times && bench.job_gpu_times);
+
+		bench.max_jobs = max;
+	}
+
+	bench.job_cpu_times[bench.num_jobs] = cpu_time;
+	bench.job_gpu_times[bench.num_jobs] = gpu_time;
+	bench.num_jobs++;
+
+	bench.current.jobs++;
+	bench.current.cpu_time += cpu_time;
+	bench.current.gpu_time += gpu_time;
+}
+
 static int submit_job(unsigned int ctx_id,
 		      unsigned int num_gathers,
 		      unsigned int num_relocs,
@@ -468,49 +1271,49 @@ static int submit_job(unsigned int ctx_id,
 	struct host1x_job *job;
 	struct rep_ctx *ctx;
 	struct rep_bo *rbo;
+	struct timespec start, flushed, signaled;
 	bool *handled_relocs;
+	uint8_t *payload;
 	unsigned int size;
 	unsigned int i, k;
 	uint32_t fence;
 	int ret;
 
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
 	job_ctx = lookup_job_context(ctx_id);
 
 	if (job_ctx->gr2d) {
 		syncpt = &gr2d->client->syncpts[0];
 		client = gr2d->client;
 
-		printf("    gr2d\n");
+		rep_printf("    gr2d\n");
 	} else {
 		syncpt = &gr3d->client->syncpts[0];
 		client = gr3d->client;
 
-		printf("    gr3d\n");
+		rep_printf("    gr3d\n");
 	}
 
 	job = HOST1X_JOB_CREATE(syncpt->id, 1);
 	if (!job)
 		abort();
 
-	if (num_gathers) {
-		size = sizeof(*gathers) * num_gathers;
-		gathers = alloca(size);
-		ret = fread(gathers, size, 1, recfile);
-		if (ret != 1)
-			return ret;
+	/*
+	 * The gathers and relocations are mapped at once, mapping them one by
+	 * one may move the window and unmap the gathers.
+	 */
+	size = sizeof(*gathers) * num_gathers + sizeof(*relocs) * num_relocs;
+	if (size) {
+		payload = rec_map(size);
+		if (!payload)
+			return 0;
 	} else {
-		gathers = NULL;
+		payload = NULL;
 	}
 
-	if (num_relocs) {
-		size = sizeof(*relocs) * num_relocs;
-		relocs = alloca(size);
-		ret = fread(relocs, size, 1, recfile);
-		if (ret != 1)
-			return ret;
-	} else {
-		relocs = NULL;
-	}
+	gathers = num_gathers ? payload : NULL;
+	relocs = num_relocs ? payload + sizeof(*gathers) * num_gathers : NULL;
 
 	handled_relocs = alloca(sizeof(bool) * num_relocs);
 	rfb = NULL;
@@ -526,7 +1329,7 @@ static int submit_job(unsigned int ctx_id,
 
 	if (num_relocs) {
 		for (i = 0; i < num_gathers; i++) {
-			printf("        gather %u bo_id: %u ctx_id: %u\n",
+			rep_printf("        gather %u bo_id: %u ctx_id: %u\n",
 			       i, gathers[i].id, gathers[i].ctx_id);
 			assert(gathers[i].ctx_id == relocs[0].ctx_id);
 		}
@@ -574,7 +1377,7 @@ static int submit_job(unsigned int ctx_id,
 			fbsrt = "(fb)";
 		}
 
-		printf("        reloc %u bo_id: %u ctx_id: %u offset: %u %s\n",
+		rep_printf("        reloc %u bo_id: %u ctx_id: %u offset: %u %s\n",
 		       i, relocs[i].id, relocs[i].ctx_id, relocs[i].offset, fbsrt);
 		assert(relocs[i].ctx_id == relocs[0].ctx_id);
 		assert(handled_relocs[i]);
@@ -592,10 +1395,21 @@ static int submit_job(unsigned int ctx_id,
 	if (ret < 0)
 		abort();
 
+	clock_gettime(CLOCK_MONOTONIC, &flushed);
+
 	ret = HOST1X_CLIENT_WAIT(client, fence, ~0u);
 	if (ret < 0)
 		abort();
 
+	clock_gettime(CLOCK_MONOTONIC, &signaled);
+
+	if (bench_measuring())
+		bench_add_job(bench_time_ms(&start, &flushed),
+			      bench_time_ms(&flushed, &signaled));
+
+	if (pace.enabled && !fast_forward)
+		pace.gpu_time += bench_time_ms(&flushed, &signaled);
+
 	return 0;
 }
 
@@ -624,11 +1438,355 @@ static void handle_single_step(void)
 	}
 }
 
+/* starts the recorded timeline over at the next timestamp */
+static void pace_start(void)
+{
+	pace.started = false;
+	pace.cpu_time = 0.0;
+	pace.wait_time = 0.0;
+	pace.gpu_time = 0.0;
+	pace.lag = 0.0;
+	pace.frame_lag = 0.0;
+}
+
+/* waits until the time of the job or display that follows @ts */
+static void pace_timestamp(struct timestamp ts)
+{
+	struct timespec target, now;
+	uint64_t delay;
+	double lag;
+
+	if (!pace.enabled || fast_forward)
+		return;
+
+	pace.stamped = true;
+	pace.cpu_time += ts.cpu_gap / 1000000.0;
+	pace.wait_time += ts.wait / 1000000.0;
+	pace.time = ts.time;
+
+	if (!pace.started) {
+		pace.started = true;
+		pace.base = ts.time;
+		pace.frame_time = ts.time;
+		clock_gettime(CLOCK_MONOTONIC, &pace.start);
+		return;
+	}
+
+	delay = 0;
+	if (ts.time > pace.base)
+		delay = (ts.time - pace.base) / pace.speed;
+
+	delay += pace.start.tv_nsec;
+	target.tv_sec = pace.start.tv_sec + delay / 1000000000;
+	target.tv_nsec = delay % 1000000000;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	lag = bench_time_ms(&target, &now);
+	if (lag < 0.0) {
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL);
+		lag = 0.0;
+	}
+
+	pace.lag = lag;
+}
+
+static void pace_end_frame(void)
+{
+	double interval, growth;
+	bool gpu_bound;
+
+	if (!pace.enabled || fast_forward || !pace.started)
+		return;
+
+	/* the time the frame took in the recording, scaled */
+	interval = (pace.time - pace.frame_time) / 1000000.0 / pace.speed;
+	growth = pace.lag - pace.frame_lag;
+
+	if (pace.cpu_time > (pace.time - pace.frame_time) / 2000000.0)
+		pace.cpu_frames++;
+
+	if (growth > pace.threshold) {
+		gpu_bound = pace.gpu_time > interval;
+
+		printf("frame %u: %.3f ms behind (+%.3f ms), GPU %.3f ms of a "
+		       "%.3f ms frame, recorded app CPU %.3f ms, waits %.3f ms: "
+		       "%s\n", frame, pace.lag, growth, pace.gpu_time,
+		       interval, pace.cpu_time, pace.wait_time,
+		       gpu_bound ? "GPU can't keep up" : "replay overhead");
+
+		pace.late_frames++;
+		if (gpu_bound)
+			pace.gpu_frames++;
+	}
+
+	pace.frames++;
+	pace.max_lag = MAX(pace.max_lag, pace.lag);
+	pace.frame_lag = pace.lag;
+	pace.frame_time = pace.time;
+	pace.cpu_time = 0.0;
+	pace.wait_time = 0.0;
+	pace.gpu_time = 0.0;
+}
+
+/* starts the measurement at the current position of the record */
+static void bench_start(void)
+{
+	bench.loop_pos = rec_pos;
+	bench.loop_frame = frame;
+
+	memset(&bench.current, 0, sizeof(bench.current));
+	clock_gettime(CLOCK_MONOTONIC, &bench.frame_start);
+}
+
+static void bench_end_frame(void)
+{
+	struct timespec now;
+	unsigned int max;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if (bench.num_frames == bench.max_frames) {
+		max = bench.max_frames * 2 ?: 256;
+
+		bench.frames = realloc(bench.frames,
+				       max * sizeof(*bench.frames));
+		assert(bench.frames != NULL);
+
+		bench.max_frames = max;
+	}
+
+	bench.current.loop = bench.loop;
+	bench.current.frame = frame;
+	bench.current.time = bench_time_ms(&bench.frame_start, &now);
+	bench.frames[bench.num_frames++] = bench.current;
+
+	memset(&bench.current, 0, sizeof(bench.current));
+	bench.frame_start = now;
+}
+
+/*
+ * Rewinds the record to the start of the measurement for the next
+ * repetition, returns false after the last one.
+ */
+static bool bench_next_loop(void)
+{
+	int err;
+
+	if (!bench.enabled || ++bench.loop >= bench.loops)
+		return false;
+
+	rec_pos = bench.loop_pos;
+	frame = bench.loop_frame;
+
+	err = prefetch_restart(rec_pos);
+	if (err < 0)
+		fprintf(stderr, "Failed to restart decompression threads: %d\n",
+			err);
+
+	/* the partial frame before the end of the record isn't counted */
+	memset(&bench.current, 0, sizeof(bench.current));
+	clock_gettime(CLOCK_MONOTONIC, &bench.frame_start);
+	pace_start();
+
+	return true;
+}
+
+static int bench_compare(const void *a, const void *b)
+{
+	const double *x = a, *y = b;
+
+	return (*x > *y) - (*x < *y);
+}
+
+/* @values get sorted */
+static double bench_percentile(double *values, unsigned int count,
+			       unsigned int percentile)
+{
+	if (!count)
+		return 0.0;
+
+	qsort(values, count, sizeof(*values), bench_compare);
+
+	return values[(count - 1) * percentile / 100];
+}
+
+struct bench_summary {
+	unsigned int frames;
+	unsigned int jobs;
+	double total_time;
+	double frame_p50, frame_p90, frame_p99, frame_max;
+	double jobs_per_frame;
+	double upload_per_frame;
+	double cpu_p50, cpu_p99;
+	double gpu_p50, gpu_p99;
+};
+
+static void bench_summarize(struct bench_summary *sum)
+{
+	uint64_t upload = 0;
+	unsigned int i;
+	double *times;
+
+	memset(sum, 0, sizeof(*sum));
+
+	times = malloc((bench.num_frames + 1) * sizeof(double));
+	assert(times != NULL);
+
+	for (i = 0; i < bench.num_frames; i++) {
+		times[i] = bench.frames[i].time;
+		sum->total_time += bench.frames[i].time;
+		upload += bench.frames[i].upload;
+	}
+
+	sum->frames = bench.num_frames;
+	sum->jobs = bench.num_jobs;
+	sum->frame_p50 = bench_percentile(times, bench.num_frames, 50);
+	sum->frame_p90 = bench_percentile(times, bench.num_frames, 90);
+	sum->frame_p99 = bench_percentile(times, bench.num_frames, 99);
+	sum->frame_max = bench_percentile(times, bench.num_frames, 100);
+
+	free(times);
+
+	if (bench.num_frames) {
+		sum->jobs_per_frame = (double)bench.num_jobs / bench.num_frames;
+		sum->upload_per_frame = (double)upload / bench.num_frames;
+	}
+
+	sum->cpu_p50 = bench_percentile(bench.job_cpu_times, bench.num_jobs, 50);
+	sum->cpu_p99 = bench_percentile(bench.job_cpu_times, bench.num_jobs, 99);
+	sum->gpu_p50 = bench_percentile(bench.job_gpu_times, bench.num_jobs, 50);
+	sum->gpu_p99 = bench_percentile(bench.job_gpu_times, bench.num_jobs, 99);
+}
+
+static void bench_write_csv(FILE *fp)
+{
+	struct bench_frame *f;
+	unsigned int i;
+
+	fprintf(fp, "loop,frame,frame_ms,jobs,cpu_ms,gpu_ms,upload_bytes\n");
+
+	for (i = 0; i < bench.num_frames; i++) {
+		f = &bench.frames[i];
+
+		fprintf(fp, "%u,%u,%.3f,%u,%.3f,%.3f,%llu\n",
+			f->loop, f->frame, f->time, f->jobs, f->cpu_time,
+			f->gpu_time, (unsigned long long)f->upload);
+	}
+}
+
+static void bench_write_json(FILE *fp, const struct bench_summary *sum)
+{
+	struct bench_frame *f;
+	unsigned int i;
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "\t\"summary\": {\n");
+	fprintf(fp, "\t\t\"loops\": %u,\n", bench.loops);
+	fprintf(fp, "\t\t\"frames\": %u,\n", sum->frames);
+	fprintf(fp, "\t\t\"jobs\": %u,\n", sum->jobs);
+	fprintf(fp, "\t\t\"total_ms\": %.3f,\n", sum->total_time);
+	fprintf(fp, "\t\t\"frame_ms_p50\": %.3f,\n", sum->frame_p50);
+	fprintf(fp, "\t\t\"frame_ms_p90\": %.3f,\n", sum->frame_p90);
+	fprintf(fp, "\t\t\"frame_ms_p99\": %.3f,\n", sum->frame_p99);
+	fprintf(fp, "\t\t\"frame_ms_max\": %.3f,\n", sum->frame_max);
+	fprintf(fp, "\t\t\"jobs_per_frame\": %.2f,\n", sum->jobs_per_frame);
+	fprintf(fp, "\t\t\"upload_bytes_per_frame\": %.0f,\n",
+		sum->upload_per_frame);
+	fprintf(fp, "\t\t\"job_cpu_ms_p50\": %.3f,\n", sum->cpu_p50);
+	fprintf(fp, "\t\t\"job_cpu_ms_p99\": %.3f,\n", sum->cpu_p99);
+	fprintf(fp, "\t\t\"job_gpu_ms_p50\": %.3f,\n", sum->gpu_p50);
+	fprintf(fp, "\t\t\"job_gpu_ms_p99\": %.3f\n", sum->gpu_p99);
+	fprintf(fp, "\t},\n");
+	fprintf(fp, "\t\"frames\": [\n");
+
+	for (i = 0; i < bench.num_frames; i++) {
+		f = &bench.frames[i];
+
+		fprintf(fp, "\t\t{ \"loop\": %u, \"frame\": %u, "
+			"\"frame_ms\": %.3f, \"jobs\": %u, \"cpu_ms\": %.3f, "
+			"\"gpu_ms\": %.3f, \"upload_bytes\": %llu }%s\n",
+			f->loop, f->frame, f->time, f->jobs, f->cpu_time,
+			f->gpu_time, (unsigned long long)f->upload,
+			i + 1 < bench.num_frames ? "," : "");
+	}
+
+	fprintf(fp, "\t]\n");
+	fprintf(fp, "}\n");
+}
+
+static void bench_report(void)
+{
+	struct bench_summary sum;
+	const char *ext;
+	FILE *fp;
+
+	if (!bench.enabled)
+		return;
+
+	bench_summarize(&sum);
+
+	printf("Benchmark: %u frames, %u jobs, %u loops\n",
+	       sum.frames, sum.jobs, bench.loops);
+	printf("  total:             %.3f ms (%.2f fps)\n", sum.total_time,
+	       sum.total_time ? sum.frames * 1000.0 / sum.total_time : 0.0);
+	printf("  frame time p50:    %.3f ms\n", sum.frame_p50);
+	printf("  frame time p90:    %.3f ms\n", sum.frame_p90);
+	printf("  frame time p99:    %.3f ms\n", sum.frame_p99);
+	printf("  frame time max:    %.3f ms\n", sum.frame_max);
+	printf("  jobs per frame:    %.2f\n", sum.jobs_per_frame);
+	printf("  upload per frame:  %.0f bytes\n", sum.upload_per_frame);
+	printf("  job CPU p50/p99:   %.3f / %.3f ms\n", sum.cpu_p50, sum.cpu_p99);
+	printf("  job GPU p50/p99:   %.3f / %.3f ms\n", sum.gpu_p50, sum.gpu_p99);
+
+	if (!bench.output)
+		return;
+
+	fp = fopen(bench.output, "w");
+	if (!fp) {
+		fprintf(stderr, "Failed to open %s: %s\n", bench.output,
+			strerror(errno));
+		return;
+	}
+
+	ext = strrchr(bench.output, '.');
+
+	if (ext && !strcmp(ext, ".json"))
+		bench_write_json(fp, &sum);
+	else
+		bench_write_csv(fp);
+
+	fclose(fp);
+}
+
+static void pace_report(void)
+{
+	if (!pace.enabled)
+		return;
+
+	if (!pace.stamped) {
+		printf("Pacing: the record has no timestamps, it was replayed "
+		       "unpaced\n");
+		return;
+	}
+
+	printf("Pacing: %u frames at %.2fx speed\n", pace.frames, pace.speed);
+	printf("  fell behind:       %u frames, %u on GPU time\n",
+	       pace.late_frames, pace.gpu_frames);
+	printf("  max lag:           %.3f ms\n", pace.max_lag);
+	printf("  app CPU-bound:     %u frames in the recording\n",
+	       pace.cpu_frames);
+}
+
 int main(int argc, char *argv[])
 {
 	struct host1x_options options = {};
+	unsigned int start_frame = 0;
+	unsigned int num_frames = 0;
+	long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
 	struct record_act r;
 	unsigned int act_cnt = 0;
+	uint64_t offset;
 	char *path = NULL;
 	int err = 1;
 	int ret;
@@ -670,6 +1828,14 @@ int main(int argc, char *argv[])
 		struct option long_options[] =
 		{
 			{"recfile",	required_argument, NULL, 0},
+			{"start-frame",	required_argument, NULL, 0},
+			{"frames",	required_argument, NULL, 0},
+			{"threads",	required_argument, NULL, 0},
+			{"benchmark",	no_argument,       NULL, 0},
+			{"loops",	required_argument, NULL, 0},
+			{"benchmark-output", required_argument, NULL, 0},
+			{"pace",	required_argument, NULL, 0},
+			{"pace-threshold", required_argument, NULL, 0},
 			{ /* Sentinel */ }
 		};
 		int option_index = 0;
@@ -683,6 +1849,41 @@ int main(int argc, char *argv[])
 				path = optarg;
 				break;
 
+			case 1:
+				start_frame = strtoul(optarg, NULL, 0);
+				break;
+
+			case 2:
+				num_frames = strtoul(optarg, NULL, 0);
+				break;
+
+			case 3:
+				num_threads = strtol(optarg, NULL, 0);
+				break;
+
+			case 4:
+				bench.enabled = true;
+				break;
+
+			case 5:
+				bench.loops = MAX(strtoul(optarg, NULL, 0), 1);
+				break;
+
+			case 6:
+				bench.output = optarg;
+				break;
+
+			case 7:
+				pace.enabled = true;
+				pace.speed = strtod(optarg, NULL);
+				if (pace.speed <= 0.0)
+					pace.speed = 1.0;
+				break;
+
+			case 8:
+				pace.threshold = strtod(optarg, NULL);
+				break;
+
 			default:
 				return 0;
 			}
@@ -701,18 +1902,40 @@ int main(int argc, char *argv[])
 		abort();
 	}
 
-	recfile = fopen(path, "r");
-	if (!recfile) {
+	ret = rec_open(path);
+	if (ret < 0) {
 		fprintf(stderr, "%s: Failed to open %s: %s\n",
-			__func__, path, strerror(errno));
+			__func__, path, strerror(-ret));
 		abort();
 	}
 
 	do {
-		ret = fread(&r.act, sizeof(r.act), 1, recfile);
+		/* the header and the record info are followed by frame 0 */
+		if (act_cnt == 2) {
+			if (start_frame)
+				rec_seek(start_frame);
+
+			ret = prefetch_start(rec_pos, MAX(num_threads, 0));
+			if (ret < 0)
+				fprintf(stderr, "Failed to start decompression threads: %d\n",
+					ret);
+
+			if (!fast_forward) {
+				bench_start();
+				pace_start();
+			}
+		}
+
+		offset = rec_pos;
+
+		ret = rec_read(&r.act, sizeof(r.act));
 		if (ret != 1) {
-			if (feof(recfile))
+			if (rec_pos >= rec_size) {
+				if (bench_next_loop())
+					continue;
+
 				break;
+			}
 
 			goto err_act;
 		}
@@ -723,24 +1946,24 @@ int main(int argc, char *argv[])
 		if (act_cnt == 1)
 			assert(r.act == REC_INFO);
 
-		if (r.act <= REC_JOB_SUBMIT)
-			printf("replaying action %u: %s\n",
+		if (r.act <= REC_TIMESTAMP)
+			rep_printf("replaying action %u: %s\n",
 			       act_cnt, str_actions[r.act]);
 
 		switch (r.act) {
 		case REC_INFO:
-			ret = fread(&r.data.record_info, sizeof(r.data.record_info), 1, recfile);
+			ret = rec_read(&r.data.record_info, sizeof(r.data.record_info));
 			if (ret != 1)
 				goto err_act_data;
 
-			printf("    drm: %u\n", r.data.record_info.drm);
+			rep_printf("    drm: %u\n", r.data.record_info.drm);
 
 			if (!r.data.record_info.drm)
 				goto err_bad_info;
 
 			compression = r.data.record_info.compression;
 
-			printf("    compression: %u\n", compression);
+			rep_printf("    compression: %u\n", compression);
 
 			if (compression > REC_LZ4)
 				goto err_bad_info;
@@ -748,36 +1971,36 @@ int main(int argc, char *argv[])
 			break;
 
 		case REC_CTX_CREATE:
-			ret = fread(&r.data, sizeof(r.data.ctx_create), 1, recfile);
+			ret = rec_read(&r.data, sizeof(r.data.ctx_create));
 			if (ret != 1)
 				goto err_act_data;
 
-			printf("    id: %u\n", r.data.ctx_create.id);
+			rep_printf("    id: %u\n", r.data.ctx_create.id);
 
 			create_context(r.data.ctx_create.id);
 
 			break;
 
 		case REC_CTX_DESTROY:
-			ret = fread(&r.data, sizeof(r.data.ctx_destroy), 1, recfile);
+			ret = rec_read(&r.data, sizeof(r.data.ctx_destroy));
 			if (ret != 1)
 				goto err_act_data;
 
-			printf("    id: %u\n", r.data.ctx_destroy.id);
+			rep_printf("    id: %u\n", r.data.ctx_destroy.id);
 
 			destroy_context(r.data.ctx_destroy.id);
 
 			break;
 
 		case REC_BO_CREATE:
-			ret = fread(&r.data, sizeof(r.data.bo_create), 1, recfile);
+			ret = rec_read(&r.data, sizeof(r.data.bo_create));
 			if (ret != 1)
 				goto err_act_data;
 
-			printf("    bo_id: %u\n", r.data.bo_create.id);
-			printf("    ctx_id: %u\n", r.data.bo_create.ctx_id);
-			printf("    num_pages: %u\n", r.data.bo_create.num_pages);
-			printf("    flags: 0x%08X\n", r.data.bo_create.flags);
+			rep_printf("    bo_id: %u\n", r.data.bo_create.id);
+			rep_printf("    ctx_id: %u\n", r.data.bo_create.ctx_id);
+			rep_printf("    num_pages: %u\n", r.data.bo_create.num_pages);
+			rep_printf("    flags: 0x%08X\n", r.data.bo_create.flags);
 
 			create_bo(r.data.bo_create.id, r.data.bo_create.ctx_id,
 				  r.data.bo_create.num_pages * 4096,
@@ -786,25 +2009,28 @@ int main(int argc, char *argv[])
 			break;
 
 		case REC_BO_DESTROY:
-			ret = fread(&r.data, sizeof(r.data.bo_destroy), 1, recfile);
+			ret = rec_read(&r.data, sizeof(r.data.bo_destroy));
 			if (ret != 1)
 				goto err_act_data;
 
-			printf("    bo_id: %u\n", r.data.bo_destroy.id);
-			printf("    ctx_id: %u\n", r.data.bo_destroy.ctx_id);
+			rep_printf("    bo_id: %u\n", r.data.bo_destroy.id);
+			rep_printf("    ctx_id: %u\n", r.data.bo_destroy.ctx_id);
+			rep_printf("    checksum: 0x%016llx\n", (unsigned long long)
+				   bo_checksum(r.data.bo_destroy.id,
+					       r.data.bo_destroy.ctx_id));
 
 			destroy_bo(r.data.bo_destroy.id, r.data.bo_destroy.ctx_id);
 
 			break;
 
 		case REC_BO_LOAD_DATA:
-			ret = fread(&r.data, sizeof(r.data.bo_load), 1, recfile);
+			ret = rec_read(&r.data, sizeof(r.data.bo_load));
 			if (ret != 1)
 				goto err_act_data;
 
-			printf("    bo_id: %u\n", r.data.bo_load.id);
-			printf("    ctx_id: %u\n", r.data.bo_load.ctx_id);
-			printf("    page: %u\n", r.data.bo_load.page_id);
+			rep_printf("    bo_id: %u\n", r.data.bo_load.id);
+			rep_printf("    ctx_id: %u\n", r.data.bo_load.ctx_id);
+			rep_printf("    page: %u\n", r.data.bo_load.page_id);
 
 			ret = load_bo(r.data.bo_load.id, r.data.bo_load.ctx_id,
 				      r.data.bo_load.page_id,
@@ -814,14 +2040,34 @@ int main(int argc, char *argv[])
 
 			break;
 
+		case REC_BO_LOAD_REF:
+			ret = rec_read(&r.data, sizeof(r.data.bo_load_ref));
+			if (ret != 1)
+				goto err_act_data;
+
+			rep_printf("    bo_id: %u\n", r.data.bo_load_ref.id);
+			rep_printf("    ctx_id: %u\n", r.data.bo_load_ref.ctx_id);
+			rep_printf("    page: %u\n", r.data.bo_load_ref.page_id);
+			rep_printf("    offset: %llu\n", (unsigned long long)
+				   r.data.bo_load_ref.offset);
+
+			ret = load_bo_ref(r.data.bo_load_ref.id,
+					  r.data.bo_load_ref.ctx_id,
+					  r.data.bo_load_ref.page_id,
+					  r.data.bo_load_ref.offset);
+			if (ret != 1)
+				goto err_act_data;
+
+			break;
+
 		case REC_BO_SET_FLAGS:
-			ret = fread(&r.data, sizeof(r.data.bo_set_flags), 1, recfile);
+			ret = rec_read(&r.data, sizeof(r.data.bo_set_flags));
 			if (ret != 1)
 				goto err_act_data;
 
-			printf("    id: %u\n", r.data.bo_set_flags.id);
-			printf("    ctx_id: %u\n", r.data.bo_set_flags.ctx_id);
-			printf("    flags: 0x%08X\n", r.data.bo_set_flags.flags);
+			rep_printf("    id: %u\n", r.data.bo_set_flags.id);
+			rep_printf("    ctx_id: %u\n", r.data.bo_set_flags.ctx_id);
+			rep_printf("    flags: 0x%08X\n", r.data.bo_set_flags.flags);
 
 			set_bo_flags(r.data.bo_set_flags.id,
 				     r.data.bo_set_flags.ctx_id,
@@ -830,17 +2076,17 @@ int main(int argc, char *argv[])
 			break;
 
 		case REC_ADD_FRAMEBUFFER:
-			ret = fread(&r.data, sizeof(r.data.add_framebuffer), 1, recfile);
+			ret = rec_read(&r.data, sizeof(r.data.add_framebuffer));
 			if (ret != 1)
 				goto err_act_data;
 
-			printf("    bo_id: %u\n", r.data.add_framebuffer.bo_id);
-			printf("    ctx_id: %u\n", r.data.add_framebuffer.ctx_id);
-			printf("    width: %u\n", r.data.add_framebuffer.width);
-			printf("    height: %u\n", r.data.add_framebuffer.height);
-			printf("    pitch: %u\n", r.data.add_framebuffer.pitch);
-			printf("    format: %u\n", r.data.add_framebuffer.format);
-			printf("    flags: %u\n", r.data.add_framebuffer.flags);
+			rep_printf("    bo_id: %u\n", r.data.add_framebuffer.bo_id);
+			rep_printf("    ctx_id: %u\n", r.data.add_framebuffer.ctx_id);
+			rep_printf("    width: %u\n", r.data.add_framebuffer.width);
+			rep_printf("    height: %u\n", r.data.add_framebuffer.height);
+			rep_printf("    pitch: %u\n", r.data.add_framebuffer.pitch);
+			rep_printf("    format: %u\n", r.data.add_framebuffer.format);
+			rep_printf("    flags: %u\n", r.data.add_framebuffer.flags);
 
 			create_framebuffer(r.data.add_framebuffer.bo_id,
 					   r.data.add_framebuffer.ctx_id,
@@ -853,12 +2099,12 @@ int main(int argc, char *argv[])
 			break;
 
 		case REC_DEL_FRAMEBUFFER:
-			ret = fread(&r.data, sizeof(r.data.del_framebuffer), 1, recfile);
+			ret = rec_read(&r.data, sizeof(r.data.del_framebuffer));
 			if (ret != 1)
 				goto err_act_data;
 
-			printf("    bo_id: %u\n", r.data.del_framebuffer.bo_id);
-			printf("    ctx_id: %u\n", r.data.del_framebuffer.ctx_id);
+			rep_printf("    bo_id: %u\n", r.data.del_framebuffer.bo_id);
+			rep_printf("    ctx_id: %u\n", r.data.del_framebuffer.ctx_id);
 
 			destroy_framebuffer(r.data.del_framebuffer.bo_id,
 					    r.data.del_framebuffer.ctx_id);
@@ -866,25 +2112,49 @@ int main(int argc, char *argv[])
 			break;
 
 		case REC_DISP_FRAMEBUFFER:
-			ret = fread(&r.data, sizeof(r.data.disp_framebuffer), 1, recfile);
+			ret = rec_read(&r.data, sizeof(r.data.disp_framebuffer));
 			if (ret != 1)
 				goto err_act_data;
 
-			printf("    bo_id: %u\n", r.data.disp_framebuffer.bo_id);
-			printf("    ctx_id: %u\n", r.data.disp_framebuffer.ctx_id);
+			rep_printf("    bo_id: %u\n", r.data.disp_framebuffer.bo_id);
+			rep_printf("    ctx_id: %u\n", r.data.disp_framebuffer.ctx_id);
 
 			display_framebuffer(r.data.disp_framebuffer.bo_id,
 					    r.data.disp_framebuffer.ctx_id);
 
+			/* a keyframe displays the frame it starts after */
+			if (rec_pos <= keyframe_end)
+				break;
+
+			if (bench_measuring())
+				bench_end_frame();
+
+			pace_end_frame();
+
+			frame++;
+
+			if (frame == start_frame) {
+				fast_forward = false;
+				bench_start();
+				pace_start();
+			}
+
+			if (num_frames && frame == start_frame + num_frames) {
+				if (bench_next_loop())
+					break;
+
+				goto done;
+			}
+
 			break;
 
 		case REC_JOB_CTX_CREATE:
-			ret = fread(&r.data, sizeof(r.data.job_ctx_create), 1, recfile);
+			ret = rec_read(&r.data, sizeof(r.data.job_ctx_create));
 			if (ret != 1)
 				goto err_act_data;
 
-			printf("    id: %u\n", r.data.job_ctx_create.id);
-			printf("    gr2d: %u\n", r.data.job_ctx_create.gr2d);
+			rep_printf("    id: %u\n", r.data.job_ctx_create.id);
+			rep_printf("    gr2d: %u\n", r.data.job_ctx_create.gr2d);
 
 			create_job_context(r.data.job_ctx_create.id,
 					   r.data.job_ctx_create.gr2d);
@@ -892,25 +2162,25 @@ int main(int argc, char *argv[])
 			break;
 
 		case REC_JOB_CTX_DESTROY:
-			ret = fread(&r.data, sizeof(r.data.job_ctx_destroy), 1, recfile);
+			ret = rec_read(&r.data, sizeof(r.data.job_ctx_destroy));
 			if (ret != 1)
 				goto err_act_data;
 
-			printf("    id: %u\n", r.data.job_ctx_destroy.id);
+			rep_printf("    id: %u\n", r.data.job_ctx_destroy.id);
 
 			destroy_job_context(r.data.job_ctx_destroy.id);
 
 			break;
 
 		case REC_JOB_SUBMIT:
-			ret = fread(&r.data, sizeof(r.data.job_submit), 1, recfile);
+			ret = rec_read(&r.data, sizeof(r.data.job_submit));
 			if (ret != 1)
 				goto err_act_data;
 
-			printf("    job_ctx_id: %u\n", r.data.job_submit.job_ctx_id);
-			printf("    num_gathers: %u\n", r.data.job_submit.num_gathers);
-			printf("    num_relocs: %u\n", r.data.job_submit.num_relocs);
-			printf("    num_syncpt_incrs: %u\n", r.data.job_submit.num_syncpt_incrs);
+			rep_printf("    job_ctx_id: %u\n", r.data.job_submit.job_ctx_id);
+			rep_printf("    num_gathers: %u\n", r.data.job_submit.num_gathers);
+			rep_printf("    num_relocs: %u\n", r.data.job_submit.num_relocs);
+			rep_printf("    num_syncpt_incrs: %u\n", r.data.job_submit.num_syncpt_incrs);
 
 			ret = submit_job(r.data.job_submit.job_ctx_id,
 					 r.data.job_submit.num_gathers,
@@ -919,12 +2189,53 @@ int main(int argc, char *argv[])
 			if (ret != 0)
 				goto err_act_data;
 
-			handle_single_step();
+			if (!fast_forward && !bench.enabled && !pace.enabled)
+				handle_single_step();
+
+			break;
+
+		case REC_KEYFRAME:
+			ret = rec_read(&r.data, sizeof(r.data.keyframe));
+			if (ret != 1)
+				goto err_act_data;
+
+			rep_printf("    frame: %u\n", r.data.keyframe.frame);
+
+			/* keyframes are only replayed when seeking to them */
+			if (offset == keyframe_offset && !keyframe_end)
+				keyframe_end = rec_pos + r.data.keyframe.size;
+			else
+				rec_pos += r.data.keyframe.size;
+
+			break;
+
+		case REC_INDEX:
+			ret = rec_read(&r.data, sizeof(r.data.index));
+			if (ret != 1)
+				goto err_act_data;
+
+			rec_pos += rec_payload_size(&r);
+
+			break;
+
+		case REC_TIMESTAMP:
+			ret = rec_read(&r.data, sizeof(r.data.timestamp));
+			if (ret != 1)
+				goto err_act_data;
+
+			rep_printf("    time: %llu ns\n", (unsigned long long)
+				   r.data.timestamp.time);
+			rep_printf("    cpu_gap: %llu ns\n", (unsigned long long)
+				   r.data.timestamp.cpu_gap);
+			rep_printf("    wait: %llu ns\n", (unsigned long long)
+				   r.data.timestamp.wait);
+
+			pace_timestamp(r.data.timestamp);
 
 			break;
 
 		case REC_START:
-			ret = fread(&r.data, sizeof(r.data.header), 1, recfile);
+			ret = rec_read(&r.data, sizeof(r.data.header));
 			if (ret != 1)
 				goto err_act_data;
 
@@ -932,7 +2243,8 @@ int main(int argc, char *argv[])
 				    strlen(REC_MAGIC) != 0))
 				goto err_invalid_header;
 
-			if (r.data.header.version != 4)
+			if (r.data.header.version < REC_MIN_VER ||
+			    r.data.header.version > REC_VER)
 				goto err_invalid_version;
 
 			break;
@@ -945,12 +2257,22 @@ int main(int argc, char *argv[])
 	} while (1);
 
 	fprintf(stderr, "\n\nEnd of record file reached\n");
+	goto stop;
+
+done:
+	fprintf(stderr, "\n\nReplayed %u frames\n", num_frames);
 
 stop:
-	fprintf(stderr, "Press Enter to exit\n");
-	grate_wait_for_key(NULL);
+	bench_report();
+	pace_report();
+
+	if (!bench.enabled) {
+		fprintf(stderr, "Press Enter to exit\n");
+		grate_wait_for_key(NULL);
+	}
 
 exit:
+	prefetch_finish();
 	grate_exit(NULL);
 
 	return err;
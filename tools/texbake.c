@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Bakes an image into a texture that libgrate loads without transcoding:
+ *	tools/texbake --input image.png --output image.tex --format etc1 \
+ *		--mipmaps
+ *
+ * The image goes through the same steps as grate_texture_load(), flip and
+ * compression, and each level is stored at the pitch and in the layout of
+ * the pixelbuffer it is loaded into, see baked_texture.h. The result is
+ * loaded with grate_create_baked_texture().
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <IL/il.h>
+#include <IL/ilu.h>
+
+#include "baked_texture.h"
+#include "etc1.h"
+#include "host1x.h"
+
+/* 16x16 tiles are 16 lines of 16 bytes each */
+#define TILE_BYTES		256
+
+#define log2_size(s)		(31 - __builtin_clz(s))
+
+static const struct {
+	const char *name;
+	enum pixel_format format;
+} formats[] = {
+	{ "rgba8888",	PIX_BUF_FMT_RGBA8888 },
+	{ "dxt1",	PIX_BUF_FMT_DXT1 },
+	{ "dxt3",	PIX_BUF_FMT_DXT3 },
+	{ "dxt5",	PIX_BUF_FMT_DXT5 },
+	{ "etc1",	PIX_BUF_FMT_ETC1 },
+};
+
+static enum pixel_format format = PIX_BUF_FMT_RGBA8888;
+static enum layout_format layout = PIX_BUF_LAYOUT_LINEAR;
+static int etc1_quality = ETC1_QUALITY_BEST;
+
+/*
+ * Compress the bound image, returns the rows of pixels or blocks packed
+ * without padding.
+ */
+static uint8_t *encode_level(unsigned int width, unsigned int height,
+			     unsigned int *pitch)
+{
+	ILubyte *pixels = ilGetData();
+	ILuint size;
+	uint8_t *data;
+	ILenum dxtc;
+	unsigned int i;
+
+	switch (format) {
+	case PIX_BUF_FMT_RGBA8888:
+		*pitch = width * 4;
+		data = malloc(*pitch * height);
+		if (data)
+			memcpy(data, pixels, *pitch * height);
+		return data;
+
+	case PIX_BUF_FMT_ETC1:
+		*pitch = ALIGN(width, 4) / 4 * 8;
+		data = malloc(etc1_get_encoded_data_size(width, height));
+		if (!data)
+			return NULL;
+
+		if (etc1_encode_image_mt(pixels, width, height, 3, width * 3,
+					 data, etc1_quality, 0)) {
+			free(data);
+			return NULL;
+		}
+
+		/* the GR3D word order, like grate_texture_load() does it */
+		for (i = 0; i < etc1_get_encoded_data_size(width, height) / 8; i++) {
+			uint64_t *word = (uint64_t *)data + i;
+			uint64_t a = __builtin_bswap32(*word >> 32);
+			uint64_t b = __builtin_bswap32(*word);
+
+			*word = (b << 32) | a;
+		}
+
+		return data;
+
+	case PIX_BUF_FMT_DXT1:
+		dxtc = IL_DXT1;
+		break;
+	case PIX_BUF_FMT_DXT3:
+		dxtc = IL_DXT3;
+		break;
+	default:
+		dxtc = IL_DXT5;
+		break;
+	}
+
+	*pitch = ALIGN(width, 4) / 4 * PIX_BUF_FORMAT_BYTES(format);
+
+	ilEnable(IL_SQUISH_COMPRESS);
+
+	data = ilCompressDXT(pixels, width, height, 1, dxtc, &size);
+	if (ilGetError() != IL_NO_ERROR) {
+		free(data);
+		return NULL;
+	}
+
+	return data;
+}
+
+/* lay the rows out at the pitch of the pixelbuffer, tiling them if needed */
+static int layout_level(uint8_t *dst, unsigned int dst_pitch,
+			const uint8_t *src, unsigned int src_pitch,
+			unsigned int width, unsigned int height)
+{
+	unsigned int th = PIX_BUF_FORMAT_TEXEL_HEIGHT(format);
+	unsigned int rows = ALIGN(height, th) / th;
+	unsigned int y;
+
+	if (layout == PIX_BUF_LAYOUT_TILED_16x16)
+		return host1x_tile_rect(dst, dst_pitch, src, src_pitch,
+					format, 0, 0, width, height);
+
+	for (y = 0; y < rows; y++)
+		memcpy(dst + y * dst_pitch, src + y * src_pitch, src_pitch);
+
+	return 0;
+}
+
+static bool write_padding(FILE *fp, uint64_t offset)
+{
+	static const uint8_t zeroes[BAKED_TEX_PAYLOAD_ALIGN];
+	uint64_t size = ALIGN(offset, BAKED_TEX_PAYLOAD_ALIGN) - offset;
+
+	return fwrite(zeroes, 1, size, fp) == size;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *input = NULL, *output = NULL;
+	struct baked_texture_header *hdr;
+	unsigned int num_levels = 1;
+	unsigned int width, height, tw, th, i;
+	bool mipmaps = false;
+	ILuint image, level_image;
+	size_t hdr_size;
+	uint64_t offset;
+	FILE *fp;
+	int c;
+
+	do {
+		struct option long_options[] =
+		{
+			{"input",	required_argument, NULL, 0},
+			{"output",	required_argument, NULL, 0},
+			{"format",	required_argument, NULL, 0},
+			{"tiled",	no_argument,       NULL, 0},
+			{"mipmaps",	no_argument,       NULL, 0},
+			{"etc1-quality", required_argument, NULL, 0},
+			{ /* Sentinel */ }
+		};
+		int option_index = 0;
+
+		c = getopt_long(argc, argv, "h", long_options, &option_index);
+
+		switch (c) {
+		case 0:
+			switch (option_index) {
+			case 0:
+				input = optarg;
+				break;
+
+			case 1:
+				output = optarg;
+				break;
+
+			case 2:
+				for (i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+					if (!strcmp(optarg, formats[i].name))
+						break;
+
+				if (i == sizeof(formats) / sizeof(formats[0])) {
+					fprintf(stderr, "Unknown format %s\n", optarg);
+					return 1;
+				}
+
+				format = formats[i].format;
+				break;
+
+			case 3:
+				layout = PIX_BUF_LAYOUT_TILED_16x16;
+				break;
+
+			case 4:
+				mipmaps = true;
+				break;
+
+			case 5:
+				if (!strcmp(optarg, "fast"))
+					etc1_quality = ETC1_QUALITY_FAST;
+				else if (!strcmp(optarg, "medium"))
+					etc1_quality = ETC1_QUALITY_MEDIUM;
+				else
+					etc1_quality = ETC1_QUALITY_BEST;
+				break;
+
+			default:
+				return 0;
+			}
+
+		case -1:
+			break;
+
+		default:
+			fprintf(stderr, "Invalid arguments\n\n");
+			return 1;
+		}
+	} while (c != -1);
+
+	if (!input || !output) {
+		fprintf(stderr, "'--input path' and '--output path' are required\n\n");
+		return 1;
+	}
+
+	if (mipmaps && layout != PIX_BUF_LAYOUT_LINEAR) {
+		fprintf(stderr, "Mipmaps are supported for the linear layout only\n");
+		return 1;
+	}
+
+	ilInit();
+	ilGenImages(1, &image);
+	ilBindImage(image);
+	ilLoadImage(input);
+	ilConvertImage(format == PIX_BUF_FMT_ETC1 ? IL_RGB : IL_RGBA,
+		       IL_UNSIGNED_BYTE);
+
+	if (ilGetError() != IL_NO_ERROR) {
+		fprintf(stderr, "Failed to load %s\n", input);
+		return 1;
+	}
+
+	width = ilGetInteger(IL_IMAGE_WIDTH);
+	height = ilGetInteger(IL_IMAGE_HEIGHT);
+
+	/* the mipmap pixelbuffer rounds the base level down to a power of two */
+	if (mipmaps) {
+		width = 1 << log2_size(width);
+		height = 1 << log2_size(height);
+		num_levels = MAX(log2_size(width), log2_size(height)) + 1;
+	}
+
+	hdr_size = sizeof(*hdr) + num_levels * sizeof(hdr->levels[0]);
+	hdr = calloc(1, hdr_size);
+	if (!hdr)
+		return 1;
+
+	memcpy(hdr->magic, BAKED_TEX_MAGIC, sizeof(hdr->magic));
+	hdr->version = BAKED_TEX_VER;
+	hdr->format = format;
+	hdr->layout = layout;
+	hdr->width = width;
+	hdr->height = height;
+	hdr->num_levels = num_levels;
+
+	tw = PIX_BUF_FORMAT_TEXEL_WIDTH(format);
+	th = PIX_BUF_FORMAT_TEXEL_HEIGHT(format);
+
+	fp = fopen(output, "w");
+	if (!fp) {
+		fprintf(stderr, "Failed to open %s: %s\n", output,
+			strerror(errno));
+		return 1;
+	}
+
+	/* the header is rewritten with the level offsets at the end */
+	offset = ALIGN(hdr_size, BAKED_TEX_PAYLOAD_ALIGN);
+
+	if (fseek(fp, offset, SEEK_SET))
+		goto err_write;
+
+	ilGenImages(1, &level_image);
+
+	for (i = 0; i < num_levels; i++) {
+		struct baked_texture_level *level = &hdr->levels[i];
+		unsigned int src_pitch;
+		uint8_t *src, *dst;
+
+		level->width = MAX(width >> i, 1);
+		level->height = MAX(height >> i, 1);
+		level->rows = ALIGN(level->height, th) / th;
+
+		/* see grate_create_texture() and setup_lod_pixbuf() */
+		if (i == 0) {
+			level->pitch = PIX_BUF_FORMAT_BYTES(format) * width / tw;
+			level->pitch = ALIGN(level->pitch,
+					     PIX_BUF_FORMAT_ALIGNMENT(format));
+		} else {
+			level->pitch = ALIGN(ALIGN(level->width, tw) / tw *
+					     PIX_BUF_FORMAT_BYTES(format), 16);
+		}
+
+		if (layout == PIX_BUF_LAYOUT_TILED_16x16) {
+			level->pitch = ALIGN(level->pitch, TILE_BYTES);
+			level->rows = ALIGN(level->rows, 16);
+		}
+
+		level->offset = offset;
+		level->size = (uint64_t)level->pitch * level->rows;
+
+		ilBindImage(level_image);
+		ilCopyImage(image);
+		iluScale(level->width, level->height, 1);
+
+		/* see grate_texture_load() about the rotation */
+		iluRotate(180.0f);
+
+		if (ilGetError() != IL_NO_ERROR) {
+			fprintf(stderr, "Failed to scale %s to %ux%u\n", input,
+				level->width, level->height);
+			return 1;
+		}
+
+		src = encode_level(level->width, level->height, &src_pitch);
+		dst = calloc(1, level->size);
+		if (!src || !dst) {
+			fprintf(stderr, "Failed to encode level %u\n", i);
+			return 1;
+		}
+
+		if (layout_level(dst, level->pitch, src, src_pitch,
+				 level->width, level->height)) {
+			fprintf(stderr, "Failed to tile level %u\n", i);
+			return 1;
+		}
+
+		if (fwrite(dst, 1, level->size, fp) != level->size)
+			goto err_write;
+
+		offset += level->size;
+
+		if (i + 1 < num_levels) {
+			if (!write_padding(fp, offset))
+				goto err_write;
+
+			offset = ALIGN(offset, BAKED_TEX_PAYLOAD_ALIGN);
+		}
+
+		printf("level %u: %ux%u pitch %u size %llu\n", i,
+		       level->width, level->height, level->pitch,
+		       (unsigned long long)level->size);
+
+		free(dst);
+		free(src);
+	}
+
+	if (fseek(fp, 0, SEEK_SET) ||
+	    fwrite(hdr, 1, hdr_size, fp) != hdr_size)
+		goto err_write;
+
+	if (fclose(fp))
+		goto err_write;
+
+	return 0;
+
+err_write:
+	fprintf(stderr, "Failed to write %s: %s\n", output, strerror(errno));
+	return 1;
+}
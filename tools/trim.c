@@ -0,0 +1,817 @@
+/*
+ * Copyright (c) 2026 grate contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Cuts a range of frames out of a record into a new, self-contained record:
+ *	tools/trim --recfile /path/record.bin --output /path/trimmed.bin \
+ *		--start-frame 1000 --frames 10
+ *
+ * The objects that are alive when the range starts are tracked without
+ * decoding any data, starting at the last keyframe before the range if the
+ * record has an index. The trimmed record begins with the actions that
+ * create them, only the BOs that the range uses are created and loaded.
+ * The actions of the range follow, the page data is copied as it is stored.
+ */
+
+#define _LARGEFILE64_SOURCE
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "list.h"
+#include "record_replay.h"
+
+struct trim_ctx {
+	struct list_head node;
+	unsigned int id;
+};
+
+struct trim_bo {
+	struct list_head node;
+	unsigned int id;
+	unsigned int ctx_id;
+	unsigned int num_pages;
+	uint32_t flags;
+
+	/* offset of the REC_BO_LOAD_DATA holding a page, 0 if never loaded */
+	uint64_t *pages;
+
+	bool is_framebuffer;
+	struct add_framebuffer fb;
+
+	/* used by the range, the trimmed record creates it */
+	bool used;
+};
+
+struct trim_job_ctx {
+	struct list_head node;
+	unsigned int id;
+	bool gr2d;
+};
+
+/* where page data of the input went into the output */
+struct trim_page {
+	uint64_t offset;
+};
+
+static FILE *fin;
+static FILE *fdata;
+static FILE *fout;
+
+static LIST_HEAD(ctxs);
+static LIST_HEAD(bos);
+static LIST_HEAD(job_ctxs);
+static struct hash_table bo_table;
+static struct hash_table page_table;
+
+static uint64_t *frames;
+static unsigned int num_frames;
+static unsigned int max_frames;
+
+static uint64_t rec_offset(FILE *fp)
+{
+	off64_t offset = ftello64(fp);
+
+	if (offset < 0) {
+		fprintf(stderr, "%s: Failed: %s\n", __func__, strerror(errno));
+		exit(1);
+	}
+
+	return offset;
+}
+
+static void rec_seek(FILE *fp, uint64_t offset)
+{
+	if (fseeko64(fp, offset, SEEK_SET) < 0) {
+		fprintf(stderr, "%s: Failed: %s\n", __func__, strerror(errno));
+		exit(1);
+	}
+}
+
+static bool rec_read(FILE *fp, void *data, size_t size)
+{
+	return !size || fread(data, size, 1, fp) == 1;
+}
+
+/* reads the next action, returns false at the end of the record */
+static bool rec_read_action(FILE *fp, struct record_act *r)
+{
+	size_t size;
+
+	if (!rec_read(fp, &r->act, sizeof(r->act)))
+		return false;
+
+	size = record_action_size(r->act);
+	if (!size) {
+		fprintf(stderr, "Invalid action %u\n", r->act);
+		exit(1);
+	}
+
+	return rec_read(fp, &r->data, size);
+}
+
+/* size of the payload that follows the data of an action */
+static uint64_t rec_payload_size(struct record_act *r)
+{
+	switch (r->act) {
+	case REC_BO_LOAD_DATA:
+		return r->data.bo_load.data_size ?: 4096;
+
+	case REC_JOB_SUBMIT:
+		return r->data.job_submit.num_gathers *
+				sizeof(struct record_gather) +
+		       r->data.job_submit.num_relocs *
+				sizeof(struct record_reloc);
+
+	case REC_KEYFRAME:
+		return r->data.keyframe.size;
+
+	default:
+		return 0;
+	}
+}
+
+static void rec_skip(FILE *fp, struct record_act *r)
+{
+	if (fseeko64(fp, rec_payload_size(r), SEEK_CUR) < 0) {
+		fprintf(stderr, "%s: Failed: %s\n", __func__, strerror(errno));
+		exit(1);
+	}
+}
+
+static void write_data(const void *data, size_t size)
+{
+	if (size && fwrite(data, size, 1, fout) != 1) {
+		fprintf(stderr, "%s: Failed: %s\n", __func__, strerror(errno));
+		exit(1);
+	}
+}
+
+static void write_action(struct record_act *r)
+{
+	write_data(r, sizeof(r->act) + record_action_size(r->act));
+}
+
+static struct trim_bo *lookup_bo(unsigned int id, unsigned int ctx_id)
+{
+	return hash_table_lookup(&bo_table, hash_key(ctx_id, id));
+}
+
+static void use_bo(unsigned int id, unsigned int ctx_id)
+{
+	struct trim_bo *bo = lookup_bo(id, ctx_id);
+
+	if (bo)
+		bo->used = true;
+}
+
+/*
+ * Tracks the objects created and destroyed by an action, @offset is the
+ * one of the action.
+ */
+static void track_action(struct record_act *r, uint64_t offset)
+{
+	struct trim_job_ctx *job_ctx;
+	struct trim_ctx *ctx;
+	struct trim_bo *bo;
+	int err;
+
+	switch (r->act) {
+	case REC_CTX_CREATE:
+		ctx = calloc(1, sizeof(*ctx));
+		if (!ctx)
+			abort();
+
+		ctx->id = r->data.ctx_create.id;
+		list_add_tail(&ctx->node, &ctxs);
+		break;
+
+	case REC_CTX_DESTROY:
+		list_for_each_entry(ctx, &ctxs, node) {
+			if (ctx->id == r->data.ctx_destroy.id) {
+				list_del(&ctx->node);
+				free(ctx);
+				break;
+			}
+		}
+		break;
+
+	case REC_BO_CREATE:
+		bo = calloc(1, sizeof(*bo));
+		if (!bo)
+			abort();
+
+		bo->id = r->data.bo_create.id;
+		bo->ctx_id = r->data.bo_create.ctx_id;
+		bo->num_pages = r->data.bo_create.num_pages;
+		bo->flags = r->data.bo_create.flags;
+		bo->pages = calloc(bo->num_pages ?: 1, sizeof(*bo->pages));
+		if (!bo->pages)
+			abort();
+
+		err = hash_table_insert(&bo_table, hash_key(bo->ctx_id, bo->id),
+					bo);
+		if (err < 0)
+			abort();
+
+		list_add_tail(&bo->node, &bos);
+		break;
+
+	case REC_BO_DESTROY:
+		bo = lookup_bo(r->data.bo_destroy.id, r->data.bo_destroy.ctx_id);
+		if (!bo)
+			break;
+
+		hash_table_remove(&bo_table, hash_key(bo->ctx_id, bo->id));
+		list_del(&bo->node);
+		free(bo->pages);
+		free(bo);
+		break;
+
+	case REC_BO_LOAD_DATA:
+		bo = lookup_bo(r->data.bo_load.id, r->data.bo_load.ctx_id);
+		if (bo && r->data.bo_load.page_id < bo->num_pages)
+			bo->pages[r->data.bo_load.page_id] = offset;
+		break;
+
+	case REC_BO_LOAD_REF:
+		bo = lookup_bo(r->data.bo_load_ref.id,
+			       r->data.bo_load_ref.ctx_id);
+		if (bo && r->data.bo_load_ref.page_id < bo->num_pages)
+			bo->pages[r->data.bo_load_ref.page_id] =
+				r->data.bo_load_ref.offset;
+		break;
+
+	case REC_BO_SET_FLAGS:
+		bo = lookup_bo(r->data.bo_set_flags.id,
+			       r->data.bo_set_flags.ctx_id);
+		if (bo)
+			bo->flags = r->data.bo_set_flags.flags;
+		break;
+
+	case REC_ADD_FRAMEBUFFER:
+		bo = lookup_bo(r->data.add_framebuffer.bo_id,
+			       r->data.add_framebuffer.ctx_id);
+		if (bo) {
+			bo->is_framebuffer = true;
+			bo->fb = r->data.add_framebuffer;
+		}
+		break;
+
+	case REC_DEL_FRAMEBUFFER:
+		bo = lookup_bo(r->data.del_framebuffer.bo_id,
+			       r->data.del_framebuffer.ctx_id);
+		if (bo)
+			bo->is_framebuffer = false;
+		break;
+
+	case REC_JOB_CTX_CREATE:
+		job_ctx = calloc(1, sizeof(*job_ctx));
+		if (!job_ctx)
+			abort();
+
+		job_ctx->id = r->data.job_ctx_create.id;
+		job_ctx->gr2d = r->data.job_ctx_create.gr2d;
+		list_add_tail(&job_ctx->node, &job_ctxs);
+		break;
+
+	case REC_JOB_CTX_DESTROY:
+		list_for_each_entry(job_ctx, &job_ctxs, node) {
+			if (job_ctx->id == r->data.job_ctx_destroy.id) {
+				list_del(&job_ctx->node);
+				free(job_ctx);
+				break;
+			}
+		}
+		break;
+	}
+}
+
+/* returns the offset of the last keyframe before @start_frame, 0 if none */
+static uint64_t find_keyframe(unsigned int start_frame, unsigned int *frame)
+{
+	struct record_keyframe keyframe;
+	struct record_trailer trailer;
+	struct record_act r;
+	uint64_t offset = 0;
+	unsigned int i;
+
+	if (fseeko64(fin, -(off64_t)sizeof(trailer), SEEK_END) < 0 ||
+	    !rec_read(fin, &trailer, sizeof(trailer)) ||
+	    memcmp(trailer.magic, REC_INDEX_MAGIC, sizeof(trailer.magic)))
+		return 0;
+
+	rec_seek(fin, trailer.index_offset);
+
+	if (!rec_read_action(fin, &r) || r.act != REC_INDEX)
+		return 0;
+
+	rec_seek(fin, trailer.index_offset + sizeof(r.act) +
+		 sizeof(r.data.index) +
+		 (r.data.index.num_frames + 1) * sizeof(uint64_t));
+
+	for (i = 0; i < r.data.index.num_keyframes; i++) {
+		if (!rec_read(fin, &keyframe, sizeof(keyframe)))
+			return 0;
+
+		if (keyframe.frame > start_frame)
+			break;
+
+		offset = keyframe.offset;
+		*frame = keyframe.frame;
+	}
+
+	return offset;
+}
+
+/*
+ * Walks the record up to the start of @start_frame, tracking the objects.
+ * Returns false if the record ends before.
+ */
+static bool seek_frame(unsigned int start_frame)
+{
+	uint64_t keyframe, offset, end = 0;
+	unsigned int frame = 0;
+	struct record_act r;
+
+	keyframe = find_keyframe(start_frame, &frame);
+	if (keyframe) {
+		fprintf(stderr, "Starting at the keyframe of frame %u\n",
+			frame);
+		rec_seek(fin, keyframe);
+
+		/*
+		 * The actions of the keyframe are tracked like any other, the
+		 * frame it ends with was counted already.
+		 */
+		if (!rec_read_action(fin, &r) || r.act != REC_KEYFRAME)
+			return false;
+
+		end = rec_offset(fin) + r.data.keyframe.size;
+	} else {
+		/* the header and the record info were read already */
+		rec_seek(fin, sizeof(r.act) * 2 + sizeof(r.data.header) +
+			 sizeof(r.data.record_info));
+	}
+
+	while (true) {
+		offset = rec_offset(fin);
+
+		if (frame == start_frame && offset >= end)
+			break;
+
+		if (!rec_read_action(fin, &r) || r.act == REC_INDEX)
+			return false;
+
+		if (r.act == REC_DISP_FRAMEBUFFER && offset >= end)
+			frame++;
+
+		if (r.act != REC_KEYFRAME)
+			track_action(&r, offset);
+
+		rec_skip(fin, &r);
+	}
+
+	return true;
+}
+
+/*
+ * Marks the BOs that the actions of the range use, destroying a BO doesn't
+ * count. Returns the number of frames in the range.
+ */
+static unsigned int scan_range(unsigned int count)
+{
+	struct record_gather gather;
+	struct record_reloc reloc;
+	unsigned int frame = 0, i;
+	struct record_act r;
+
+	while (frame < count) {
+		if (!rec_read_action(fin, &r) || r.act == REC_INDEX)
+			break;
+
+		switch (r.act) {
+		case REC_BO_LOAD_DATA:
+			use_bo(r.data.bo_load.id, r.data.bo_load.ctx_id);
+			break;
+
+		case REC_BO_LOAD_REF:
+			use_bo(r.data.bo_load_ref.id,
+			       r.data.bo_load_ref.ctx_id);
+			break;
+
+		case REC_BO_SET_FLAGS:
+			use_bo(r.data.bo_set_flags.id,
+			       r.data.bo_set_flags.ctx_id);
+			break;
+
+		case REC_ADD_FRAMEBUFFER:
+			use_bo(r.data.add_framebuffer.bo_id,
+			       r.data.add_framebuffer.ctx_id);
+			break;
+
+		case REC_DEL_FRAMEBUFFER:
+			use_bo(r.data.del_framebuffer.bo_id,
+			       r.data.del_framebuffer.ctx_id);
+			break;
+
+		case REC_DISP_FRAMEBUFFER:
+			use_bo(r.data.disp_framebuffer.bo_id,
+			       r.data.disp_framebuffer.ctx_id);
+			frame++;
+			break;
+
+		case REC_JOB_SUBMIT:
+			for (i = 0; i < r.data.job_submit.num_gathers; i++) {
+				if (!rec_read(fin, &gather, sizeof(gather)))
+					return frame;
+
+				use_bo(gather.id, gather.ctx_id);
+			}
+
+			for (i = 0; i < r.data.job_submit.num_relocs; i++) {
+				if (!rec_read(fin, &reloc, sizeof(reloc)))
+					return frame;
+
+				use_bo(reloc.id, reloc.ctx_id);
+			}
+			continue;
+		}
+
+		rec_skip(fin, &r);
+	}
+
+	return frame;
+}
+
+/*
+ * Loads a BO page with the data of the REC_BO_LOAD_DATA at @src in the
+ * input. Data that went into the output already is referenced.
+ */
+static void write_page(unsigned int id, unsigned int ctx_id,
+		       unsigned int page, uint64_t src)
+{
+	uint8_t data[4096];
+	struct trim_page *out;
+	struct record_act r;
+	size_t size;
+	int err;
+
+	out = hash_table_lookup(&page_table, src);
+	if (out) {
+		r.act = REC_BO_LOAD_REF;
+		r.data.bo_load_ref.id = id;
+		r.data.bo_load_ref.ctx_id = ctx_id;
+		r.data.bo_load_ref.page_id = page;
+		r.data.bo_load_ref.offset = out->offset;
+
+		write_action(&r);
+		return;
+	}
+
+	rec_seek(fdata, src);
+
+	if (!rec_read_action(fdata, &r) || r.act != REC_BO_LOAD_DATA) {
+		fprintf(stderr, "Invalid page data at %llu\n",
+			(unsigned long long)src);
+		exit(1);
+	}
+
+	size = r.data.bo_load.data_size ?: 4096;
+
+	if (!rec_read(fdata, data, size)) {
+		fprintf(stderr, "Failed to read page data at %llu\n",
+			(unsigned long long)src);
+		exit(1);
+	}
+
+	out = malloc(sizeof(*out));
+	if (!out)
+		abort();
+
+	out->offset = rec_offset(fout);
+
+	err = hash_table_insert(&page_table, src, out);
+	if (err < 0)
+		abort();
+
+	r.data.bo_load.id = id;
+	r.data.bo_load.ctx_id = ctx_id;
+	r.data.bo_load.page_id = page;
+
+	write_action(&r);
+	write_data(data, size);
+}
+
+static void add_frame(void)
+{
+	if (num_frames == max_frames) {
+		max_frames = max_frames ? max_frames * 2 : 256;
+
+		frames = realloc(frames, sizeof(*frames) * max_frames);
+		if (!frames)
+			abort();
+	}
+
+	frames[num_frames++] = rec_offset(fout);
+}
+
+/* creates the objects that are alive at the start of the range */
+static void write_setup(void)
+{
+	struct trim_job_ctx *job_ctx;
+	struct trim_ctx *ctx;
+	struct record_act r;
+	struct trim_bo *bo;
+	unsigned int i;
+
+	list_for_each_entry(ctx, &ctxs, node) {
+		r.act = REC_CTX_CREATE;
+		r.data.ctx_create.id = ctx->id;
+
+		write_action(&r);
+	}
+
+	list_for_each_entry(bo, &bos, node) {
+		if (!bo->used)
+			continue;
+
+		r.act = REC_BO_CREATE;
+		r.data.bo_create.id = bo->id;
+		r.data.bo_create.ctx_id = bo->ctx_id;
+		r.data.bo_create.num_pages = bo->num_pages;
+		r.data.bo_create.flags = bo->flags;
+
+		write_action(&r);
+
+		for (i = 0; i < bo->num_pages; i++)
+			if (bo->pages[i])
+				write_page(bo->id, bo->ctx_id, i, bo->pages[i]);
+	}
+
+	list_for_each_entry(bo, &bos, node) {
+		if (!bo->used || !bo->is_framebuffer)
+			continue;
+
+		r.act = REC_ADD_FRAMEBUFFER;
+		r.data.add_framebuffer = bo->fb;
+
+		write_action(&r);
+	}
+
+	list_for_each_entry(job_ctx, &job_ctxs, node) {
+		r.act = REC_JOB_CTX_CREATE;
+		r.data.job_ctx_create.id = job_ctx->id;
+		r.data.job_ctx_create.gr2d = job_ctx->gr2d;
+
+		write_action(&r);
+	}
+}
+
+/*
+ * Copies the actions of the range. Keyframes are dropped, BOs that weren't
+ * created by the setup aren't destroyed.
+ */
+static void write_range(unsigned int count)
+{
+	unsigned int frame = 0;
+	struct record_act r;
+	struct trim_bo *bo;
+	uint64_t offset;
+	uint8_t *payload;
+	size_t size;
+
+	while (frame < count) {
+		offset = rec_offset(fin);
+
+		if (!rec_read_action(fin, &r) || r.act == REC_INDEX)
+			break;
+
+		switch (r.act) {
+		case REC_KEYFRAME:
+			rec_skip(fin, &r);
+			continue;
+
+		case REC_BO_LOAD_DATA:
+			write_page(r.data.bo_load.id, r.data.bo_load.ctx_id,
+				   r.data.bo_load.page_id, offset);
+			track_action(&r, offset);
+			rec_skip(fin, &r);
+			continue;
+
+		case REC_BO_LOAD_REF:
+			write_page(r.data.bo_load_ref.id,
+				   r.data.bo_load_ref.ctx_id,
+				   r.data.bo_load_ref.page_id,
+				   r.data.bo_load_ref.offset);
+			track_action(&r, offset);
+			continue;
+
+		case REC_BO_CREATE:
+			track_action(&r, offset);
+			use_bo(r.data.bo_create.id, r.data.bo_create.ctx_id);
+			break;
+
+		case REC_BO_DESTROY:
+			bo = lookup_bo(r.data.bo_destroy.id,
+				       r.data.bo_destroy.ctx_id);
+			if (bo && !bo->used) {
+				track_action(&r, offset);
+				continue;
+			}
+
+			track_action(&r, offset);
+			break;
+
+		default:
+			track_action(&r, offset);
+			break;
+		}
+
+		write_action(&r);
+
+		size = rec_payload_size(&r);
+		if (size) {
+			payload = malloc(size);
+			if (!payload || !rec_read(fin, payload, size)) {
+				fprintf(stderr, "Failed to read action %u\n",
+					r.act);
+				exit(1);
+			}
+
+			write_data(payload, size);
+			free(payload);
+		}
+
+		if (r.act == REC_DISP_FRAMEBUFFER) {
+			frame++;
+
+			if (frame < count)
+				add_frame();
+		}
+	}
+}
+
+static void write_index(void)
+{
+	struct record_trailer trailer;
+	struct record_act r;
+
+	/* the last entry is the end of the last frame */
+	add_frame();
+
+	trailer.index_offset = rec_offset(fout);
+	memcpy(trailer.magic, REC_INDEX_MAGIC, sizeof(trailer.magic));
+
+	r.act = REC_INDEX;
+	r.data.index.num_frames = num_frames - 1;
+	r.data.index.num_keyframes = 0;
+
+	write_action(&r);
+	write_data(frames, sizeof(*frames) * num_frames);
+	write_data(&trailer, sizeof(trailer));
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int start_frame = 0, count = 1;
+	const char *path = NULL, *output = NULL;
+	struct record_act header, info;
+	uint64_t range;
+	int c;
+
+	do {
+		struct option long_options[] =
+		{
+			{"recfile",	required_argument, NULL, 0},
+			{"output",	required_argument, NULL, 0},
+			{"start-frame",	required_argument, NULL, 0},
+			{"frames",	required_argument, NULL, 0},
+			{ /* Sentinel */ }
+		};
+		int option_index = 0;
+
+		c = getopt_long(argc, argv, "h", long_options, &option_index);
+
+		switch (c) {
+		case 0:
+			switch (option_index) {
+			case 0:
+				path = optarg;
+				break;
+
+			case 1:
+				output = optarg;
+				break;
+
+			case 2:
+				start_frame = strtoul(optarg, NULL, 0);
+				break;
+
+			case 3:
+				count = strtoul(optarg, NULL, 0);
+				break;
+
+			default:
+				return 0;
+			}
+
+		case -1:
+			break;
+
+		default:
+			fprintf(stderr, "Invalid arguments\n\n");
+			return 1;
+		}
+	} while (c != -1);
+
+	if (!path || !output) {
+		fprintf(stderr, "'--recfile path' and '--output path' are required\n\n");
+		return 1;
+	}
+
+	fin = fopen64(path, "r");
+	fdata = fopen64(path, "r");
+	if (!fin || !fdata) {
+		fprintf(stderr, "Failed to open %s: %s\n", path,
+			strerror(errno));
+		return 1;
+	}
+
+	if (!rec_read_action(fin, &header) || header.act != REC_START ||
+	    strncmp(header.data.header.magic, REC_MAGIC,
+		    sizeof(header.data.header.magic)) ||
+	    header.data.header.version < REC_MIN_VER ||
+	    header.data.header.version > REC_VER ||
+	    !rec_read_action(fin, &info) || info.act != REC_INFO) {
+		fprintf(stderr, "Invalid record\n");
+		return 1;
+	}
+
+	if (!seek_frame(start_frame)) {
+		fprintf(stderr, "Record ends before frame %u\n", start_frame);
+		return 1;
+	}
+
+	range = rec_offset(fin);
+	count = scan_range(count);
+	rec_seek(fin, range);
+
+	if (!count) {
+		fprintf(stderr, "Record has no frames after %u\n", start_frame);
+		return 1;
+	}
+
+	fout = fopen64(output, "w");
+	if (!fout) {
+		fprintf(stderr, "Failed to open %s: %s\n", output,
+			strerror(errno));
+		return 1;
+	}
+
+	header.data.header.version = REC_VER;
+
+	write_action(&header);
+	write_action(&info);
+
+	add_frame();
+	write_setup();
+	write_range(count);
+	write_index();
+
+	if (fclose(fout)) {
+		fprintf(stderr, "Failed to write %s: %s\n", output,
+			strerror(errno));
+		return 1;
+	}
+
+	fprintf(stderr, "Wrote frames %u to %u into %s\n", start_frame,
+		start_frame + count - 1, output);
+
+	return 0;
+}